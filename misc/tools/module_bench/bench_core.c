@@ -0,0 +1,302 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <syslog.h>
+#include <sys/mman.h>
+#include <arpa/inet.h>
+
+#include "core/mem/memapi.h"
+#include "core/dprint.h"
+#include "core/ip_addr.h"
+#include "core/resolve.h"
+
+#include "bench_core.h"
+
+#define BENCH_MEM_HDR 16
+
+sr_pkg_api_t _pkg_root;
+sr_shm_api_t _shm_root;
+
+static size_t bench_mem_used[2];
+static size_t bench_mem_peak;
+
+/* mapping serving shared memory, see bench_core_init_shared(), its first
+ * bytes keeping the used size for all the processes */
+static char *bench_shared;
+static size_t bench_shared_size;
+
+int process_no = 0;
+int log_stderr = 1;
+int log_color = 0;
+str *log_prefix_val = NULL;
+volatile int dprint_crit = 0;
+km_log_f _km_log_func = NULL;
+ksr_slog_f _ksr_slog_func = NULL;
+
+struct log_level_info log_level_info[] = {{"ALERT", LOG_ALERT},
+		{"BUG", LOG_CRIT}, {"CRITICAL", LOG_CRIT}, {"", LOG_CRIT},
+		{"ERROR", LOG_ERR}, {"WARNING", LOG_WARNING}, {"NOTICE", LOG_NOTICE},
+		{"INFO", LOG_INFO}, {"DEBUG", LOG_DEBUG}};
+
+/* pid kept per process_no, as the process table of kamailio, forked
+ * processes setting their own process_no */
+int my_pid(void)
+{
+	static int pid_no = -1;
+	static int pid;
+
+	if(pid_no != process_no) {
+		pid = (int)getpid();
+		pid_no = process_no;
+	}
+	return pid;
+}
+
+int get_debug_level(char *mname, int mnlen)
+{
+	return L_ERR;
+}
+
+int get_debug_facility(char *mname, int mnlen)
+{
+	return LOG_DAEMON;
+}
+
+void dprint_color(int level)
+{
+}
+
+void dprint_color_reset(void)
+{
+}
+
+static void *bench_malloc(int shm, size_t size)
+{
+	char *p;
+
+	if(shm && bench_shared) {
+		p = bench_shared
+			+ __atomic_fetch_add((size_t *)bench_shared,
+					(size + 2 * BENCH_MEM_HDR - 1)
+							& ~((size_t)BENCH_MEM_HDR - 1),
+					__ATOMIC_RELAXED);
+		if(p + size + BENCH_MEM_HDR > bench_shared + bench_shared_size) {
+			return NULL;
+		}
+	} else {
+		p = malloc(size + BENCH_MEM_HDR);
+	}
+	if(p == NULL) {
+		return NULL;
+	}
+	*(size_t *)p = size;
+	bench_mem_used[shm] += size;
+	if(shm && bench_mem_used[shm] > bench_mem_peak) {
+		bench_mem_peak = bench_mem_used[shm];
+	}
+	return p + BENCH_MEM_HDR;
+}
+
+static void bench_free(int shm, void *p)
+{
+	if(p == NULL) {
+		return;
+	}
+	p = (char *)p - BENCH_MEM_HDR;
+	bench_mem_used[shm] -= *(size_t *)p;
+	if(shm && bench_shared) {
+		return;
+	}
+	free(p);
+}
+
+static void *bench_realloc(int shm, void *p, size_t size)
+{
+	void *n;
+	size_t osize;
+
+	n = bench_malloc(shm, size);
+	if(n == NULL || p == NULL) {
+		return n;
+	}
+	osize = *(size_t *)((char *)p - BENCH_MEM_HDR);
+	memcpy(n, p, (osize < size) ? osize : size);
+	bench_free(shm, p);
+	return n;
+}
+
+static void *bench_pkg_malloc(void *mbp, size_t size)
+{
+	return bench_malloc(0, size);
+}
+
+static void *bench_pkg_mallocxz(void *mbp, size_t size)
+{
+	void *p;
+
+	p = bench_malloc(0, size);
+	if(p != NULL) {
+		memset(p, 0, size);
+	}
+	return p;
+}
+
+static void bench_pkg_free(void *mbp, void *p)
+{
+	bench_free(0, p);
+}
+
+static void *bench_pkg_realloc(void *mbp, void *p, size_t size)
+{
+	return bench_realloc(0, p, size);
+}
+
+static void *bench_shm_malloc(void *mbp, size_t size)
+{
+	return bench_malloc(1, size);
+}
+
+static void *bench_shm_mallocxz(void *mbp, size_t size)
+{
+	void *p;
+
+	p = bench_malloc(1, size);
+	if(p != NULL) {
+		memset(p, 0, size);
+	}
+	return p;
+}
+
+static void bench_shm_free(void *mbp, void *p)
+{
+	bench_free(1, p);
+}
+
+static void *bench_shm_realloc(void *mbp, void *p, size_t size)
+{
+	return bench_realloc(1, p, size);
+}
+
+static void bench_shm_glock(void *mbp)
+{
+}
+
+void bench_core_init(void)
+{
+	memset(&_pkg_root, 0, sizeof(_pkg_root));
+	_pkg_root.mname = "bench";
+	_pkg_root.xmalloc = bench_pkg_malloc;
+	_pkg_root.xmallocxz = bench_pkg_mallocxz;
+	_pkg_root.xrealloc = bench_pkg_realloc;
+	_pkg_root.xreallocxf = bench_pkg_realloc;
+	_pkg_root.xfree = bench_pkg_free;
+
+	memset(&_shm_root, 0, sizeof(_shm_root));
+	_shm_root.mname = "bench";
+	_shm_root.xmalloc = bench_shm_malloc;
+	_shm_root.xmallocxz = bench_shm_mallocxz;
+	_shm_root.xmalloc_unsafe = bench_shm_malloc;
+	_shm_root.xrealloc = bench_shm_realloc;
+	_shm_root.xreallocxf = bench_shm_realloc;
+	_shm_root.xfree = bench_shm_free;
+	_shm_root.xfree_unsafe = bench_shm_free;
+	_shm_root.xglock = bench_shm_glock;
+	_shm_root.xgunlock = bench_shm_glock;
+}
+
+int bench_core_init_shared(size_t size)
+{
+	bench_core_init();
+	bench_shared = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if(bench_shared == MAP_FAILED) {
+		bench_shared = NULL;
+		return -1;
+	}
+	bench_shared_size = size;
+	*(size_t *)bench_shared = BENCH_MEM_HDR;
+	return 0;
+}
+
+size_t bench_shm_used(void)
+{
+	return bench_mem_used[1];
+}
+
+size_t bench_pkg_used(void)
+{
+	return bench_mem_used[0];
+}
+
+size_t bench_shm_peak(void)
+{
+	return bench_mem_peak;
+}
+
+void bench_shm_peak_reset(void)
+{
+	bench_mem_peak = bench_mem_used[1];
+}
+
+double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* address parsing of core/resolve.c, done with inet_pton() */
+static ip_addr_t *bench_str2ip(str *st, int af)
+{
+	static ip_addr_t ip;
+	char buf[INET6_ADDRSTRLEN + 1];
+
+	if(st == NULL || st->s == NULL || st->len <= 0
+			|| st->len > INET6_ADDRSTRLEN) {
+		return NULL;
+	}
+	memcpy(buf, st->s, st->len);
+	buf[st->len] = '\0';
+	memset(&ip, 0, sizeof(ip));
+	if(inet_pton(af, buf, ip.u.addr) != 1) {
+		return NULL;
+	}
+	ip.af = af;
+	ip.len = (af == AF_INET) ? 4 : 16;
+	return &ip;
+}
+
+ip_addr_t *str2ip(str *st)
+{
+	return bench_str2ip(st, AF_INET);
+}
+
+ip_addr_t *str2ip6(str *st)
+{
+	return bench_str2ip(st, AF_INET6);
+}
@@ -0,0 +1,54 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Minimal core environment to run module code out of kamailio: shared and
+ * private memory served by malloc() with the allocated sizes accounted,
+ * logging to stderr of errors only, and a monotonic clock for the reports.
+ */
+
+#ifndef _BENCH_CORE_H_
+#define _BENCH_CORE_H_
+
+#include <stddef.h>
+
+/* set the memory roots, to be called before any module code */
+void bench_core_init(void);
+
+/* same, with the shared memory served from a mapping of size bytes kept
+ * by the forked processes, as the shared memory of kamailio; the memory
+ * is not reused once freed and the sizes are accounted per process
+ * returns 0 on success, -1 on error */
+int bench_core_init_shared(size_t size);
+
+/* bytes currently allocated in shared and private memory */
+size_t bench_shm_used(void);
+size_t bench_pkg_used(void);
+
+/* maximum of bytes allocated at a time since the last reset */
+size_t bench_shm_peak(void);
+void bench_shm_peak_reset(void);
+
+/* monotonic time in seconds */
+double bench_now(void);
+
+#endif
@@ -0,0 +1,297 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Rule matching of dp_translate() in modules/dialplan: <rules> regular
+ * expression rules of one dpid, each for its own number prefix, are loaded
+ * by init_data() of dp_db.c from an in memory database driver, then
+ * dp_translate_helper() of dp_repl.c finds the rule of numbers spread over
+ * all prefixes, checking first that each number gets the rule of its
+ * prefix (from the rule attributes). The rules are anchored
+ * (^\+49<prefix>[0-9]{7}$) or not (49<prefix>[0-9]{7}$). Only the matching
+ * is run, the rules have no replacement, as it costs the same with and
+ * without match_compiled.
+ *   test-dialplan-translate <seconds> <rules> <anchored|unanchored>
+ *           <match_compiled>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/re.h"
+#include "core/str_list.h"
+#include "core/usr_avp.h"
+#include "core/pvar.h"
+#include "lib/srdb1/db.h"
+#include "modules/dialplan/dialplan.h"
+
+#include "bench_core.h"
+
+#define BENCH_INPUTS 4096
+
+/* parameters and globals of dialplan.c */
+pcre2_general_context *dpl_gctx = NULL;
+pcre2_compile_context *dpl_ctx = NULL;
+int dp_fetch_rows = 1000;
+int dp_match_dynamic = 0;
+int dp_match_compiled = 0;
+
+/* core functions used by the module, not called for these rules */
+char ut_buf_int2str[INT2STR_MAX_LEN];
+
+int parse_repl(struct replace_with *rw, char **begin, char *end,
+		int *max_token_no, int with_sep)
+{
+	return -1;
+}
+
+struct str_list *append_str_list(
+		char *s, int len, struct str_list **last, int *total)
+{
+	return NULL;
+}
+
+int str_append(str *orig, str *suffix, str *dest)
+{
+	return -1;
+}
+
+int pv_elem_free_all(pv_elem_p log)
+{
+	return 0;
+}
+
+int pv_get_spec_value(struct sip_msg *msg, pv_spec_p sp, pv_value_t *value)
+{
+	return -1;
+}
+
+int pv_parse_format(str *in, pv_elem_p *el)
+{
+	return -1;
+}
+
+int pv_printf_s(struct sip_msg *msg, pv_elem_p list, str *s)
+{
+	return -1;
+}
+
+pv_spec_t *pv_spec_lookup(str *name, int *len)
+{
+	return NULL;
+}
+
+int pv_get_avp_name(struct sip_msg *msg, pv_param_p ip, avp_name_t *avp_name,
+		avp_flags_t *name_type)
+{
+	return -1;
+}
+
+void get_avp_val(avp_t *avp, avp_value_t *val)
+{
+}
+
+avp_t *search_first_avp(avp_flags_t flags, avp_name_t name, avp_value_t *val,
+		struct search_state *state)
+{
+	return NULL;
+}
+
+avp_t *search_next_avp(struct search_state *state, avp_value_t *val)
+{
+	return NULL;
+}
+
+/* in memory database driver returning the dialplan rows */
+static db1_res_t bench_res;
+static db1_con_t bench_con;
+
+static db1_con_t *bench_db_init(const str *url)
+{
+	return &bench_con;
+}
+
+static void bench_db_close(db1_con_t *h)
+{
+}
+
+static int bench_db_use_table(db1_con_t *h, const str *t)
+{
+	return 0;
+}
+
+static int bench_db_query(const db1_con_t *h, const db_key_t *k,
+		const db_op_t *op, const db_val_t *v, const db_key_t *c, const int n,
+		const int nc, const db_key_t o, db1_res_t **r)
+{
+	*r = &bench_res;
+	return 0;
+}
+
+static int bench_db_free_result(db1_con_t *h, db1_res_t *r)
+{
+	return 0;
+}
+
+int db_bind_mod(const str *mod, db_func_t *dbf)
+{
+	memset(dbf, 0, sizeof(db_func_t));
+	dbf->init = bench_db_init;
+	dbf->close = bench_db_close;
+	dbf->use_table = bench_db_use_table;
+	dbf->query = bench_db_query;
+	dbf->free_result = bench_db_free_result;
+	return 0;
+}
+
+int db_check_table_version(
+		db_func_t *dbf, db1_con_t *dbh, const str *table, const unsigned int v)
+{
+	return 0;
+}
+
+static void bench_set_int(db_val_t *v, int i)
+{
+	v->type = DB1_INT;
+	v->val.int_val = i;
+}
+
+static void bench_set_str(db_val_t *v, char *s)
+{
+	v->type = DB1_STR;
+	v->val.str_val.s = s;
+	v->val.str_val.len = strlen(s);
+}
+
+/* columns: dpid, pr, match_op, match_exp, match_len, subst_exp, repl_exp,
+ * attrs */
+static int bench_rows(int rules, int anchored)
+{
+	db_val_t *vals;
+	char *exp;
+	char *tag;
+	int i;
+
+	bench_res.rows = calloc(rules, sizeof(db_row_t));
+	vals = calloc(rules * 8, sizeof(db_val_t));
+	if(bench_res.rows == NULL || vals == NULL) {
+		return -1;
+	}
+	for(i = 0; i < rules; i++) {
+		exp = malloc(64);
+		tag = malloc(16);
+		if(exp == NULL || tag == NULL) {
+			return -1;
+		}
+		snprintf(tag, 16, "%d", i);
+		if(anchored) {
+			snprintf(exp, 64, "^\\+49%d[0-9]{7}$", 1000 + i);
+		} else {
+			snprintf(exp, 64, "49%d[0-9]{7}$", 1000 + i);
+		}
+		bench_res.rows[i].values = vals + i * 8;
+		bench_res.rows[i].n = 8;
+		bench_set_int(vals + i * 8, 1);
+		bench_set_int(vals + i * 8 + 1, i);
+		bench_set_int(vals + i * 8 + 2, DP_REGEX_OP);
+		bench_set_str(vals + i * 8 + 3, exp);
+		bench_set_int(vals + i * 8 + 4, 0);
+		bench_set_str(vals + i * 8 + 5, "");
+		bench_set_str(vals + i * 8 + 6, "");
+		bench_set_str(vals + i * 8 + 7, tag);
+	}
+	bench_res.n = rules;
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	static char inputs[BENCH_INPUTS][32];
+	unsigned long long translations = 0;
+	dpl_id_p idp;
+	str input;
+	str attrs;
+	double t0, t1;
+	int duration;
+	int rules;
+	int anchored;
+	int i;
+
+	if(argc != 5) {
+		fprintf(stderr,
+				"Usage: %s <seconds> <rules> <anchored|unanchored> "
+				"<match_compiled>\n",
+				argv[0]);
+		return 1;
+	}
+	duration = atoi(argv[1]);
+	rules = atoi(argv[2]);
+	anchored = (strcmp(argv[3], "anchored") == 0);
+	dp_match_compiled = atoi(argv[4]);
+	if(duration <= 0 || rules <= 0) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	bench_core_init();
+	if(bench_rows(rules, anchored) < 0 || init_data() != 0) {
+		fprintf(stderr, "Error: failed to load the rules\n");
+		return 1;
+	}
+	idp = select_dpid(1);
+	if(idp == NULL) {
+		fprintf(stderr, "Error: no rules loaded\n");
+		return 1;
+	}
+	for(i = 0; i < BENCH_INPUTS; i++) {
+		snprintf(inputs[i], sizeof(inputs[i]), "+49%d%07d",
+				1000 + (i * 7919) % rules, i);
+		input.s = inputs[i];
+		input.len = strlen(input.s);
+		if(dp_translate_helper(NULL, &input, NULL, idp, &attrs) != 0
+				|| attrs.s == NULL || atoi(attrs.s) != (i * 7919) % rules) {
+			fprintf(stderr, "Error: wrong rule for %s\n", inputs[i]);
+			return 1;
+		}
+	}
+
+	t0 = bench_now();
+	do {
+		for(i = 0; i < 100; i++) {
+			input.s = inputs[(translations + i) % BENCH_INPUTS];
+			input.len = strlen(input.s);
+			if(dp_translate_helper(NULL, &input, NULL, idp, &attrs) != 0) {
+				fprintf(stderr, "Error: no rule for %s\n", input.s);
+				return 1;
+			}
+		}
+		translations += 100;
+		t1 = bench_now();
+	} while(t1 - t0 < duration);
+
+	printf("rules: %d %s match_compiled: %d\n", rules,
+			(anchored) ? "anchored" : "unanchored", dp_match_compiled);
+	printf("translations/sec: %.0f\n", (double)translations / (t1 - t0));
+	printf("shm memory: %zu bytes\n", bench_shm_used());
+	return 0;
+}
@@ -0,0 +1,249 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Remapping of hash values by ds_hmap_lookup() in modules/dispatcher when
+ * a destination goes down and comes back, for the modulo, ring and maglev
+ * mappings of ds_hmap.c: a set of <destinations> is built by
+ * ds_hmap_build(), then each destination in turn is marked inactive, the
+ * <hash values> are mapped again and the destination is marked active.
+ * Reported for each mapping:
+ * - moved: values of the active destinations that went to another one
+ *   (average and maximum over the destination taken down)
+ * - spread: largest part of the values of the down destination that went
+ *   to a single other destination
+ * - rebuild: time of ds_hmap_state_change() for one state change
+ *   test-dispatcher-hmap <destinations> <hash values>
+ * The exit code is 1 if a value maps to an inactive destination, if the
+ * ring moves values of an active destination, if the maglev table moves
+ * more than 10% of them, or if a value is not mapped back to its
+ * destination when it comes back.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "modules/dispatcher/dispatch.h"
+#include "modules/dispatcher/ds_hmap.h"
+
+#include "bench_core.h"
+
+/* parameters of dispatcher.c */
+int ds_use_default = 0;
+int ds_hash_mapping = DS_HMAP_MODULO;
+int ds_hash_vnodes = 160;
+
+static const char *bench_mappings[] = {"modulo", "ring", "maglev"};
+
+static unsigned int bench_rand(void)
+{
+	static unsigned int x = 2463534242u;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+static ds_set_t *bench_set(int dests)
+{
+	ds_set_t *dset;
+	char *uri;
+	int i;
+
+	dset = (ds_set_t *)shm_malloc(sizeof(ds_set_t));
+	if(dset == NULL) {
+		return NULL;
+	}
+	memset(dset, 0, sizeof(ds_set_t));
+	/* items aligned to a cache line, as allocated by ds_dest_alloc() */
+	uri = (char *)shm_malloc(dests * sizeof(ds_dest_t) + DS_CACHELINE_SIZE);
+	if(uri == NULL) {
+		return NULL;
+	}
+	dset->dlist = (ds_dest_t *)(((unsigned long)uri + DS_CACHELINE_SIZE - 1)
+								& ~((unsigned long)DS_CACHELINE_SIZE - 1));
+	memset(dset->dlist, 0, dests * sizeof(ds_dest_t));
+	for(i = 0; i < dests; i++) {
+		uri = malloc(32);
+		if(uri == NULL) {
+			return NULL;
+		}
+		snprintf(uri, 32, "sip:10.0.%d.%d:5060", i / 250, 1 + i % 250);
+		dset->dlist[i].uri.s = uri;
+		dset->dlist[i].uri.len = strlen(uri);
+	}
+	dset->nr = dests;
+	dset->id = 1;
+	lock_init(&dset->lock);
+	lock_init(&dset->slock);
+	if(ds_hmap_build(dset) != 0) {
+		return NULL;
+	}
+	return dset;
+}
+
+static int bench_map(ds_set_t *dset, unsigned int *hashes, int *map, int nh)
+{
+	int i;
+
+	for(i = 0; i < nh; i++) {
+		map[i] = ds_hmap_lookup(dset, hashes[i]);
+		if(map[i] < 0 || ds_skip_dst(dset->dlist[map[i]].flags)) {
+			fprintf(stderr, "Error: hash %u mapped to inactive %d\n",
+					hashes[i], map[i]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int bench_mapping(int mapping, int dests, unsigned int *hashes, int nh)
+{
+	ds_set_t *dset;
+	int *map0;
+	int *map1;
+	int *spread;
+	double moved;
+	double moved_max;
+	double moved_sum;
+	double spread_max;
+	double rebuild;
+	double t0;
+	int active;
+	int diffs;
+	int down;
+	int i;
+
+	ds_hash_mapping = mapping;
+	dset = bench_set(dests);
+	map0 = malloc(nh * sizeof(int));
+	map1 = malloc(nh * sizeof(int));
+	spread = malloc(dests * sizeof(int));
+	if(dset == NULL || map0 == NULL || map1 == NULL || spread == NULL) {
+		fprintf(stderr, "Error: failed to build the set\n");
+		return -1;
+	}
+	if(bench_map(dset, hashes, map0, nh) < 0) {
+		return -1;
+	}
+
+	moved_max = moved_sum = spread_max = rebuild = 0;
+	for(down = 0; down < dests; down++) {
+		t0 = bench_now();
+		dset->dlist[down].flags |= DS_INACTIVE_DST;
+		ds_hmap_state_change(0, DS_INACTIVE_DST, dset);
+		rebuild += bench_now() - t0;
+		if(bench_map(dset, hashes, map1, nh) < 0) {
+			return -1;
+		}
+		memset(spread, 0, dests * sizeof(int));
+		active = diffs = 0;
+		for(i = 0; i < nh; i++) {
+			if(map0[i] == down) {
+				spread[map1[i]]++;
+				continue;
+			}
+			active++;
+			if(map1[i] != map0[i]) {
+				diffs++;
+			}
+		}
+		moved = (active > 0) ? 100.0 * diffs / active : 0;
+		moved_sum += moved;
+		if(moved > moved_max) {
+			moved_max = moved;
+		}
+		for(i = 0; i < dests; i++) {
+			if(nh - active > 0
+					&& 100.0 * spread[i] / (nh - active) > spread_max) {
+				spread_max = 100.0 * spread[i] / (nh - active);
+			}
+		}
+
+		t0 = bench_now();
+		dset->dlist[down].flags &= ~DS_INACTIVE_DST;
+		ds_hmap_state_change(DS_INACTIVE_DST, 0, dset);
+		rebuild += bench_now() - t0;
+		if(bench_map(dset, hashes, map1, nh) < 0) {
+			return -1;
+		}
+		for(i = 0; i < nh; i++) {
+			if(map1[i] != map0[i]) {
+				fprintf(stderr, "Error: %s - hash %u not restored on %d\n",
+						bench_mappings[mapping], hashes[i], map0[i]);
+				return -1;
+			}
+		}
+	}
+
+	printf("%-6s moved: %6.2f%% avg %6.2f%% max  spread: %6.2f%%"
+		   "  rebuild: %8.1f us\n",
+			bench_mappings[mapping], moved_sum / dests, moved_max, spread_max,
+			rebuild * 1e6 / (2 * dests));
+	ds_hmap_free(dset);
+
+	if((mapping == DS_HMAP_RING && moved_max > 0)
+			|| (mapping == DS_HMAP_MAGLEV && moved_max > 10)) {
+		fprintf(stderr, "Error: %s moved too many values\n",
+				bench_mappings[mapping]);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int *hashes;
+	int dests;
+	int nh;
+	int i;
+
+	if(argc != 3) {
+		fprintf(stderr, "Usage: %s <destinations> <hash values>\n", argv[0]);
+		return 1;
+	}
+	dests = atoi(argv[1]);
+	nh = atoi(argv[2]);
+	if(dests <= 1 || nh <= 0) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	bench_core_init();
+	hashes = malloc(nh * sizeof(unsigned int));
+	if(hashes == NULL) {
+		return 1;
+	}
+	for(i = 0; i < nh; i++) {
+		hashes[i] = bench_rand();
+	}
+
+	printf("destinations: %d hash values: %d\n", dests, nh);
+	for(i = DS_HMAP_MODULO; i <= DS_HMAP_MAGLEV; i++) {
+		if(bench_mapping(i, dests, hashes, nh) < 0) {
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,301 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Contention on the call load of destinations in modules/dispatcher:
+ * <workers> threads select the least loaded destination of a set of
+ * <destinations> (as ds_get_leastloaded() for alg 10), increment its load
+ * and decrement the load of the call selected 16 selections before, as
+ * DS_LOAD_INC/DS_LOAD_DEC of dispatch.c. Layouts:
+ * - locked: ds_dest_t fields in the order before the runtime state was
+ *   moved apart, selection and load updates under the set lock
+ * - unpadded: same fields, selection without lock, atomic load updates
+ * - aligned: ds_dest_t items aligned to a cache line, as allocated by
+ *   ds_dest_alloc(), selection without lock, atomic load updates
+ *   test-dispatcher-load <seconds> <workers> <destinations>
+ *           <locked|unpadded|aligned>
+ * The exit code is 1 if a load is not back to 0 once all the workers
+ * decremented the load of their pending calls.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "core/atomic_ops.h"
+#include "modules/dispatcher/dispatch.h"
+
+#include "bench_core.h"
+
+#define BENCH_PENDING 16
+
+/* ds_dest_t fields read by selection, in the order before the runtime
+ * state was moved apart */
+typedef struct bench_dest
+{
+	str uri;
+	str host;
+	int flags;
+	int priority;
+	int dload;
+	ds_attrs_t attrs;
+	ds_latency_stats_t latency_stats;
+	int irmode;
+	struct socket_info *sock;
+	struct ip_addr ip_address;
+} bench_dest_t;
+
+/* one cache line per worker, apart from the others */
+typedef struct bench_worker
+{
+	pthread_t tid __attribute__((aligned(DS_CACHELINE_SIZE)));
+	unsigned long long selections;
+	int pending[BENCH_PENDING];
+} bench_worker_t;
+
+enum
+{
+	BENCH_LOCKED = 0,
+	BENCH_UNPADDED,
+	BENCH_ALIGNED
+};
+
+static int bench_mode;
+static int bench_nr;
+static bench_dest_t *bench_old;
+static ds_dest_t *bench_new;
+static gen_lock_t bench_lock;
+static pthread_barrier_t bench_start;
+static volatile int bench_stop;
+
+/* DS_LOAD_DEC of dispatch.c */
+static inline void bench_load_dec(int *dl)
+{
+	int dv;
+
+	do {
+		dv = atomic_get_int(dl);
+	} while(dv > 0 && atomic_cmpxchg_int(dl, dv, dv - 1) != dv);
+}
+
+/* ds_get_leastloaded() of dispatch.c on the old layout */
+static int bench_leastloaded_old(void)
+{
+	int j;
+	int k;
+	int t;
+	int l;
+
+	k = -1;
+	t = 0x7fffffff;
+	for(j = 0; j < bench_nr; j++) {
+		if(ds_skip_dst(atomic_get_int(&bench_old[j].flags)))
+			continue;
+		l = atomic_get_int(&bench_old[j].dload);
+		if((bench_old[j].attrs.maxload == 0 || l < bench_old[j].attrs.maxload)
+				&& l < t) {
+			k = j;
+			t = l;
+		}
+	}
+	return k;
+}
+
+/* ds_get_leastloaded() of dispatch.c */
+static int bench_leastloaded_new(void)
+{
+	int j;
+	int k;
+	int t;
+	int l;
+
+	k = -1;
+	t = 0x7fffffff;
+	for(j = 0; j < bench_nr; j++) {
+		if(ds_skip_dst(atomic_get_int(&bench_new[j].flags)))
+			continue;
+		l = atomic_get_int(&bench_new[j].dload);
+		if((bench_new[j].attrs.maxload == 0 || l < bench_new[j].attrs.maxload)
+				&& l < t) {
+			k = j;
+			t = l;
+		}
+	}
+	return k;
+}
+
+static void bench_select(bench_worker_t *w, int slot)
+{
+	int k;
+
+	switch(bench_mode) {
+		case BENCH_LOCKED:
+			lock_get(&bench_lock);
+			if(w->pending[slot] >= 0 && bench_old[w->pending[slot]].dload > 0)
+				bench_old[w->pending[slot]].dload--;
+			k = bench_leastloaded_old();
+			if(k >= 0)
+				bench_old[k].dload++;
+			lock_release(&bench_lock);
+			break;
+		case BENCH_UNPADDED:
+			if(w->pending[slot] >= 0)
+				bench_load_dec(&bench_old[w->pending[slot]].dload);
+			k = bench_leastloaded_old();
+			if(k >= 0)
+				atomic_inc_int(&bench_old[k].dload);
+			break;
+		default:
+			if(w->pending[slot] >= 0)
+				bench_load_dec(&bench_new[w->pending[slot]].dload);
+			k = bench_leastloaded_new();
+			if(k >= 0)
+				atomic_inc_int(&bench_new[k].dload);
+			break;
+	}
+	w->pending[slot] = k;
+}
+
+static void *bench_worker_run(void *arg)
+{
+	bench_worker_t *w = (bench_worker_t *)arg;
+	int i;
+
+	pthread_barrier_wait(&bench_start);
+	while(bench_stop == 0) {
+		for(i = 0; i < 100; i++) {
+			bench_select(w, (w->selections + i) % BENCH_PENDING);
+		}
+		w->selections += 100;
+	}
+	return NULL;
+}
+
+static void *bench_aligned_alloc(size_t size)
+{
+	char *p;
+
+	p = (char *)shm_malloc(size + DS_CACHELINE_SIZE - 1);
+	if(p == NULL)
+		return NULL;
+	p = (char *)(((unsigned long)p + DS_CACHELINE_SIZE - 1)
+				 & ~((unsigned long)DS_CACHELINE_SIZE - 1));
+	memset(p, 0, size);
+	return p;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long selections = 0;
+	bench_worker_t *workers;
+	double t0, t1;
+	int duration;
+	int nworkers;
+	int i;
+	int k;
+
+	if(argc != 5) {
+		fprintf(stderr,
+				"Usage: %s <seconds> <workers> <destinations> "
+				"<locked|unpadded|aligned>\n",
+				argv[0]);
+		return 1;
+	}
+	duration = atoi(argv[1]);
+	nworkers = atoi(argv[2]);
+	bench_nr = atoi(argv[3]);
+	if(strcmp(argv[4], "locked") == 0) {
+		bench_mode = BENCH_LOCKED;
+	} else if(strcmp(argv[4], "unpadded") == 0) {
+		bench_mode = BENCH_UNPADDED;
+	} else {
+		bench_mode = BENCH_ALIGNED;
+	}
+	if(duration <= 0 || nworkers <= 0 || bench_nr <= 0) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	bench_core_init();
+	lock_init(&bench_lock);
+	bench_old = (bench_dest_t *)shm_malloc(bench_nr * sizeof(bench_dest_t));
+	bench_new = (ds_dest_t *)bench_aligned_alloc(bench_nr * sizeof(ds_dest_t));
+	workers = (bench_worker_t *)bench_aligned_alloc(
+			nworkers * sizeof(bench_worker_t));
+	if(bench_old == NULL || bench_new == NULL || workers == NULL) {
+		fprintf(stderr, "Error: failed to allocate the set\n");
+		return 1;
+	}
+	memset(bench_old, 0, bench_nr * sizeof(bench_dest_t));
+	pthread_barrier_init(&bench_start, NULL, nworkers + 1);
+	for(i = 0; i < nworkers; i++) {
+		for(k = 0; k < BENCH_PENDING; k++) {
+			workers[i].pending[k] = -1;
+		}
+		if(pthread_create(&workers[i].tid, NULL, bench_worker_run, workers + i)
+				!= 0) {
+			fprintf(stderr, "Error: failed to start the workers\n");
+			return 1;
+		}
+	}
+
+	pthread_barrier_wait(&bench_start);
+	t0 = bench_now();
+	do {
+		usleep(10000);
+		t1 = bench_now();
+	} while(t1 - t0 < duration);
+	bench_stop = 1;
+	for(i = 0; i < nworkers; i++) {
+		pthread_join(workers[i].tid, NULL);
+		selections += workers[i].selections;
+	}
+	t1 = bench_now();
+
+	/* end the pending calls, all loads have to be back to 0 */
+	for(i = 0; i < nworkers; i++) {
+		for(k = 0; k < BENCH_PENDING; k++) {
+			if(workers[i].pending[k] < 0)
+				continue;
+			if(bench_mode == BENCH_ALIGNED) {
+				bench_load_dec(&bench_new[workers[i].pending[k]].dload);
+			} else {
+				bench_load_dec(&bench_old[workers[i].pending[k]].dload);
+			}
+		}
+	}
+	for(i = 0; i < bench_nr; i++) {
+		k = (bench_mode == BENCH_ALIGNED) ? bench_new[i].dload
+										  : bench_old[i].dload;
+		if(k != 0) {
+			fprintf(stderr, "Error: load %d left on destination %d\n", k, i);
+			return 1;
+		}
+	}
+
+	printf("workers: %d destinations: %d layout: %s\n", nworkers, bench_nr,
+			argv[4]);
+	printf("selections/sec: %.0f\n", (double)selections / (t1 - t0));
+	return 0;
+}
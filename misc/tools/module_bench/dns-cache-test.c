@@ -0,0 +1,365 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Lookups and eviction of the dns cache of core/dns_cache.c, with its
+ * hash partitions:
+ * - eviction: <names> A records are added by dns_cache_add_record(), one
+ *   per tick, then a random half of them (hot) is looked up again; with
+ *   dns_cache_max_mem set to the memory used by the records and
+ *   dns_cache_del_nonexp set, <names> / 4 more records are added and the
+ *   hot and the other (cold) names still cached are counted, an lru order
+ *   evicting only cold ones
+ * - lookups: <processes> forked processes look up random names of the
+ *   cache, kept in memory shared by them, with dns_get_ip() for <seconds>,
+ *   no name being resolved
+ *   test-dns-cache <seconds> <processes> <names>
+ * The exit code is 1 if more than 1% of the hot names are evicted or if a
+ * lookup fails.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "core/cfg_core.h"
+#include "core/counters.h"
+#include "core/dns_cache.h"
+#include "core/resolve.h"
+#include "core/timer.h"
+#include "core/async_task.h"
+
+#include "bench_core.h"
+
+/* core symbols the dns cache needs, no name being resolved */
+struct cfg_group_core default_core_cfg;
+void *core_cfg = &default_core_cfg;
+struct dns_counters_h dns_cnts_h;
+struct dns_func_t dns_func;
+static counter_array_t bench_cnts[64];
+counter_array_t *_cnts_vals = bench_cnts;
+int _cnts_row_len = 0;
+int _cnts_threaded = 0;
+
+static volatile ticks_t bench_ticks = 1;
+static struct timer_ln *bench_timer;
+static int bench_names;
+static unsigned char *bench_hot;
+
+int counters_initialized(void)
+{
+	return 0;
+}
+
+void counter_inc_atomic(counter_handle_t handle)
+{
+}
+
+ticks_t get_ticks_raw(void)
+{
+	return bench_ticks;
+}
+
+unsigned int fastrand_max(unsigned int max)
+{
+	return 0;
+}
+
+struct timer_ln *timer_alloc(void)
+{
+	return bench_timer;
+}
+
+void timer_free(struct timer_ln *t)
+{
+}
+
+int timer_add_safe(struct timer_ln *tl, ticks_t delta)
+{
+	return 0;
+}
+
+int timer_del_safe(struct timer_ln *tl)
+{
+	return 0;
+}
+
+int async_task_push(async_task_t *task)
+{
+	return -1;
+}
+
+int async_task_workers_active(void)
+{
+	return 0;
+}
+
+struct rdata *get_record(char *name, int type, int flags)
+{
+	return NULL;
+}
+
+void free_rdata_list(struct rdata *head)
+{
+}
+
+void create_srv_name(char proto, str *name, char *srv)
+{
+}
+
+size_t create_srv_pref_list(char *proto, struct dns_srv_proto *list)
+{
+	return 0;
+}
+
+struct hostent *_sip_resolvehost(str *name, unsigned short *port, char *proto)
+{
+	return NULL;
+}
+
+static unsigned int bench_rand(void)
+{
+	static unsigned int x = 2463534242u;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+static void bench_name(int i, char *buf, str *name)
+{
+	name->len = snprintf(buf, 64, "host%d.bench.kamailio.org", i);
+	name->s = buf;
+}
+
+static int bench_add(int i)
+{
+	char buf[64];
+	char ipbuf[32];
+	str name;
+	str ip;
+
+	bench_name(i, buf, &name);
+	ip.len = snprintf(ipbuf, sizeof(ipbuf), "10.%d.%d.%d", (i >> 16) & 0xff,
+			(i >> 8) & 0xff, i & 0xff);
+	ip.s = ipbuf;
+	return dns_cache_add_record(T_A, &name, 3600, &ip, 0, 0, 0, 0);
+}
+
+static int bench_lookup(int i)
+{
+	char buf[64];
+	struct ip_addr ip;
+	str name;
+
+	bench_name(i, buf, &name);
+	return dns_get_ip(&name, &ip, 0);
+}
+
+static int bench_eviction(void)
+{
+	size_t used;
+	int hot_kept;
+	int cold_kept;
+	int hot;
+	int i;
+
+	used = bench_shm_used();
+	default_core_cfg.dns_cache_max_mem = 1 << 30;
+	for(i = 0; i < bench_names; i++) {
+		bench_ticks++;
+		if(bench_add(i) < 0) {
+			fprintf(stderr, "Error: failed to add name %d\n", i);
+			return -1;
+		}
+	}
+	hot = 0;
+	for(i = 0; i < bench_names; i++) {
+		if(bench_rand() & 1) {
+			bench_ticks++;
+			bench_hot[i] = 1;
+			hot++;
+			if(bench_lookup(i) < 0) {
+				fprintf(stderr, "Error: failed to look up name %d\n", i);
+				return -1;
+			}
+		}
+	}
+
+	/* cache full, the next adds free memory */
+	default_core_cfg.dns_cache_max_mem = bench_shm_used() - used;
+	default_core_cfg.dns_cache_del_nonexp = 1;
+	for(i = bench_names; i < bench_names + bench_names / 4; i++) {
+		bench_ticks++;
+		if(bench_add(i) < 0) {
+			fprintf(stderr, "Error: failed to add name %d\n", i);
+			return -1;
+		}
+	}
+	hot_kept = cold_kept = 0;
+	for(i = 0; i < bench_names; i++) {
+		if(bench_lookup(i) == 0) {
+			if(bench_hot[i]) {
+				hot_kept++;
+			} else {
+				cold_kept++;
+			}
+		}
+	}
+	printf("eviction - hot evicted: %6.2f%%  cold evicted: %6.2f%%\n",
+			100.0 * (hot - hot_kept) / hot,
+			100.0 * (bench_names - hot - cold_kept) / (bench_names - hot));
+	if(100.0 * (hot - hot_kept) / hot > 1) {
+		fprintf(stderr, "Error: too many hot names evicted\n");
+		return -1;
+	}
+
+	/* all the names back for the lookups */
+	default_core_cfg.dns_cache_max_mem = 1 << 30;
+	for(i = 0; i < bench_names; i++) {
+		if(bench_add(i) < 0) {
+			fprintf(stderr, "Error: failed to add name %d\n", i);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/* shared state of the lookup processes */
+typedef struct bench_shared
+{
+	volatile int start;
+	volatile int stop;
+	volatile int failed;
+	volatile unsigned long long lookups[];
+} bench_shared_t;
+
+static void bench_worker_run(bench_shared_t *sh, int idx)
+{
+	unsigned long long lookups;
+	unsigned int x;
+	int i;
+
+	x = 2463534242u ^ (unsigned int)idx;
+	lookups = 0;
+	while(sh->start == 0)
+		usleep(1000);
+	while(sh->stop == 0) {
+		for(i = 0; i < 100; i++) {
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			if(bench_lookup(x % bench_names) < 0) {
+				sh->failed = 1;
+			}
+		}
+		lookups += 100;
+	}
+	sh->lookups[idx] = lookups;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long lookups = 0;
+	bench_shared_t *sh;
+	double t0, t1;
+	int duration;
+	int nworkers;
+	pid_t pid;
+	int i;
+
+	if(argc != 4) {
+		fprintf(stderr, "Usage: %s <seconds> <processes> <names>\n", argv[0]);
+		return 1;
+	}
+	duration = atoi(argv[1]);
+	nworkers = atoi(argv[2]);
+	bench_names = atoi(argv[3]);
+	if(duration <= 0 || nworkers <= 0 || bench_names <= 0) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	if(bench_core_init_shared(
+			   (size_t)bench_names * 1024 + nworkers * 8 + (8 << 20))
+			< 0) {
+		fprintf(stderr, "Error: failed to map the shared memory\n");
+		return 1;
+	}
+	bench_timer = (struct timer_ln *)shm_malloc(sizeof(struct timer_ln));
+	bench_hot = (unsigned char *)calloc(bench_names, 1);
+	sh = (bench_shared_t *)shm_mallocxz(sizeof(bench_shared_t)
+										+ nworkers * sizeof(sh->lookups[0]));
+	if(bench_timer == NULL || bench_hot == NULL || sh == NULL) {
+		return 1;
+	}
+	default_core_cfg.use_dns_cache = 1;
+	default_core_cfg.dns_cache_max_ttl = 3600;
+	dns_timer_interval = 0;
+	if(init_dns_cache() < 0) {
+		fprintf(stderr, "Error: failed to init the dns cache\n");
+		return 1;
+	}
+
+	printf("processes: %d names: %d\n", nworkers, bench_names);
+	if(bench_eviction() < 0) {
+		return 1;
+	}
+
+	/* lookups from processes, as the sip workers of kamailio */
+	for(i = 0; i < nworkers; i++) {
+		pid = fork();
+		if(pid < 0) {
+			fprintf(stderr, "Error: failed to fork\n");
+			return 1;
+		}
+		if(pid == 0) {
+			process_no = i + 1;
+			bench_worker_run(sh, i);
+			_exit(0);
+		}
+	}
+	t0 = bench_now();
+	sh->start = 1;
+	do {
+		usleep(10000);
+		t1 = bench_now();
+	} while(t1 - t0 < duration);
+	sh->stop = 1;
+	for(i = 0; i < nworkers; i++) {
+		wait(NULL);
+	}
+	t1 = bench_now();
+	for(i = 0; i < nworkers; i++) {
+		lookups += sh->lookups[i];
+	}
+	if(sh->failed) {
+		fprintf(stderr, "Error: a lookup failed\n");
+		return 1;
+	}
+	printf("lookups/sec: %.0f\n", (double)lookups / (t1 - t0));
+	destroy_dns_cache();
+	return 0;
+}
@@ -0,0 +1,474 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Rule lookup of do_routing() in modules/drouting: <prefixes> distinct
+ * random number prefixes of 1 to 7 digits, each with one to three rules in
+ * one of 4 groups, <timed> percent of them with a time recurrence (office
+ * hours on weekdays, a daily window, a daily window with until, or a one
+ * time window of days) and the others without, are added to the compact
+ * prefix tree of prefix_tree.c and looked up with get_prefix() (time checks
+ * cached per rule), compared with the previous tree of 13 children per
+ * node and a time check running dr_check_tmrec() for each rule on each
+ * lookup. time() is replaced by a clock of the test: first both have to
+ * return the same rule for random numbers at times over three weeks, then
+ * the lookups per second of both are reported, the clock advancing one
+ * second every 1000 lookups.
+ *   test-drouting-lookup <seconds> <prefixes> <timed>
+ * The exit code is 1 if the trees differ.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core/mem/shm_mem.h"
+#include "core/resolve.h"
+#include "core/parser/parse_uri.h"
+#include "modules/drouting/prefix_tree.h"
+#include "modules/drouting/routing.h"
+#include "modules/drouting/dr_time.h"
+
+#include "bench_core.h"
+
+#define BENCH_GROUPS 4
+#define BENCH_INPUTS 4096
+#define BENCH_MAX_LEN 7
+/* Monday 2026-01-05 00:00:00 UTC, start of the time recurrences */
+#define BENCH_T0 1767571200
+
+/* parameters and counters of drouting.c */
+int dr_force_dns = 1;
+int tree_size = 0;
+int inode = 0;
+int unode = 0;
+
+/* core functions used by add_dst() of routing.c, not called by the test */
+int parse_uri(char *buf, int len, struct sip_uri *uri)
+{
+	return -1;
+}
+
+struct hostent *__sip_resolvehost(str *name, unsigned short *port, char *proto)
+{
+	return NULL;
+}
+
+/* clock of the test, replacing the one of the C library */
+static time_t bench_time = BENCH_T0;
+
+time_t time(time_t *t)
+{
+	if(t != NULL) {
+		*t = bench_time;
+	}
+	return bench_time;
+}
+
+static unsigned int bench_rand(void)
+{
+	static unsigned int x = 2463534242u;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+/*
+ * Tree before the compact nodes, as it was in prefix_tree.c: each node with
+ * all PTREE_CHILDREN children, the next member of a child pointing to a
+ * struct bench_ptree
+ */
+struct bench_ptree
+{
+	struct bench_ptree *bp;
+	ptree_node_t ptnode[PTREE_CHILDREN];
+};
+
+#define BENCH_NEXT(n) ((struct bench_ptree *)(n)->next)
+
+static size_t bench_old_size = 0;
+
+static struct bench_ptree *bench_old_node(struct bench_ptree *bp)
+{
+	struct bench_ptree *t;
+
+	t = shm_malloc(sizeof(struct bench_ptree));
+	if(t == NULL) {
+		return NULL;
+	}
+	memset(t, 0, sizeof(struct bench_ptree));
+	t->bp = bp;
+	bench_old_size += sizeof(struct bench_ptree);
+	return t;
+}
+
+static int bench_old_add(
+		struct bench_ptree *ptree, str *prefix, rt_info_t *r, unsigned int rg)
+{
+	char *tmp;
+	int idx;
+
+	for(tmp = prefix->s; tmp < prefix->s + prefix->len; tmp++) {
+		idx = get_node_index(*tmp);
+		if(idx == -1) {
+			return -1;
+		}
+		if(tmp == prefix->s + prefix->len - 1) {
+			return add_rt_info(&ptree->ptnode[idx], r, rg);
+		}
+		if(ptree->ptnode[idx].next == NULL) {
+			ptree->ptnode[idx].next = (ptree_t *)bench_old_node(ptree);
+			if(ptree->ptnode[idx].next == NULL) {
+				return -1;
+			}
+		}
+		ptree = BENCH_NEXT(&ptree->ptnode[idx]);
+	}
+	return -1;
+}
+
+static inline int bench_old_check_time(dr_tmrec_t *time_rec)
+{
+	dr_ac_tm_t att;
+
+	/* shortcut: if there is no dstart, timerec is valid */
+	if(time_rec->dtstart == 0)
+		return 1;
+
+	memset(&att, 0, sizeof(att));
+
+	/* set current time */
+	if(dr_ac_tm_set_time(&att, time(0)))
+		return 0;
+
+	/* does the recv_time match the specified interval?  */
+	if(dr_check_tmrec(time_rec, &att, 0) != 0)
+		return 0;
+
+	return 1;
+}
+
+static inline rt_info_t *bench_old_check_rt(
+		ptree_node_t *ptn, unsigned int rgid)
+{
+	int i;
+	int rg_pos = 0;
+	rg_entry_t *rg = NULL;
+	rt_info_wrp_t *rtlw = NULL;
+
+	if((NULL == ptn) || (NULL == ptn->rg))
+		return NULL;
+
+	rg_pos = ptn->rg_pos;
+	rg = ptn->rg;
+	for(i = 0; (i < rg_pos) && (rg[i].rgid != rgid); i++)
+		;
+	if(i < rg_pos) {
+		rtlw = rg[i].rtlw;
+		while(rtlw != NULL) {
+			if(bench_old_check_time(rtlw->rtl->time_rec))
+				return rtlw->rtl;
+			rtlw = rtlw->next;
+		}
+	}
+
+	return NULL;
+}
+
+static rt_info_t *bench_old_get_prefix(
+		struct bench_ptree *ptree, str *prefix, unsigned int rgid)
+{
+	rt_info_t *rt = NULL;
+	char *tmp = NULL;
+	int idx = 0;
+
+	tmp = prefix->s;
+	/* go the tree down to the last digit in the
+	 * prefix string or down to a leaf */
+	while(tmp < (prefix->s + prefix->len)) {
+		idx = get_node_index(*tmp);
+		if(idx == -1) {
+			/* unknown character in the prefix string */
+			return NULL;
+		}
+		if(tmp == (prefix->s + prefix->len - 1)) {
+			/* last digit in the prefix string */
+			break;
+		}
+		if(NULL == ptree->ptnode[idx].next) {
+			/* this is a leaf */
+			break;
+		}
+		ptree = BENCH_NEXT(&ptree->ptnode[idx]);
+		tmp++;
+	}
+	/* go in the tree up to the root trying to match the prefix */
+	while(ptree != NULL) {
+		/* is it a real node or an intermediate one */
+		idx = get_node_index(*tmp);
+		if(idx != -1 && NULL != ptree->ptnode[idx].rg) {
+			/* real node; check the constraints on the routing info*/
+			if(NULL != (rt = bench_old_check_rt(&(ptree->ptnode[idx]), rgid)))
+				break;
+		}
+		tmp--;
+		ptree = ptree->bp;
+	}
+	return rt;
+}
+
+/* time recurrence of "dtstart|duration|freq|until|interval|byday" */
+static dr_tmrec_t *bench_time_rec(char *def)
+{
+	int (*parse[])(dr_tmrec_p, char *) = {dr_tr_parse_dtstart,
+			dr_tr_parse_duration, dr_tr_parse_freq, dr_tr_parse_until,
+			dr_tr_parse_interval, dr_tr_parse_byday};
+	dr_tmrec_t *trec;
+	char buf[128];
+	char *p, *s;
+	int i;
+
+	trec = shm_malloc(sizeof(dr_tmrec_t));
+	if(trec == NULL) {
+		return NULL;
+	}
+	memset(trec, 0, sizeof(dr_tmrec_t));
+	if(def == NULL) {
+		return trec;
+	}
+	snprintf(buf, sizeof(buf), "%s", def);
+	for(i = 0, p = buf; p != NULL && i < 6; i++, p = s) {
+		s = strchr(p, '|');
+		if(s != NULL) {
+			*s++ = '\0';
+		}
+		if(*p != '\0' && parse[i](trec, p) != 0) {
+			return NULL;
+		}
+	}
+	return trec;
+}
+
+static char *bench_time_def(void)
+{
+	static char def[128];
+
+	switch(bench_rand() % 4) {
+		case 0:
+			return "20260105T080000|PT10H|weekly|||MO,TU,WE,TH,FR";
+		case 1:
+			snprintf(def, sizeof(def), "20260105T%02u%02u00|PT%uH|daily",
+					bench_rand() % 24, (bench_rand() % 4) * 15,
+					1 + bench_rand() % 12);
+			return def;
+		case 2:
+			snprintf(def, sizeof(def),
+					"20260105T%02u0000|PT%uH|daily|202601%02uT000000",
+					bench_rand() % 24, 1 + bench_rand() % 12,
+					6 + bench_rand() % 20);
+			return def;
+		default:
+			snprintf(def, sizeof(def), "202601%02uT000000|P%uD",
+					5 + bench_rand() % 20, 1 + bench_rand() % 5);
+			return def;
+	}
+}
+
+static int bench_rules(ptree_t *tree, struct bench_ptree *old, int prefixes,
+		int timed, char **prefix_list, pgw_t *gw)
+{
+	static const unsigned int bench_offsets[BENCH_MAX_LEN + 1] = {
+			0, 0, 10, 110, 1110, 11110, 111110, 1111110};
+	static unsigned char used[11111110 / 8 + 1];
+	dr_tmrec_t *trec;
+	rt_info_t *rt;
+	unsigned int pos, rg;
+	str prefix;
+	int i, j, k, len, tries, nrules;
+
+	for(i = 0; i < prefixes; i++) {
+		tries = 0;
+		do {
+			len = 1 + bench_rand() % BENCH_MAX_LEN;
+			for(k = 0, pos = 0; k < len; k++) {
+				pos = pos * 10 + bench_rand() % 10;
+			}
+			pos += bench_offsets[len];
+		} while((used[pos / 8] & (1 << (pos % 8))) && ++tries < 100);
+		used[pos / 8] |= 1 << (pos % 8);
+		prefix_list[i] = malloc(BENCH_MAX_LEN + 1);
+		if(prefix_list[i] == NULL) {
+			return -1;
+		}
+		snprintf(prefix_list[i], BENCH_MAX_LEN + 1, "%0*u", len,
+				pos - bench_offsets[len]);
+		prefix.s = prefix_list[i];
+		prefix.len = len;
+		rg = bench_rand() % BENCH_GROUPS;
+		nrules = 1 + bench_rand() % 3;
+		for(j = 0; j < nrules; j++) {
+			trec = bench_time_rec(
+					((int)(bench_rand() % 100) < timed) ? bench_time_def()
+														: NULL);
+			if(trec == NULL) {
+				return -1;
+			}
+			rt = build_rt_info(nrules - j, trec, 0, "1", gw);
+			if(rt == NULL || add_prefix(tree, &prefix, rt, rg) != 0
+					|| bench_old_add(old, &prefix, rt, rg) != 0) {
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+static void bench_input(char *user, char **prefix_list, int prefixes)
+{
+	int i;
+
+	/* half of the numbers after one of the prefixes */
+	i = 0;
+	if(bench_rand() % 2) {
+		strcpy(user, prefix_list[bench_rand() % prefixes]);
+		i = strlen(user);
+	}
+	for(; i < 12; i++) {
+		user[i] = '0' + bench_rand() % 10;
+	}
+	user[12] = '\0';
+}
+
+static double bench_rate(int compact, ptree_t *tree, struct bench_ptree *old,
+		str *users, int duration)
+{
+	unsigned long long lookups = 0;
+	double t0, t1;
+	int i, k;
+
+	bench_time = BENCH_T0 + 2 * 24 * 3600 + 10 * 3600;
+	t0 = bench_now();
+	do {
+		for(i = 0; i < 100; i++) {
+			k = (lookups + i) % BENCH_INPUTS;
+			if(compact) {
+				get_prefix(tree, &users[k], k % BENCH_GROUPS);
+			} else {
+				bench_old_get_prefix(old, &users[k], k % BENCH_GROUPS);
+			}
+		}
+		lookups += 100;
+		if(lookups % 1000 == 0) {
+			bench_time++;
+		}
+		t1 = bench_now();
+	} while(t1 - t0 < duration);
+	return (double)lookups / (t1 - t0);
+}
+
+int main(int argc, char *argv[])
+{
+	static char ubuf[BENCH_INPUTS][16];
+	str users[BENCH_INPUTS];
+	char **prefix_list;
+	rt_data_t *rdata;
+	ptree_t *tree;
+	struct bench_ptree *old;
+	pgw_t gw;
+	rt_info_t *r1, *r2;
+	unsigned long long checks = 0, found = 0;
+	double rold, rnew;
+	int duration;
+	int prefixes;
+	int timed;
+	int diffs = 0;
+	int i, j;
+
+	if(argc != 4) {
+		fprintf(stderr, "Usage: %s <seconds> <prefixes> <timed>\n", argv[0]);
+		return 1;
+	}
+	duration = atoi(argv[1]);
+	prefixes = atoi(argv[2]);
+	timed = atoi(argv[3]);
+	if(duration <= 0 || prefixes <= 0 || timed < 0 || timed > 100) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	bench_core_init();
+	setenv("TZ", "UTC", 1);
+	tzset();
+	memset(&gw, 0, sizeof(gw));
+	gw.id = 1;
+	prefix_list = malloc(prefixes * sizeof(char *));
+	rdata = build_rt_data();
+	old = bench_old_node(NULL);
+	if(prefix_list == NULL || rdata == NULL || old == NULL) {
+		return 1;
+	}
+	tree = rdata->pt;
+	if(bench_rules(tree, old, prefixes, timed, prefix_list, &gw) < 0) {
+		fprintf(stderr, "Error: failed to add the rules\n");
+		return 1;
+	}
+
+	for(i = 0; i < BENCH_INPUTS; i++) {
+		bench_input(ubuf[i], prefix_list, prefixes);
+		users[i].s = ubuf[i];
+		users[i].len = strlen(ubuf[i]);
+	}
+
+	/* from a day before the first recurrences, every 7 minutes 13 seconds
+	 * over three weeks */
+	for(bench_time = BENCH_T0 - 24 * 3600;
+			bench_time < BENCH_T0 + 20 * 24 * 3600; bench_time += 433) {
+		for(j = 0; j < 64; j++) {
+			i = bench_rand() % BENCH_INPUTS;
+			r1 = get_prefix(tree, &users[i], i % BENCH_GROUPS);
+			r2 = bench_old_get_prefix(old, &users[i], i % BENCH_GROUPS);
+			if(r1 != r2) {
+				diffs++;
+			}
+			if(r2 != NULL) {
+				found++;
+			}
+			checks++;
+		}
+	}
+
+	rold = bench_rate(0, tree, old, users, duration);
+	rnew = bench_rate(1, tree, old, users, duration);
+
+	printf("prefixes: %d timed rules: %d%% tree: %d bytes, previous tree: "
+		   "%zu bytes\n",
+			prefixes, timed, tree_size, bench_old_size);
+	printf("lookups with a rule: %llu of %llu\n", found, checks);
+	printf("results differing from the previous tree: %d\n", diffs);
+	printf("lookups/sec: previous %.0f compact %.0f\n", rold, rnew);
+
+	free_rt_data(rdata, 1);
+	return (diffs > 0) ? 1 : 0;
+}
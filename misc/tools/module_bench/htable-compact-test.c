@@ -0,0 +1,298 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Fill ratio and memory of a compact table of modules/htable/ht_compact.c:
+ * a table of 2^<size> slots with <items> items per slot, keys up to 32
+ * bytes and int values, is filled with ht_set_cell() with as many keys as
+ * it has items, then the items stored, the fill ratio at the first failed
+ * add and the bytes per stored key are reported, next to the shm bytes
+ * per key of a table with the default layout holding the same keys. The
+ * lookups of stored and missing keys are timed with the compact table
+ * filled at 90% and full and with the default one, then half of the keys
+ * are removed from the compact table and added again.
+ *   test-htable-compact <size> <items>
+ * The exit code is 1 if an add fails before the table is full, if an add
+ * to the full table succeeds or if a stored key is not found.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "core/route.h"
+#include "core/parser/msg_parser.h"
+#include "core/kemi.h"
+#include "modules/htable/ht_api.h"
+#include "modules/htable/ht_db.h"
+#include "modules/htable/ht_dmq.h"
+
+#include "bench_core.h"
+
+/* symbols of the core and of the other htable files, no table being
+ * loaded, replicated or expired */
+struct route_list event_rt;
+int route_type = 0;
+int ht_timer_procs = 0;
+str ht_event_callback = STR_NULL;
+
+int route_lookup(struct route_list *rt, char *name)
+{
+	return -1;
+}
+
+int run_top_route(struct action *a, sip_msg_t *msg, struct run_act_ctx *c)
+{
+	return 0;
+}
+
+int faked_msg_init(void)
+{
+	return 0;
+}
+
+sip_msg_t *faked_msg_next(void)
+{
+	return NULL;
+}
+
+sr_kemi_eng_t *sr_kemi_eng_get(void)
+{
+	return NULL;
+}
+
+int sr_kemi_route(sr_kemi_eng_t *keng, sip_msg_t *msg, int rtype, str *ename,
+		str *edata)
+{
+	return 0;
+}
+
+int shm_initialized(void)
+{
+	return 1;
+}
+
+int ksr_clock_gettime(struct timespec *ts)
+{
+	return clock_gettime(CLOCK_REALTIME, ts);
+}
+
+char *str_search(str *text, str *needle)
+{
+	return NULL;
+}
+
+int ht_db_load_table(ht_t *ht, str *dbtable, int mode)
+{
+	return 0;
+}
+
+int ht_db_save_table(ht_t *ht, str *dbtable)
+{
+	return 0;
+}
+
+int ht_db_delete_records(str *dbtable)
+{
+	return 0;
+}
+
+int ht_dmq_replicate_action(ht_dmq_action_t action, str *htname, str *cname,
+		int type, int_str *val, int mode, uint64_t lm)
+{
+	return 0;
+}
+
+int ht_reload_table(ht_t *ht)
+{
+	return 0;
+}
+
+static void bench_key(int i, char *buf, str *key)
+{
+	key->len = snprintf(buf, 32, "10.%d.%d.%d", (i >> 16) & 0xff,
+			(i >> 8) & 0xff, i & 0xff);
+	key->s = buf;
+}
+
+/* add the keys from first to last - 1, return the number of failed adds
+ * and set ffail to the first key failing */
+static int bench_fill(ht_t *ht, int first, int last, int *ffail)
+{
+	char buf[32];
+	int_str val;
+	str key;
+	int nfail;
+	int i;
+
+	nfail = 0;
+	*ffail = -1;
+	for(i = first; i < last; i++) {
+		bench_key(i, buf, &key);
+		val.n = i;
+		if(ht_set_cell(ht, &key, 0, &val, 1) != 0) {
+			if(*ffail < 0)
+				*ffail = i;
+			nfail++;
+		}
+	}
+	return nfail;
+}
+
+/* look up the keys from first to last - 1, return the number found */
+static int bench_lookup(ht_t *ht, int first, int last)
+{
+	char buf[32];
+	str key;
+	int found;
+	int i;
+
+	found = 0;
+	for(i = first; i < last; i++) {
+		bench_key(i, buf, &key);
+		found += ht_cell_exists(ht, &key);
+	}
+	return found;
+}
+
+/* time the lookups of the n first keys, stored, and of as many missing
+ * ones, return the number of keys found */
+static int bench_lookups(ht_t *ht, int n, int nitems, char *fill)
+{
+	double t0, t1, t2;
+	int found;
+
+	t0 = bench_now();
+	found = bench_lookup(ht, 0, n);
+	t1 = bench_now();
+	bench_lookup(ht, nitems + 1, nitems + 1 + n);
+	t2 = bench_now();
+	printf("lookups/sec at %s - stored: %.0f missing: %.0f\n", fill,
+			n / (t1 - t0), n / (t2 - t1));
+	return found;
+}
+
+int main(int argc, char *argv[])
+{
+	str cname = str_init("compact");
+	str dname = str_init("default");
+	ht_t *cht;
+	ht_t *dht;
+	size_t used;
+	double dbytes;
+	int nitems;
+	int nfail;
+	int ffail;
+	int found;
+	int size;
+	int csize;
+	int ret;
+
+	if(argc != 3) {
+		fprintf(stderr, "Usage: %s <size> <items>\n", argv[0]);
+		return 1;
+	}
+	size = atoi(argv[1]);
+	csize = atoi(argv[2]);
+	if(size <= 1 || size > 14 || csize <= 0) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+	nitems = (1 << size) * csize;
+
+	bench_core_init();
+	if(ht_add_table(&cname, 0, NULL, NULL, size, 0, 0, NULL, 0, 0, ',', 0, 0,
+			   0, csize, 32, 32, 0)
+					!= 0
+			|| ht_add_table(&dname, 0, NULL, NULL, size, 0, 0, NULL, 0, 0,
+					   ',', 0, 0, 0, 0, 0, 0, 0)
+					   != 0
+			|| ht_init_tables() != 0) {
+		fprintf(stderr, "Error: failed to create the tables\n");
+		return 1;
+	}
+	cht = ht_get_table(&cname);
+	dht = ht_get_table(&dname);
+	if(cht == NULL || dht == NULL) {
+		fprintf(stderr, "Error: failed to get the tables\n");
+		return 1;
+	}
+
+	printf("slots: %u items per slot: %d item size: %u\n", cht->htsize,
+			csize, cht->ccellsize);
+	ret = 0;
+	nfail = bench_fill(cht, 0, nitems / 10 * 9, &ffail);
+	bench_lookups(cht, nitems / 10 * 9, nitems, "compact 90%");
+	found = ffail;
+	nfail += bench_fill(cht, nitems / 10 * 9, nitems, &ffail);
+	if(found >= 0)
+		ffail = found;
+	printf("compact - stored: %d of %d  first failed add at: %6.2f%%"
+		   "  bytes per key: %.1f\n",
+			nitems - nfail, nitems,
+			100.0 * ((ffail < 0) ? nitems : ffail) / nitems,
+			(double)nitems * cht->ccellsize / (nitems - nfail));
+	if(nfail > 0) {
+		fprintf(stderr, "Error: %d adds failed before the table was full\n",
+				nfail);
+		ret = 1;
+	}
+	if(bench_fill(cht, nitems, nitems + 1, &ffail) != 1) {
+		fprintf(stderr, "Error: add to the full table succeeded\n");
+		ret = 1;
+	}
+
+	used = bench_shm_used();
+	bench_fill(dht, 0, nitems, &ffail);
+	dbytes = (double)(bench_shm_used() - used) / nitems;
+	printf("default - bytes per key: %.1f (without the shm allocator "
+		   "header)\n",
+			dbytes);
+
+	found = bench_lookups(cht, nitems, nitems, "compact full");
+	bench_lookups(dht, nitems, nitems, "default");
+	if(found != nitems - nfail) {
+		fprintf(stderr, "Error: %d stored keys not found\n",
+				nitems - nfail - found);
+		ret = 1;
+	}
+
+	/* remove half of the keys, the freed items are reused */
+	for(found = 0; found < nitems; found += 2) {
+		char buf[32];
+		str key;
+
+		bench_key(found, buf, &key);
+		ht_del_cell(cht, &key);
+	}
+	if(bench_lookup(cht, 0, nitems) != nitems / 2) {
+		fprintf(stderr, "Error: removed keys still found\n");
+		ret = 1;
+	}
+	if(bench_fill(cht, 0, nitems, &ffail) != 0
+			|| bench_lookup(cht, 0, nitems) != nitems) {
+		fprintf(stderr, "Error: keys not stored again\n");
+		ret = 1;
+	}
+	return ret;
+}
@@ -0,0 +1,325 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Read-heavy access to one slot of a table of modules/htable/ht_api.c,
+ * with the rwlock table attribute set or not: <processes> forked
+ * processes, sharing the table as the sip workers of kamailio, copy the
+ * value of one of 4 keys of the same slot with ht_cell_pkg_copy() (as
+ * $sht(...) does) or, for <write-percent> of the operations, increment
+ * it with ht_cell_value_add() (as $shtinc(...) does), for <seconds>.
+ *   test-htable-rwlock <seconds> <processes> <rwlock> <write-percent>
+ * The exit code is 1 if a lookup fails or if the sum of the values is not
+ * the number of increments done.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "core/route.h"
+#include "core/parser/msg_parser.h"
+#include "core/kemi.h"
+#include "modules/htable/ht_api.h"
+#include "modules/htable/ht_db.h"
+#include "modules/htable/ht_dmq.h"
+
+#include "bench_core.h"
+
+#define BENCH_KEYS 4
+
+/* symbols of the core and of the other htable files, no table being
+ * loaded, replicated or expired */
+struct route_list event_rt;
+int route_type = 0;
+int ht_timer_procs = 0;
+str ht_event_callback = STR_NULL;
+
+int route_lookup(struct route_list *rt, char *name)
+{
+	return -1;
+}
+
+int run_top_route(struct action *a, sip_msg_t *msg, struct run_act_ctx *c)
+{
+	return 0;
+}
+
+int faked_msg_init(void)
+{
+	return 0;
+}
+
+sip_msg_t *faked_msg_next(void)
+{
+	return NULL;
+}
+
+sr_kemi_eng_t *sr_kemi_eng_get(void)
+{
+	return NULL;
+}
+
+int sr_kemi_route(sr_kemi_eng_t *keng, sip_msg_t *msg, int rtype, str *ename,
+		str *edata)
+{
+	return 0;
+}
+
+int shm_initialized(void)
+{
+	return 1;
+}
+
+int ksr_clock_gettime(struct timespec *ts)
+{
+	return clock_gettime(CLOCK_REALTIME, ts);
+}
+
+char *str_search(str *text, str *needle)
+{
+	return NULL;
+}
+
+int ht_db_load_table(ht_t *ht, str *dbtable, int mode)
+{
+	return 0;
+}
+
+int ht_db_save_table(ht_t *ht, str *dbtable)
+{
+	return 0;
+}
+
+int ht_db_delete_records(str *dbtable)
+{
+	return 0;
+}
+
+int ht_dmq_replicate_action(ht_dmq_action_t action, str *htname, str *cname,
+		int type, int_str *val, int mode, uint64_t lm)
+{
+	return 0;
+}
+
+int ht_reload_table(ht_t *ht)
+{
+	return 0;
+}
+
+/* shared state of the processes */
+typedef struct bench_shared
+{
+	volatile int start;
+	volatile int stop;
+	volatile int failed;
+	struct
+	{
+		unsigned long long reads;
+		unsigned long long writes;
+	} counts[];
+} bench_shared_t;
+
+static ht_t *bench_ht;
+static str bench_keys[BENCH_KEYS];
+static int bench_write_percent;
+
+/* keys hashing to the slot 0 of the table */
+static int bench_keys_init(void)
+{
+	char buf[32];
+	int i;
+	int k;
+
+	for(i = 0, k = 0; k < BENCH_KEYS && i < 100000; i++) {
+		bench_keys[k].len = snprintf(buf, sizeof(buf), "key%d", i);
+		bench_keys[k].s = buf;
+		if(ht_get_entry(ht_compute_hash(&bench_keys[k]), bench_ht->htsize)
+				!= 0) {
+			continue;
+		}
+		bench_keys[k].s = strdup(buf);
+		if(bench_keys[k].s == NULL) {
+			return -1;
+		}
+		k++;
+	}
+	return (k == BENCH_KEYS) ? 0 : -1;
+}
+
+static void bench_worker_run(bench_shared_t *sh, int idx)
+{
+	unsigned long long reads;
+	unsigned long long writes;
+	ht_cell_t *old;
+	ht_cell_t *c;
+	unsigned int x;
+	int i;
+
+	x = 2463534242u ^ (unsigned int)idx;
+	reads = writes = 0;
+	old = NULL;
+	while(sh->start == 0)
+		usleep(1000);
+	while(sh->stop == 0) {
+		for(i = 0; i < 100; i++) {
+			x ^= x << 13;
+			x ^= x >> 17;
+			x ^= x << 5;
+			if(x % 100 < bench_write_percent) {
+				c = ht_cell_value_add(
+						bench_ht, &bench_keys[(x >> 8) % BENCH_KEYS], 1, NULL);
+				if(c == NULL) {
+					sh->failed = 1;
+				} else {
+					ht_cell_pkg_free(c);
+				}
+				writes++;
+			} else {
+				c = ht_cell_pkg_copy(
+						bench_ht, &bench_keys[(x >> 8) % BENCH_KEYS], old);
+				if(c == NULL) {
+					sh->failed = 1;
+				} else {
+					old = c;
+				}
+				reads++;
+			}
+		}
+	}
+	sh->counts[idx].reads = reads;
+	sh->counts[idx].writes = writes;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long reads = 0;
+	unsigned long long writes = 0;
+	unsigned long long sum = 0;
+	bench_shared_t *sh;
+	ht_cell_t *c;
+	str name = str_init("bench");
+	int_str val;
+	double t0, t1;
+	int duration;
+	int nworkers;
+	int rwlock;
+	pid_t pid;
+	int i;
+
+	if(argc != 5) {
+		fprintf(stderr,
+				"Usage: %s <seconds> <processes> <rwlock> <write-percent>\n",
+				argv[0]);
+		return 1;
+	}
+	duration = atoi(argv[1]);
+	nworkers = atoi(argv[2]);
+	rwlock = atoi(argv[3]);
+	bench_write_percent = atoi(argv[4]);
+	if(duration <= 0 || nworkers <= 0 || bench_write_percent < 0
+			|| bench_write_percent > 100) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	if(bench_core_init_shared(64 << 20) < 0) {
+		fprintf(stderr, "Error: failed to map the shared memory\n");
+		return 1;
+	}
+	sh = (bench_shared_t *)shm_mallocxz(
+			sizeof(bench_shared_t) + nworkers * sizeof(sh->counts[0]));
+	if(sh == NULL
+			|| ht_add_table(&name, 0, NULL, NULL, 0, 0, 0, NULL, 0, 0, ',',
+					   0, 0, rwlock, 0, 0, 0, 0)
+					   != 0
+			|| ht_init_tables() != 0) {
+		fprintf(stderr, "Error: failed to create the table\n");
+		return 1;
+	}
+	bench_ht = ht_get_table(&name);
+	if(bench_ht == NULL || bench_keys_init() < 0) {
+		fprintf(stderr, "Error: failed to set the keys\n");
+		return 1;
+	}
+	val.n = 0;
+	for(i = 0; i < BENCH_KEYS; i++) {
+		if(ht_set_cell(bench_ht, &bench_keys[i], 0, &val, 1) != 0) {
+			fprintf(stderr, "Error: failed to set the keys\n");
+			return 1;
+		}
+	}
+
+	for(i = 0; i < nworkers; i++) {
+		pid = fork();
+		if(pid < 0) {
+			fprintf(stderr, "Error: failed to fork\n");
+			return 1;
+		}
+		if(pid == 0) {
+			process_no = i + 1;
+			bench_worker_run(sh, i);
+			_exit(0);
+		}
+	}
+	t0 = bench_now();
+	sh->start = 1;
+	do {
+		usleep(10000);
+		t1 = bench_now();
+	} while(t1 - t0 < duration);
+	sh->stop = 1;
+	for(i = 0; i < nworkers; i++) {
+		wait(NULL);
+	}
+	t1 = bench_now();
+	for(i = 0; i < nworkers; i++) {
+		reads += sh->counts[i].reads;
+		writes += sh->counts[i].writes;
+	}
+	for(i = 0; i < BENCH_KEYS; i++) {
+		c = ht_cell_pkg_copy(bench_ht, &bench_keys[i], NULL);
+		if(c == NULL) {
+			sh->failed = 1;
+			continue;
+		}
+		sum += c->value.n;
+		ht_cell_pkg_free(c);
+	}
+	if(sh->failed) {
+		fprintf(stderr, "Error: a lookup failed\n");
+		return 1;
+	}
+	printf("processes: %d rwlock: %d writes: %d%%\n", nworkers, rwlock,
+			bench_write_percent);
+	printf("reads/sec: %.0f writes/sec: %.0f\n", (double)reads / (t1 - t0),
+			(double)writes / (t1 - t0));
+	if(sum != writes) {
+		fprintf(stderr, "Error: sum of values %llu, %llu increments\n", sum,
+				writes);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,643 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Gateway selection of load_gws() in modules/lcr: <rules> rules of one lcr
+ * instance with distinct random number prefixes of 1 to 6 digits after 49
+ * (the rules with a from_uri pattern share the prefix of another rule), 1
+ * to 3 targets each over 64 gateways, some of them with request_uri
+ * patterns or stoppers, are loaded by reload_tables() from an in memory
+ * database driver (with lcr_rule_hash_size = <rules>), then the prefix
+ * index of rule_index.c (load_gws_dummy()) is compared with the previous
+ * walk over the prefix lengths and the rule hash table, creating pcre2
+ * match data for each pattern check and sorting the gateways with qsort().
+ * For random numbers, first both have to select the same gateways in the
+ * same (prefix length,) priority order in both priority_ordering modes,
+ * then the checks per second of both are reported.
+ * lcr_mod.c is included to reach its static functions and database handle.
+ *   test-lcr-load-gws <seconds> <rules>
+ * The exit code is 1 if the index and the walk differ.
+ */
+
+#include "modules/lcr/lcr_mod.c"
+
+#include "bench_core.h"
+
+#define BENCH_GWS 64
+#define BENCH_FROM_URIS 8
+#define BENCH_INPUTS 4096
+
+/* core and module functions used by lcr_mod.c, not called by the test */
+char ut_buf_int2str[INT2STR_MAX_LEN];
+
+int flag_in_range(flag_t flag)
+{
+	return 1;
+}
+
+int parse_sip_msg_uri(struct sip_msg *msg)
+{
+	return -1;
+}
+
+int add_avp(avp_flags_t flags, avp_name_t name, avp_value_t val)
+{
+	return -1;
+}
+
+void delete_avp(avp_flags_t flags, avp_name_t name)
+{
+}
+
+int rpc_register_array(rpc_export_t *rpc_array)
+{
+	return 0;
+}
+
+int sr_kemi_modules_add(sr_kemi_t *klist)
+{
+	return 0;
+}
+
+int parse_uri(char *buf, int len, struct sip_uri *uri)
+{
+	return -1;
+}
+
+pv_spec_t *pv_cache_get(str *name)
+{
+	return NULL;
+}
+
+avp_t *search_first_avp(avp_flags_t flags, avp_name_t name, avp_value_t *val,
+		struct search_state *state)
+{
+	return NULL;
+}
+
+/* in memory database driver returning the lcr tables */
+static db1_res_t bench_rule_res;
+static db1_res_t bench_gw_res;
+static db1_res_t bench_target_res;
+static db1_res_t bench_empty_res;
+static db1_res_t *bench_table_res;
+static db1_con_t bench_con;
+
+static db1_con_t *bench_db_init(const str *url)
+{
+	return &bench_con;
+}
+
+static void bench_db_close(db1_con_t *h)
+{
+}
+
+static int bench_db_use_table(db1_con_t *h, const str *t)
+{
+	if(STR_EQ(*t, lcr_rule_table)) {
+		bench_table_res = &bench_rule_res;
+	} else if(STR_EQ(*t, lcr_gw_table)) {
+		bench_table_res = &bench_gw_res;
+	} else {
+		bench_table_res = &bench_target_res;
+	}
+	return 0;
+}
+
+static int bench_db_query(const db1_con_t *h, const db_key_t *k,
+		const db_op_t *op, const db_val_t *v, const db_key_t *c, const int n,
+		const int nc, const db_key_t o, db1_res_t **r)
+{
+	/* only lcr_id 1 has rows, gateways of lcr_id 0 are queried too */
+	*r = (VAL_INT(v) == 1) ? bench_table_res : &bench_empty_res;
+	return 0;
+}
+
+static int bench_db_free_result(db1_con_t *h, db1_res_t *r)
+{
+	return 0;
+}
+
+int db_bind_mod(const str *mod, db_func_t *dbf)
+{
+	memset(dbf, 0, sizeof(db_func_t));
+	dbf->cap = DB_CAP_QUERY;
+	dbf->init = bench_db_init;
+	dbf->close = bench_db_close;
+	dbf->use_table = bench_db_use_table;
+	dbf->query = bench_db_query;
+	dbf->free_result = bench_db_free_result;
+	return 0;
+}
+
+static unsigned int bench_rand(void)
+{
+	static unsigned int x = 2463534242u;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+static void bench_set_int(db_val_t *v, int i)
+{
+	v->type = DB1_INT;
+	v->nul = 0;
+	v->val.int_val = i;
+}
+
+static void bench_set_str(db_val_t *v, char *s)
+{
+	v->type = DB1_STR;
+	v->nul = 0;
+	v->val.str_val.s = s;
+	v->val.str_val.len = strlen(s);
+}
+
+static void bench_set_null(db_val_t *v)
+{
+	v->type = DB1_STR;
+	v->nul = 1;
+}
+
+static db_val_t *bench_alloc_rows(db1_res_t *res, int rows, int cols)
+{
+	db_val_t *vals;
+	int i;
+
+	res->rows = calloc(rows, sizeof(db_row_t));
+	vals = calloc(rows * cols, sizeof(db_val_t));
+	if(res->rows == NULL || vals == NULL) {
+		return NULL;
+	}
+	for(i = 0; i < rows; i++) {
+		res->rows[i].values = vals + i * cols;
+		res->rows[i].n = cols;
+	}
+	res->n = rows;
+	return vals;
+}
+
+/*
+ * lcr_rule columns: id, prefix, from_uri, stopper, enabled, request_uri,
+ * mt_tvalue; lcr_gw columns: gw_name, ip_addr, port, uri_scheme, transport,
+ * params, hostname, strip, prefix, tag, flags, defunct, id; lcr_rule_target
+ * columns: rule_id, gw_id, priority, weight
+ */
+static int bench_rows(int rules, char **prefixes)
+{
+	static const unsigned int bench_offsets[7] = {
+			0, 0, 10, 110, 1110, 11110, 111110};
+	static unsigned char used[1111110 / 8 + 1];
+	db_val_t *vals, *v;
+	char *s;
+	unsigned int pos;
+	int ntargets;
+	int i, j, k, len, gw, tries;
+
+	if((vals = bench_alloc_rows(&bench_rule_res, rules, 7)) == NULL) {
+		return -1;
+	}
+	for(i = 0; i < rules; i++) {
+		v = vals + i * 7;
+		s = malloc(MAX_URI_LEN + 1);
+		prefixes[i] = malloc(16);
+		if(s == NULL || prefixes[i] == NULL) {
+			return -1;
+		}
+		bench_set_int(v, i + 1);
+		if(bench_rand() % 10 == 0) {
+			snprintf(s, MAX_URI_LEN, "^sip:[^@]*@pbx%u\\.example\\.com$",
+					bench_rand() % BENCH_FROM_URIS);
+			bench_set_str(v + 2, s);
+		} else {
+			bench_set_null(v + 2);
+		}
+		if(i % 10000 == 0) {
+			/* a few rules for all numbers */
+			prefixes[i][0] = '\0';
+			bench_set_null(v + 1);
+		} else if(i > 0 && !VAL_NULL(v + 2)) {
+			/* rules with a from_uri pattern share the prefix of another */
+			strcpy(prefixes[i], prefixes[bench_rand() % i]);
+			bench_set_str(v + 1, prefixes[i]);
+		} else {
+			/* distinct prefixes, filling the short lengths first */
+			tries = 0;
+			do {
+				len = 1 + bench_rand() % 6;
+				for(k = 0, pos = 0; k < len; k++) {
+					pos = pos * 10 + bench_rand() % 10;
+				}
+				pos += bench_offsets[len];
+			} while((used[pos / 8] & (1 << (pos % 8))) && ++tries < 100);
+			used[pos / 8] |= 1 << (pos % 8);
+			snprintf(prefixes[i], 16, "49%0*u", len, pos - bench_offsets[len]);
+			bench_set_str(v + 1, prefixes[i]);
+		}
+		bench_set_int(v + 3, (bench_rand() % 50 == 0) ? 1 : 0);
+		bench_set_int(v + 4, 1);
+		if(bench_rand() % 20 == 0) {
+			bench_set_str(v + 5, "^sip:\\+49[0-9]*@gw\\.example\\.net$");
+		} else {
+			bench_set_null(v + 5);
+		}
+		bench_set_null(v + 6);
+	}
+
+	if((vals = bench_alloc_rows(&bench_gw_res, BENCH_GWS, 13)) == NULL) {
+		return -1;
+	}
+	for(i = 0; i < BENCH_GWS; i++) {
+		v = vals + i * 13;
+		s = malloc(16);
+		if(s == NULL) {
+			return -1;
+		}
+		snprintf(s, 16, "192.0.2.%d", i + 1);
+		for(k = 0; k < 13; k++) {
+			bench_set_null(v + k);
+		}
+		bench_set_str(v + 1, s);
+		bench_set_int(v + 12, i + 1);
+	}
+
+	ntargets = 0;
+	for(i = 0; i < rules; i++) {
+		ntargets += 1 + i % 3;
+	}
+	if((vals = bench_alloc_rows(&bench_target_res, ntargets, 4)) == NULL) {
+		return -1;
+	}
+	v = vals;
+	for(i = 0; i < rules; i++) {
+		gw = bench_rand() % BENCH_GWS;
+		for(j = 0; j < 1 + i % 3; j++) {
+			bench_set_int(v, i + 1);
+			bench_set_int(v + 1, 1 + (gw + j * 7) % BENCH_GWS);
+			bench_set_int(v + 2, bench_rand() % 4);
+			bench_set_int(v + 3, 1 + bench_rand() % 10);
+			v += 4;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Gateway selection before the prefix index, as it was in load_gws_dummy():
+ * matched_gws gets the gateways in the order of comp_matched(), with
+ * duplicates marked, and the number of entries is returned
+ */
+static int match_gws_walk(int lcr_id, str *ruri_user, str *from_uri,
+		str *request_uri, struct matched_gw_info *matched_gws)
+{
+	int i, j, rc;
+	unsigned int gw_index, now, dex;
+	struct rule_info **rules, *rule, *pl;
+	struct gw_info *gws;
+	struct target *t;
+	pcre2_match_data *pcre_md = NULL;
+
+	rules = rule_pt[lcr_id];
+	gws = gw_pt[lcr_id];
+	pl = rules[lcr_rule_hash_size_param];
+	gw_index = 0;
+
+	now = time((time_t *)NULL);
+
+	while(pl) {
+		if(ruri_user->len < pl->prefix_len) {
+			pl = pl->next;
+			continue;
+		}
+		rule = rule_hash_table_lookup(rules, pl->prefix_len, ruri_user->s);
+		while(rule) {
+
+			if((rule->prefix_len != pl->prefix_len)
+					|| strncmp(rule->prefix, ruri_user->s, pl->prefix_len))
+				goto next;
+
+			if(rule->from_uri_len != 0) {
+				pcre_md = pcre2_match_data_create_from_pattern(
+						rule->from_uri_re, NULL);
+				if(pcre_md == NULL) {
+					return -1;
+				}
+				rc = pcre2_match(rule->from_uri_re, (PCRE2_SPTR)from_uri->s,
+						(PCRE2_SIZE)from_uri->len, 0, 0, pcre_md, NULL);
+				pcre2_match_data_free(pcre_md);
+				if(rc < 0)
+					goto next;
+			}
+
+			if(rule->request_uri_len != 0) {
+				pcre_md = pcre2_match_data_create_from_pattern(
+						rule->request_uri_re, NULL);
+				if(pcre_md == NULL) {
+					return -1;
+				}
+				rc = pcre2_match(rule->request_uri_re,
+						(PCRE2_SPTR)request_uri->s,
+						(PCRE2_SIZE)request_uri->len, 0, 0, pcre_md, NULL);
+				pcre2_match_data_free(pcre_md);
+				if(rc < 0)
+					goto next;
+			}
+
+			t = rule->targets;
+			while(t) {
+				if((gws[t->gw_index].defunct_until > now)
+						|| (gws[t->gw_index].state == GW_INACTIVE))
+					goto skip_gw;
+				matched_gws[gw_index].gw_index = t->gw_index;
+				matched_gws[gw_index].rule_id = rule->rule_id;
+				matched_gws[gw_index].prefix_len = pl->prefix_len;
+				matched_gws[gw_index].priority = t->priority;
+				matched_gws[gw_index].weight = t->weight * (kam_rand() >> 8);
+				matched_gws[gw_index].duplicate = 0;
+				gw_index++;
+			skip_gw:
+				t = t->next;
+			}
+			if(rule->stopper == 1)
+				goto done;
+
+		next:
+			rule = rule->next;
+		}
+		pl = pl->next;
+	}
+
+done:
+	qsort(matched_gws, gw_index, sizeof(struct matched_gw_info), comp_matched);
+
+	for(i = gw_index - 1; i >= 0; i--) {
+		if(matched_gws[i].duplicate == 1)
+			continue;
+		dex = matched_gws[i].gw_index;
+		for(j = i - 1; j >= 0; j--) {
+			if(matched_gws[j].gw_index == dex) {
+				matched_gws[j].duplicate = 1;
+			}
+		}
+	}
+
+	return gw_index;
+}
+
+static int load_gws_walk(int lcr_id, str *ruri_user, str *from_uri,
+		str *request_uri, unsigned int *gw_indexes)
+{
+	struct matched_gw_info matched_gws[MAX_NO_OF_GWS + 1];
+	int i, j, gw_cnt;
+
+	gw_cnt = match_gws_walk(
+			lcr_id, ruri_user, from_uri, request_uri, matched_gws);
+	if(gw_cnt < 0)
+		return -1;
+
+	j = 0;
+	for(i = gw_cnt - 1; i >= 0; i--) {
+		if(matched_gws[i].duplicate == 1)
+			continue;
+		gw_indexes[j] = matched_gws[i].gw_index;
+		j++;
+	}
+	return j;
+}
+
+/* selected gateways in load_gws() order, with the key of their position */
+struct bench_gw
+{
+	unsigned int key;
+	unsigned int gw_index;
+};
+
+static int bench_gw_cmp(const void *p1, const void *p2)
+{
+	const struct bench_gw *g1 = p1;
+	const struct bench_gw *g2 = p2;
+
+	if(g1->key != g2->key) {
+		return (g1->key > g2->key) ? -1 : 1;
+	}
+	return (int)g1->gw_index - (int)g2->gw_index;
+}
+
+/*
+ * Selected gateways of the matched_gws array, returning their number or -1
+ * if they are not in (prefix length,) priority order. Gateways of equal
+ * key are ordered by their randomized weight, so they are sorted by index.
+ */
+static int bench_selected(struct matched_gw_info *matched_gws, int gw_cnt,
+		struct bench_gw *sel)
+{
+	int i, n = 0;
+
+	for(i = gw_cnt - 1; i >= 0; i--) {
+		if(matched_gws[i].duplicate == 1)
+			continue;
+		sel[n].key = 255 - matched_gws[i].priority;
+		if(!priority_ordering_param) {
+			sel[n].key |= matched_gws[i].prefix_len << 8;
+		}
+		sel[n].gw_index = matched_gws[i].gw_index;
+		if(n > 0 && sel[n].key > sel[n - 1].key) {
+			return -1;
+		}
+		n++;
+	}
+	qsort(sel, n, sizeof(struct bench_gw), bench_gw_cmp);
+	return n;
+}
+
+static void bench_input(char *user, char *from, char **prefixes, int rules)
+{
+	char *p;
+	int i;
+
+	/* half of the numbers after the prefix of a rule */
+	if(bench_rand() % 2) {
+		p = prefixes[bench_rand() % rules];
+		if(*p == '\0') {
+			p = "49";
+		}
+	} else {
+		p = "49";
+	}
+	strcpy(user, p);
+	for(i = strlen(p); i < 12; i++) {
+		user[i] = '0' + bench_rand() % 10;
+	}
+	user[12] = '\0';
+	snprintf(from, 64, "sip:alice@pbx%u.example.com",
+			bench_rand() % (2 * BENCH_FROM_URIS));
+}
+
+static double bench_rate(int idx, str *users, str *froms, str *ruris,
+		int duration)
+{
+	unsigned int gw_indexes[MAX_NO_OF_GWS];
+	unsigned long long checks = 0;
+	double t0, t1;
+	int i, k;
+
+	t0 = bench_now();
+	do {
+		for(i = 0; i < 100; i++) {
+			k = (checks + i) % BENCH_INPUTS;
+			if(idx) {
+				load_gws_dummy(1, &users[k], &froms[k], &ruris[k], gw_indexes);
+			} else {
+				load_gws_walk(1, &users[k], &froms[k], &ruris[k], gw_indexes);
+			}
+		}
+		checks += 100;
+		t1 = bench_now();
+	} while(t1 - t0 < duration);
+	return (double)checks / (t1 - t0);
+}
+
+int main(int argc, char *argv[])
+{
+	static char ubuf[BENCH_INPUTS][16];
+	static char fbuf[BENCH_INPUTS][64];
+	static char rbuf[BENCH_INPUTS][64];
+	static struct matched_gw_info mi[MAX_NO_OF_GWS + 1];
+	static struct matched_gw_info mw[MAX_NO_OF_GWS + 1];
+	static struct bench_gw si[MAX_NO_OF_GWS + 1];
+	static struct bench_gw sw[MAX_NO_OF_GWS + 1];
+	str users[BENCH_INPUTS], froms[BENCH_INPUTS], ruris[BENCH_INPUTS];
+	sip_msg_t msg;
+	char **prefixes;
+	str url = str_init("bench://lcr");
+	double rwalk[2], ridx[2], t0, treload;
+	size_t rmem, imem;
+	unsigned long long selected = 0;
+	int duration;
+	int rules;
+	int diffs = 0;
+	int mode;
+	int i, ni, nw;
+
+	if(argc != 3) {
+		fprintf(stderr, "Usage: %s <seconds> <rules>\n", argv[0]);
+		return 1;
+	}
+	duration = atoi(argv[1]);
+	rules = atoi(argv[2]);
+	if(duration <= 0 || rules <= 0) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	bench_core_init();
+	lcr_count_param = 1;
+	lcr_rule_hash_size_param = rules;
+	lcr_gw_count_param = BENCH_GWS + 1;
+	prefixes = malloc(rules * sizeof(char *));
+	if(prefixes == NULL || bench_rows(rules, prefixes) < 0) {
+		fprintf(stderr, "Error: failed to create the rows\n");
+		return 1;
+	}
+
+	/* tables of the lcr instance and the temporary ones, as in mod_init() */
+	rule_pt = shm_malloc(2 * sizeof(struct rule_info **));
+	gw_pt = shm_malloc(2 * sizeof(struct gw_info *));
+	rule_index_pt = shm_malloc(2 * sizeof(struct rule_index *));
+	if(rule_pt == NULL || gw_pt == NULL || rule_index_pt == NULL) {
+		return 1;
+	}
+	memset(rule_index_pt, 0, 2 * sizeof(struct rule_index *));
+	for(i = 0; i < 2; i++) {
+		rule_pt[i] = shm_malloc(
+				sizeof(struct rule_info *) * (lcr_rule_hash_size_param + 1));
+		gw_pt[i] = shm_malloc(
+				sizeof(struct gw_info) * (lcr_gw_count_param + 1));
+		if(rule_pt[i] == NULL || gw_pt[i] == NULL) {
+			return 1;
+		}
+		memset(rule_pt[i], 0,
+				sizeof(struct rule_info *) * (lcr_rule_hash_size_param + 1));
+		memset(gw_pt[i], 0, sizeof(struct gw_info) * (lcr_gw_count_param + 1));
+	}
+
+	rmem = bench_shm_used();
+	t0 = bench_now();
+	if(lcr_db_bind(&url) < 0 || reload_tables() != 1) {
+		fprintf(stderr, "Error: failed to load the rules\n");
+		return 1;
+	}
+	treload = bench_now() - t0;
+	rmem = bench_shm_used() - rmem;
+	imem = rule_index_pt[1]->nnodes * sizeof(struct rule_index_node)
+		   + rule_index_pt[1]->nrules * sizeof(struct rule_index_rule)
+		   + rule_index_pt[1]->ntargets * sizeof(struct rule_index_target);
+
+	for(i = 0; i < BENCH_INPUTS; i++) {
+		bench_input(ubuf[i], fbuf[i], prefixes, rules);
+		snprintf(rbuf[i], sizeof(rbuf[i]), "sip:+%s@gw.example.net", ubuf[i]);
+		users[i].s = ubuf[i];
+		users[i].len = strlen(ubuf[i]);
+		froms[i].s = fbuf[i];
+		froms[i].len = strlen(fbuf[i]);
+		ruris[i].s = rbuf[i];
+		ruris[i].len = strlen(rbuf[i]);
+	}
+
+	memset(&msg, 0, sizeof(sip_msg_t));
+	for(mode = 0; mode < 2; mode++) {
+		priority_ordering_param = mode;
+		for(i = 0; i < BENCH_INPUTS; i++) {
+			ni = match_gws(&msg, rule_index_pt[1], gw_pt[1], &users[i],
+					&froms[i], &ruris[i], mi);
+			nw = match_gws_walk(1, &users[i], &froms[i], &ruris[i], mw);
+			if(ni >= 0) {
+				ni = bench_selected(mi, ni, si);
+			}
+			if(nw >= 0) {
+				nw = bench_selected(mw, nw, sw);
+			}
+			if(ni < 0 || nw < 0 || ni != nw
+					|| memcmp(si, sw, ni * sizeof(struct bench_gw)) != 0) {
+				diffs++;
+				continue;
+			}
+			selected += ni;
+		}
+		rwalk[mode] = bench_rate(0, users, froms, ruris, duration);
+		ridx[mode] = bench_rate(1, users, froms, ruris, duration);
+	}
+
+	printf("rules: %d reload: %.3f s, rules and index: %zu bytes, "
+		   "index: %zu bytes\n",
+			rules, treload, rmem, imem);
+	printf("gateways per check: %.2f\n",
+			(double)selected / (2 * BENCH_INPUTS));
+	printf("results differing from the walk: %d\n", diffs);
+	for(mode = 0; mode < 2; mode++) {
+		printf("priority_ordering %d checks/sec: walk %.0f index %.0f\n", mode,
+				rwalk[mode], ridx[mode]);
+	}
+	return (diffs > 0) ? 1 : 0;
+}
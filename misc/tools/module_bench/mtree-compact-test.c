@@ -0,0 +1,251 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Tree layouts of modules/mtree: <prefixes> random digit prefixes of 3 to
+ * 10 chars are loaded with mt_add_to_tree() of mtree.c in the default
+ * layout (node arrays) and with mt_compact_mode set (records sorted and
+ * placed in the double-array trie by mt_compact_tree()). The longest
+ * prefix match of mt_get_tvalue() has to return the same value with both
+ * layouts for random 12 digit numbers, then the shm memory used by each
+ * tree, the peak while loading it and the lookups per second are reported.
+ *   test-mtree-compact <seconds> <prefixes>
+ * The exit code is 1 if the layouts return different values.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/pvar.h"
+#include "core/usr_avp.h"
+#include "core/parser/parse_param.h"
+#include "modules/mtree/mtree.h"
+
+#include "bench_core.h"
+
+#define BENCH_NUMBERS 200000
+
+/* parameters and globals of mtree_mod.c */
+str mt_char_list = str_init("0123456789");
+pv_spec_t pv_value;
+pv_spec_t pv_values;
+pv_spec_t pv_dstid;
+pv_spec_t pv_weight;
+pv_spec_t pv_count;
+int _mt_tree_type = MT_TREE_SVAL;
+int _mt_ignore_duplicates = 1;
+int _mt_allow_duplicates = 0;
+int _mt_compact_mode = 0;
+
+/* core functions used by the module, not called for string trees */
+int shm_initialized(void)
+{
+	return 1;
+}
+
+int parse_params(str *_s, pclass_t _c, param_hooks_t *_h, param_t **_p)
+{
+	return -1;
+}
+
+void free_params(param_t *_p)
+{
+}
+
+int add_avp(avp_flags_t flags, avp_name_t name, avp_value_t val)
+{
+	return -1;
+}
+
+int destroy_avps(avp_flags_t flags, avp_name_t name, int all)
+{
+	return 0;
+}
+
+int pv_get_avp_name(struct sip_msg *msg, pv_param_p ip, avp_name_t *avp_name,
+		avp_flags_t *name_type)
+{
+	return -1;
+}
+
+static unsigned int bench_rand(void)
+{
+	static unsigned int x = 2463534242u;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+static void bench_digits(char *s, int len)
+{
+	int i;
+
+	for(i = 0; i < len; i++) {
+		s[i] = '0' + bench_rand() % 10;
+	}
+	s[len] = '\0';
+}
+
+static m_tree_t *bench_load(char *name, char (*prefixes)[16], int n,
+		size_t *mem, size_t *peak)
+{
+	str tname;
+	str dbtable = str_init("");
+	str tprefix, tvalue;
+	char value[16];
+	m_tree_t *pt;
+	size_t mem0;
+	int i;
+
+	mem0 = bench_shm_used();
+	bench_shm_peak_reset();
+	tname.s = name;
+	tname.len = strlen(name);
+	pt = mt_init_tree(&tname, &dbtable, NULL, MT_TREE_SVAL, 0, 0);
+	if(pt == NULL) {
+		return NULL;
+	}
+	for(i = 0; i < n; i++) {
+		tprefix.s = prefixes[i];
+		tprefix.len = strlen(prefixes[i]);
+		tvalue.len = snprintf(value, sizeof(value), "%d", i);
+		tvalue.s = value;
+		if(mt_add_to_tree(pt, &tprefix, &tvalue) < 0) {
+			return NULL;
+		}
+	}
+	if(_mt_compact_mode != 0 && mt_compact_tree(pt) < 0) {
+		return NULL;
+	}
+	*mem = bench_shm_used() - mem0;
+	*peak = bench_shm_peak() - mem0;
+	return pt;
+}
+
+static double bench_rate(m_tree_t *pt, char (*numbers)[16], int duration)
+{
+	unsigned long long lookups = 0;
+	double t0, t1;
+	str tomatch;
+	int len;
+	int i;
+
+	t0 = bench_now();
+	do {
+		for(i = 0; i < 100; i++) {
+			tomatch.s = numbers[(lookups + i) % BENCH_NUMBERS];
+			tomatch.len = 12;
+			mt_get_tvalue(pt, &tomatch, &len);
+		}
+		lookups += 100;
+		t1 = bench_now();
+	} while(t1 - t0 < duration);
+	return (double)lookups / (t1 - t0);
+}
+
+int main(int argc, char *argv[])
+{
+	char(*prefixes)[16];
+	char(*numbers)[16];
+	m_tree_t *ptree, *ctree;
+	size_t pmem, ppeak, cmem, cpeak;
+	double prate, crate;
+	is_t *pv, *cv;
+	str tomatch;
+	char *p;
+	int plen, clen;
+	int duration;
+	int n;
+	int diffs = 0;
+	int i;
+
+	if(argc != 3) {
+		fprintf(stderr, "Usage: %s <seconds> <prefixes>\n", argv[0]);
+		return 1;
+	}
+	duration = atoi(argv[1]);
+	n = atoi(argv[2]);
+	if(duration <= 0 || n <= 0) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	bench_core_init();
+	prefixes = malloc(n * sizeof(*prefixes));
+	numbers = malloc(BENCH_NUMBERS * sizeof(*numbers));
+	if(prefixes == NULL || numbers == NULL) {
+		return 1;
+	}
+	for(i = 0; i < n; i++) {
+		bench_digits(prefixes[i], 3 + bench_rand() % 8);
+	}
+	/* half of the numbers starting with a loaded prefix */
+	for(i = 0; i < BENCH_NUMBERS; i++) {
+		bench_digits(numbers[i], 12);
+		if(i % 2 == 0) {
+			p = prefixes[bench_rand() % n];
+			memcpy(numbers[i], p, strlen(p));
+		}
+	}
+
+	_mt_compact_mode = 0;
+	ptree = bench_load("default", prefixes, n, &pmem, &ppeak);
+	_mt_compact_mode = 1;
+	ctree = bench_load("compact", prefixes, n, &cmem, &cpeak);
+	if(ptree == NULL || ctree == NULL) {
+		fprintf(stderr, "Error: failed to load the trees\n");
+		return 1;
+	}
+
+	for(i = 0; i < BENCH_NUMBERS; i++) {
+		tomatch.s = numbers[i];
+		tomatch.len = 12;
+		plen = clen = 0;
+		pv = mt_get_tvalue(ptree, &tomatch, &plen);
+		cv = mt_get_tvalue(ctree, &tomatch, &clen);
+		if((pv == NULL) != (cv == NULL) || plen != clen
+				|| (pv != NULL && (pv->s.len != cv->s.len
+										  || memcmp(pv->s.s, cv->s.s, pv->s.len)
+													 != 0))) {
+			diffs++;
+		}
+	}
+
+	prate = bench_rate(ptree, numbers, duration);
+	crate = bench_rate(ctree, numbers, duration);
+
+	printf("prefixes: %d\n", n);
+	printf("results differing between layouts: %d\n", diffs);
+	printf("default layout: %zu bytes (peak %zu) lookups/sec: %.0f\n", pmem,
+			ppeak, prate);
+	printf("compact layout: %zu bytes (peak %zu) lookups/sec: %.0f\n", cmem,
+			cpeak, crate);
+
+	mt_free_tree(ptree);
+	mt_free_tree(ctree);
+	free(prefixes);
+	free(numbers);
+	return (diffs > 0) ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Prefix-domain translation of modules/pdt: <prefixes> distinct random
+ * digit prefixes of 3 to 10 chars, each with its own domain, are added to
+ * the shm tree of pdtree.c for the source domain "*" as pdt_load_db()
+ * does, and written to a text file built by utils/mtbuild and mapped with
+ * the file parameter (pdt_mfile.c). The longest prefix match has to return
+ * the same domain and prefix length with the file as with the tree for
+ * random 12 digit numbers, then the memory of each and the lookups per
+ * second are reported.
+ *   test-pdt-file <seconds> <prefixes>
+ * The exit code is 1 if the file and the tree return different domains.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "core/str.h"
+#include "modules/pdt/pdtree.h"
+#include "modules/pdt/pdt_mfile.h"
+
+#include "bench_core.h"
+
+#define BENCH_NUMBERS 200000
+
+/* parameters of pdt.c */
+str pdt_char_list = str_init("0123456789");
+int _pdt_mode = 0;
+
+static unsigned int bench_rand(void)
+{
+	static unsigned int x = 2463534242u;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+static void bench_digits(char *s, int len)
+{
+	int i;
+
+	for(i = 0; i < len; i++) {
+		s[i] = '0' + bench_rand() % 10;
+	}
+	s[len] = '\0';
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	return strcmp((const char *)a, (const char *)b);
+}
+
+static double bench_rate(pdt_tree_t *pt, char (*numbers)[16], int duration)
+{
+	unsigned long long lookups = 0;
+	str sdall = str_init("*");
+	double t0, t1;
+	str code;
+	int plen;
+	int i;
+
+	t0 = bench_now();
+	do {
+		for(i = 0; i < 100; i++) {
+			code.s = numbers[(lookups + i) % BENCH_NUMBERS];
+			code.len = 12;
+			if(pt != NULL) {
+				pdt_get_domain(pt, &sdall, &code, &plen);
+			} else {
+				pdt_mfile_get_domain(&sdall, &code, &plen);
+			}
+		}
+		lookups += 100;
+		t1 = bench_now();
+	} while(t1 - t0 < duration);
+	return (double)lookups / (t1 - t0);
+}
+
+int main(int argc, char *argv[])
+{
+	char(*prefixes)[16];
+	char(*numbers)[16];
+	char txt[] = "/tmp/test-pdt-XXXXXX";
+	char mtb[64];
+	char cmd[256];
+	char param[128];
+	char domain[32];
+	str sdall = str_init("*");
+	pdt_tree_t *pt = NULL;
+	size_t tmem;
+	long fsize;
+	double trate, frate;
+	str code, d;
+	str *td, *fd;
+	int tlen, flen;
+	FILE *f;
+	char *p;
+	int duration;
+	int n, m;
+	int diffs = 0;
+	int tfd;
+	int i;
+
+	if(argc != 3) {
+		fprintf(stderr, "Usage: %s <seconds> <prefixes>\n", argv[0]);
+		return 1;
+	}
+	duration = atoi(argv[1]);
+	n = atoi(argv[2]);
+	if(duration <= 0 || n <= 0) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	bench_core_init();
+	prefixes = malloc(n * sizeof(*prefixes));
+	numbers = malloc(BENCH_NUMBERS * sizeof(*numbers));
+	if(prefixes == NULL || numbers == NULL) {
+		return 1;
+	}
+	for(i = 0; i < n; i++) {
+		bench_digits(prefixes[i], 3 + bench_rand() % 8);
+	}
+	/* duplicated prefixes stop both the tree load and mtbuild */
+	qsort(prefixes, n, sizeof(*prefixes), bench_cmp);
+	for(i = 1, m = 1; i < n; i++) {
+		if(strcmp(prefixes[i], prefixes[m - 1]) != 0) {
+			memcpy(prefixes[m++], prefixes[i], sizeof(*prefixes));
+		}
+	}
+	n = m;
+	/* half of the numbers starting with a loaded prefix */
+	for(i = 0; i < BENCH_NUMBERS; i++) {
+		bench_digits(numbers[i], 12);
+		if(i % 2 == 0) {
+			p = prefixes[bench_rand() % n];
+			memcpy(numbers[i], p, strlen(p));
+		}
+	}
+
+	tfd = mkstemp(txt);
+	if(tfd < 0 || (f = fdopen(tfd, "w")) == NULL) {
+		fprintf(stderr, "Error: cannot create the text file\n");
+		return 1;
+	}
+	tmem = bench_shm_used();
+	for(i = 0; i < n; i++) {
+		code.s = prefixes[i];
+		code.len = strlen(code.s);
+		d.len = snprintf(domain, sizeof(domain), "gw%d.example.net", i);
+		d.s = domain;
+		if(pdt_add_to_tree(&pt, &sdall, &code, &d) < 0) {
+			fprintf(stderr, "Error: cannot add prefix %s\n", prefixes[i]);
+			return 1;
+		}
+		fprintf(f, "%s %s\n", prefixes[i], domain);
+	}
+	tmem = bench_shm_used() - tmem;
+	fclose(f);
+
+	snprintf(mtb, sizeof(mtb), "%s.mtb", txt);
+	snprintf(cmd, sizeof(cmd), "%s -i %s -o %s", BENCH_MTBUILD, txt, mtb);
+	if(system(cmd) != 0) {
+		fprintf(stderr, "Error: failed to run [%s]\n", cmd);
+		return 1;
+	}
+	unlink(txt);
+	f = fopen(mtb, "r");
+	if(f == NULL || fseek(f, 0, SEEK_END) != 0) {
+		return 1;
+	}
+	fsize = ftell(f);
+	fclose(f);
+
+	snprintf(param, sizeof(param), "sdomain=*;file=%s", mtb);
+	if(pdt_mfile_param(PARAM_STRING, param) != 0 || pdt_mfile_init() != 0) {
+		fprintf(stderr, "Error: failed to map %s\n", mtb);
+		return 1;
+	}
+	for(i = 0; i < BENCH_NUMBERS; i++) {
+		code.s = numbers[i];
+		code.len = 12;
+		tlen = flen = 0;
+		td = pdt_get_domain(pt, &sdall, &code, &tlen);
+		fd = pdt_mfile_get_domain(&sdall, &code, &flen);
+		if((td == NULL) != (fd == NULL) || tlen != flen
+				|| (td != NULL
+						&& (td->len != fd->len
+								|| strcmp(td->s, fd->s) != 0))) {
+			diffs++;
+		}
+	}
+
+	trate = bench_rate(pt, numbers, duration);
+	frate = bench_rate(NULL, numbers, duration);
+	unlink(mtb);
+
+	printf("prefixes: %d\n", n);
+	printf("domains differing between file and tree: %d\n", diffs);
+	printf("tree: %zu bytes shm lookups/sec: %.0f\n", tmem, trate);
+	printf("file: %ld bytes mapped lookups/sec: %.0f\n", fsize, frate);
+
+	pdt_free_tree(pt);
+	free(prefixes);
+	free(numbers);
+	return (diffs > 0) ? 1 : 0;
+}
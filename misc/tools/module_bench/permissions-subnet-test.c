@@ -0,0 +1,326 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Subnet table matching of modules/permissions (allow_address() and
+ * allow_source_address_group()) with the prefix index of hash.c against
+ * the linear scan of the records, for <subnets> random IPv4 and IPv6
+ * subnets spread over 16 groups, plus records with mask 0.
+ * First the index has to select the same record as the scan (identified by
+ * its tag) for random addresses in both subnet_match_mode values, and the
+ * cases with mask 0 records are checked, then the lookups per second of
+ * both are reported.
+ *   test-permissions-subnet <seconds> <subnets>
+ * The exit code is 1 if the index and the scan differ.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "core/usr_avp.h"
+#include "core/pvar.h"
+#include "core/parser/msg_parser.h"
+#include "modules/permissions/hash.h"
+
+#include "bench_core.h"
+
+#define BENCH_GROUPS 16
+#define BENCH_CHECKS 200000
+
+/* parameters and globals of permissions.c and trusted.c */
+int perm_peer_tag_mode = 0;
+int _perm_max_subnets = 512;
+int _perm_subnet_match_mode = 0;
+unsigned int *perm_trust_version = NULL;
+
+/* tag of the record selected by the last matching */
+static char *bench_tag = NULL;
+
+int add_avp(avp_flags_t flags, avp_name_t name, avp_value_t val)
+{
+	bench_tag = val.s.s;
+	return 0;
+}
+
+int pv_get_avp_name(struct sip_msg *msg, pv_param_p ip, avp_name_t *avp_name,
+		avp_flags_t *name_type)
+{
+	avp_name->n = 1;
+	*name_type = 0;
+	return 0;
+}
+
+char *pv_parse_spec2(str *in, pv_spec_p sp, int silent)
+{
+	memset(sp, 0, sizeof(pv_spec_t));
+	sp->type = PVT_AVP;
+	return in->s + in->len;
+}
+
+static unsigned int bench_rand(void)
+{
+	static unsigned int x = 2463534242u;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+static void bench_rand_addr(ip_addr_t *ip, int v6)
+{
+	int i;
+
+	memset(ip, 0, sizeof(ip_addr_t));
+	ip->af = (v6) ? AF_INET6 : AF_INET;
+	ip->len = (v6) ? 16 : 4;
+	for(i = 0; i < ip->len; i++) {
+		ip->u.addr[i] = (unsigned char)bench_rand();
+	}
+	if(v6) {
+		/* keep the prefixes in a few /16 networks */
+		ip->u.addr[0] = 0x20;
+		ip->u.addr[1] = 0x01;
+	} else {
+		ip->u.addr[0] = 10 + bench_rand() % 4;
+	}
+}
+
+static int bench_insert(struct subnet *table, unsigned int grp, ip_addr_t *ip,
+		unsigned int mask, unsigned int port, int n)
+{
+	char buf[16];
+	str tag;
+
+	tag.len = snprintf(buf, sizeof(buf), "%d", n);
+	tag.s = buf;
+	return subnet_table_insert(table, grp, ip, mask, port, &tag);
+}
+
+/*
+ * Match with the index if idx is set, otherwise with the linear scan,
+ * returning the tag of the selected record or NULL
+ */
+static char *bench_match(struct subnet *table, int idx, int anygrp,
+		unsigned int grp, ip_addr_t *ip, unsigned int port)
+{
+	struct subnet_lpm *lpm;
+	int ret;
+
+	lpm = table[_perm_max_subnets].lpm;
+	if(!idx) {
+		table[_perm_max_subnets].lpm = NULL;
+	}
+	bench_tag = NULL;
+	if(anygrp) {
+		ret = find_group_in_subnet_table(table, ip, port);
+	} else {
+		ret = match_subnet_table(table, grp, ip, port);
+	}
+	table[_perm_max_subnets].lpm = lpm;
+	return (ret < 0) ? NULL : bench_tag;
+}
+
+static int bench_same(char *t1, char *t2)
+{
+	if(t1 == NULL || t2 == NULL) {
+		return (t1 == t2);
+	}
+	return (strcmp(t1, t2) == 0);
+}
+
+/*
+ * Mask 0 records: never selected by the scan, but ending it without result
+ * in match mode 0 if reached first, for any address family
+ */
+static int bench_check_mask0(void)
+{
+	struct subnet *table;
+	ip_addr_t net, ip4, ip6;
+	char *t;
+	int err = 0;
+
+	table = new_subnet_table();
+	memset(&net, 0, sizeof(net));
+	net.af = AF_INET;
+	net.len = 4;
+	bench_insert(table, 1, &net, 0, 0, 1);
+	net.u.addr[0] = 10;
+	bench_insert(table, 1, &net, 8, 0, 2);
+	subnet_table_index(table);
+
+	memset(&ip4, 0, sizeof(ip4));
+	ip4.af = AF_INET;
+	ip4.len = 4;
+	ip4.u.addr[0] = 10;
+	ip4.u.addr[3] = 1;
+	memset(&ip6, 0, sizeof(ip6));
+	ip6.af = AF_INET6;
+	ip6.len = 16;
+	ip6.u.addr[15] = 1;
+
+	_perm_subnet_match_mode = 0;
+	if((t = bench_match(table, 1, 0, 1, &ip4, 5060)) != NULL
+			|| bench_match(table, 0, 0, 1, &ip4, 5060) != NULL) {
+		fprintf(stderr, "mask 0: mode 0 selected record %s\n", t);
+		err = 1;
+	}
+	if(bench_match(table, 1, 1, 0, &ip6, 5060) != NULL) {
+		fprintf(stderr, "mask 0: mode 0 matched an IPv6 address\n");
+		err = 1;
+	}
+	_perm_subnet_match_mode = 1;
+	t = bench_match(table, 1, 0, 1, &ip4, 5060);
+	if(t == NULL || strcmp(t, "2") != 0
+			|| !bench_same(t, bench_match(table, 0, 0, 1, &ip4, 5060))) {
+		fprintf(stderr, "mask 0: mode 1 selected record %s\n", t);
+		err = 1;
+	}
+	if((t = bench_match(table, 1, 1, 0, &ip6, 5060)) != NULL) {
+		fprintf(stderr, "mask 0: mode 1 matched IPv6 to record %s\n", t);
+		err = 1;
+	}
+	free_subnet_table(table);
+	return err;
+}
+
+static double bench_rate(struct subnet *table, int idx, ip_addr_t *addrs,
+		int naddrs, int duration)
+{
+	unsigned long long lookups = 0;
+	double t0, t1;
+	int i;
+
+	t0 = bench_now();
+	do {
+		for(i = 0; i < 100; i++) {
+			bench_match(table, idx, 1, 0, &addrs[(lookups + i) % naddrs],
+					5060);
+		}
+		lookups += 100;
+		t1 = bench_now();
+	} while(t1 - t0 < duration);
+	return (double)lookups / (t1 - t0);
+}
+
+int main(int argc, char *argv[])
+{
+	struct subnet *table;
+	ip_addr_t ip;
+	ip_addr_t *addrs;
+	str tagavp = str_init("$avp(tag)");
+	unsigned int mask, grp;
+	double rscan[2], ridx[2];
+	size_t imem;
+	int duration;
+	int subnets;
+	int diffs = 0;
+	int mode;
+	int i;
+	char *t1, *t2;
+
+	if(argc != 3) {
+		fprintf(stderr, "Usage: %s <seconds> <subnets>\n", argv[0]);
+		return 1;
+	}
+	duration = atoi(argv[1]);
+	subnets = atoi(argv[2]);
+	if(duration <= 0 || subnets <= 0) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	bench_core_init();
+	init_tag_avp(&tagavp);
+	if(bench_check_mask0() != 0) {
+		diffs++;
+	}
+
+	_perm_max_subnets = subnets + 4;
+	table = new_subnet_table();
+	addrs = malloc(BENCH_CHECKS * sizeof(ip_addr_t));
+	if(table == NULL || addrs == NULL) {
+		return 1;
+	}
+	for(i = 0; i < subnets; i++) {
+		if(i == subnets / 2) {
+			/* mask 0 records in the middle of the table */
+			memset(&ip, 0, sizeof(ip));
+			ip.af = AF_INET;
+			ip.len = 4;
+			bench_insert(table, 3, &ip, 0, 5080, subnets);
+			bench_insert(table, 5, &ip, 0, 0, subnets + 1);
+		}
+		bench_rand_addr(&ip, (bench_rand() % 4) == 0);
+		if(ip.af == AF_INET) {
+			mask = 16 + bench_rand() % 17;
+		} else {
+			mask = 32 + bench_rand() % 97;
+		}
+		grp = 1 + bench_rand() % BENCH_GROUPS;
+		bench_insert(table, grp, &ip, mask, (bench_rand() % 3) ? 0 : 5060, i);
+	}
+	imem = bench_shm_used();
+	subnet_table_index(table);
+	imem = bench_shm_used() - imem;
+
+	/* half of the addresses inside one of the subnets */
+	for(i = 0; i < BENCH_CHECKS; i++) {
+		if(i % 2) {
+			bench_rand_addr(&addrs[i], (bench_rand() % 4) == 0);
+		} else {
+			addrs[i] = table[bench_rand() % subnets].subnet;
+			addrs[i].u.addr[addrs[i].len - 1] ^= bench_rand() & 0x3;
+		}
+	}
+
+	for(mode = 0; mode < 2; mode++) {
+		_perm_subnet_match_mode = mode;
+		for(i = 0; i < BENCH_CHECKS / 20; i++) {
+			grp = 1 + i % BENCH_GROUPS;
+			t1 = bench_match(table, 1, 0, grp, &addrs[i], 5060);
+			t2 = bench_match(table, 0, 0, grp, &addrs[i], 5060);
+			if(!bench_same(t1, t2)) {
+				diffs++;
+			}
+			t1 = bench_match(table, 1, 1, 0, &addrs[i], 5060);
+			t2 = bench_match(table, 0, 1, 0, &addrs[i], 5060);
+			if(!bench_same(t1, t2)) {
+				diffs++;
+			}
+		}
+		rscan[mode] = bench_rate(table, 0, addrs, BENCH_CHECKS, duration);
+		ridx[mode] = bench_rate(table, 1, addrs, BENCH_CHECKS, duration);
+	}
+
+	printf("subnets: %d index: %zu bytes\n", subnets, imem);
+	printf("results differing from the scan: %d\n", diffs);
+	for(mode = 0; mode < 2; mode++) {
+		printf("subnet_match_mode %d lookups/sec: scan %.0f index %.0f\n", mode,
+				rscan[mode], ridx[mode]);
+	}
+
+	free_subnet_table(table);
+	free(addrs);
+	return (diffs > 0) ? 1 : 0;
+}
@@ -0,0 +1,229 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * allow_trusted() matching of the trusted table of modules/permissions:
+ * one source address with <rules> entries, each with its own From pattern
+ * and a Request URI pattern shared by all, with a From URI matching only
+ * the last entry, then with a From URI matching none. Matching:
+ * - grouped: table built and matched as by trusted.c, with match_hash_table()
+ *   of hash.c (patterns compiled once per process), after hash_table_group()
+ *   combined the From patterns of the entries
+ * - cached: the same, without combined patterns
+ * - percheck: the previous matching, running regcomp(), regexec() and
+ *   regfree() for each pattern of each entry
+ *   test-permissions-trusted <seconds> <rules> <grouped|cached|percheck>
+ * The exit code is 1 if the From URI of the last entry does not match or
+ * if the other one matches.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <regex.h>
+
+#include "core/hash_func.h"
+#include "core/usr_avp.h"
+#include "core/pvar.h"
+#include "core/parser/msg_parser.h"
+#include "modules/permissions/hash.h"
+
+#include "bench_core.h"
+
+#define BENCH_SRC_IP "192.0.2.10"
+
+/* parameters and globals of permissions.c and trusted.c */
+int perm_peer_tag_mode = 0;
+int _perm_max_subnets = 512;
+int _perm_subnet_match_mode = 0;
+unsigned int *perm_trust_version = NULL;
+
+int add_avp(avp_flags_t flags, avp_name_t name, avp_value_t val)
+{
+	return 0;
+}
+
+int pv_get_avp_name(struct sip_msg *msg, pv_param_p ip, avp_name_t *avp_name,
+		avp_flags_t *name_type)
+{
+	return -1;
+}
+
+char *pv_parse_spec2(str *in, pv_spec_p sp, int silent)
+{
+	return NULL;
+}
+
+/*
+ * Matching of the trusted table before the patterns cache, as it was in
+ * match_hash_table()
+ */
+static int match_hash_table_percheck(struct trusted_list **table,
+		char *src_ip_c_str, char *from_uri, char *ruri)
+{
+	regex_t preg;
+	struct trusted_list *np;
+	str src_ip;
+
+	src_ip.s = src_ip_c_str;
+	src_ip.len = strlen(src_ip.s);
+
+	for(np = table[core_hash(&src_ip, 0, PERM_HASH_SIZE)]; np != NULL;
+			np = np->next) {
+		if((np->src_ip.len != src_ip.len)
+				|| (strncmp(np->src_ip.s, src_ip.s, src_ip.len) != 0)) {
+			continue;
+		}
+		if(np->pattern) {
+			if(regcomp(&preg, np->pattern, REG_NOSUB)) {
+				continue;
+			}
+			if(regexec(&preg, from_uri, 0, (regmatch_t *)0, 0)) {
+				regfree(&preg);
+				continue;
+			}
+			regfree(&preg);
+		}
+		if(np->ruri_pattern) {
+			if(regcomp(&preg, np->ruri_pattern, REG_NOSUB)) {
+				continue;
+			}
+			if(regexec(&preg, ruri, 0, (regmatch_t *)0, 0)) {
+				regfree(&preg);
+				continue;
+			}
+			regfree(&preg);
+		}
+		return 1;
+	}
+	return -1;
+}
+
+static int bench_run(struct trusted_list **table, struct sip_msg *msg,
+		char *from_uri, int duration, int cached, int expected)
+{
+	unsigned long long checks = 0;
+	char *ruri;
+	double t0, t1;
+	int i;
+
+	ruri = msg->first_line.u.request.uri.s;
+	t0 = bench_now();
+	do {
+		for(i = 0; i < 100; i++) {
+			if(cached) {
+				if(match_hash_table(
+						   table, msg, BENCH_SRC_IP, PROTO_UDP, from_uri)
+						!= expected) {
+					fprintf(stderr, "Error: wrong result for %s\n", from_uri);
+					return -1;
+				}
+			} else {
+				if(match_hash_table_percheck(
+						   table, BENCH_SRC_IP, from_uri, ruri)
+						!= expected) {
+					fprintf(stderr, "Error: wrong result for %s\n", from_uri);
+					return -1;
+				}
+			}
+		}
+		checks += 100;
+		t1 = bench_now();
+	} while(t1 - t0 < duration);
+
+	printf("%-8s checks/sec: %.0f\n", (expected == 1) ? "match" : "no match",
+			(double)checks / (t1 - t0));
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	struct trusted_list **table;
+	struct sip_msg msg;
+	char ruri[] = "sip:+4930123456@gw.example.net";
+	char from_uri[128];
+	char pattern[128];
+	unsigned int version = 0;
+	int duration;
+	int rules;
+	int cached;
+	int grouped;
+	int i;
+
+	if(argc != 4) {
+		fprintf(stderr,
+				"Usage: %s <seconds> <rules> <grouped|cached|percheck>\n",
+				argv[0]);
+		return 1;
+	}
+	duration = atoi(argv[1]);
+	rules = atoi(argv[2]);
+	grouped = (strcmp(argv[3], "grouped") == 0);
+	cached = grouped || (strcmp(argv[3], "cached") == 0);
+	if(duration <= 0 || rules <= 0) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	bench_core_init();
+	perm_trust_version = &version;
+	table = new_hash_table();
+	if(table == NULL) {
+		return 1;
+	}
+	for(i = 0; i < rules; i++) {
+		snprintf(pattern, sizeof(pattern),
+				"^sip:[a-z0-9.]*@pbx%d\\.customer\\.example\\.com$", i);
+		if(hash_table_insert(table, BENCH_SRC_IP, "any", pattern,
+				   "^sip:+49[0-9]*@gw\\.example\\.net$", NULL, 0)
+				< 0) {
+			return 1;
+		}
+	}
+	if(grouped && hash_table_group(table) < 0) {
+		return 1;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.first_line.type = SIP_REQUEST;
+	msg.first_line.flags = FLINE_FLAG_PROTO_SIP;
+	msg.first_line.u.request.uri.s = ruri;
+	msg.first_line.u.request.uri.len = strlen(ruri);
+
+	printf("rules: %d matching: %s\n", rules, argv[3]);
+	snprintf(from_uri, sizeof(from_uri),
+			"sip:alice@pbx%d.customer.example.com", rules - 1);
+	if(bench_run(table, &msg, from_uri, duration, cached, 1) < 0) {
+		return 1;
+	}
+	snprintf(from_uri, sizeof(from_uri),
+			"sip:alice@pbx%d.customer.example.com", rules);
+	if(bench_run(table, &msg, from_uri, duration, cached, -1) < 0) {
+		return 1;
+	}
+	printf("pkg memory of cache items: %zu bytes (regcomp() data not "
+		   "counted)\n",
+			bench_pkg_used());
+
+	free_hash_table(table);
+	return 0;
+}
@@ -0,0 +1,238 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Prefix routes of modules/prefix_route: <prefixes> distinct random digit
+ * prefixes of 3 to 10 chars, each for one of 64 route blocks, are added to
+ * the shm tree of tree.c as pr_db_load() does, and written to a text file
+ * built by utils/mtbuild and mapped with the file parameter (tree_mfile.c).
+ * tree_route_get() has to return the same route with the file as with the
+ * tree for random 12 digit numbers, then the memory of each and the lookups
+ * per second are reported.
+ *   test-prefix-route-file <seconds> <prefixes>
+ * The exit code is 1 if the file and the tree return different routes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "core/str.h"
+#include "core/route.h"
+#include "modules/prefix_route/tree.h"
+
+#include "bench_core.h"
+
+#define BENCH_NUMBERS 200000
+#define BENCH_ROUTES 64
+
+/* route blocks "r1" to "r64" of the configuration */
+struct route_list main_rt = {.entries = BENCH_ROUTES + 1};
+
+int route_lookup(struct route_list *rt, char *name)
+{
+	int ix;
+
+	if(name[0] != 'r' || (ix = atoi(name + 1)) <= 0 || ix > BENCH_ROUTES) {
+		return -1;
+	}
+	return ix;
+}
+
+static unsigned int bench_rand(void)
+{
+	static unsigned int x = 2463534242u;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return x;
+}
+
+static void bench_digits(char *s, int len)
+{
+	int i;
+
+	for(i = 0; i < len; i++) {
+		s[i] = '0' + bench_rand() % 10;
+	}
+	s[len] = '\0';
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	return strcmp((const char *)a, (const char *)b);
+}
+
+static double bench_rate(char (*numbers)[16], int duration)
+{
+	unsigned long long lookups = 0;
+	double t0, t1;
+	str user;
+	int i;
+
+	t0 = bench_now();
+	do {
+		for(i = 0; i < 100; i++) {
+			user.s = numbers[(lookups + i) % BENCH_NUMBERS];
+			user.len = 12;
+			tree_route_get(&user);
+		}
+		lookups += 100;
+		t1 = bench_now();
+	} while(t1 - t0 < duration);
+	return (double)lookups / (t1 - t0);
+}
+
+int main(int argc, char *argv[])
+{
+	char(*prefixes)[16];
+	char(*numbers)[16];
+	char txt[] = "/tmp/test-prefix-route-XXXXXX";
+	char mtb[64];
+	char cmd[256];
+	char name[16];
+	struct tree_item *root;
+	int *routes;
+	size_t tmem;
+	long fsize;
+	double trate, frate;
+	str user;
+	FILE *f;
+	char *p;
+	int duration;
+	int n, m;
+	int diffs = 0;
+	int fd;
+	int i;
+
+	if(argc != 3) {
+		fprintf(stderr, "Usage: %s <seconds> <prefixes>\n", argv[0]);
+		return 1;
+	}
+	duration = atoi(argv[1]);
+	n = atoi(argv[2]);
+	if(duration <= 0 || n <= 0) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	bench_core_init();
+	prefixes = malloc(n * sizeof(*prefixes));
+	numbers = malloc(BENCH_NUMBERS * sizeof(*numbers));
+	routes = malloc(BENCH_NUMBERS * sizeof(int));
+	if(prefixes == NULL || numbers == NULL || routes == NULL) {
+		return 1;
+	}
+	for(i = 0; i < n; i++) {
+		bench_digits(prefixes[i], 3 + bench_rand() % 8);
+	}
+	/* the tree keeps the last duplicated prefix, mtbuild stops on them */
+	qsort(prefixes, n, sizeof(*prefixes), bench_cmp);
+	for(i = 1, m = 1; i < n; i++) {
+		if(strcmp(prefixes[i], prefixes[m - 1]) != 0) {
+			memcpy(prefixes[m++], prefixes[i], sizeof(*prefixes));
+		}
+	}
+	n = m;
+	/* half of the numbers starting with a loaded prefix */
+	for(i = 0; i < BENCH_NUMBERS; i++) {
+		bench_digits(numbers[i], 12);
+		if(i % 2 == 0) {
+			p = prefixes[bench_rand() % n];
+			memcpy(numbers[i], p, strlen(p));
+		}
+	}
+
+	fd = mkstemp(txt);
+	if(fd < 0 || (f = fdopen(fd, "w")) == NULL) {
+		fprintf(stderr, "Error: cannot create the text file\n");
+		return 1;
+	}
+	if(tree_init() != 0 || (root = tree_item_alloc()) == NULL) {
+		fprintf(stderr, "Error: cannot init the tree\n");
+		return 1;
+	}
+	tmem = bench_shm_used();
+	for(i = 0; i < n; i++) {
+		snprintf(name, sizeof(name), "r%d", 1 + i % BENCH_ROUTES);
+		if(tree_item_add(root, prefixes[i], name, 1 + i % BENCH_ROUTES)
+				!= 0) {
+			fprintf(stderr, "Error: cannot add prefix %s\n", prefixes[i]);
+			return 1;
+		}
+		fprintf(f, "%s %s\n", prefixes[i], name);
+	}
+	tmem = bench_shm_used() - tmem;
+	fclose(f);
+	if(tree_swap(root) != 0) {
+		return 1;
+	}
+
+	snprintf(mtb, sizeof(mtb), "%s.mtb", txt);
+	snprintf(cmd, sizeof(cmd), "%s -i %s -o %s", BENCH_MTBUILD, txt, mtb);
+	if(system(cmd) != 0) {
+		fprintf(stderr, "Error: failed to run [%s]\n", cmd);
+		return 1;
+	}
+	unlink(txt);
+	f = fopen(mtb, "r");
+	if(f == NULL || fseek(f, 0, SEEK_END) != 0) {
+		return 1;
+	}
+	fsize = ftell(f);
+	fclose(f);
+
+	for(i = 0; i < BENCH_NUMBERS; i++) {
+		user.s = numbers[i];
+		user.len = 12;
+		routes[i] = tree_route_get(&user);
+	}
+	trate = bench_rate(numbers, duration);
+
+	if(tree_mfile_init(mtb) != 0) {
+		fprintf(stderr, "Error: failed to map %s\n", mtb);
+		return 1;
+	}
+	for(i = 0; i < BENCH_NUMBERS; i++) {
+		user.s = numbers[i];
+		user.len = 12;
+		if(tree_route_get(&user) != routes[i]) {
+			diffs++;
+		}
+	}
+	frate = bench_rate(numbers, duration);
+	unlink(mtb);
+
+	printf("prefixes: %d\n", n);
+	printf("routes differing between file and tree: %d\n", diffs);
+	printf("tree: %zu bytes shm lookups/sec: %.0f\n", tmem, trate);
+	printf("file: %ld bytes mapped, %zu bytes pkg per process "
+		   "lookups/sec: %.0f\n",
+			fsize, bench_pkg_used(), frate);
+
+	free(prefixes);
+	free(numbers);
+	free(routes);
+	return (diffs > 0) ? 1 : 0;
+}
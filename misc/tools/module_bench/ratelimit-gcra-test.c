@@ -0,0 +1,330 @@
+/*
+* Copyright (C) 2026 kamailio.org
+*
+* This file is part of Kamailio, a free SIP server.
+*
+* SPDX-License-Identifier: GPL-2.0-or-later
+*
+* Kamailio is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version
+*
+* Kamailio is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software
+* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Accepted rate and cost of the checks of one pipe from <processes>
+ * forked processes, sharing it as the sip workers of kamailio:
+ * - taildrop: rl_check() of modules/ratelimit on a TAILDROP pipe, counted
+ *   under rl_lock, the counter being reset by rl_timer_handle() every
+ *   <interval> seconds
+ * - gcra: rl_check() of modules/ratelimit on a GCRA pipe, deciding with
+ *   rl_gcra_push() without lock
+ * - pl-gcra: pl_pipe_gcra_check() of modules/pipelimit/pl_ht.c, under the
+ *   lock of the slot of the pipe as done by pl_check()
+ * As for the modules, the limit is per second for the ratelimit pipes and
+ * per <interval> seconds for the pipelimit one. <rate> is the total number
+ * of checks per second done by the processes, 0 for as fast as possible.
+ * ratelimit.c is included to reach its static functions and pipes.
+ *   test-ratelimit-gcra <seconds> <processes> <taildrop|gcra|pl-gcra>
+ *           <limit> <interval> <rate>
+ * The exit code is 1 if more requests are accepted than the limit and the
+ * burst of one limit allow, or if a gcra pipe checked faster than its
+ * limit accepts less than 90% of it.
+ */
+
+#include <sys/wait.h>
+
+/* algo_names is global in both modules, loaded apart by kamailio */
+#define algo_names rl_algo_names
+#include "modules/ratelimit/ratelimit.c"
+#undef algo_names
+
+#include "bench_core.h"
+
+/* pipelimit functions of pl_ht.c, its header clashing with ratelimit.c */
+typedef struct _pl_pipe pl_pipe_t;
+int pl_init_htable(unsigned int hsize);
+int pl_pipe_add(str *pipeid, str *algorithm, int limit);
+pl_pipe_t *pl_pipe_get(str *pipeid, int mode);
+void pl_pipe_release(str *pipeid);
+int pl_pipe_gcra_check(pl_pipe_t *it, int interval, int burst);
+
+/* core and pipelimit symbols used by ratelimit.c and pl_ht.c, not called
+ * by the test, no pipelimit node being in a cluster */
+char ut_buf_int2str[INT2STR_MAX_LEN];
+int pl_enable_dmq = 0;
+int pl_clean_unused = 0;
+int _pl_cfg_setpoint = 0;
+double *_pl_pid_setpoint = NULL;
+
+int rpc_register_array(rpc_export_t *rpc_array)
+{
+	return 0;
+}
+
+int sr_kemi_modules_add(sr_kemi_t *klist)
+{
+	return 0;
+}
+
+int parse_headers(
+		struct sip_msg *const msg, const hdr_flags_t flags, const int next)
+{
+	return -1;
+}
+
+int get_int_fparam(int *dst, struct sip_msg *msg, fparam_t *param)
+{
+	return -1;
+}
+
+int fixup_igp_null(void **param, int param_no)
+{
+	return -1;
+}
+
+int fixup_free_igp_null(void **param, int param_no)
+{
+	return -1;
+}
+
+int fixup_free_pvar_null(void **param, int param_no)
+{
+	return -1;
+}
+
+int pl_dmq_batch_init(void)
+{
+	return 0;
+}
+
+int pl_dmq_batch_add(str *pipeid, int counter)
+{
+	return 0;
+}
+
+int pl_dmq_batch_flush(int force)
+{
+	return 0;
+}
+
+void pl_dmq_nodes_expire(void)
+{
+}
+
+void timer_free(struct timer_ln *t)
+{
+}
+
+struct timer_ln *timer_alloc(void)
+{
+	return (struct timer_ln *)shm_mallocxz(sizeof(struct timer_ln));
+}
+
+int timer_add_safe(struct timer_ln *tl, ticks_t delta)
+{
+	return 0;
+}
+
+int get_total_bytes_waiting(void)
+{
+	return 0;
+}
+
+enum
+{
+	BENCH_TAILDROP = 0,
+	BENCH_GCRA,
+	BENCH_PL_GCRA
+};
+
+/* shared state of the processes */
+typedef struct bench_shared
+{
+	volatile int start;
+	volatile int stop;
+	struct
+	{
+		unsigned long long checks;
+		unsigned long long accepted;
+	} counts[];
+} bench_shared_t;
+
+static int bench_mode;
+static int bench_interval;
+static long bench_rate;
+static str bench_pipe = str_init("bench");
+
+static int bench_check(sip_msg_t *msg)
+{
+	pl_pipe_t *pipe;
+	int ret;
+
+	if(bench_mode != BENCH_PL_GCRA) {
+		return rl_check(msg, 0);
+	}
+	pipe = pl_pipe_get(&bench_pipe, 1);
+	if(pipe == NULL) {
+		return -2;
+	}
+	ret = pl_pipe_gcra_check(pipe, bench_interval, 0);
+	pl_pipe_release(&bench_pipe);
+	return ret;
+}
+
+static void bench_worker_run(bench_shared_t *sh, int idx, int nworkers)
+{
+	unsigned long long checks;
+	unsigned long long accepted;
+	sip_msg_t msg;
+	double period;
+	double next;
+
+	memset(&msg, 0, sizeof(sip_msg_t));
+	msg.first_line.type = SIP_REQUEST;
+	msg.first_line.u.request.method.s = "INVITE";
+	msg.first_line.u.request.method.len = 6;
+	period = (bench_rate > 0) ? (double)nworkers / bench_rate : 0;
+	checks = accepted = 0;
+	while(sh->start == 0)
+		usleep(1000);
+	next = bench_now();
+	while(sh->stop == 0) {
+		if(period > 0) {
+			next += period;
+			while(bench_now() < next) {
+				usleep(50);
+			}
+		}
+		if(bench_check(&msg) == 1) {
+			accepted++;
+		}
+		checks++;
+	}
+	sh->counts[idx].checks = checks;
+	sh->counts[idx].accepted = accepted;
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long long checks = 0;
+	unsigned long long accepted = 0;
+	str algo = str_init("GCRA");
+	bench_shared_t *sh;
+	double t0, t1, tr;
+	double limit_sec;
+	int duration;
+	int nworkers;
+	int limit;
+	pid_t pid;
+	int i;
+
+	if(argc != 7) {
+		fprintf(stderr,
+				"Usage: %s <seconds> <processes> <taildrop|gcra|pl-gcra> "
+				"<limit> <interval> <rate>\n",
+				argv[0]);
+		return 1;
+	}
+	duration = atoi(argv[1]);
+	nworkers = atoi(argv[2]);
+	if(strcmp(argv[3], "taildrop") == 0) {
+		bench_mode = BENCH_TAILDROP;
+	} else if(strcmp(argv[3], "gcra") == 0) {
+		bench_mode = BENCH_GCRA;
+	} else {
+		bench_mode = BENCH_PL_GCRA;
+	}
+	limit = atoi(argv[4]);
+	bench_interval = atoi(argv[5]);
+	bench_rate = atol(argv[6]);
+	if(duration <= 0 || nworkers <= 0 || limit <= 0 || bench_interval <= 0
+			|| bench_rate < 0) {
+		fprintf(stderr, "Error: invalid parameters\n");
+		return 1;
+	}
+
+	if(bench_core_init_shared(8 << 20) < 0) {
+		fprintf(stderr, "Error: failed to map the shared memory\n");
+		return 1;
+	}
+	sh = (bench_shared_t *)shm_mallocxz(
+			sizeof(bench_shared_t) + nworkers * sizeof(sh->counts[0]));
+	if(sh == NULL) {
+		return 1;
+	}
+	/* pipe 0 of ratelimit, as set by the pipe modparam */
+	timer_interval = bench_interval;
+	pipes[0].algo_mp =
+			(bench_mode == BENCH_TAILDROP) ? PIPE_ALGO_TAILDROP : PIPE_ALGO_GCRA;
+	pipes[0].limit_mp = limit;
+	load_source_mp = LOAD_SOURCE_EXTERNAL;
+	if(mod_init() < 0 || pl_init_htable(16) < 0
+			|| pl_pipe_add(&bench_pipe, &algo, limit) < 0) {
+		fprintf(stderr, "Error: failed to init the pipes\n");
+		return 1;
+	}
+
+	for(i = 0; i < nworkers; i++) {
+		pid = fork();
+		if(pid < 0) {
+			fprintf(stderr, "Error: failed to fork\n");
+			return 1;
+		}
+		if(pid == 0) {
+			process_no = i + 1;
+			bench_worker_run(sh, i, nworkers);
+			_exit(0);
+		}
+	}
+	t0 = tr = bench_now();
+	sh->start = 1;
+	do {
+		usleep(10000);
+		t1 = bench_now();
+		if(t1 - tr >= bench_interval) {
+			/* ratelimit timer */
+			rl_timer_handle(0, NULL, NULL);
+			tr += bench_interval;
+		}
+	} while(t1 - t0 < duration);
+	sh->stop = 1;
+	for(i = 0; i < nworkers; i++) {
+		wait(NULL);
+	}
+	t1 = bench_now();
+	for(i = 0; i < nworkers; i++) {
+		checks += sh->counts[i].checks;
+		accepted += sh->counts[i].accepted;
+	}
+
+	limit_sec = (bench_mode == BENCH_PL_GCRA) ? (double)limit / bench_interval
+											  : limit;
+	printf("processes: %d algo: %s limit: %d per %s interval: %ds\n",
+			nworkers, argv[3], limit,
+			(bench_mode == BENCH_PL_GCRA) ? "interval" : "second",
+			bench_interval);
+	printf("checks/sec:   %.0f\n", (double)checks / (t1 - t0));
+	printf("accepted/sec: %.1f (limit %.1f)\n", (double)accepted / (t1 - t0),
+			limit_sec);
+	if(accepted > limit_sec * (t1 - t0 + bench_interval) + limit) {
+		fprintf(stderr, "Error: more requests accepted than the limit\n");
+		return 1;
+	}
+	if(bench_mode != BENCH_TAILDROP
+			&& (bench_rate == 0 || bench_rate > limit_sec * 1.1)
+			&& accepted < 0.9 * limit_sec * (t1 - t0)) {
+		fprintf(stderr, "Error: less requests accepted than the limit\n");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,6 @@
+/* this file is autogenerated by CMake */
+/* DO NOT EDIT IT */
+
+#define REPO_VER "dd4e67-dirty"
+#define REPO_HASH "dd4e67"
+#define REPO_STATE "dirty"
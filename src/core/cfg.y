@@ -371,6 +371,9 @@ extern char *default_routename;
 %token DNS_CACHE_GC_INT
 %token DNS_CACHE_DEL_NONEXP
 %token DNS_CACHE_REC_PREF
+%token DNS_CACHE_STALE_TTL
+%token DNS_CACHE_ASYNC_WAIT
+%token DNS_CACHE_PREFETCH_HITS
 
 /* ipv6 auto bind */
 %token AUTO_BIND_IPV6
@@ -1014,6 +1017,12 @@ assign_stm:
 	| DNS_CACHE_DEL_NONEXP error { yyerror("boolean value expected"); }
 	| DNS_CACHE_REC_PREF EQUAL NUMBER   { IF_DNS_CACHE(default_core_cfg.dns_cache_rec_pref=$3); }
 	| DNS_CACHE_REC_PREF error { yyerror("boolean value expected"); }
+	| DNS_CACHE_STALE_TTL EQUAL NUMBER   { IF_DNS_CACHE(default_core_cfg.dns_cache_stale_ttl=$3); }
+	| DNS_CACHE_STALE_TTL error { yyerror("number expected"); }
+	| DNS_CACHE_ASYNC_WAIT EQUAL NUMBER   { IF_DNS_CACHE(default_core_cfg.dns_cache_async_wait=$3); }
+	| DNS_CACHE_ASYNC_WAIT error { yyerror("number expected"); }
+	| DNS_CACHE_PREFETCH_HITS EQUAL NUMBER   { IF_DNS_CACHE(default_core_cfg.dns_cache_prefetch_hits=$3); }
+	| DNS_CACHE_PREFETCH_HITS error { yyerror("number expected"); }
 	| AUTO_BIND_IPV6 EQUAL NUMBER {IF_AUTO_BIND_IPV6(auto_bind_ipv6 = $3);}
 	| AUTO_BIND_IPV6 error { yyerror("boolean value expected"); }
 	| IPV6_HEX_STYLE EQUAL STRING {
@@ -98,6 +98,9 @@ struct cfg_group_core default_core_cfg = {
 		DEFAULT_DNS_MAX_MEM,	   /*!< dns_cache_max_mem */
 		0, /*!< dns_cache_del_nonexp -- delete only expired entries by default */
 		0, /*!< dns_cache_rec_pref -- 0 by default, do not check the existing entries. */
+		0, /*!< dns_cache_stale_ttl -- do not serve expired entries */
+		0, /*!< dns_cache_async_wait -- resolve in the process missing the cache */
+		0, /*!< dns_cache_prefetch_hits -- no prefetch */
 #endif
 #ifdef PKG_MALLOC
 		0, /*!< mem_dump_pkg */
@@ -278,6 +281,18 @@ cfg_def_t core_cfg_def[] = {
 				" 1 - prefer old records"
 				" 2 - prefer new records"
 				" 3 - prefer records with longer lifetime"},
+		{"dns_cache_stale_ttl", CFG_VAR_INT, 0, 0, 0, 0,
+				"time in seconds an expired record is still served while "
+				"it is refreshed in background. Use 0 to disable"},
+		{"dns_cache_async_wait", CFG_VAR_INT, 0, 0, 0, 0,
+				"time in milliseconds to wait for a cache miss resolved by "
+				"async workers, the lookup fails if there is no result in "
+				"time and the workers add it to the cache later. "
+				"Use 0 to resolve in the process itself"},
+		{"dns_cache_prefetch_hits", CFG_VAR_INT, 0, 0, 0, 0,
+				"number of lookups between two dns cache timer runs for "
+				"a record to be resolved again in background before it "
+				"expires. Use 0 to disable"},
 #endif
 #ifdef PKG_MALLOC
 		{"mem_dump_pkg", CFG_VAR_INT, 0, 0, 0, mem_dump_pkg_cb,
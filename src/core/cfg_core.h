@@ -89,6 +89,9 @@ struct cfg_group_core
 	unsigned int dns_cache_max_mem;
 	int dns_cache_del_nonexp;
 	int dns_cache_rec_pref;
+	unsigned int dns_cache_stale_ttl;
+	int dns_cache_async_wait;
+	unsigned int dns_cache_prefetch_hits;
 #endif
 #ifdef PKG_MALLOC
 	int mem_dump_pkg;
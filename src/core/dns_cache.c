@@ -51,6 +51,14 @@
 #include "error.h"
 #include "rpc.h"
 #include "rand/fastrand.h"
+#include "async_task.h"
+#include <sys/time.h>
+#ifdef __OS_linux
+#include <limits.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 #ifdef USE_DNS_CACHE_STATS
 #include "pt.h"
 #endif
@@ -75,8 +83,6 @@
 #define DNS_CACHE_RMDELAY 300
 
 int dns_cache_init = 1; /* if 0, the DNS cache is not initialized at startup */
-static gen_lock_t *dns_hash_lock = 0;
-static volatile unsigned int *dns_cache_mem_used = 0; /* current mem. use */
 unsigned int dns_timer_interval = DEFAULT_DNS_TIMER_INTERVAL; /* in s */
 int dns_flags = 0; /* default flags used for the  dns_*resolvehost
                     (compatibility wrappers) */
@@ -85,8 +91,33 @@ int dns_flags = 0; /* default flags used for the  dns_*resolvehost
 struct t_dns_cache_stats *dns_cache_stats = 0;
 #endif
 
-#define LOCK_DNS_HASH() lock_get(dns_hash_lock)
-#define UNLOCK_DNS_HASH() lock_release(dns_hash_lock)
+/* the hash table is split in partitions, each with its own lock, last used
+ * list and memory use counter, the bucket h belonging to the partition
+ * h & (DNS_HASH_PARTS - 1), so that processes looking up different names
+ * do not contend for the same lock; dns_cache_max_mem is the limit for
+ * the sum of the memory used by all partitions */
+#define DNS_HASH_PARTS 16 /* must be a power of 2, <= DNS_HASH_SIZE */
+
+/* steps of last used time in which the entries of the partitions are freed
+ * when the cache is full, see _dns_cache_free_lru() */
+#define DNS_LRU_BANDS 8
+
+#define dns_hash_part_no(h) ((h) & (DNS_HASH_PARTS - 1))
+#define dns_entry_part_no(e) \
+	dns_hash_part_no(dns_hash_no((e)->name, (e)->name_len, (e)->type))
+
+#define LOCK_DNS_PART(p) lock_get(&dns_hash_parts[(p)].lock)
+#define UNLOCK_DNS_PART(p) lock_release(&dns_hash_parts[(p)].lock)
+
+#ifdef USE_DNS_CACHE_STATS
+#define DNS_STATS_ADD(field, v)                         \
+	do {                                                \
+		if(dns_cache_stats)                             \
+			dns_cache_stats[process_no].field += (v);   \
+	} while(0)
+#else
+#define DNS_STATS_ADD(field, v)
+#endif
 
 static int _dns_local_ttl = 0;
 
@@ -102,6 +133,12 @@ static int _dns_local_ttl = 0;
 															dns_cache_max_ttl) \
 													: (t))))
 
+/* ticks an expired entry can still be served while it is refreshed */
+#define DNS_STALE_GRACE(e)                                                  \
+	((((e)->ent_flags & (DNS_FLAG_BAD_NAME | DNS_FLAG_PERMANENT)) == 0)    \
+					? S_TO_TICKS(cfg_get(core, core_cfg, dns_cache_stale_ttl)) \
+					: 0)
+
 
 struct dns_hash_head
 {
@@ -109,7 +146,14 @@ struct dns_hash_head
 	struct dns_hash_entry *prev;
 };
 
-struct dns_lu_lst *dns_last_used_lst = 0;
+struct dns_hash_part
+{
+	gen_lock_t lock;
+	struct dns_lu_lst lu_lst; /* last used entries list */
+	unsigned int mem_used;	  /* memory used by the entries */
+};
+
+static struct dns_hash_part *dns_hash_parts = 0;
 
 static struct dns_hash_head *dns_hash = 0;
 
@@ -120,6 +164,39 @@ static struct timer_ln *dns_timer_h = 0;
 static atomic_t *dns_servers_up = NULL;
 #endif
 
+/* cache misses handed to async workers, indexed by name hash, so that
+ * only one query is done for a name no matter how many processes wait */
+#define DNS_ASYNC_PENDING_SIZE 256
+
+typedef struct dns_async_pending
+{
+	volatile unsigned int gen; /* incremented when the query is done */
+	int busy;
+	unsigned short type;
+	unsigned short name_len;
+	char name[MAX_DNS_NAME];
+} dns_async_pending_t;
+
+/* param of the task executed by async workers */
+typedef struct dns_async_param
+{
+	int type;
+	int pidx; /* pending slot index or DNS_ASYNC_REFRESH/PREFETCH/FILL */
+	int name_len;
+	char name[MAX_DNS_NAME];
+} dns_async_param_t;
+
+#define DNS_ASYNC_REFRESH (-1)	 /* refresh of an expired entry */
+#define DNS_ASYNC_PREFETCH (-2) /* refresh of a hot entry before expiring */
+#define DNS_ASYNC_FILL (-3)	 /* cache miss nobody waits for */
+
+/* maximum number of entries prefetched on a dns timer run */
+#define DNS_PREFETCH_MAX 64
+
+static gen_lock_t *dns_async_lock = 0;
+static dns_async_pending_t *dns_async_pending = 0;
+static int _dns_async_ctx = 0; /* resolving inside an async worker task */
+
 
 /* clang-format off */
 static const char *dns_str_errors[] = {
@@ -206,6 +283,20 @@ void dns_hash_put_entry_shm_unsafe(
 
 inline static int dns_cache_clean(unsigned int no, int expired_only);
 inline static int dns_cache_free_mem(unsigned int target, int expired_only);
+static void dns_cache_prefetch(void);
+
+
+/* memory used by the whole cache */
+static unsigned int dns_cache_mem_used(void)
+{
+	unsigned int m;
+	int p;
+
+	for(m = 0, p = 0; p < DNS_HASH_PARTS; p++)
+		m += dns_hash_parts[p].mem_used;
+	return m;
+}
+
 
 static ticks_t dns_timer(ticks_t ticks, struct timer_ln *tl, void *data)
 {
@@ -214,7 +305,7 @@ static ticks_t dns_timer(ticks_t ticks, struct timer_ln *tl, void *data)
 	if(atomic_get(dns_servers_up) == 0)
 		return (ticks_t)(-1);
 #endif
-	if(*dns_cache_mem_used
+	if(dns_cache_mem_used()
 			> 12
 					  * (cfg_get(core, core_cfg, dns_cache_max_mem)
 							  / 16)) { /* ~ 75% used */
@@ -223,12 +314,16 @@ static ticks_t dns_timer(ticks_t ticks, struct timer_ln *tl, void *data)
 		dns_cache_clean(-1, 1); /* all the table, only expired entries */
 								/* TODO: better strategy? */
 	}
+	if(cfg_get(core, core_cfg, dns_cache_prefetch_hits) > 0)
+		dns_cache_prefetch();
 	return (ticks_t)(-1);
 }
 
 
 void destroy_dns_cache()
 {
+	int r;
+
 	if(dns_timer_h) {
 		timer_del(dns_timer_h);
 		timer_free(dns_timer_h);
@@ -240,27 +335,29 @@ void destroy_dns_cache()
 		dns_servers_up = 0;
 	}
 #endif
-	if(dns_hash_lock) {
-		lock_destroy(dns_hash_lock);
-		lock_dealloc(dns_hash_lock);
-		dns_hash_lock = 0;
+	if(dns_hash_parts) {
+		for(r = 0; r < DNS_HASH_PARTS; r++)
+			lock_destroy(&dns_hash_parts[r].lock);
+		shm_free(dns_hash_parts);
+		dns_hash_parts = 0;
+	}
+	if(dns_async_lock) {
+		lock_destroy(dns_async_lock);
+		lock_dealloc(dns_async_lock);
+		dns_async_lock = 0;
+	}
+	if(dns_async_pending) {
+		shm_free(dns_async_pending);
+		dns_async_pending = 0;
 	}
 	if(dns_hash) {
 		shm_free(dns_hash);
 		dns_hash = 0;
 	}
-	if(dns_last_used_lst) {
-		shm_free(dns_last_used_lst);
-		dns_last_used_lst = 0;
-	}
 #ifdef USE_DNS_CACHE_STATS
 	if(dns_cache_stats)
 		shm_free(dns_cache_stats);
 #endif
-	if(dns_cache_mem_used) {
-		shm_free((void *)dns_cache_mem_used);
-		dns_cache_mem_used = 0;
-	}
 }
 
 /* set the value of dns_flags */
@@ -356,21 +453,25 @@ int init_dns_cache()
 		ret = E_BUG;
 		goto error;
 	}
-	dns_cache_mem_used = shm_malloc(sizeof(*dns_cache_mem_used));
-	if(dns_cache_mem_used == 0) {
+	dns_hash_parts = shm_malloc(sizeof(struct dns_hash_part) * DNS_HASH_PARTS);
+	if(dns_hash_parts == 0) {
 		SHM_MEM_ERROR;
 		ret = E_OUT_OF_MEM;
 		goto error;
 	}
-	*dns_cache_mem_used = 0;
-
-	dns_last_used_lst = shm_malloc(sizeof(*dns_last_used_lst));
-	if(dns_last_used_lst == 0) {
-		SHM_MEM_ERROR;
-		ret = E_OUT_OF_MEM;
-		goto error;
+	memset(dns_hash_parts, 0, sizeof(struct dns_hash_part) * DNS_HASH_PARTS);
+	for(r = 0; r < DNS_HASH_PARTS; r++) {
+		clist_init(&dns_hash_parts[r].lu_lst, next, prev);
+		if(lock_init(&dns_hash_parts[r].lock) == 0) {
+			LM_CRIT("failed to init dns hash lock\n");
+			for(r--; r >= 0; r--)
+				lock_destroy(&dns_hash_parts[r].lock);
+			shm_free(dns_hash_parts);
+			dns_hash_parts = 0;
+			ret = -1;
+			goto error;
+		}
 	}
-	clist_init(dns_last_used_lst, next, prev);
 
 	dns_hash = shm_malloc(sizeof(struct dns_hash_head) * DNS_HASH_SIZE);
 	if(dns_hash == 0) {
@@ -381,14 +482,23 @@ int init_dns_cache()
 	for(r = 0; r < DNS_HASH_SIZE; r++)
 		clist_init(&dns_hash[r], next, prev);
 
-	dns_hash_lock = lock_alloc();
-	if(dns_hash_lock == 0) {
+	dns_async_pending =
+			shm_malloc(sizeof(dns_async_pending_t) * DNS_ASYNC_PENDING_SIZE);
+	if(dns_async_pending == 0) {
+		SHM_MEM_ERROR;
 		ret = E_OUT_OF_MEM;
 		goto error;
 	}
-	if(lock_init(dns_hash_lock) == 0) {
-		lock_dealloc(dns_hash_lock);
-		dns_hash_lock = 0;
+	memset(dns_async_pending, 0,
+			sizeof(dns_async_pending_t) * DNS_ASYNC_PENDING_SIZE);
+	dns_async_lock = lock_alloc();
+	if(dns_async_lock == 0) {
+		ret = E_OUT_OF_MEM;
+		goto error;
+	}
+	if(lock_init(dns_async_lock) == 0) {
+		lock_dealloc(dns_async_lock);
+		dns_async_lock = 0;
 		ret = -1;
 		goto error;
 	}
@@ -463,8 +573,11 @@ int init_dns_cache_stats(int iproc_num)
 
 
 #include <stdlib.h> /* abort() */
+#define is_lu_lst_head(l)                       \
+	(((char *)(l) >= (char *)dns_hash_parts) \
+			&& ((char *)(l) < (char *)(dns_hash_parts + DNS_HASH_PARTS)))
 #define check_lu_lst(l) \
-	((((l)->next == (l)) || ((l)->prev == (l))) && ((l) != dns_last_used_lst))
+	((((l)->next == (l)) || ((l)->prev == (l))) && !is_lu_lst_head(l))
 
 #define dbg_lu_lst(txt, l)                                   \
 	LM_CRIT("%s: crt(%p, %p, %p),"                           \
@@ -492,7 +605,7 @@ int init_dns_cache_stats(int iproc_num)
 	} while(0)
 
 
-/* must be called with the DNS_LOCK hold
+/* must be called with the lock of the entry partition held
  * removes an entry from the hash, dec. its refcnt and if not referenced
  * anymore deletes it */
 inline static void _dns_hash_remove_entry(
@@ -504,7 +617,7 @@ inline static void _dns_hash_remove_entry(
 	clist_rm(&e->last_used_lst, next, prev);
 	debug_lu_lst("dns hash remove: post rm:", &e->last_used_lst);
 	e->last_used_lst.next = e->last_used_lst.prev = 0;
-	*dns_cache_mem_used -= e->total_size;
+	dns_hash_parts[dns_entry_part_no(e)].mem_used -= e->total_size;
 	if(atomic_get_int(&e->refcnt) > 1) {
 		LM_DBG("item %p with high refcnt %d (%s:%u)\n", e,
 				atomic_get_int(&e->refcnt), fpath, line);
@@ -515,9 +628,11 @@ inline static void _dns_hash_remove_entry(
 
 #define _dns_hash_remove(e) _dns_hash_remove_entry(e, __FILE__, __LINE__)
 
-/* non locking  version (the dns hash must _be_ locked externally)
+/* non locking  version (the partition of name must _be_ locked externally)
  * returns 0 when not found, or the entry on success (an entry with a
  * similar name but with a CNAME type will always match).
+ * a CNAME chain is followed only inside the partition of name, the last
+ * CNAME being returned when the chain continues in another partition
  * it doesn't increase the internal refcnt
  * returns the entry when found, 0 when not found and sets *err to !=0
  *  on error (e.g. recursive cnames)
@@ -532,6 +647,7 @@ inline static struct dns_hash_entry *_dns_hash_find(
 	ticks_t now;
 	int cname_chain;
 	str cname;
+	int part;
 #ifdef DNS_WATCHDOG_SUPPORT
 	int servers_up;
 
@@ -539,6 +655,7 @@ inline static struct dns_hash_entry *_dns_hash_find(
 #endif
 
 	cname_chain = 0;
+	part = -1;
 	ret = 0;
 	now = get_ticks_raw();
 	*err = 0;
@@ -551,6 +668,12 @@ inline static struct dns_hash_entry *_dns_hash_find(
 	}
 again:
 	*h = dns_hash_no(name->s, name->len, type);
+	if(part < 0) {
+		part = dns_hash_part_no(*h);
+	} else if(dns_hash_part_no(*h) != part) {
+		/* the chain continues in another partition */
+		return ret;
+	}
 	LM_DBG("(%.*s(%d), %d), h=%d\n", name->len, name->s, name->len, type, *h);
 	clist_foreach_safe(&dns_hash[*h], e, tmp, next)
 	{
@@ -559,9 +682,10 @@ again:
 				/* remove expired elements only when the dns servers are up */
 				servers_up &&
 #endif
-				/* automatically remove expired elements */
+				/* automatically remove expired elements, keeping them
+				 * for the stale grace period */
 				((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
-				&& ((s_ticks_t)(now - e->expire) >= 0)) {
+				&& ((s_ticks_t)(now - e->expire - DNS_STALE_GRACE(e)) >= 0)) {
 			if(atomic_get(&e->refcnt) > 1) {
 				if((s_ticks_t)(now - e->expire - S_TO_TICKS(DNS_CACHE_RMDELAY))
 						>= 0) {
@@ -579,10 +703,12 @@ again:
 		} else if((e->type == type) && (e->name_len == name->len)
 				  && (strncasecmp(e->name, name->s, e->name_len) == 0)) {
 			e->last_used = now;
+			e->hits++;
 			/* add it at the end */
 			debug_lu_lst("_dns_hash_find: pre rm:", &e->last_used_lst);
 			clist_rm(&e->last_used_lst, next, prev);
-			clist_append(dns_last_used_lst, &e->last_used_lst, next, prev);
+			clist_append(&dns_hash_parts[part].lu_lst, &e->last_used_lst, next,
+					prev);
 			debug_lu_lst("_dns_hash_find: post append:", &e->last_used_lst);
 			return e;
 		} else if((e->type == T_CNAME)
@@ -595,7 +721,8 @@ again:
 			/* add it at the end */
 			debug_lu_lst("_dns_hash_find: cname: pre rm:", &e->last_used_lst);
 			clist_rm(&e->last_used_lst, next, prev);
-			clist_append(dns_last_used_lst, &e->last_used_lst, next, prev);
+			clist_append(&dns_hash_parts[part].lu_lst, &e->last_used_lst, next,
+					prev);
 			debug_lu_lst(
 					"_dns_hash_find: cname: post append:", &e->last_used_lst);
 			ret = e; /* if this is an unfinished cname chain, we try to
@@ -634,50 +761,61 @@ inline static int dns_cache_clean(unsigned int no, int expired_only)
 	unsigned int deleted;
 	struct dns_lu_lst *l;
 	struct dns_lu_lst *tmp;
+	int p;
 
 	n = 0;
 	deleted = 0;
 	now = get_ticks_raw();
-	LOCK_DNS_HASH();
-	clist_foreach_safe(dns_last_used_lst, l, tmp, next)
-	{
-		e = (struct dns_hash_entry *)(((char *)l)
-									  - (char *)&((struct dns_hash_entry *)(0))
-												->last_used_lst);
-		if(((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
-				&& (!expired_only || ((s_ticks_t)(now - e->expire) >= 0))) {
-			if(atomic_get(&e->refcnt) > 1) {
-				if((s_ticks_t)(now - e->expire - S_TO_TICKS(DNS_CACHE_RMDELAY))
-						>= 0) {
-					LM_DBG("delayed removal: %p (%d)\n", e,
-							(int)atomic_get(&e->refcnt));
+	for(p = 0; p < DNS_HASH_PARTS; p++) {
+		LOCK_DNS_PART(p);
+		clist_foreach_safe(&dns_hash_parts[p].lu_lst, l, tmp, next)
+		{
+			e = (struct dns_hash_entry *)(((char *)l)
+										  - (char *)&(
+												  (struct dns_hash_entry *)(0))
+													->last_used_lst);
+			if(((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
+					&& (!expired_only
+							|| ((s_ticks_t)(now - e->expire
+											- DNS_STALE_GRACE(e))
+									>= 0))) {
+				if(atomic_get(&e->refcnt) > 1) {
+					if((s_ticks_t)(now - e->expire
+								   - S_TO_TICKS(DNS_CACHE_RMDELAY))
+							>= 0) {
+						LM_DBG("delayed removal: %p (%d)\n", e,
+								(int)atomic_get(&e->refcnt));
+						_dns_hash_remove(e);
+						deleted++;
+					} else {
+						LM_DBG("delaying removal: %p (%d)\n", e,
+								(int)atomic_get(&e->refcnt));
+					}
+				} else {
+					LM_DBG("immediate removal: %p\n", e);
 					_dns_hash_remove(e);
 					deleted++;
-				} else {
-					LM_DBG("delaying removal: %p (%d)\n", e,
-							(int)atomic_get(&e->refcnt));
 				}
-			} else {
-				LM_DBG("immediate removal: %p\n", e);
-				_dns_hash_remove(e);
-				deleted++;
 			}
+			n++;
+			if(n >= no)
+				break;
 		}
-		n++;
+		UNLOCK_DNS_PART(p);
 		if(n >= no)
 			break;
 	}
-	UNLOCK_DNS_HASH();
 	return deleted;
 }
 
 
-/* frees cache entries, if expired_only=0 only expired entries will be
- * removed, else all of them
- * it will stop when the dns cache used memory reaches target (to process all
- * of them use 0)
+/* frees cache entries of partition p last used before cutoff, if
+ * expired_only=0 only expired entries will be removed, else all of them
+ * it will stop when the used memory of the whole cache reaches target
+ * the partition lock must be held
  * returns the number of deleted entries */
-inline static int dns_cache_free_mem(unsigned int target, int expired_only)
+static int _dns_cache_free_part(
+		int p, unsigned int target, ticks_t cutoff, int expired_only)
 {
 	struct dns_hash_entry *e;
 	ticks_t now;
@@ -687,14 +825,16 @@ inline static int dns_cache_free_mem(unsigned int target, int expired_only)
 
 	deleted = 0;
 	now = get_ticks_raw();
-	LOCK_DNS_HASH();
-	clist_foreach_safe(dns_last_used_lst, l, tmp, next)
+	clist_foreach_safe(&dns_hash_parts[p].lu_lst, l, tmp, next)
 	{
-		if(*dns_cache_mem_used <= target)
+		if(dns_cache_mem_used() <= target)
 			break;
 		e = (struct dns_hash_entry *)(((char *)l)
 									  - (char *)&((struct dns_hash_entry *)(0))
 												->last_used_lst);
+		/* the list is in last used order */
+		if((s_ticks_t)(e->last_used - cutoff) > 0)
+			break;
 		if(((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
 				&& (!expired_only || ((s_ticks_t)(now - e->expire) >= 0))) {
 			if(atomic_get(&e->refcnt) > 1) {
@@ -715,11 +855,95 @@ inline static int dns_cache_free_mem(unsigned int target, int expired_only)
 			}
 		}
 	}
-	UNLOCK_DNS_HASH();
 	return deleted;
 }
 
 
+/* locks partition q for freeing entries from it, with the lock of
+ * partition p held (only tried, to avoid lock order problems) or with no
+ * lock held if p is -1
+ * returns 0 on success, -1 if q is locked by someone else */
+static int _dns_cache_lock_other(int q, int p)
+{
+	if(q == p)
+		return 0;
+	if(p < 0) {
+		LOCK_DNS_PART(q);
+		return 0;
+	}
+	return (lock_try(&dns_hash_parts[q].lock) == 0) ? 0 : -1;
+}
+
+
+/* frees cache entries of all the partitions, the least recently used
+ * first, until the used memory of the whole cache reaches target: the
+ * entries used before a cutoff going from the oldest use to now in
+ * DNS_LRU_BANDS steps are freed from each partition in turn, which keeps
+ * the global lru order within the length of a step
+ * p - partition whose lock is held or -1 (see _dns_cache_lock_other())
+ * returns the number of deleted entries */
+static int _dns_cache_free_lru(int p, unsigned int target, int expired_only)
+{
+	struct dns_hash_entry *e;
+	struct dns_lu_lst *l;
+	ticks_t now;
+	ticks_t oldest;
+	ticks_t step;
+	unsigned int deleted;
+	int b;
+	int q;
+	int r;
+
+	now = get_ticks_raw();
+	oldest = now;
+	for(q = 0; q < DNS_HASH_PARTS; q++) {
+		if(_dns_cache_lock_other(q, p) < 0)
+			continue;
+		if(!clist_empty(&dns_hash_parts[q].lu_lst, next)) {
+			l = dns_hash_parts[q].lu_lst.next;
+			e = (struct dns_hash_entry *)(((char *)l)
+										  - (char *)&(
+												  (struct dns_hash_entry *)(0))
+													->last_used_lst);
+			if((s_ticks_t)(e->last_used - oldest) < 0)
+				oldest = e->last_used;
+		}
+		if(q != p)
+			UNLOCK_DNS_PART(q);
+	}
+
+	deleted = 0;
+	step = (now - oldest) / DNS_LRU_BANDS + 1;
+	for(b = 1; b <= DNS_LRU_BANDS; b++) {
+		/* start each band with another partition */
+		for(r = 0; r < DNS_HASH_PARTS; r++) {
+			if(dns_cache_mem_used() <= target)
+				return deleted;
+			q = (r + b) & (DNS_HASH_PARTS - 1);
+			if(dns_hash_parts[q].mem_used == 0
+					|| _dns_cache_lock_other(q, p) < 0)
+				continue;
+			deleted += _dns_cache_free_part(
+					q, target, oldest + b * step, expired_only);
+			if(q != p)
+				UNLOCK_DNS_PART(q);
+		}
+	}
+	return deleted;
+}
+
+
+/* frees cache entries, if expired_only=0 only expired entries will be
+ * removed, else all of them
+ * it will stop when the dns cache used memory reaches target (to process all
+ * of them use 0), freeing the least recently used entries first
+ * returns the number of deleted entries */
+inline static int dns_cache_free_mem(unsigned int target, int expired_only)
+{
+	return _dns_cache_free_lru(-1, target, expired_only);
+}
+
+
 /* locking  version (the dns hash must _not_be locked externally)
  * returns 0 when not found, the searched entry on success (with CNAMEs
  *  followed) or the last CNAME entry from an unfinished CNAME chain,
@@ -731,90 +955,118 @@ inline static struct dns_hash_entry *dns_hash_get(
 		str *name, int type, int *h, int *err)
 {
 	struct dns_hash_entry *e;
+	struct dns_hash_entry *c;
+	str cname;
+	int chain;
+	int p;
 
-	LOCK_DNS_HASH();
-	e = _dns_hash_find(name, type, h, err);
-	if(e) {
-		atomic_inc(&e->refcnt);
+	e = 0;
+	for(chain = 0; chain <= MAX_CNAME_CHAIN; chain++) {
+		p = dns_hash_part_no(dns_hash_no(name->s, name->len, type));
+		LOCK_DNS_PART(p);
+		c = _dns_hash_find(name, type, h, err);
+		if(c) {
+			atomic_inc(&c->refcnt);
+		}
+		UNLOCK_DNS_PART(p);
+		if(c == 0) {
+			if(*err && e) {
+				dns_hash_put(e);
+				e = 0;
+			}
+			/* not found or unfinished CNAME chain */
+			return e;
+		}
+		if(e)
+			dns_hash_put(e);
+		e = c;
+		if((e->type != T_CNAME) || (type == T_CNAME) || (e->rr_lst == 0)
+				|| (e->ent_flags & DNS_FLAG_BAD_NAME))
+			return e;
+		cname.s = ((struct cname_rdata *)e->rr_lst->rdata)->name;
+		cname.len = ((struct cname_rdata *)e->rr_lst->rdata)->name_len;
+		if((cname.s == NULL) || (cname.len <= 0)
+				|| (dns_hash_part_no(dns_hash_no(cname.s, cname.len, type))
+						== p))
+			/* chain already followed in the same partition */
+			return e;
+		/* continue the chain in the partition of the CNAME value,
+		 * e keeping it referenced */
+		name = &cname;
 	}
-	UNLOCK_DNS_HASH();
-	return e;
+	LM_ERR("cname chain too long or recursive\n");
+	dns_hash_put(e);
+	*err = -1;
+	return 0;
 }
 
 
-/* adds a fully created and init. entry (see dns_cache_mk_entry()) to the hash
- * table
+/* adds an entry to the hash table, with the lock of its partition p held
  * returns 0 on success, -1 on error */
-inline static int dns_cache_add(struct dns_hash_entry *e)
+static int _dns_cache_add_part(struct dns_hash_entry *e, int p, int h)
 {
-	int h;
+	unsigned int max_mem;
+	unsigned int target;
 
-	/* check space */
-	/* atomic_add_long(dns_cache_total_used, e->size); */
-	if((*dns_cache_mem_used + e->total_size)
-			>= cfg_get(core, core_cfg, dns_cache_max_mem)) {
+	/* check space - the partitions share the memory of the cache, each
+	 * one writing only its own counter */
+	max_mem = cfg_get(core, core_cfg, dns_cache_max_mem);
+	if((dns_cache_mem_used() + e->total_size) >= max_mem) {
 #ifdef USE_DNS_CACHE_STATS
 		dns_cache_stats[process_no].dc_lru_cnt++;
 #endif
 		LM_WARN("cache full, trying to free...\n");
-		/* free ~ 12% of the cache */
-		dns_cache_free_mem(*dns_cache_mem_used / 16 * 14,
-				!cfg_get(core, core_cfg, dns_cache_del_nonexp));
-		if((*dns_cache_mem_used + e->total_size)
-				>= cfg_get(core, core_cfg, dns_cache_max_mem)) {
+		/* free ~ 12% of the cache, the least recently used entries of
+		 * all the partitions first */
+		target = dns_cache_mem_used() / 16 * 14;
+		if(target + e->total_size >= max_mem)
+			target = (max_mem > e->total_size) ? max_mem - e->total_size - 1
+											   : 0;
+		_dns_cache_free_lru(
+				p, target, !cfg_get(core, core_cfg, dns_cache_del_nonexp));
+		if((dns_cache_mem_used() + e->total_size) >= max_mem) {
 			LM_ERR("max. cache mem size exceeded\n");
 			return -1;
 		}
 	}
 	atomic_inc(&e->refcnt);
-	h = dns_hash_no(e->name, e->name_len, e->type);
 	LM_DBG("adding %.*s(%d) %d (flags=%0x) at %d\n", e->name_len, e->name,
 			e->name_len, e->type, e->ent_flags, h);
-	LOCK_DNS_HASH();
-	*dns_cache_mem_used += e->total_size; /* no need for atomic ops, written
-										 only from within a lock */
+	dns_hash_parts[p].mem_used += e->total_size; /* no need for atomic ops,
+											written only from within a lock */
 	clist_append(&dns_hash[h], e, next, prev);
-	clist_append(dns_last_used_lst, &e->last_used_lst, next, prev);
-	UNLOCK_DNS_HASH();
+	clist_append(&dns_hash_parts[p].lu_lst, &e->last_used_lst, next, prev);
 	return 0;
 }
 
 
-/* same as above, but it must be called with the dns hash lock held
+/* adds a fully created and init. entry (see dns_cache_mk_entry()) to the hash
+ * table
  * returns 0 on success, -1 on error */
-inline static int dns_cache_add_unsafe(struct dns_hash_entry *e)
+inline static int dns_cache_add(struct dns_hash_entry *e)
 {
 	int h;
+	int p;
+	int ret;
 
-	/* check space */
-	/* atomic_add_long(dns_cache_total_used, e->size); */
-	if((*dns_cache_mem_used + e->total_size)
-			>= cfg_get(core, core_cfg, dns_cache_max_mem)) {
-#ifdef USE_DNS_CACHE_STATS
-		dns_cache_stats[process_no].dc_lru_cnt++;
-#endif
-		LM_WARN("cache full, trying to free...\n");
-		/* free ~ 12% of the cache */
-		UNLOCK_DNS_HASH();
-		dns_cache_free_mem(*dns_cache_mem_used / 16 * 14,
-				!cfg_get(core, core_cfg, dns_cache_del_nonexp));
-		LOCK_DNS_HASH();
-		if((*dns_cache_mem_used + e->total_size)
-				>= cfg_get(core, core_cfg, dns_cache_max_mem)) {
-			LM_ERR("max. cache mem size exceeded\n");
-			return -1;
-		}
-	}
-	atomic_inc(&e->refcnt);
 	h = dns_hash_no(e->name, e->name_len, e->type);
-	LM_DBG("adding %.*s(%d) %d (flags=%0x) at %d\n", e->name_len, e->name,
-			e->name_len, e->type, e->ent_flags, h);
-	*dns_cache_mem_used += e->total_size; /* no need for atomic ops, written
-										 only from within a lock */
-	clist_append(&dns_hash[h], e, next, prev);
-	clist_append(dns_last_used_lst, &e->last_used_lst, next, prev);
+	p = dns_hash_part_no(h);
+	LOCK_DNS_PART(p);
+	ret = _dns_cache_add_part(e, p, h);
+	UNLOCK_DNS_PART(p);
+	return ret;
+}
 
-	return 0;
+
+/* same as above, but it must be called with the lock of the entry partition
+ * held
+ * returns 0 on success, -1 on error */
+inline static int dns_cache_add_unsafe(struct dns_hash_entry *e)
+{
+	int h;
+
+	h = dns_hash_no(e->name, e->name_len, e->type);
+	return _dns_cache_add_part(e, dns_hash_part_no(h), h);
 }
 
 
@@ -1863,7 +2115,7 @@ inline static struct dns_hash_entry *dns_cache_do_request(str *name, int type)
 	char name_buf[MAX_DNS_NAME];
 	struct dns_hash_entry *old;
 	str rec_name;
-	int add_record, h, err;
+	int add_record, h, err, p;
 
 	e = 0;
 	l = 0;
@@ -1932,9 +2184,10 @@ inline static struct dns_hash_entry *dns_cache_do_request(str *name, int type)
 			/* add all the records to the hash */
 			l->prev->next = 0; /* we break the double linked list for easier
 								searching */
-			LOCK_DNS_HASH();   /* optimization */
 			for(r = l; r; r = t) {
 				t = r->next;
+				p = dns_entry_part_no(r);
+				LOCK_DNS_PART(p);
 				/* add the new record to the cache by default */
 				add_record = 1;
 				if(cfg_get(core, core_cfg, dns_cache_rec_pref) > 0) {
@@ -1952,6 +2205,12 @@ inline static struct dns_hash_entry *dns_cache_do_request(str *name, int type)
 							/* never overwrite permanent entries */
 							add_record = 0;
 
+						} else if((s_ticks_t)(get_ticks_raw() - old->expire)
+								  >= 0) {
+							/* expired entry served while refreshed,
+							 * dropped when the refresh is done */
+							old = NULL;
+
 						} else if((old->ent_flags & DNS_FLAG_BAD_NAME) == 0) {
 							/* Non-negative, non-permanent entry found with
 							 * the same type. */
@@ -1993,8 +2252,8 @@ inline static struct dns_hash_entry *dns_cache_do_request(str *name, int type)
 					}
 					dns_destroy_entry(r);
 				}
+				UNLOCK_DNS_PART(p);
 			}
-			UNLOCK_DNS_HASH();
 			/* if only cnames found => try to resolve the last one */
 			if(cname_val.s) {
 				LM_DBG("dns_get_entry(cname: %.*s (%d))\n", cname_val.len,
@@ -2021,9 +2280,10 @@ inline static struct dns_hash_entry *dns_cache_do_request(str *name, int type)
 		 * we are looking for */
 		l->prev->next = 0; /* we break the double linked list for easier
 							searching */
-		LOCK_DNS_HASH();   /* optimization */
 		for(r = l; r; r = t) {
 			t = r->next;
+			p = dns_entry_part_no(r);
+			LOCK_DNS_PART(p);
 			if(e == 0) { /* no entry found yet */
 				if(r->type == T_CNAME) {
 					if((r->name_len == name->len) && (r->rr_lst)
@@ -2061,6 +2321,11 @@ inline static struct dns_hash_entry *dns_cache_do_request(str *name, int type)
 						/* never overwrite permanent entries */
 						add_record = 0;
 
+					} else if((s_ticks_t)(get_ticks_raw() - old->expire) >= 0) {
+						/* expired entry served while refreshed,
+						 * dropped when the refresh is done */
+						old = NULL;
+
 					} else if((old->ent_flags & DNS_FLAG_BAD_NAME) == 0) {
 						/* Non-negative, non-permanent entry found with
 						 * the same type. */
@@ -2101,8 +2366,8 @@ inline static struct dns_hash_entry *dns_cache_do_request(str *name, int type)
 				}
 				dns_destroy_entry(r);
 			}
+			UNLOCK_DNS_PART(p);
 		}
-		UNLOCK_DNS_HASH();
 		if((e == 0) && (cname_val.s)) { /* not found, but found a cname */
 			/* only one cname is allowed (rfc2181), so we ignore the
 			 * others (we take only the first one) */
@@ -2118,6 +2383,349 @@ end:
 }
 
 
+/* milliseconds elapsed since tvb */
+static unsigned long dns_ms_since(struct timeval *tvb)
+{
+	struct timeval tve;
+
+	gettimeofday(&tve, NULL);
+	return (unsigned long)((tve.tv_sec - tvb->tv_sec) * 1000
+						   + (tve.tv_usec - tvb->tv_usec) / 1000);
+}
+
+
+/* called after re-resolving (name, type): on success the expired entries
+ * and the ones being refreshed are not served anymore, on failure they are
+ * served again until they expire or the stale grace period ends
+ * prefetch - set if the entries were refreshed before expiring */
+static void dns_cache_refresh_done(str *name, int type, int ok, int prefetch)
+{
+	struct dns_hash_entry *e;
+	ticks_t now;
+	int h;
+
+	now = get_ticks_raw();
+	h = dns_hash_no(name->s, name->len, type);
+	LOCK_DNS_PART(dns_hash_part_no(h));
+	clist_foreach(&dns_hash[h], e, next)
+	{
+		if(((e->type == type) || (e->type == T_CNAME))
+				&& ((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
+				&& (e->name_len == name->len)
+				&& (strncasecmp(e->name, name->s, e->name_len) == 0)) {
+			if((e->ent_flags & DNS_FLAG_REFRESH)
+					|| ((s_ticks_t)(now - e->expire) >= 0)) {
+				e->ent_flags &= ~DNS_FLAG_REFRESH;
+				if(ok)
+					e->expire = now - DNS_STALE_GRACE(e) - 1;
+			} else if(ok && prefetch) {
+				/* new entry */
+				e->ent_flags |= DNS_FLAG_PREFETCHED;
+			}
+		}
+	}
+	UNLOCK_DNS_PART(dns_hash_part_no(h));
+}
+
+
+/* marks the pending query in slot idx as done, waking up the waiters */
+static void dns_async_pending_release(int idx)
+{
+	lock_get(dns_async_lock);
+	dns_async_pending[idx].busy = 0;
+	dns_async_pending[idx].gen++;
+	lock_release(dns_async_lock);
+#ifdef __OS_linux
+	syscall(SYS_futex, &dns_async_pending[idx].gen, FUTEX_WAKE, INT_MAX, 0,
+			0, 0);
+#endif
+}
+
+
+/* waits at most ms milliseconds for the pending query in p to be done
+ * (p->gen to change from gen), without polling; there is no wait if the
+ * platform has no futex support, the async worker still fills the cache
+ * returns 1 if the query is done, 0 on timeout */
+static int dns_async_pending_wait(
+		dns_async_pending_t *p, unsigned int gen, int ms)
+{
+#ifdef __OS_linux
+	struct timespec ts;
+	struct timeval tvb;
+	unsigned long elapsed;
+
+	gettimeofday(&tvb, NULL);
+	while(p->gen == gen) {
+		elapsed = dns_ms_since(&tvb);
+		if(elapsed >= (unsigned long)ms)
+			break;
+		ts.tv_sec = (ms - elapsed) / 1000;
+		ts.tv_nsec = ((ms - elapsed) % 1000) * 1000000;
+		/* returns at once if p->gen is not gen anymore */
+		syscall(SYS_futex, &p->gen, FUTEX_WAIT, gen, &ts, 0, 0);
+	}
+#endif
+	return (p->gen != gen);
+}
+
+
+/* async worker task: resolves a name and adds the result to the cache */
+static void dns_cache_async_exec(void *param)
+{
+	dns_async_param_t *ap;
+	struct dns_hash_entry *e;
+	struct timeval tvb;
+	str name;
+	int ok;
+
+	ap = (dns_async_param_t *)param;
+	name.s = ap->name;
+	name.len = ap->name_len;
+
+	gettimeofday(&tvb, NULL);
+	_dns_async_ctx = 1;
+	e = dns_cache_do_request(&name, ap->type);
+	_dns_async_ctx = 0;
+	ok = (e != NULL) && (e->rr_lst != NULL)
+		 && ((e->ent_flags & DNS_FLAG_BAD_NAME) == 0);
+	if(e)
+		dns_hash_put(e);
+
+	if(ap->pidx == DNS_ASYNC_FILL) {
+		/* nobody waits for it */
+	} else if(ap->pidx < 0) {
+		dns_cache_refresh_done(
+				&name, ap->type, ok, (ap->pidx == DNS_ASYNC_PREFETCH));
+		DNS_STATS_ADD(dc_refresh_cnt, 1);
+		DNS_STATS_ADD(dc_refresh_ms, dns_ms_since(&tvb));
+		if(!ok && ap->pidx == DNS_ASYNC_PREFETCH)
+			DNS_STATS_ADD(dc_prefetch_misses, 1);
+	} else {
+		dns_async_pending_release(ap->pidx);
+	}
+}
+
+
+/* hands the resolving of (name, type) to the async workers
+ * pidx - pending slot index or DNS_ASYNC_REFRESH/PREFETCH/FILL
+ * returns 0 on success, -1 on error */
+static int dns_cache_async_push(str *name, int type, int pidx)
+{
+	async_task_t *at;
+	dns_async_param_t *ap;
+
+	if(name->len >= MAX_DNS_NAME)
+		return -1;
+	at = (async_task_t *)shm_malloc(
+			sizeof(async_task_t) + sizeof(dns_async_param_t));
+	if(at == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	ap = (dns_async_param_t *)(at + 1);
+	ap->type = type;
+	ap->pidx = pidx;
+	ap->name_len = name->len;
+	memcpy(ap->name, name->s, name->len);
+	ap->name[name->len] = 0;
+	at->exec = dns_cache_async_exec;
+	at->param = ap;
+	if(async_task_push(at) < 0) {
+		shm_free(at);
+		return -1;
+	}
+	return 0;
+}
+
+
+/* resolves a cache miss: if dns_cache_async_wait is set and there are
+ * async workers, the query is done by them and the process waits at most
+ * dns_cache_async_wait ms for the result (processes missing the same name
+ * wait for the same query), otherwise it is done in the process itself;
+ * if the async result is not available in time, the lookup gets what is
+ * in the cache (e.g., an entry in the stale grace period) or misses, the
+ * async worker adds the result to the cache for the next lookups
+ * returns the same as dns_cache_do_request() */
+static struct dns_hash_entry *dns_cache_miss_request(str *name, int type)
+{
+	struct dns_hash_entry *e;
+	dns_async_pending_t *p;
+	struct timeval tvb;
+	unsigned int gen;
+	int wait;
+	int push;
+	int idx;
+	int h;
+	int err;
+
+	if(_dns_async_ctx)
+		return dns_cache_do_request(name, type);
+
+	gettimeofday(&tvb, NULL);
+	wait = cfg_get(core, core_cfg, dns_cache_async_wait);
+	if(wait <= 0 || dns_async_pending == NULL || name->len >= MAX_DNS_NAME
+			|| !async_task_workers_active()) {
+		e = dns_cache_do_request(name, type);
+		goto done;
+	}
+
+	idx = get_hash1_case_raw(name->s, name->len) % DNS_ASYNC_PENDING_SIZE;
+	p = &dns_async_pending[idx];
+	push = 0;
+	lock_get(dns_async_lock);
+	if(p->busy == 0) {
+		p->busy = 1;
+		p->type = type;
+		p->name_len = name->len;
+		memcpy(p->name, name->s, name->len);
+		push = 1;
+	} else if((p->type != type) || (p->name_len != name->len)
+			  || (strncasecmp(p->name, name->s, name->len) != 0)) {
+		/* slot used by a query for another name - no wait */
+		lock_release(dns_async_lock);
+		if(dns_cache_async_push(name, type, DNS_ASYNC_FILL) < 0) {
+			e = dns_cache_do_request(name, type);
+		} else {
+			DNS_STATS_ADD(dc_async_timeout_cnt, 1);
+			e = 0;
+		}
+		goto done;
+	}
+	gen = p->gen;
+	lock_release(dns_async_lock);
+
+	if(push && dns_cache_async_push(name, type, idx) < 0) {
+		dns_async_pending_release(idx);
+		e = dns_cache_do_request(name, type);
+		goto done;
+	}
+	/* the result (or a stale entry) may have been added meanwhile, also
+	 * after a timeout; a result not cached (e.g., no negative caching) is
+	 * a miss too */
+	if(dns_async_pending_wait(p, gen, wait) == 0) {
+		LM_DBG("no async result in time for %.*s (%d)\n", name->len,
+				name->s, type);
+		DNS_STATS_ADD(dc_async_timeout_cnt, 1);
+	}
+	e = dns_hash_get(name, type, &h, &err);
+
+done:
+	DNS_STATS_ADD(dc_blocked_ms, dns_ms_since(&tvb));
+	return e;
+}
+
+
+/* handles an expired entry found within the stale grace period: only the
+ * first process finding it refreshes it, in background if there are async
+ * workers, all the others get the expired entry meanwhile; the expired
+ * entry is also returned if the refresh fails
+ * returns the entry to be used, with a reference to it */
+static struct dns_hash_entry *dns_cache_stale_entry(
+		struct dns_hash_entry *e, str *name, int type)
+{
+	struct dns_hash_entry *n;
+	struct timeval tvb;
+	int refresh;
+	int p;
+
+	refresh = 0;
+	p = dns_entry_part_no(e);
+	LOCK_DNS_PART(p);
+	if((e->ent_flags & DNS_FLAG_REFRESH) == 0) {
+		e->ent_flags |= DNS_FLAG_REFRESH;
+		refresh = 1;
+	}
+	UNLOCK_DNS_PART(p);
+
+	if(refresh && (_dns_async_ctx == 0) && async_task_workers_active()
+			&& (dns_cache_async_push(name, type, DNS_ASYNC_REFRESH) == 0)) {
+		refresh = 0;
+	}
+	if(refresh) {
+		gettimeofday(&tvb, NULL);
+		n = dns_cache_do_request(name, type);
+		DNS_STATS_ADD(dc_refresh_cnt, 1);
+		DNS_STATS_ADD(dc_refresh_ms, dns_ms_since(&tvb));
+		if(_dns_async_ctx == 0)
+			DNS_STATS_ADD(dc_blocked_ms, dns_ms_since(&tvb));
+		if(n && n->rr_lst && ((n->ent_flags & DNS_FLAG_BAD_NAME) == 0)) {
+			dns_cache_refresh_done(name, type, 1, 0);
+			dns_hash_put(e);
+			return n;
+		}
+		if(n)
+			dns_hash_put(n);
+		dns_cache_refresh_done(name, type, 0, 0);
+	}
+	DNS_STATS_ADD(dc_stale_cnt, 1);
+	return e;
+}
+
+
+/* re-resolves in background the entries looked up at least
+ * dns_cache_prefetch_hits times since the last dns timer run and expiring
+ * before the next run, so that hot entries do not expire
+ * it is called from the dns timer and resets the hits of all entries */
+static void dns_cache_prefetch(void)
+{
+	static dns_async_param_t plist[DNS_PREFETCH_MAX];
+	struct dns_hash_entry *e;
+	struct dns_lu_lst *l;
+	unsigned int min_hits;
+	unsigned int hits;
+	ticks_t window;
+	ticks_t now;
+	str name;
+	int n;
+	int i;
+	int p;
+
+	if(!async_task_workers_active())
+		return;
+	min_hits = cfg_get(core, core_cfg, dns_cache_prefetch_hits);
+	window = S_TO_TICKS(dns_timer_interval);
+	now = get_ticks_raw();
+	n = 0;
+	for(p = 0; p < DNS_HASH_PARTS; p++) {
+		LOCK_DNS_PART(p);
+		clist_foreach(&dns_hash_parts[p].lu_lst, l, next)
+		{
+			e = (struct dns_hash_entry *)(((char *)l)
+										  - (char *)&(
+												  (struct dns_hash_entry *)(0))
+													->last_used_lst);
+			hits = e->hits;
+			e->hits = 0;
+			if((n >= DNS_PREFETCH_MAX) || (hits < min_hits)
+					|| (e->ent_flags
+							& (DNS_FLAG_BAD_NAME | DNS_FLAG_PERMANENT
+									| DNS_FLAG_REFRESH))
+					|| ((s_ticks_t)(now - e->expire) >= 0)
+					|| ((s_ticks_t)(e->expire - now - window) >= 0))
+				continue;
+			e->ent_flags |= DNS_FLAG_REFRESH;
+			plist[n].type = e->type;
+			plist[n].name_len = e->name_len;
+			memcpy(plist[n].name, e->name, e->name_len);
+			n++;
+		}
+		UNLOCK_DNS_PART(p);
+	}
+
+	for(i = 0; i < n; i++) {
+		name.s = plist[i].name;
+		name.len = plist[i].name_len;
+		LM_DBG("prefetching %.*s (%d)\n", name.len, name.s, plist[i].type);
+		if(dns_cache_async_push(&name, plist[i].type, DNS_ASYNC_PREFETCH)
+				< 0) {
+			dns_cache_refresh_done(&name, plist[i].type, 0, 0);
+			continue;
+		}
+		DNS_STATS_ADD(dc_prefetch_cnt, 1);
+	}
+}
+
+
 /* tries to lookup (name, type) in the hash and if not found tries to make
  *  a dns request
  *  return: 0 on error, pointer to a dns_hash_entry on success
@@ -2128,6 +2736,7 @@ inline static struct dns_hash_entry *dns_get_entry(str *name, int type)
 	struct dns_hash_entry *e;
 	str cname_val;
 	int err;
+	int pfhit;
 	static int rec_cnt = 0; /* recursion protection */
 
 	e = 0;
@@ -2152,7 +2761,29 @@ inline static struct dns_hash_entry *dns_get_entry(str *name, int type)
 	}
 #endif /* USE_DNS_CACHE_STATS */
 
-	if((e == 0) && ((err) || ((e = dns_cache_do_request(name, type)) == 0))) {
+	if(e && (e->ent_flags & DNS_FLAG_PREFETCHED)) {
+		/* count only the first use of a prefetched entry */
+		pfhit = 0;
+		LOCK_DNS_PART(dns_entry_part_no(e));
+		if(e->ent_flags & DNS_FLAG_PREFETCHED) {
+			e->ent_flags &= ~DNS_FLAG_PREFETCHED;
+			pfhit = 1;
+		}
+		UNLOCK_DNS_PART(dns_entry_part_no(e));
+		if(pfhit)
+			DNS_STATS_ADD(dc_prefetch_hits, 1);
+	}
+	if(e && ((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
+			&& ((s_ticks_t)(get_ticks_raw() - e->expire) >= 0)) {
+		/* expired, but still in the stale grace period */
+		if(cfg_get(core, core_cfg, dns_cache_prefetch_hits) > 0
+				&& e->hits >= cfg_get(core, core_cfg, dns_cache_prefetch_hits))
+			DNS_STATS_ADD(dc_prefetch_misses, 1);
+		e = dns_cache_stale_entry(e, name, type);
+	}
+
+	if((e == 0)
+			&& ((err) || ((e = dns_cache_miss_request(name, type)) == 0))) {
 		goto error;
 	} else if((e->type == T_CNAME) && (type != T_CNAME)) {
 		/* cname found instead which couldn't be resolved with the cached
@@ -2218,8 +2849,8 @@ inline static struct dns_rr *dns_entry_get_rr(
 				servers_up &&
 #endif
 				((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
-				&& ((s_ticks_t)(now - rr->expire) >= 0) /* expired rr */
-		)
+				/* expired rr, out of the stale grace period */
+				&& ((s_ticks_t)(now - rr->expire - DNS_STALE_GRACE(e)) >= 0))
 			continue;
 		/* everything is ok now */
 		*no = n;
@@ -3621,7 +4252,7 @@ void dns_cache_mem_info(rpc_t *rpc, void *ctx)
 		rpc->fault(ctx, 500, "dns cache support disabled (see use_dns_cache)");
 		return;
 	}
-	rpc->add(ctx, "dd", *dns_cache_mem_used,
+	rpc->add(ctx, "dd", dns_cache_mem_used(),
 			cfg_get(core, core_cfg, dns_cache_max_mem));
 }
 
@@ -3637,8 +4268,8 @@ void dns_cache_debug(rpc_t *rpc, void *ctx)
 		return;
 	}
 	now = get_ticks_raw();
-	LOCK_DNS_HASH();
 	for(h = 0; h < DNS_HASH_SIZE; h++) {
+		LOCK_DNS_PART(dns_hash_part_no(h));
 		clist_foreach(&dns_hash[h], e, next)
 		{
 			rpc->add(ctx, "sdddddd", e->name, e->type, e->total_size,
@@ -3648,8 +4279,8 @@ void dns_cache_debug(rpc_t *rpc, void *ctx)
 							: TICKS_TO_S(e->expire - now),
 					TICKS_TO_S(now - e->last_used), e->ent_flags);
 		}
+		UNLOCK_DNS_PART(dns_hash_part_no(h));
 	}
-	UNLOCK_DNS_HASH();
 }
 
 
@@ -3657,8 +4288,17 @@ void dns_cache_debug(rpc_t *rpc, void *ctx)
 static unsigned long stat_sum(int ivar, int breset)
 {
 	unsigned long isum = 0;
+	unsigned long ihits = 0;
 	int i1 = 0;
 
+	if(ivar == 10) {
+		/* prefetch hit ratio (percent) - hits and misses are reset
+		 * by their own entries */
+		ihits = stat_sum(11, 0);
+		isum = ihits + stat_sum(12, 0);
+		return (isum > 0) ? (ihits * 100 / isum) : 0;
+	}
+
 	for(; i1 < get_max_procs(); i1++)
 		switch(ivar) {
 			case 0:
@@ -3681,6 +4321,46 @@ static unsigned long stat_sum(int ivar, int breset)
 				if(breset)
 					dns_cache_stats[i1].dc_lru_cnt = 0;
 				break;
+			case 4:
+				isum += dns_cache_stats[i1].dc_stale_cnt;
+				if(breset)
+					dns_cache_stats[i1].dc_stale_cnt = 0;
+				break;
+			case 5:
+				isum += dns_cache_stats[i1].dc_refresh_cnt;
+				if(breset)
+					dns_cache_stats[i1].dc_refresh_cnt = 0;
+				break;
+			case 6:
+				isum += dns_cache_stats[i1].dc_refresh_ms;
+				if(breset)
+					dns_cache_stats[i1].dc_refresh_ms = 0;
+				break;
+			case 7:
+				isum += dns_cache_stats[i1].dc_async_timeout_cnt;
+				if(breset)
+					dns_cache_stats[i1].dc_async_timeout_cnt = 0;
+				break;
+			case 8:
+				isum += dns_cache_stats[i1].dc_blocked_ms;
+				if(breset)
+					dns_cache_stats[i1].dc_blocked_ms = 0;
+				break;
+			case 9:
+				isum += dns_cache_stats[i1].dc_prefetch_cnt;
+				if(breset)
+					dns_cache_stats[i1].dc_prefetch_cnt = 0;
+				break;
+			case 11:
+				isum += dns_cache_stats[i1].dc_prefetch_hits;
+				if(breset)
+					dns_cache_stats[i1].dc_prefetch_hits = 0;
+				break;
+			case 12:
+				isum += dns_cache_stats[i1].dc_prefetch_misses;
+				if(breset)
+					dns_cache_stats[i1].dc_prefetch_misses = 0;
+				break;
 		}
 
 	return isum;
@@ -3694,7 +4374,10 @@ void dns_cache_stats_get(rpc_t *rpc, void *c)
 	int found = 0, i = 0;
 	int reset = 0;
 	char *dns_cache_stats_names[] = {"dns_req_cnt", "dc_hits_cnt",
-			"dc_neg_hits_cnt", "dc_lru_cnt", NULL};
+			"dc_neg_hits_cnt", "dc_lru_cnt", "dc_stale_cnt", "dc_refresh_cnt",
+			"dc_refresh_ms", "dc_async_timeout_cnt", "dc_blocked_ms",
+			"dc_prefetch_cnt", "dc_prefetch_ratio", "dc_prefetch_hits",
+			"dc_prefetch_misses", NULL};
 
 
 	if(!cfg_get(core, core_cfg, use_dns_cache)) {
@@ -3745,8 +4428,8 @@ void dns_cache_debug_all(rpc_t *rpc, void *ctx)
 		return;
 	}
 	now = get_ticks_raw();
-	LOCK_DNS_HASH();
 	for(h = 0; h < DNS_HASH_SIZE; h++) {
+		LOCK_DNS_PART(dns_hash_part_no(h));
 		clist_foreach(&dns_hash[h], e, next)
 		{
 			for(i = 0, rr = e->rr_lst; rr; i++, rr = rr->next) {
@@ -3802,8 +4485,8 @@ void dns_cache_debug_all(rpc_t *rpc, void *ctx)
 								: TICKS_TO_S(rr->expire - now));
 			}
 		}
+		UNLOCK_DNS_PART(dns_hash_part_no(h));
 	}
-	UNLOCK_DNS_HASH();
 }
 
 
@@ -4094,8 +4777,8 @@ void dns_cache_view(rpc_t *rpc, void *ctx)
 		return;
 	}
 	now = get_ticks_raw();
-	LOCK_DNS_HASH();
 	for(h = 0; h < DNS_HASH_SIZE; h++) {
+		LOCK_DNS_PART(dns_hash_part_no(h));
 		clist_foreach(&dns_hash[h], e, next)
 		{
 			if(((e->ent_flags & DNS_FLAG_PERMANENT) == 0)
@@ -4104,11 +4787,12 @@ void dns_cache_view(rpc_t *rpc, void *ctx)
 			}
 			if(dns_cache_print_entry(rpc, ctx, e) < 0) {
 				LM_DBG("failed to print dns entry\n");
+				UNLOCK_DNS_PART(dns_hash_part_no(h));
 				return;
 			}
 		}
+		UNLOCK_DNS_PART(dns_hash_part_no(h));
 	}
-	UNLOCK_DNS_HASH();
 }
 
 
@@ -4123,15 +4807,15 @@ void dns_cache_flush(int del_permanent)
 	struct dns_hash_entry *tmp;
 
 	LM_DBG("removing elements from the cache\n");
-	LOCK_DNS_HASH();
 	for(h = 0; h < DNS_HASH_SIZE; h++) {
+		LOCK_DNS_PART(dns_hash_part_no(h));
 		clist_foreach_safe(&dns_hash[h], e, tmp, next)
 		{
 			if(del_permanent || ((e->ent_flags & DNS_FLAG_PERMANENT) == 0))
 				_dns_hash_remove(e);
 		}
+		UNLOCK_DNS_PART(dns_hash_part_no(h));
 	}
-	UNLOCK_DNS_HASH();
 }
 
 /* deletes all the non-permanent entries from the cache */
@@ -4352,7 +5036,7 @@ int dns_cache_add_record(unsigned short type, str *name, int ttl, str *value,
 	str rr_name;
 	struct ip_addr *ip_addr;
 	ticks_t expire;
-	int err, h;
+	int err, h, p;
 	int size;
 	struct dns_rr *new_rr, **rr_p, **rr_iter;
 	struct srv_rdata *srv_rd;
@@ -4600,17 +5284,18 @@ int dns_cache_add_record(unsigned short type, str *name, int ttl, str *value,
 		}
 	}
 
-	LOCK_DNS_HASH();
+	p = dns_entry_part_no(new);
+	LOCK_DNS_PART(p);
 	if(dns_cache_add_unsafe(new)) {
 		LM_ERR("Failed to add the entry to the cache\n");
-		UNLOCK_DNS_HASH();
+		UNLOCK_DNS_PART(p);
 		goto error;
 	} else {
 		/* remove the old entry from the list */
 		if(old)
 			_dns_hash_remove(old);
 	}
-	UNLOCK_DNS_HASH();
+	UNLOCK_DNS_PART(p);
 
 	if(old)
 		dns_hash_put(old);
@@ -4631,7 +5316,7 @@ static void dns_cache_delete_record(rpc_t *rpc, void *ctx, unsigned short type)
 {
 	struct dns_hash_entry *e;
 	str name;
-	int err, h, found = 0, permanent = 0;
+	int err, h, p, found = 0, permanent = 0;
 
 	if(!cfg_get(core, core_cfg, use_dns_cache)) {
 		rpc->fault(ctx, 500, "dns cache support disabled (see use_dns_cache)");
@@ -4641,7 +5326,8 @@ static void dns_cache_delete_record(rpc_t *rpc, void *ctx, unsigned short type)
 	if(rpc->scan(ctx, "S", &name) < 1)
 		return;
 
-	LOCK_DNS_HASH();
+	p = dns_hash_part_no(dns_hash_no(name.s, name.len, type));
+	LOCK_DNS_PART(p);
 
 	e = _dns_hash_find(&name, type, &h, &err);
 	if(e && (e->type == type)) {
@@ -4652,7 +5338,7 @@ static void dns_cache_delete_record(rpc_t *rpc, void *ctx, unsigned short type)
 		found = 1;
 	}
 
-	UNLOCK_DNS_HASH();
+	UNLOCK_DNS_PART(p);
 
 	if(permanent)
 		rpc->fault(ctx, 400, "Permanent entries cannot be deleted");
@@ -4673,7 +5359,7 @@ int dns_cache_delete_single_record(
 	struct dns_rr *rr, **next_p;
 	str rr_name;
 	struct ip_addr *ip_addr;
-	int err, h;
+	int err, h, p;
 
 	/* eliminate gcc warnings */
 	rr_name.s = NULL;
@@ -4771,12 +5457,14 @@ int dns_cache_delete_single_record(
 		*next_p = rr->next;
 	}
 
-	delete : LOCK_DNS_HASH();
+delete:
+	p = dns_entry_part_no(old);
+	LOCK_DNS_PART(p);
 	if(new) {
 		/* delete the old entry only if the new one can be added */
 		if(dns_cache_add_unsafe(new)) {
 			LM_ERR("Failed to add the entry to the cache\n");
-			UNLOCK_DNS_HASH();
+			UNLOCK_DNS_PART(p);
 			if(old)
 				dns_hash_put(old);
 			return -1;
@@ -4788,7 +5476,7 @@ int dns_cache_delete_single_record(
 	} else if(old) {
 		_dns_hash_remove(old);
 	}
-	UNLOCK_DNS_HASH();
+	UNLOCK_DNS_PART(p);
 
 	if(old)
 		dns_hash_put(old);
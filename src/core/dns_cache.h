@@ -102,6 +102,8 @@ const char *dns_strerror(int err);
 	2 /**< permanent record, never times out,
 					never deleted, never overwritten
 					unless explicitely requested */
+#define DNS_FLAG_REFRESH 4 /**< refresh of expired record in progress */
+#define DNS_FLAG_PREFETCHED 8 /**< record resolved by prefetch, not used yet */
 /*@} */
 
 /** @name dns requests flags */
@@ -149,7 +151,8 @@ struct dns_hash_entry
 	struct dns_rr *rr_lst;
 	atomic_t refcnt;
 	ticks_t last_used;
-	ticks_t expire; /* when the whole entry will expire */
+	ticks_t expire;	   /* when the whole entry will expire */
+	unsigned int hits; /* lookups since the last dns timer run */
 	int total_size;
 	unsigned short type;
 	unsigned char ent_flags; /* entry flags: unresolvable/permanent */
@@ -277,6 +277,14 @@ struct t_dns_cache_stats
 	unsigned long dc_hits_cnt;
 	unsigned long dc_neg_hits_cnt;
 	unsigned long dc_lru_cnt;
+	unsigned long dc_stale_cnt;			/* expired entries served */
+	unsigned long dc_refresh_cnt;		/* background refreshes */
+	unsigned long dc_refresh_ms;		/* time spent in refreshes */
+	unsigned long dc_async_timeout_cnt; /* misses not resolved in time */
+	unsigned long dc_blocked_ms;		/* time workers waited for dns */
+	unsigned long dc_prefetch_cnt;		/* records resolved by prefetch */
+	unsigned long dc_prefetch_hits;		/* prefetched records used */
+	unsigned long dc_prefetch_misses;	/* hot records not prefetched in time */
 };
 extern struct t_dns_cache_stats *dns_cache_stats;
 #endif /* USE_DNS_CACHE_STATS */
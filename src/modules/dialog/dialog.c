@@ -103,14 +103,18 @@ static int default_timeout = 60 * 60 * 12; /* 12 hours */
 static int seq_match_mode = SEQ_MATCH_STRICT_ID;
 static char *profiles_wv_s = NULL;
 static char *profiles_nv_s = NULL;
+static int dlg_profiles_hash_size = 16;
 str dlg_extra_hdrs = {NULL, 0};
 static int db_fetch_rows = 200;
+static int db_async_queue_size = 0;
+static int db_async_interval = 100;
 static int db_skip_load = 0;
 static int dlg_keep_proxy_rr = 0;
 int dlg_filter_mode = 0;
 int initial_cbs_inscript = 1;
 int dlg_wait_ack = 1;
 static int dlg_timer_procs = 0;
+static int dlg_timer_wheel_size = 4096;
 static int _dlg_track_cseq_updates = 0;
 int dlg_ka_failed_limit = 1;
 int dlg_early_timeout = 300;
@@ -148,6 +152,7 @@ stat_var *processed_dlgs = 0;
 stat_var *expired_dlgs = 0;
 stat_var *failed_dlgs = 0;
 stat_var *early_dlgs = 0;
+stat_var *db_flushed_dlgs = 0;
 
 int debug_variables_list = 0;
 
@@ -372,8 +377,11 @@ static param_export_t mod_params[]={
 
 	{ "db_update_period",      PARAM_INT, &db_update_period         },
 	{ "db_fetch_rows",         PARAM_INT, &db_fetch_rows            },
+	{ "db_async_queue_size",   PARAM_INT, &db_async_queue_size      },
+	{ "db_async_interval",     PARAM_INT, &db_async_interval        },
 	{ "profiles_with_value",   PARAM_STRING, &profiles_wv_s            },
 	{ "profiles_no_value",     PARAM_STRING, &profiles_nv_s            },
+	{ "profiles_hash_size",    PARAM_INT, &dlg_profiles_hash_size   },
 	{ "bridge_controller",     PARAM_STR, &dlg_bridge_controller  },
 	{ "bridge_contact",        PARAM_STR, &dlg_bridge_contact       },
 	{ "ruri_pvar",             PARAM_STR, &ruri_pvar_param        },
@@ -385,6 +393,7 @@ static param_export_t mod_params[]={
 	{ "ka_interval",           PARAM_INT, &dlg_ka_interval          },
 	{ "timeout_noreset",       PARAM_INT, &dlg_timeout_noreset      },
 	{ "timer_procs",           PARAM_INT, &dlg_timer_procs          },
+	{ "timer_wheel_size",      PARAM_INT, &dlg_timer_wheel_size     },
 	{ "track_cseq_updates",    PARAM_INT, &_dlg_track_cseq_updates  },
 	{ "lreq_callee_headers",   PARAM_STR, &dlg_lreq_callee_headers  },
 	{ "db_skip_load",          PARAM_INT, &db_skip_load             },
@@ -416,6 +425,13 @@ static stat_export_t mod_stats[] = {
 	{"processed_dialogs" ,  0,              &processed_dlgs    },
 	{"expired_dialogs" ,    0,              &expired_dlgs      },
 	{"failed_dialogs",      0,              &failed_dlgs       },
+	{"db_flushed_dialogs",  0,              &db_flushed_dlgs   },
+	{"db_queue_depth",      STAT_IS_FUNC,
+		(stat_var **)dlg_db_queue_depth_stat },
+	{"db_flush_last_ms",    STAT_IS_FUNC,
+		(stat_var **)dlg_db_flush_last_ms_stat },
+	{"db_flush_max_ms",     STAT_IS_FUNC,
+		(stat_var **)dlg_db_flush_max_ms_stat },
 	{0,0,0}
 };
 
@@ -664,11 +680,20 @@ static int mod_init(void)
 	}
 
 	/* create profile hashes */
-	if(add_profile_definitions(profiles_nv_s, 0) != 0) {
+	if(dlg_profiles_hash_size <= 0
+			|| (dlg_profiles_hash_size & (dlg_profiles_hash_size - 1)) != 0) {
+		LM_ERR("invalid value %d for profiles_hash_size param - must be a "
+			   "power of 2\n",
+				dlg_profiles_hash_size);
+		return -1;
+	}
+	if(add_profile_definitions(profiles_nv_s, 0, dlg_profiles_hash_size)
+			!= 0) {
 		LM_ERR("failed to add profiles without value\n");
 		return -1;
 	}
-	if(add_profile_definitions(profiles_wv_s, 1) != 0) {
+	if(add_profile_definitions(profiles_wv_s, 1, dlg_profiles_hash_size)
+			!= 0) {
 		LM_ERR("failed to add profiles with value\n");
 		return -1;
 	}
@@ -748,7 +773,11 @@ static int mod_init(void)
 			default_timeout, seq_match_mode, dlg_keep_proxy_rr);
 
 	/* init timer */
-	if(init_dlg_timer(dlg_ontimeout) != 0) {
+	if(dlg_timer_wheel_size < 1) {
+		dlg_timer_wheel_size = 1;
+	}
+	if(init_dlg_timer(dlg_ontimeout, (unsigned int)dlg_timer_wheel_size)
+			!= 0) {
 		LM_ERR("cannot init timer list\n");
 		return -1;
 	}
@@ -798,6 +827,17 @@ static int mod_init(void)
 			LM_ERR("failed to initialize the DB support\n");
 			return -1;
 		}
+		if(dlg_db_mode == DB_MODE_REALTIME && db_async_queue_size > 0) {
+			if(db_async_interval <= 0) {
+				db_async_interval = 100;
+			}
+			if(dlg_db_queue_init(db_async_queue_size) < 0) {
+				LM_ERR("failed to initialize the DB writer queue\n");
+				return -1;
+			}
+			/* timer process to write the queued dialog changes */
+			register_basic_timers(1);
+		}
 	}
 
 	/* timer process to send keep alive requests */
@@ -866,6 +906,16 @@ static int child_init(int rank)
 			LM_ERR("failed to start clean timer routine as process\n");
 			return -1; /* error */
 		}
+
+		if(dlg_db_mode == DB_MODE_REALTIME && dlg_db_queue_enabled()) {
+			if(fork_basic_utimer(PROC_TIMER, "Dialog DB Writer",
+					   1 /*socks flag*/, dlg_db_writer_exec, NULL,
+					   db_async_interval * 1000 /*ms*/)
+					< 0) {
+				LM_ERR("failed to start db writer routine as process\n");
+				return -1; /* error */
+			}
+		}
 	}
 
 	if(((dlg_db_mode == DB_MODE_REALTIME || dlg_db_mode == DB_MODE_DELAYED)
@@ -897,6 +947,19 @@ static void mod_destroy(void)
 		dialog_update_db(0, 0);
 		destroy_dlg_db();
 	}
+	if(dlg_db_mode_param == DB_MODE_REALTIME
+			&& dlg_db_queue_depth_stat() > 0) {
+		/* write the changes left in queue by the db writer process */
+		if(dlg_connect_db(&db_url) == 0) {
+			dlg_db_writer_exec(0, NULL);
+			destroy_dlg_db();
+		} else {
+			LM_ERR("failed to connect to database to flush %lu queued "
+				   "dialog operations\n",
+					dlg_db_queue_depth_stat());
+		}
+	}
+	dlg_db_queue_destroy();
 }
 
 
@@ -82,7 +82,33 @@ str dialog_vars_table_name = str_init(DIALOG_VARS_TABLE_NAME);
 static db1_con_t *dialog_db_handle = 0; /* database connection handle */
 static db_func_t dialog_dbf;
 
+#define DLG_DBQ_UPDATE 1
+#define DLG_DBQ_DELETE 2
+
+/* item of the async db writer queue */
+typedef struct dlg_db_qitem
+{
+	unsigned int op;
+	unsigned int h_entry;
+	unsigned int h_id;
+} dlg_db_qitem_t;
+
+/* queue of dialog db operations for the async db writer */
+typedef struct dlg_db_queue
+{
+	gen_lock_t lock;
+	unsigned int size;	/* capacity of the ring buffer */
+	unsigned int start; /* index of the first item */
+	unsigned int count; /* number of queued items */
+	unsigned int flush_last_ms;
+	unsigned int flush_max_ms;
+	dlg_db_qitem_t *items;
+} dlg_db_queue_t;
+
+static dlg_db_queue_t *_dlg_db_queue = NULL;
+
 extern int dlg_enable_stats;
+extern stat_var *db_flushed_dlgs;
 extern int dlg_h_id_start;
 extern int dlg_h_id_step;
 
@@ -726,27 +752,23 @@ error:
 	return -1;
 }
 
-/*this is only called from destroy_dlg, where the cell's entry lock is acquired*/
-int remove_dialog_from_db(struct dlg_cell *cell)
+static int dlg_db_queue_push(
+		unsigned int op, unsigned int h_entry, unsigned int h_id);
+
+static int remove_dialog_rows_from_db(unsigned int h_entry, unsigned int h_id)
 {
 	db_val_t values[2];
 	db_key_t match_keys[2] = {&h_entry_column, &h_id_column};
 	db_key_t vars_match_keys[2] = {&vars_h_entry_column, &vars_h_id_column};
 
-	/*if the dialog hasn 't been yet inserted in the database*/
-	LM_DBG("trying to remove dialog [%.*s], update_flag is %i\n",
-			cell->callid.len, cell->callid.s, cell->dflags);
-	if(cell->dflags & DLG_FLAG_NEW)
-		return 0;
-
 	if(use_dialog_table() != 0)
 		return -1;
 
 	VAL_TYPE(values) = VAL_TYPE(values + 1) = DB1_INT;
 	VAL_NULL(values) = VAL_NULL(values + 1) = 0;
 
-	VAL_INT(values) = cell->h_entry;
-	VAL_INT(values + 1) = cell->h_id;
+	VAL_INT(values) = h_entry;
+	VAL_INT(values + 1) = h_id;
 
 	if(dialog_dbf.delete(dialog_db_handle, match_keys, 0, values, 2) < 0) {
 		LM_ERR("failed to delete database information\n");
@@ -761,6 +783,27 @@ int remove_dialog_from_db(struct dlg_cell *cell)
 		return -1;
 	}
 
+	return 0;
+}
+
+/*this is only called from destroy_dlg, where the cell's entry lock is acquired*/
+int remove_dialog_from_db(struct dlg_cell *cell)
+{
+	/*if the dialog hasn 't been yet inserted in the database*/
+	LM_DBG("trying to remove dialog [%.*s], update_flag is %i\n",
+			cell->callid.len, cell->callid.s, cell->dflags);
+	if(cell->dflags & DLG_FLAG_NEW)
+		return 0;
+
+	if(dlg_db_queue_enabled()
+			&& dlg_db_queue_push(DLG_DBQ_DELETE, cell->h_entry, cell->h_id)
+					   == 0) {
+		return 0;
+	}
+
+	if(remove_dialog_rows_from_db(cell->h_entry, cell->h_id) < 0)
+		return -1;
+
 	LM_DBG("callid was %.*s\n", cell->callid.len, cell->callid.s);
 
 	return 0;
@@ -1060,6 +1103,20 @@ int update_dialog_dbinfo(struct dlg_cell *cell)
 {
 	/* lock the entry */
 	dlg_lock(d_table, &d_table->entries[cell->h_entry]);
+	if(dlg_db_queue_enabled()) {
+		if(cell->dflags & DLG_FLAG_DBQUEUED) {
+			/* pending write will store the latest state */
+			dlg_unlock(d_table, &d_table->entries[cell->h_entry]);
+			return 0;
+		}
+		if(dlg_db_queue_push(DLG_DBQ_UPDATE, cell->h_entry, cell->h_id)
+				== 0) {
+			cell->dflags |= DLG_FLAG_DBQUEUED;
+			dlg_unlock(d_table, &d_table->entries[cell->h_entry]);
+			return 0;
+		}
+		/* queue is full - write it now */
+	}
 	if(update_dialog_dbinfo_unsafe(cell) != 0) {
 		dlg_unlock(d_table, &d_table->entries[cell->h_entry]);
 		return -1;
@@ -1086,3 +1143,196 @@ void dialog_update_db(unsigned int ticks, void *param)
 	}
 	return;
 }
+
+/**
+ * init the queue for the async db writer
+ */
+int dlg_db_queue_init(int qsize)
+{
+	if(qsize <= 0) {
+		return 0;
+	}
+	_dlg_db_queue = (dlg_db_queue_t *)shm_malloc(
+			sizeof(dlg_db_queue_t) + qsize * sizeof(dlg_db_qitem_t));
+	if(_dlg_db_queue == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(_dlg_db_queue, 0, sizeof(dlg_db_queue_t));
+	_dlg_db_queue->size = qsize;
+	_dlg_db_queue->items = (dlg_db_qitem_t *)(_dlg_db_queue + 1);
+	if(lock_init(&_dlg_db_queue->lock) == NULL) {
+		LM_ERR("failed to init db queue lock\n");
+		shm_free(_dlg_db_queue);
+		_dlg_db_queue = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * destroy the queue for the async db writer
+ */
+void dlg_db_queue_destroy(void)
+{
+	if(_dlg_db_queue == NULL) {
+		return;
+	}
+	lock_destroy(&_dlg_db_queue->lock);
+	shm_free(_dlg_db_queue);
+	_dlg_db_queue = NULL;
+}
+
+/**
+ * return 1 if the dialog db operations are done by the async writer
+ */
+int dlg_db_queue_enabled(void)
+{
+	return (_dlg_db_queue != NULL && dlg_db_mode == DB_MODE_REALTIME) ? 1 : 0;
+}
+
+/**
+ * add a dialog db operation to the queue
+ * - return 0 if queued, -1 if the queue is full
+ */
+static int dlg_db_queue_push(
+		unsigned int op, unsigned int h_entry, unsigned int h_id)
+{
+	dlg_db_qitem_t *it;
+
+	lock_get(&_dlg_db_queue->lock);
+	if(_dlg_db_queue->count >= _dlg_db_queue->size) {
+		lock_release(&_dlg_db_queue->lock);
+		LM_DBG("db queue full - doing the operation directly\n");
+		return -1;
+	}
+	it = &_dlg_db_queue->items[(_dlg_db_queue->start + _dlg_db_queue->count)
+							   % _dlg_db_queue->size];
+	it->op = op;
+	it->h_entry = h_entry;
+	it->h_id = h_id;
+	_dlg_db_queue->count++;
+	lock_release(&_dlg_db_queue->lock);
+	return 0;
+}
+
+/**
+ * move up to n items from the queue to the buffer
+ * - return the number of items
+ */
+static int dlg_db_queue_pop(dlg_db_qitem_t *buf, unsigned int n)
+{
+	unsigned int i;
+
+	lock_get(&_dlg_db_queue->lock);
+	for(i = 0; i < n && _dlg_db_queue->count > 0; i++) {
+		buf[i] = _dlg_db_queue->items[_dlg_db_queue->start];
+		_dlg_db_queue->start = (_dlg_db_queue->start + 1) % _dlg_db_queue->size;
+		_dlg_db_queue->count--;
+	}
+	lock_release(&_dlg_db_queue->lock);
+	return i;
+}
+
+/**
+ * write a batch of queued dialog operations to database
+ */
+static void dlg_db_write_batch(dlg_db_qitem_t *buf, int n)
+{
+	int i;
+	int intx;
+	dlg_cell_t *dlg;
+
+	intx = 0;
+	if(n > 1 && dialog_dbf.start_transaction && dialog_dbf.end_transaction) {
+		/* group the batch in one transaction to avoid a commit per row */
+		if(dialog_dbf.start_transaction(dialog_db_handle, DB_LOCKING_NONE)
+				< 0) {
+			LM_ERR("failed to start db transaction\n");
+		} else {
+			intx = 1;
+		}
+	}
+
+	for(i = 0; i < n; i++) {
+		if(buf[i].op == DLG_DBQ_DELETE) {
+			remove_dialog_rows_from_db(buf[i].h_entry, buf[i].h_id);
+			continue;
+		}
+		dlg = dlg_lookup(buf[i].h_entry, buf[i].h_id);
+		if(dlg == NULL) {
+			/* dialog destroyed meanwhile */
+			continue;
+		}
+		dlg_lock(d_table, &d_table->entries[dlg->h_entry]);
+		dlg->dflags &= ~DLG_FLAG_DBQUEUED;
+		update_dialog_dbinfo_unsafe(dlg);
+		dlg_unlock(d_table, &d_table->entries[dlg->h_entry]);
+		dlg_release(dlg);
+	}
+
+	if(intx) {
+		if(dialog_dbf.end_transaction(dialog_db_handle) < 0) {
+			LM_ERR("failed to end db transaction\n");
+			if(dialog_dbf.abort_transaction) {
+				dialog_dbf.abort_transaction(dialog_db_handle);
+			}
+		}
+	}
+}
+
+#define DLG_DB_WRITER_BATCH 128
+
+/**
+ * async db writer routine - flush the queued dialog operations
+ */
+void dlg_db_writer_exec(unsigned int ticks, void *param)
+{
+	dlg_db_qitem_t buf[DLG_DB_WRITER_BATCH];
+	struct timeval tvb, tve;
+	unsigned int dms;
+	unsigned long nflushed;
+	int n;
+
+	if(_dlg_db_queue == NULL || dialog_db_handle == NULL) {
+		return;
+	}
+
+	gettimeofday(&tvb, NULL);
+	nflushed = 0;
+	while((n = dlg_db_queue_pop(buf, DLG_DB_WRITER_BATCH)) > 0) {
+		dlg_db_write_batch(buf, n);
+		nflushed += n;
+	}
+	if(nflushed == 0) {
+		return;
+	}
+	gettimeofday(&tve, NULL);
+	dms = (unsigned int)((tve.tv_sec - tvb.tv_sec) * 1000
+						 + (tve.tv_usec - tvb.tv_usec) / 1000);
+
+	_dlg_db_queue->flush_last_ms = dms;
+	if(dms > _dlg_db_queue->flush_max_ms) {
+		_dlg_db_queue->flush_max_ms = dms;
+	}
+	if_update_stat(dlg_enable_stats, db_flushed_dlgs, nflushed);
+	LM_DBG("flushed %lu dialog db operations in %u ms\n", nflushed, dms);
+}
+
+/**
+ * statistics of the async db writer
+ */
+unsigned long dlg_db_queue_depth_stat(void)
+{
+	return (_dlg_db_queue != NULL) ? _dlg_db_queue->count : 0;
+}
+
+unsigned long dlg_db_flush_last_ms_stat(void)
+{
+	return (_dlg_db_queue != NULL) ? _dlg_db_queue->flush_last_ms : 0;
+}
+
+unsigned long dlg_db_flush_max_ms_stat(void)
+{
+	return (_dlg_db_queue != NULL) ? _dlg_db_queue->flush_max_ms : 0;
+}
@@ -126,4 +126,12 @@ void dialog_update_db(unsigned int ticks, void *param);
 int load_dialog_info_from_db(
 		int dlg_hash_size, int fetch_num_rows, int mode, str *mval);
 
+int dlg_db_queue_init(int qsize);
+void dlg_db_queue_destroy(void);
+int dlg_db_queue_enabled(void);
+void dlg_db_writer_exec(unsigned int ticks, void *param);
+unsigned long dlg_db_queue_depth_stat(void);
+unsigned long dlg_db_flush_last_ms_stat(void);
+unsigned long dlg_db_flush_max_ms_stat(void);
+
 #endif
@@ -76,6 +76,8 @@
 
 #define DLG_FLAG_CHANGED_SFLAGS \
 	(1 << 13) /*!< sflags changed - needs db update */
+#define DLG_FLAG_DBQUEUED \
+	(1 << 14) /*!< queued for the async db writer */
 
 /* internal flags stored in db */
 #define DLG_IFLAG_TIMEOUTBYE (1 << 0) /*!< send bye on time-out */
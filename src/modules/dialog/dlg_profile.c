@@ -45,9 +45,6 @@
 #include "dlg_profile.h"
 
 
-/*! size of dialog profile hash */
-#define PROFILE_HASH_SIZE 16
-
 /*! tm bindings */
 extern struct tm_binds d_tmb;
 
@@ -74,9 +71,11 @@ static sruid_t _dlg_profile_sruid;
  * \see new_dlg_profile
  * \param profiledef profile name
  * \param has_value set to 0 for a profile without value, otherwise it has a value
+ * \param size profile hash table size, must be a power of 2
  * \return 0 on success, -1 on failure
  */
-int add_profile_definitions(char *profiledef, unsigned int has_value)
+int add_profile_definitions(
+		char *profiledef, unsigned int has_value, unsigned int size)
 {
 	char *p;
 	char *d;
@@ -119,7 +118,7 @@ int add_profile_definitions(char *profiledef, unsigned int has_value)
 		/* name ok -> create the profile */
 		LM_DBG("creating profile <%.*s>\n", name.len, name.s);
 
-		if(new_dlg_profile(&name, PROFILE_HASH_SIZE, has_value) == NULL) {
+		if(new_dlg_profile(&name, size, has_value) == NULL) {
 			LM_ERR("failed to create new profile <%.*s>\n", name.len, name.s);
 			return -1;
 		}
@@ -235,9 +234,19 @@ static struct dlg_profile_table *new_dlg_profile(
  */
 static void destroy_dlg_profile(struct dlg_profile_table *profile)
 {
+	struct dlg_profile_value *pv;
+	unsigned int i;
+
 	if(profile == NULL)
 		return;
 
+	for(i = 0; i < profile->size; i++) {
+		while(profile->entries[i].values) {
+			pv = profile->entries[i].values;
+			profile->entries[i].values = pv->next;
+			shm_free(pv);
+		}
+	}
 	lock_destroy(&profile->lock);
 	shm_free(profile);
 	return;
@@ -260,6 +269,128 @@ void destroy_dlg_profiles(void)
 }
 
 
+/*!
+ * \brief Find the counter of a value in a profile hash entry
+ * \note must be called with the profile lock held
+ * \param p_entry profile hash entry
+ * \param value profile value
+ * \param hash hash id over the value
+ * \return the value counter if found, NULL otherwise
+ */
+static inline struct dlg_profile_value *profile_value_find_unsafe(
+		struct dlg_profile_entry *p_entry, str *value, unsigned int hash)
+{
+	struct dlg_profile_value *pv;
+
+	for(pv = p_entry->values; pv; pv = pv->next) {
+		if(pv->hash == hash && pv->value.len == value->len
+				&& memcmp(pv->value.s, value->s, value->len) == 0) {
+			return pv;
+		}
+	}
+	return NULL;
+}
+
+
+/*!
+ * \brief Count an item with value in a profile hash entry
+ * \note must be called with the profile lock held
+ * \param p_entry profile hash entry
+ * \param lh profile hash item
+ */
+static void profile_value_inc_unsafe(
+		struct dlg_profile_entry *p_entry, struct dlg_profile_hash *lh)
+{
+	struct dlg_profile_value *pv;
+	unsigned int hash;
+
+	hash = core_hash(&lh->value, NULL, 0);
+	pv = profile_value_find_unsafe(p_entry, &lh->value, hash);
+	if(pv == NULL) {
+		pv = (struct dlg_profile_value *)shm_malloc(
+				sizeof(struct dlg_profile_value) + lh->value.len + 1);
+		if(pv == NULL) {
+			LM_ERR("no more shm memory for profile value counter\n");
+			return;
+		}
+		memset(pv, 0, sizeof(struct dlg_profile_value));
+		pv->value.s = (char *)(pv + 1);
+		memcpy(pv->value.s, lh->value.s, lh->value.len);
+		pv->value.s[lh->value.len] = '\0';
+		pv->value.len = lh->value.len;
+		pv->hash = hash;
+		pv->next = p_entry->values;
+		p_entry->values = pv;
+	}
+	pv->count++;
+	lh->vcounter = pv;
+}
+
+
+/*!
+ * \brief Uncount an item with value from a profile hash entry
+ * \note must be called with the profile lock held
+ * \param p_entry profile hash entry
+ * \param lh profile hash item
+ */
+static void profile_value_dec_unsafe(
+		struct dlg_profile_entry *p_entry, struct dlg_profile_hash *lh)
+{
+	struct dlg_profile_value *pv;
+	struct dlg_profile_value *pv0;
+
+	if(lh->vcounter == NULL) {
+		return;
+	}
+	pv = lh->vcounter;
+	lh->vcounter = NULL;
+	if(pv->count > 1) {
+		pv->count--;
+		return;
+	}
+	/* last item with this value - drop the counter */
+	if(p_entry->values == pv) {
+		p_entry->values = pv->next;
+	} else {
+		for(pv0 = p_entry->values; pv0 && pv0->next != pv; pv0 = pv0->next)
+			;
+		if(pv0 == NULL) {
+			LM_CRIT("value counter not found in profile entry\n");
+			return;
+		}
+		pv0->next = pv->next;
+	}
+	shm_free(pv);
+}
+
+
+/*!
+ * \brief Unlink an item from a profile hash entry
+ * \note must be called with the profile lock held
+ * \param profile dialog profile table
+ * \param p_entry profile hash entry
+ * \param lh profile hash item
+ */
+static void profile_unlink_unsafe(struct dlg_profile_table *profile,
+		struct dlg_profile_entry *p_entry, struct dlg_profile_hash *lh)
+{
+	/* last element on the list? */
+	if(lh == lh->next) {
+		p_entry->first = NULL;
+	} else {
+		if(p_entry->first == lh)
+			p_entry->first = lh->next;
+		lh->next->prev = lh->prev;
+		lh->prev->next = lh->next;
+	}
+	lh->next = lh->prev = NULL;
+	if(profile->has_value) {
+		profile_value_dec_unsafe(p_entry, lh);
+	}
+	p_entry->content--;
+}
+
+
 /*!
  * \brief Destroy dialog linkers
  * \param linker dialog linker
@@ -278,17 +409,7 @@ void destroy_linkers(struct dlg_profile_link *linker)
 			p_entry = &l->profile->entries[l->hash_linker.hash];
 			lock_get(&l->profile->lock);
 			lh = &l->hash_linker;
-			/* last element on the list? */
-			if(lh == lh->next) {
-				p_entry->first = NULL;
-			} else {
-				if(p_entry->first == lh)
-					p_entry->first = lh->next;
-				lh->next->prev = lh->prev;
-				lh->prev->next = lh->next;
-			}
-			lh->next = lh->prev = NULL;
-			p_entry->content--;
+			profile_unlink_unsafe(l->profile, p_entry, lh);
 			lock_release(&l->profile->lock);
 		}
 		/* free memory */
@@ -342,19 +463,9 @@ void remove_expired_remote_profiles(time_t te)
 				while(lh) {
 					kh = lh->next;
 					if(lh->dlg == NULL && lh->expires > 0 && lh->expires < te) {
-						/* last element on the list? */
-						if(lh == lh->next) {
-							p_entry->first = NULL;
-						} else {
-							if(p_entry->first == lh)
-								p_entry->first = lh->next;
-							lh->next->prev = lh->prev;
-							lh->prev->next = lh->next;
-						}
-						lh->next = lh->prev = NULL;
+						profile_unlink_unsafe(profile, p_entry, lh);
 						if(lh->linker)
 							shm_free(lh->linker);
-						p_entry->content--;
 						lock_release(&profile->lock);
 						return;
 					}
@@ -388,19 +499,9 @@ int remove_profile(dlg_profile_table_t *profile, str *value, str *puid)
 					&& lh->value.len == value->len
 					&& strncmp(lh->puid, puid->s, puid->len) == 0
 					&& strncmp(lh->value.s, value->s, value->len) == 0) {
-				/* last element on the list? */
-				if(lh == lh->next) {
-					p_entry->first = NULL;
-				} else {
-					if(p_entry->first == lh)
-						p_entry->first = lh->next;
-					lh->next->prev = lh->prev;
-					lh->prev->next = lh->next;
-				}
-				lh->next = lh->prev = NULL;
+				profile_unlink_unsafe(profile, p_entry, lh);
 				if(lh->linker)
 					shm_free(lh->linker);
-				p_entry->content--;
 				lock_release(&profile->lock);
 				return 1;
 			}
@@ -495,6 +596,9 @@ static void link_profile(struct dlg_profile_link *linker, str *vkey)
 		p_entry->first = linker->hash_linker.next = linker->hash_linker.prev =
 				&linker->hash_linker;
 	}
+	if(linker->profile->has_value) {
+		profile_value_inc_unsafe(p_entry, &linker->hash_linker);
+	}
 	p_entry->content++;
 	lock_release(&linker->profile->lock);
 }
@@ -847,33 +951,23 @@ done:
 unsigned int get_profile_size(struct dlg_profile_table *profile, str *value)
 {
 	unsigned int n, i;
-	struct dlg_profile_hash *ph;
+	struct dlg_profile_value *pv;
 
 	if(profile->has_value == 0 || value == NULL) {
-		/* iterate through the hash and count all records */
-		lock_get(&profile->lock);
+		/* sum the per hash entry counters - each of them is updated under
+		 * lock, the total is a snapshot without locking the profile */
 		for(i = 0, n = 0; i < profile->size; i++)
 			n += profile->entries[i].content;
-		lock_release(&profile->lock);
 		return n;
 	} else {
-		/* iterate through the hash entry and count only matching */
-		/* calculate the hash position */
+		/* get the counter of the value from its hash entry */
 		i = calc_hash_profile(value, NULL, profile);
 		n = 0;
 		lock_get(&profile->lock);
-		ph = profile->entries[i].first;
-		if(ph) {
-			do {
-				/* compare */
-				if(value->len == ph->value.len
-						&& memcmp(value->s, ph->value.s, value->len) == 0) {
-					/* found */
-					n++;
-				}
-				/* next */
-				ph = ph->next;
-			} while(ph != profile->entries[i].first);
+		pv = profile_value_find_unsafe(
+				&profile->entries[i], value, core_hash(value, NULL, 0));
+		if(pv != NULL) {
+			n = pv->count;
 		}
 		lock_release(&profile->lock);
 		return n;
@@ -51,6 +51,16 @@
  */
 
 
+/*! counter of profile items having the same value */
+typedef struct dlg_profile_value
+{
+	str value;		   /*!< profile value */
+	unsigned int hash; /*!< hash id over the value */
+	unsigned int count; /*!< number of items with this value */
+	struct dlg_profile_value *next;
+} dlg_profile_value_t;
+
+
 /*! dialog profile hash list */
 typedef struct dlg_profile_hash
 {
@@ -61,6 +71,7 @@ typedef struct dlg_profile_hash
 	time_t expires;
 	int flags;
 	struct dlg_profile_link *linker;
+	struct dlg_profile_value *vcounter; /*!< counter of the value */
 	struct dlg_profile_hash *next;
 	struct dlg_profile_hash *prev;
 	unsigned int hash; /*!< position in the hash table */
@@ -80,7 +91,8 @@ typedef struct dlg_profile_link
 typedef struct dlg_profile_entry
 {
 	struct dlg_profile_hash *first;
-	unsigned int content; /*!< content of the entry */
+	struct dlg_profile_value *values; /*!< counters per value */
+	volatile unsigned int content;	  /*!< content of the entry */
 } dlg_profile_entry_t;
 
 #define FLAG_PROFILE_REMOTE 1
@@ -104,9 +116,11 @@ typedef struct dlg_profile_table
  * \see new_dlg_profile
  * \param profiles profile name
  * \param has_value set to 0 for a profile without value, otherwise it has a value
+ * \param size profile hash table size, must be a power of 2
  * \return 0 on success, -1 on failure
  */
-int add_profile_definitions(char *profiles, unsigned int has_value);
+int add_profile_definitions(
+		char *profiles, unsigned int has_value, unsigned int size);
 
 
 /*!
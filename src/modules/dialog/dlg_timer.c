@@ -32,45 +32,97 @@
 #include "../../core/timer.h"
 #include "dlg_timer.h"
 
+/*! number of locks used to serialize changes of the same timer link */
+#define DLG_TIMER_TL_LOCKS 256
+
 /*! global dialog timer */
 struct dlg_timer *d_timer = 0;
 /*! global dialog timer handler */
 dlg_timer_handler timer_hdl = 0;
 
 
+/*!
+ * \brief Last tick lower or equal to ticks that maps on a wheel slot
+ * \param idx wheel slot index
+ * \param ticks reference tick
+ * \return tick value, 0 if the slot was not reached yet
+ */
+static inline unsigned int dlg_timer_slot_tick(
+		unsigned int idx, unsigned int ticks)
+{
+	if(ticks < idx)
+		return 0;
+	return ticks - ((ticks - idx) & d_timer->mask);
+}
+
+
 /*!
  * \brief Initialize the dialog timer handler
- * Initialize the dialog timer handler, allocate the lock and a global
- * timer in shared memory. The global timer handler will be set on success.
+ * Initialize the dialog timer handler, allocate the locks and a global
+ * timing wheel in shared memory. The global timer handler will be set
+ * on success.
  * \param hdl dialog timer handler
+ * \param size number of wheel slots, rounded up to a power of 2
  * \return 0 on success, -1 on failure
  */
-int init_dlg_timer(dlg_timer_handler hdl)
+int init_dlg_timer(dlg_timer_handler hdl, unsigned int size)
 {
-	d_timer = (struct dlg_timer *)shm_malloc(sizeof(struct dlg_timer));
+	unsigned int i;
+	unsigned int n;
+
+	for(n = 1; n < size && n < (1U << 20); n <<= 1)
+		;
+
+	d_timer = (struct dlg_timer *)shm_malloc(
+			sizeof(struct dlg_timer) + (n + 1) * sizeof(dlg_timer_slot_t));
 	if(d_timer == 0) {
 		LM_ERR("no more shm mem\n");
 		return -1;
 	}
-	memset(d_timer, 0, sizeof(struct dlg_timer));
-
-	d_timer->first.next = d_timer->first.prev = &(d_timer->first);
+	memset(d_timer, 0,
+			sizeof(struct dlg_timer) + (n + 1) * sizeof(dlg_timer_slot_t));
+
+	d_timer->size = n;
+	d_timer->mask = n - 1;
+	d_timer->last = get_ticks();
+	d_timer->slots = (dlg_timer_slot_t *)(d_timer + 1);
+	for(i = 0; i <= n; i++) {
+		d_timer->slots[i].first.next = d_timer->slots[i].first.prev =
+				&(d_timer->slots[i].first);
+		if(i < n) {
+			d_timer->slots[i].swept = dlg_timer_slot_tick(i, d_timer->last);
+		}
+	}
 
-	d_timer->lock = lock_alloc();
-	if(d_timer->lock == 0) {
-		LM_ERR("failed to alloc lock\n");
+	d_timer->locks = lock_set_alloc(n + 1);
+	if(d_timer->locks == 0) {
+		LM_ERR("failed to alloc slot locks\n");
 		goto error0;
 	}
-
-	if(lock_init(d_timer->lock) == 0) {
-		LM_ERR("failed to init lock\n");
+	if(lock_set_init(d_timer->locks) == 0) {
+		LM_ERR("failed to init slot locks\n");
 		goto error1;
 	}
 
+	d_timer->tl_locks = lock_set_alloc(DLG_TIMER_TL_LOCKS);
+	if(d_timer->tl_locks == 0) {
+		LM_ERR("failed to alloc link locks\n");
+		goto error2;
+	}
+	if(lock_set_init(d_timer->tl_locks) == 0) {
+		LM_ERR("failed to init link locks\n");
+		goto error3;
+	}
+
+	LM_DBG("dialog timer wheel with %u slots\n", n);
 	timer_hdl = hdl;
 	return 0;
+error3:
+	lock_set_dealloc(d_timer->tl_locks);
+error2:
+	lock_set_destroy(d_timer->locks);
 error1:
-	lock_dealloc(d_timer->lock);
+	lock_set_dealloc(d_timer->locks);
 error0:
 	shm_free(d_timer);
 	d_timer = 0;
@@ -86,34 +138,68 @@ void destroy_dlg_timer(void)
 	if(d_timer == 0)
 		return;
 
-	lock_destroy(d_timer->lock);
-	lock_dealloc(d_timer->lock);
+	lock_set_destroy(d_timer->tl_locks);
+	lock_set_dealloc(d_timer->tl_locks);
+	lock_set_destroy(d_timer->locks);
+	lock_set_dealloc(d_timer->locks);
 
 	shm_free(d_timer);
 	d_timer = 0;
 }
 
 
+/*!
+ * \brief Index of the lock serializing changes of a timer link
+ * \param tl dialog timer list
+ * \return lock index
+ */
+static inline unsigned int dlg_tl_lock_idx(struct dlg_tl *tl)
+{
+	return (unsigned int)(((unsigned long)tl >> 4) % DLG_TIMER_TL_LOCKS);
+}
+
+
+/*!
+ * \brief Wheel slot of a timer link, the due slot for unknown values
+ * \param tl dialog timer list
+ * \return slot index
+ */
+static inline unsigned int dlg_tl_slot(struct dlg_tl *tl)
+{
+	return (tl->slot > d_timer->size) ? d_timer->size : tl->slot;
+}
+
+
 /*!
  * \brief Helper function for insert_dialog_timer
+ * Links the timer at the end of the wheel slot matching its timeout. If
+ * that slot was already swept for the timeout tick, the timer goes to the
+ * due slot that is checked on every timer run.
  * \see insert_dialog_timer
- * \param tl dialog timer list
+ * \param tl dialog timer list, having the timeout set
  */
 static inline void insert_dialog_timer_unsafe(struct dlg_tl *tl)
 {
-	struct dlg_tl *ptr;
-
-	/* insert in sorted order */
-	for(ptr = d_timer->first.prev; ptr != &d_timer->first; ptr = ptr->prev) {
-		if(ptr->timeout <= tl->timeout)
-			break;
+	unsigned int idx;
+	dlg_timer_slot_t *slot;
+
+	idx = tl->timeout & d_timer->mask;
+	lock_set_get(d_timer->locks, idx);
+	if(tl->timeout <= d_timer->slots[idx].swept) {
+		lock_set_release(d_timer->locks, idx);
+		idx = d_timer->size;
+		lock_set_get(d_timer->locks, idx);
 	}
+	slot = &d_timer->slots[idx];
 
-	LM_DBG("inserting %p for %d\n", tl, tl->timeout);
-	tl->prev = ptr;
-	tl->next = ptr->next;
+	LM_DBG("inserting %p for %d in slot %u\n", tl, tl->timeout, idx);
+	tl->slot = idx;
+	tl->next = &slot->first;
+	tl->prev = slot->first.prev;
 	tl->prev->next = tl;
-	tl->next->prev = tl;
+	slot->first.prev = tl;
+
+	lock_set_release(d_timer->locks, idx);
 }
 
 
@@ -125,25 +211,35 @@ static inline void insert_dialog_timer_unsafe(struct dlg_tl *tl)
  */
 int insert_dlg_timer(struct dlg_tl *tl, int interval)
 {
-	lock_get(d_timer->lock);
+	unsigned int lidx;
+	unsigned int idx;
+
+	lidx = dlg_tl_lock_idx(tl);
+	lock_set_get(d_timer->tl_locks, lidx);
+	idx = dlg_tl_slot(tl);
+	lock_set_get(d_timer->locks, idx);
 
 	if((tl->next == 0) != (tl->prev == 0)) {
 		/* only one of next/prev set => genuinely corrupt link */
 		LM_CRIT("Trying to insert a bogus dlg tl=%p tl->next=%p tl->prev=%p\n",
 				tl, tl->next, tl->prev);
-		lock_release(d_timer->lock);
+		lock_set_release(d_timer->locks, idx);
+		lock_set_release(d_timer->tl_locks, lidx);
 		return -1;
 	}
 	if(tl->next != 0) {
 		/* already linked - nothing to insert */
-		lock_release(d_timer->lock);
+		lock_set_release(d_timer->locks, idx);
+		lock_set_release(d_timer->tl_locks, lidx);
 		LM_NOTICE("dlg timer already linked on insert - skipped tl=%p\n", tl);
 		return 1;
 	}
+	lock_set_release(d_timer->locks, idx);
+
 	tl->timeout = get_ticks() + interval;
 	insert_dialog_timer_unsafe(tl);
 
-	lock_release(d_timer->lock);
+	lock_set_release(d_timer->tl_locks, lidx);
 
 	return 0;
 }
@@ -169,17 +265,25 @@ static inline void remove_dialog_timer_unsafe(struct dlg_tl *tl)
  */
 int remove_dialog_timer(struct dlg_tl *tl)
 {
-	lock_get(d_timer->lock);
+	unsigned int lidx;
+	unsigned int idx;
+
+	lidx = dlg_tl_lock_idx(tl);
+	lock_set_get(d_timer->tl_locks, lidx);
+	idx = dlg_tl_slot(tl);
+	lock_set_get(d_timer->locks, idx);
 
 	if(tl->prev == NULL && tl->timeout == 0) {
-		lock_release(d_timer->lock);
+		lock_set_release(d_timer->locks, idx);
+		lock_set_release(d_timer->tl_locks, lidx);
 		return 1;
 	}
 
 	if(tl->prev == NULL || tl->next == NULL) {
 		LM_CRIT("bogus tl=%p tl->prev=%p tl->next=%p\n", tl, tl->prev,
 				tl->next);
-		lock_release(d_timer->lock);
+		lock_set_release(d_timer->locks, idx);
+		lock_set_release(d_timer->tl_locks, lidx);
 		return -1;
 	}
 
@@ -188,7 +292,8 @@ int remove_dialog_timer(struct dlg_tl *tl)
 	tl->prev = NULL;
 	tl->timeout = 0;
 
-	lock_release(d_timer->lock);
+	lock_set_release(d_timer->locks, idx);
+	lock_set_release(d_timer->tl_locks, lidx);
 	return 0;
 }
 
@@ -202,92 +307,106 @@ int remove_dialog_timer(struct dlg_tl *tl)
  */
 int update_dlg_timer(struct dlg_tl *tl, int timeout)
 {
-	lock_get(d_timer->lock);
+	unsigned int lidx;
+	unsigned int idx;
+
+	lidx = dlg_tl_lock_idx(tl);
+	lock_set_get(d_timer->tl_locks, lidx);
+	idx = dlg_tl_slot(tl);
+	lock_set_get(d_timer->locks, idx);
 
 	if((tl->next == 0) != (tl->prev == 0)) {
 		/* only one of next/prev set => genuinely corrupt link */
 		LM_CRIT("Trying to update a bogus dlg tl=%p tl->next=%p tl->prev=%p\n",
 				tl, tl->next, tl->prev);
-		lock_release(d_timer->lock);
+		lock_set_release(d_timer->locks, idx);
+		lock_set_release(d_timer->tl_locks, lidx);
 		return -1;
 	}
 	if(tl->next == 0) {
 		/* not linked - nothing to update */
-		lock_release(d_timer->lock);
+		lock_set_release(d_timer->locks, idx);
+		lock_set_release(d_timer->tl_locks, lidx);
 		LM_NOTICE("dlg timer not linked on update - skipped tl=%p\n", tl);
 		return 1;
 	}
 	remove_dialog_timer_unsafe(tl);
+	tl->next = NULL;
+	tl->prev = NULL;
+	lock_set_release(d_timer->locks, idx);
+
 	tl->timeout = get_ticks() + timeout;
 	insert_dialog_timer_unsafe(tl);
 
-	lock_release(d_timer->lock);
+	lock_set_release(d_timer->tl_locks, lidx);
 	return 0;
 }
 
 
 /*!
  * \brief Helper function for dlg_timer_routine
+ * Detach the expired dialogs from one wheel slot. The detached timers have
+ * prev and timeout reset and are chained via next, the last one having
+ * next set to 0.
+ * \param idx wheel slot index
+ * \param swept tick value the slot is swept for
  * \param time time for expiration check
- * \return list of expired dialogs on success, 0 on failure
+ * \return list of expired dialogs on success, 0 when none expired
  */
-static inline struct dlg_tl *get_expired_dlgs(unsigned int time)
+static inline struct dlg_tl *get_expired_dlgs(
+		unsigned int idx, unsigned int swept, unsigned int time)
 {
-	struct dlg_tl *tl, *end, *ret;
+	dlg_timer_slot_t *slot;
+	struct dlg_tl *tl, *next, *ret, *last;
 
-	lock_get(d_timer->lock);
+	slot = &d_timer->slots[idx];
+	ret = last = 0;
 
-	if(d_timer->first.next == &(d_timer->first)
-			|| d_timer->first.next->timeout > time) {
-		lock_release(d_timer->lock);
-		return 0;
+	lock_set_get(d_timer->locks, idx);
+
+	if(idx < d_timer->size) {
+		slot->swept = swept;
 	}
 
-	end = &d_timer->first;
-	tl = d_timer->first.next;
-	LM_DBG("start with tl=%p tl->prev=%p tl->next=%p (%d) at %d "
-		   "and end with end=%p end->prev=%p end->next=%p\n",
-			tl, tl->prev, tl->next, tl->timeout, time, end, end->prev,
-			end->next);
-	while(tl != end && tl->timeout <= time) {
+	for(tl = slot->first.next; tl != &slot->first; tl = next) {
+		next = tl->next;
+		if(tl->timeout > time) {
+			continue;
+		}
 		LM_DBG("getting tl=%p tl->prev=%p tl->next=%p with %d\n", tl, tl->prev,
 				tl->next, tl->timeout);
+		remove_dialog_timer_unsafe(tl);
 		tl->prev = 0;
+		tl->next = 0;
 		tl->timeout = 0;
-		tl = tl->next;
-	}
-	LM_DBG("end with tl=%p tl->prev=%p tl->next=%p and "
-		   "d_timer->first.next->prev=%p\n",
-			tl, tl->prev, tl->next, d_timer->first.next->prev);
-
-	if(tl == end && d_timer->first.next->prev) {
-		ret = 0;
-	} else {
-		ret = d_timer->first.next;
-		if(tl->prev) {
-			tl->prev->next = 0;
+		if(last) {
+			last->next = tl;
+		} else {
+			ret = tl;
 		}
-		d_timer->first.next = tl;
-		tl->prev = &d_timer->first;
+		last = tl;
 	}
 
-	lock_release(d_timer->lock);
+	lock_set_release(d_timer->locks, idx);
 
 	return ret;
 }
 
 
 /*!
- * \brief Timer routine for expiration of dialogs
- * Timer handler for expiration of dialogs, runs the global timer handler on them.
+ * \brief Helper function for dlg_timer_routine
+ * Sweep one wheel slot and run the global timer handler on the expired
+ * dialogs.
+ * \param idx wheel slot index
+ * \param swept tick value the slot is swept for
  * \param ticks time for expiration checks
- * \param attr unused
  */
-void dlg_timer_routine(unsigned int ticks, void *attr)
+static inline void dlg_timer_run_slot(
+		unsigned int idx, unsigned int swept, unsigned int ticks)
 {
 	struct dlg_tl *tl, *ctl;
 
-	tl = get_expired_dlgs(ticks);
+	tl = get_expired_dlgs(idx, swept, ticks);
 
 	while(tl) {
 		ctl = tl;
@@ -297,3 +416,34 @@ void dlg_timer_routine(unsigned int ticks, void *attr)
 		timer_hdl(ctl);
 	}
 }
+
+
+/*!
+ * \brief Timer routine for expiration of dialogs
+ * Timer handler for expiration of dialogs, runs the global timer handler on them.
+ * Only the wheel slots for the ticks passed since the previous run are
+ * checked, plus the due slot.
+ * \param ticks time for expiration checks
+ * \param attr unused
+ */
+void dlg_timer_routine(unsigned int ticks, void *attr)
+{
+	unsigned int t;
+	unsigned int i;
+
+	if(ticks > d_timer->last) {
+		if(ticks - d_timer->last >= d_timer->size) {
+			/* a full wheel turn passed - sweep all slots */
+			for(i = 0; i < d_timer->size; i++) {
+				dlg_timer_run_slot(i, dlg_timer_slot_tick(i, ticks), ticks);
+			}
+		} else {
+			for(t = d_timer->last + 1; t <= ticks; t++) {
+				dlg_timer_run_slot(t & d_timer->mask, t, ticks);
+			}
+		}
+		d_timer->last = ticks;
+	}
+
+	dlg_timer_run_slot(d_timer->size, ticks, ticks);
+}
@@ -41,14 +41,27 @@ typedef struct dlg_tl
 	struct dlg_tl *next;
 	struct dlg_tl *prev;
 	volatile unsigned int timeout; /*!< timeout in seconds */
+	unsigned int slot;			   /*!< wheel slot while linked */
 } dlg_tl_t;
 
 
-/*! dialog timer */
+/*! dialog timer wheel slot */
+typedef struct dlg_timer_slot
+{
+	struct dlg_tl first;	/*!< dialog timeout list (unsorted) */
+	unsigned int swept;		/*!< last tick the slot was swept for */
+} dlg_timer_slot_t;
+
+
+/*! dialog timer - timing wheel with per slot locks */
 typedef struct dlg_timer
 {
-	struct dlg_tl first; /*!< dialog timeout list */
-	gen_lock_t *lock;	 /*!< lock for the list */
+	unsigned int size;		   /*!< number of wheel slots (power of 2) */
+	unsigned int mask;		   /*!< size - 1 */
+	unsigned int last;		   /*!< last tick processed by timer routine */
+	dlg_timer_slot_t *slots;   /*!< wheel slots, plus the due slot at size */
+	gen_lock_set_t *locks;	   /*!< one lock per slot, plus the due slot */
+	gen_lock_set_t *tl_locks;  /*!< serialize changes of the same tl */
 } dlg_timer_t;
 
 
@@ -58,12 +71,14 @@ typedef void (*dlg_timer_handler)(struct dlg_tl *);
 
 /*!
  * \brief Initialize the dialog timer handler
- * Initialize the dialog timer handler, allocate the lock and a global
- * timer in shared memory. The global timer handler will be set on success.
+ * Initialize the dialog timer handler, allocate the locks and a global
+ * timing wheel in shared memory. The global timer handler will be set
+ * on success.
  * \param hdl dialog timer handler
+ * \param size number of wheel slots, rounded up to a power of 2
  * \return 0 on success, -1 on failure
  */
-int init_dlg_timer(dlg_timer_handler);
+int init_dlg_timer(dlg_timer_handler hdl, unsigned int size);
 
 
 /*!
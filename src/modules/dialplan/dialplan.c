@@ -94,6 +94,7 @@ dp_param_p dp_default_par2 = NULL;
 
 int dp_fetch_rows = 1000;
 int dp_match_dynamic = 0;
+int dp_match_compiled = 0;
 int dp_append_branch = 1;
 int dp_reload_delta = 5;
 
@@ -113,6 +114,7 @@ static param_export_t mod_params[]={
 	{ "attrs_pvar",	    PARAM_STR,	&dp_attr_pvar_s },
 	{ "fetch_rows",		PARAM_INT,	&dp_fetch_rows },
 	{ "match_dynamic",	PARAM_INT,	&dp_match_dynamic },
+	{ "match_compiled",	PARAM_INT,	&dp_match_compiled },
 	{ "append_branch",	PARAM_INT,	&dp_append_branch },
 	{ "reload_delta",	PARAM_INT,	&dp_reload_delta },
 	{0,0,0}
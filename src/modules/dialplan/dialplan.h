@@ -46,6 +46,8 @@
 #define DP_TFLAGS_PV_MATCH (1 << 0)
 #define DP_TFLAGS_PV_SUBST (1 << 1)
 
+#define DP_MGROUP_MAX 1024
+
 extern pcre2_general_context *dpl_gctx;
 extern pcre2_compile_context *dpl_ctx;
 
@@ -63,6 +65,8 @@ typedef struct dpl_node
 	struct subst_expr *repl_comp; /* compiled replacement */
 	str attrs;					  /* attributes string */
 	unsigned int tflags;		  /* flags for type of values for matching */
+	pcre2_code *mgroup_comp;	  /* combined match of the next rules */
+	int mgroup_size;			  /* number of rules in mgroup_comp */
 
 	struct dpl_node *next; /* next rule */
 } dpl_node_t, *dpl_node_p;
@@ -52,6 +52,7 @@ str attrs_column = str_init(ATTRS_COL);
 
 extern int dp_fetch_rows;
 extern int dp_match_dynamic;
+extern int dp_match_compiled;
 
 static db1_con_t *dp_db_handle = 0; /* database connection handle */
 static db_func_t dp_dbf;
@@ -76,6 +77,7 @@ int add_rule2hash(dpl_node_t *, int);
 
 void list_rule(dpl_node_t *);
 void list_hash(int h_index);
+static void dpl_build_mgroups(int h_index);
 
 
 static dpl_id_p *dp_rules_hash = NULL;
@@ -358,6 +360,9 @@ int dp_load_db(void)
 		}
 	} while(RES_ROW_N(res) > 0);
 
+	if(dp_match_compiled) {
+		dpl_build_mgroups(*dp_next_idx);
+	}
 
 end:
 	/*update data*/
@@ -676,6 +681,212 @@ err:
 }
 
 
+/* check if the match expression keeps its meaning when wrapped as one branch
+ * of a combined expression - no back references, recursion, named groups,
+ * verbs, callouts, quoting or extended mode comments */
+static int dpl_mgroup_supported(str *exp)
+{
+	char *p;
+	char *end;
+
+	end = exp->s + exp->len;
+	for(p = exp->s; p < end - 1; p++) {
+		if(*p == '\\') {
+			p++;
+			if((*p >= '0' && *p <= '9') || *p == 'g' || *p == 'k' || *p == 'G'
+					|| *p == 'K' || *p == 'Q')
+				return 0;
+			continue;
+		}
+		if(*p != '(')
+			continue;
+		if(p[1] == '*')
+			return 0;
+		if(p[1] != '?')
+			continue;
+		if(p + 2 >= end)
+			return 0;
+		switch(p[2]) {
+			case ':':
+			case '=':
+			case '!':
+			case '>':
+				break;
+			case '<':
+				if(p + 3 >= end || (p[3] != '=' && p[3] != '!'))
+					return 0;
+				break;
+			case '#':
+				break;
+			default:
+				/* inline options, only without extended mode - this also
+				 * rejects (?R), (?C...), (?1), (?P...), (?| and (?( */
+				for(p += 2; p < end && *p != ')' && *p != ':'; p++) {
+					if(*p == '\0' || strchr("imnsJU-^", *p) == NULL)
+						return 0;
+				}
+				p--;
+		}
+	}
+	return 1;
+}
+
+/* an expression starting with ^, without alternation and multiline option,
+ * can only match at the start of the input */
+static int dpl_mgroup_anchored(str *exp)
+{
+	char *p;
+	char *end;
+
+	if(exp->len < 1 || exp->s[0] != '^')
+		return 0;
+	end = exp->s + exp->len;
+	for(p = exp->s; p < end; p++) {
+		if(*p == '|')
+			return 0;
+		if(*p != '(' || p + 1 >= end || p[1] != '?')
+			continue;
+		for(p += 2; p < end && *p != ')' && *p != ':'; p++) {
+			if(*p == 'm')
+				return 0;
+		}
+		p--;
+	}
+	return 1;
+}
+
+/* only anchored expressions are combined - an unanchored one would be a
+ * branch scanning the input from each position, slower than its own
+ * pcre2_match() with the start of match optimizations */
+static int dpl_mgroup_rule(dpl_node_t *rule)
+{
+	return (rule->matchop == DP_REGEX_OP && rule->match_comp != NULL
+			&& !(rule->tflags & DP_TFLAGS_PV_MATCH)
+			&& dpl_mgroup_anchored(&rule->match_exp)
+			&& dpl_mgroup_supported(&rule->match_exp));
+}
+
+#define DP_MGROUP_HEAD "^(?:"
+#define DP_MGROUP_BRANCH_START "(?=(?:"
+#define DP_MGROUP_BRANCH_END "))(*MARK:"
+
+/* compile one expression matching at the first rule of the group and
+ * telling through the mark which of the size rules is the first to match.
+ * This is not a single pass over the input: the branches are tried in
+ * priority order inside one pcre2_match() call, each one from the start of
+ * the input, so the gain is the per rule match call and setup, and the
+ * branches failing on their first characters */
+static pcre2_code *dpl_mgroup_comp(dpl_node_t *first, int size)
+{
+	dpl_node_t *rule;
+	pcre2_code *re;
+	char *pattern;
+	char *p;
+	int len, i;
+	int pcre_error_num = 0;
+	size_t pcre_erroffset;
+
+	len = sizeof(DP_MGROUP_HEAD) + 1;
+	for(rule = first, i = 0; i < size; rule = rule->next, i++) {
+		len += rule->match_exp.len + sizeof(DP_MGROUP_BRANCH_START)
+			   + sizeof(DP_MGROUP_BRANCH_END) + INT2STR_MAX_LEN + 2;
+	}
+	pattern = (char *)pkg_malloc(len);
+	if(pattern == NULL) {
+		PKG_MEM_ERROR;
+		return NULL;
+	}
+	p = pattern;
+	memcpy(p, DP_MGROUP_HEAD, sizeof(DP_MGROUP_HEAD) - 1);
+	p += sizeof(DP_MGROUP_HEAD) - 1;
+	for(rule = first, i = 0; i < size; rule = rule->next, i++) {
+		if(i > 0)
+			*p++ = '|';
+		p += sprintf(p, "%s%.*s%s%d)", DP_MGROUP_BRANCH_START,
+				rule->match_exp.len, rule->match_exp.s, DP_MGROUP_BRANCH_END,
+				i);
+	}
+	*p++ = ')';
+	*p = '\0';
+
+	re = pcre2_compile((PCRE2_SPTR)pattern, PCRE2_ZERO_TERMINATED, 0,
+			&pcre_error_num, &pcre_erroffset, dpl_ctx);
+	if(re == NULL) {
+		LM_DBG("cannot combine %d rules - pcre2 error %d at offset %zu\n",
+				size, pcre_error_num, pcre_erroffset);
+	}
+	pkg_free(pattern);
+	return re;
+}
+
+/* combine the size rules starting with first, in as few groups as possible:
+ * a group that does not compile (e.g., over the pcre2 compiled size limit)
+ * is halved until it does, returning the number of groups */
+static int dpl_mgroup_set(dpl_node_t *first, int size)
+{
+	int part;
+	int n = 0;
+
+	while(size > 1) {
+		for(part = size; part > 1; part /= 2) {
+			first->mgroup_comp = dpl_mgroup_comp(first, part);
+			if(first->mgroup_comp != NULL)
+				break;
+		}
+		if(part > 1) {
+			first->mgroup_size = part;
+			n++;
+		}
+		size -= part;
+		for(; part > 0; part--) {
+			first = first->next;
+		}
+	}
+	return n;
+}
+
+/* group consecutive regular expression rules of each index, so that the
+ * first matching one is found with a single pcre2 match */
+static void dpl_build_mgroups(int h_index)
+{
+	dpl_id_p idp;
+	dpl_index_p indexp;
+	dpl_node_p rulep;
+	dpl_node_p first;
+	int size;
+	int ngroups = 0;
+
+	for(idp = dp_rules_hash[h_index]; idp != NULL; idp = idp->next) {
+		for(indexp = idp->first_index; indexp != NULL; indexp = indexp->next) {
+			first = NULL;
+			size = 0;
+			for(rulep = indexp->first_rule;; rulep = rulep->next) {
+				if(rulep != NULL && size < DP_MGROUP_MAX
+						&& dpl_mgroup_rule(rulep)) {
+					if(first == NULL)
+						first = rulep;
+					size++;
+					continue;
+				}
+				if(size > 1) {
+					ngroups += dpl_mgroup_set(first, size);
+				}
+				first = NULL;
+				size = 0;
+				if(rulep == NULL)
+					break;
+				if(dpl_mgroup_rule(rulep)) {
+					/* size limit reached - start the next group */
+					first = rulep;
+					size = 1;
+				}
+			}
+		}
+	}
+	LM_DBG("built %d combined match expressions\n", ngroups);
+}
+
+
 void destroy_hash(int index)
 {
 	dpl_id_p crt_idp;
@@ -728,6 +939,9 @@ void destroy_rule(dpl_node_t *rule)
 	if(rule->subst_comp)
 		pcre2_code_free(rule->subst_comp);
 
+	if(rule->mgroup_comp)
+		pcre2_code_free(rule->mgroup_comp);
+
 	/*destroy repl_exp*/
 	if(rule->repl_comp)
 		repl_expr_free(rule->repl_comp);
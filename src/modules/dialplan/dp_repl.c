@@ -601,8 +601,9 @@ int dp_translate_helper(
 	static pcre2_match_data *pcre_md = NULL;
 	dpl_node_p rulep;
 	dpl_index_p indexp;
-	int user_len, rez;
+	int user_len, rez, n;
 	char b;
+	PCRE2_SPTR mark;
 	dpl_dyn_pcre_p re_list = NULL;
 	dpl_dyn_pcre_p rt = NULL;
 
@@ -631,6 +632,28 @@ int dp_translate_helper(
 
 search_rule:
 	for(rulep = indexp->first_rule; rulep != NULL; rulep = rulep->next) {
+		if(rulep->mgroup_comp != NULL) {
+			/* one match for the group, the mark is the first matching rule */
+			LM_DBG("combined regex testing of %d rules over [%.*s]\n",
+					rulep->mgroup_size, input->len, input->s);
+			rez = pcre2_match(rulep->mgroup_comp, (PCRE2_SPTR)input->s,
+					(PCRE2_SIZE)input->len, 0, 0, pcre_md, 0);
+			if(rez >= 0) {
+				mark = pcre2_get_mark(pcre_md);
+				for(n = 0; mark != NULL && *mark >= '0' && *mark <= '9';
+						mark++) {
+					n = n * 10 + (*mark - '0');
+				}
+				for(; n > 0 && rulep->next != NULL; n--) {
+					rulep = rulep->next;
+				}
+				goto repl;
+			}
+			for(n = rulep->mgroup_size; n > 1 && rulep->next != NULL; n--) {
+				rulep = rulep->next;
+			}
+			continue;
+		}
 		switch(rulep->matchop) {
 
 			case DP_REGEX_OP:
@@ -58,8 +58,11 @@
 #include "../../core/kemi.h"
 #include "../../core/fmsg.h"
 #include "../../core/rand/ksrxrand.h"
+#include "../../core/hashes.h"
+#include "../../core/atomic_ops.h"
 
 #include "ds_ht.h"
+#include "ds_hmap.h"
 #include "api.h"
 #include "dispatch.h"
 
@@ -94,22 +97,25 @@
 #define DS_MATCHED_SOCK (1 << 3)
 
 /* increment call load */
-#define DS_LOAD_INC(dgrp, didx)      \
-	do {                             \
-		lock_get(&(dgrp)->lock);     \
-		(dgrp)->dlist[didx].dload++; \
-		lock_release(&(dgrp)->lock); \
+#define DS_LOAD_INC(dgrp, didx) atomic_inc_int(&(dgrp)->dlist[didx].dload)
+
+/* decrement call load, if not zero */
+#define DS_LOAD_DEC(dgrp, didx)                                   \
+	do {                                                          \
+		int *_dl = &(dgrp)->dlist[didx].dload;                    \
+		int _dv;                                                  \
+		do {                                                      \
+			_dv = atomic_get_int(_dl);                            \
+		} while(likely(_dv > 0)                                   \
+				&& atomic_cmpxchg_int(_dl, _dv, _dv - 1) != _dv); \
 	} while(0)
 
-/* decrement call load */
-#define DS_LOAD_DEC(dgrp, didx)                     \
-	do {                                            \
-		lock_get(&(dgrp)->lock);                    \
-		if(likely((dgrp)->dlist[didx].dload > 0)) { \
-			(dgrp)->dlist[didx].dload--;            \
-		}                                           \
-		lock_release(&(dgrp)->lock);                \
-	} while(0)
+/* latency used by selection, published for reading without lock */
+#define DS_DEST_LATENCY(dp)                                           \
+	((dp)->attrs.congestion_control                                   \
+					? (int)((dp)->latency_stats.estimate              \
+							- (dp)->latency_stats.average)            \
+					: (int)(dp)->latency_stats.estimate)
 
 static int _ds_table_version = DS_TABLE_VERSION;
 
@@ -633,6 +639,34 @@ static inline int ds_oc_skip(ds_set_t *dsg, int alg, int n)
 	return ret;
 }
 
+/**
+ * allocate n destination items, zeroed and aligned to a cache line - the
+ * start of the shm chunk is stored before the first item
+ */
+static ds_dest_t *ds_dest_alloc(int n)
+{
+	char *p;
+	char *a;
+
+	p = (char *)shm_malloc(
+			n * sizeof(ds_dest_t) + sizeof(void *) + DS_CACHELINE_SIZE - 1);
+	if(p == NULL)
+		return NULL;
+	a = (char *)(((unsigned long)p + sizeof(void *) + DS_CACHELINE_SIZE - 1)
+				 & ~((unsigned long)DS_CACHELINE_SIZE - 1));
+	((void **)a)[-1] = p;
+	memset(a, 0, n * sizeof(ds_dest_t));
+	return (ds_dest_t *)a;
+}
+
+/**
+ * free destination items allocated with ds_dest_alloc()
+ */
+static void ds_dest_free(ds_dest_t *dp)
+{
+	shm_free(((void **)dp)[-1]);
+}
+
 /**
  *
  */
@@ -686,12 +720,11 @@ ds_dest_t *pack_dest(str iuri, int flags, int priority, str *attrs, int dload)
 	}
 
 	/* store uri */
-	dp = (ds_dest_t *)shm_malloc(sizeof(ds_dest_t));
+	dp = ds_dest_alloc(1);
 	if(dp == NULL) {
 		SHM_MEM_ERROR;
 		goto err;
 	}
-	memset(dp, 0, sizeof(ds_dest_t));
 
 	dp->uri.s = (char *)shm_malloc((uri.len + 1) * sizeof(char));
 	if(dp->uri.s == NULL) {
@@ -839,7 +872,7 @@ err:
 			shm_free(dp->uri.s);
 		if(dp->attrs.body.s != NULL)
 			shm_free(dp->attrs.body.s);
-		shm_free(dp);
+		ds_dest_free(dp);
 	}
 
 	return NULL;
@@ -881,7 +914,10 @@ static ds_dest_t *add_dest2list(int id, str uri, int flags, int priority,
 		dp->latency_stats.estimate = latency_stats->estimate;
 		dp->latency_stats.count = latency_stats->count;
 		dp->latency_stats.timeout = latency_stats->timeout;
+		memcpy(dp->latency_stats.rtt_hist, latency_stats->rtt_hist,
+				sizeof(dp->latency_stats.rtt_hist));
 	}
+	dp->latency = DS_DEST_LATENCY(dp);
 
 	sp = ds_avl_insert(&list->head, id, &list->nr);
 	if(!sp) {
@@ -927,7 +963,7 @@ error:
 			shm_free(dp->uri.s);
 		if(dp->attrs.body.s != NULL)
 			shm_free(dp->attrs.body.s);
-		shm_free(dp);
+		ds_dest_free(dp);
 	}
 
 	return NULL;
@@ -1248,12 +1284,11 @@ static int reindex_dests(ds_set_t *node)
 
 	ds_dest_t *dp = NULL, *dp0 = NULL;
 
-	dp0 = (ds_dest_t *)shm_malloc(node->nr * sizeof(ds_dest_t));
+	dp0 = ds_dest_alloc(node->nr);
 	if(dp0 == NULL) {
 		SHM_MEM_ERROR;
 		goto err1;
 	}
-	memset(dp0, 0, node->nr * sizeof(ds_dest_t));
 
 	/* copy from the old pointer to destination, and then free it */
 	for(j = node->nr - 1; j >= 0 && node->dlist != NULL; j--) {
@@ -1267,13 +1302,15 @@ static int reindex_dests(ds_set_t *node)
 		dp = node->dlist;
 		node->dlist = dp->next;
 
-		shm_free(dp);
+		ds_dest_free(dp);
 		dp = NULL;
 	}
 	node->dlist = dp0;
 	dp_init_weights(node);
 	dp_init_relative_weights(node);
 	dp_init_priority_weights(node);
+	if(ds_hmap_build(node) != 0)
+		goto err1;
 
 	return 0;
 
@@ -2204,22 +2241,21 @@ int ds_get_leastloaded(ds_set_t *dset)
 	int j;
 	int k;
 	int t;
+	int l;
 
 	k = -1;
 	t = 0x7fffffff; /* high load */
-	lock_get(&dset->lock);
 	for(j = 0; j < dset->nr; j++) {
-		if(!ds_skip_dst(dset->dlist[j].flags)
-				&& (dset->dlist[j].attrs.maxload == 0
-						|| dset->dlist[j].dload
-								   < dset->dlist[j].attrs.maxload)) {
-			if(dset->dlist[j].dload < t) {
-				k = j;
-				t = dset->dlist[k].dload;
-			}
+		if(ds_skip_dst(atomic_get_int(&dset->dlist[j].flags)))
+			continue;
+		l = atomic_get_int(&dset->dlist[j].dload);
+		if((dset->dlist[j].attrs.maxload == 0
+				   || l < dset->dlist[j].attrs.maxload)
+				&& l < t) {
+			k = j;
+			t = l;
 		}
 	}
-	lock_release(&dset->lock);
 	return k;
 }
 
@@ -3021,10 +3057,12 @@ void ds_sorted_by_priority(sorted_ds_t *sorted_ds, int size)
 
 int ds_manage_route_algo13(ds_set_t *idx, ds_select_state_t *rstate)
 {
-	int hash = idx->last;
+	int last = atomic_get_int(&idx->last);
+	int hash = last;
 	int y = 0;
 	int z = hash;
 	int active_priority = 0;
+	int rpriority = 0;
 	sorted_ds_t *ds_sorted = pkg_malloc(sizeof(sorted_ds_t) * idx->nr);
 	if(ds_sorted == NULL) {
 		PKG_MEM_ERROR;
@@ -3035,34 +3073,32 @@ int ds_manage_route_algo13(ds_set_t *idx, ds_select_state_t *rstate)
 		int latency_priority_handicap = 0;
 		ds_dest_t *ds_dest = &idx->dlist[z];
 		int gw_priority = ds_dest->priority;
-		int gw_latency = ds_dest->latency_stats.estimate;
-		int gw_inactive = ds_skip_dst(ds_dest->flags);
+		int gw_flags = atomic_get_int(&ds_dest->flags);
 		// if cc is enabled, the latency is the congestion ms instead of the estimated latency.
-		if(ds_dest->attrs.congestion_control)
-			gw_latency = ds_dest->latency_stats.estimate
-						 - ds_dest->latency_stats.average;
+		int gw_latency = atomic_get_int(&ds_dest->latency);
+		int gw_inactive = ds_skip_dst(gw_flags);
 		if(!gw_inactive) {
 			if(gw_latency > gw_priority && gw_priority > 0)
 				latency_priority_handicap = gw_latency / gw_priority;
-			ds_dest->attrs.rpriority = gw_priority - latency_priority_handicap;
-			if(ds_dest->attrs.rpriority < 1 && gw_priority > 0)
-				ds_dest->attrs.rpriority = 1;
+			rpriority = gw_priority - latency_priority_handicap;
+			if(rpriority < 1 && gw_priority > 0)
+				rpriority = 1;
 			ds_sorted[y].idx = z;
-			ds_sorted[y].priority = ds_dest->attrs.rpriority;
+			ds_sorted[y].priority = rpriority;
 			LM_DBG("[active][%d]idx[%d]uri[%.*s]priority[%d-%d=%d]latency[%dms]"
 				   "flag[%d]\n",
 					y, z, ds_dest->uri.len, ds_dest->uri.s, gw_priority,
-					latency_priority_handicap, ds_dest->attrs.rpriority,
-					gw_latency, ds_dest->flags);
+					latency_priority_handicap, rpriority, gw_latency,
+					gw_flags);
 		} else {
 			ds_sorted[y].idx = -1;
 			ds_sorted[y].priority = -1;
 			LM_DBG("[inactive][%d]idx[%d]uri[%.*s]priority[%d]latency[%dms]"
 				   "flag[%d]\n",
 					y, -1, ds_dest->uri.len, ds_dest->uri.s, gw_priority,
-					gw_latency, ds_dest->flags);
+					gw_latency, gw_flags);
 		}
-		ds_sorted[y].flags = ds_dest->flags;
+		ds_sorted[y].flags = gw_flags;
 		ds_sorted[y].dest = ds_dest;
 
 		if(ds_use_default != 0 && idx->nr != 1)
@@ -3077,9 +3113,10 @@ int ds_manage_route_algo13(ds_set_t *idx, ds_select_state_t *rstate)
 		active_priority = ds_sorted[0].priority;
 	}
 	ds_manage_routes_fill_reordered_xavp(ds_sorted, idx, rstate);
-	idx->last = (hash + 1) % idx->nr;
+	/* advance the start index, if not updated meanwhile */
+	atomic_cmpxchg_int(&idx->last, last, (hash + 1) % idx->nr);
 	LM_DBG("priority[%d]gateway_selected[%d]next_index[%d]\n", active_priority,
-			hash, idx->last);
+			hash, (hash + 1) % idx->nr);
 	pkg_free(ds_sorted);
 	return hash;
 }
@@ -3097,6 +3134,7 @@ int ds_manage_routes(
 	int vlast = 0;
 	int valg = 0;
 	int xavp_filled = 0;
+	int hmap = 0;
 	ds_list_t *list;
 
 	if(msg == NULL) {
@@ -3144,24 +3182,28 @@ int ds_manage_routes(
 				LM_ERR("can't get callid hash\n");
 				goto error;
 			}
+			hmap = 1;
 			break;
 		case DS_ALG_HASHFROMURI: /* 1 - hash from-uri */
 			if(ds_hash_fromuri(msg, &hash) != 0) {
 				LM_ERR("can't get From uri hash\n");
 				goto error;
 			}
+			hmap = 1;
 			break;
 		case DS_ALG_HASHTOURI: /* 2 - hash to-uri */
 			if(ds_hash_touri(msg, &hash) != 0) {
 				LM_ERR("can't get To uri hash\n");
 				goto error;
 			}
+			hmap = 1;
 			break;
 		case DS_ALG_HASHRURI: /* 3 - hash r-uri */
 			if(ds_hash_ruri(msg, &hash) != 0) {
 				LM_ERR("can't get ruri hash\n");
 				goto error;
 			}
+			hmap = 1;
 			break;
 		case DS_ALG_ROUNDROBIN: /* 4 - round robin */
 			lock_get(&idx->lock);
@@ -3176,6 +3218,7 @@ int ds_manage_routes(
 			switch(i) {
 				case 0:
 					/* Authorization-Header found: Nothing to be done here */
+					hmap = 1;
 					break;
 				case 1:
 					/* No Authorization found: Use round robin */
@@ -3199,6 +3242,7 @@ int ds_manage_routes(
 				LM_ERR("can't get PV hash\n");
 				goto error;
 			}
+			hmap = 1;
 			break;
 		case DS_ALG_SERIAL: /* 8 - use always first entry */
 			hash = 0;
@@ -3246,9 +3290,7 @@ int ds_manage_routes(
 			hash = 0;
 			break;
 		case DS_ALG_LATENCY: /* 13 - latency optimized round-robin with failover */
-			lock_get(&idx->lock);
 			hash = ds_manage_route_algo13(idx, rstate);
-			lock_release(&idx->lock);
 			if(hash == -1) {
 				goto error;
 			}
@@ -3277,7 +3319,20 @@ int ds_manage_routes(
 
 	LM_DBG("using alg [%d] hash [%u]\n", rstate->alg, hash);
 
-	if(ds_use_default != 0 && idx->nr != 1)
+	if(hmap && ds_hash_mapping != DS_HMAP_MODULO) {
+		/* mapping to an active destination, keeping the others in place */
+		i = ds_hmap_lookup(idx, hash);
+		if(i < 0) {
+			if(ds_use_default == 0 || idx->nr == 1) {
+				goto error;
+			}
+			i = idx->nr - 1;
+			if(ds_skip_dst(idx->dlist[i].flags)) {
+				goto error;
+			}
+		}
+		hash = i;
+	} else if(ds_use_default != 0 && idx->nr != 1)
 		hash = hash % (idx->nr - 1);
 	else
 		hash = hash % idx->nr;
@@ -3760,6 +3815,7 @@ static inline void latency_stats_update(
 		ds_latency_stats_t *latency_stats, int latency)
 {
 	int training_count = 10000;
+	int i;
 
 	/* after 2^21 ~24 days at 1s interval, the average becomes a weighted average */
 	if(latency_stats->count < 2097152) {
@@ -3792,6 +3848,11 @@ static inline void latency_stats_update(
 		latency_stats->stdev =
 				sqrt(latency_stats->m2 / _VOR1(latency_stats->count - 1));
 	}
+	/* histogram of round trip times - bucket i is for [2^(i-1), 2^i) ms */
+	for(i = 0; i < DS_RTT_HIST_SIZE - 1 && latency >= (1 << i); i++)
+		;
+	if(latency_stats->rtt_hist[i] < UINT32_MAX)
+		latency_stats->rtt_hist[i]++;
 	/* exponentially weighted moving average */
 	if(latency_stats->count < 10) {
 		latency_stats->estimate = latency_stats->average;
@@ -3863,7 +3924,9 @@ int ds_update_latency(int group, str *address, int code)
 		LM_ERR("destination set [%d] not found\n", group);
 		return -1;
 	}
-	lock_get(&idx->lock);
+	/* stats are updated only by replies to keepalives, the selection reads
+	 * the published latency and does not wait for this lock */
+	lock_get(&idx->slock);
 	while(i < idx->nr) {
 		ds_dest_t *ds_dest = &idx->dlist[i];
 		ds_latency_stats_t *latency_stats = &ds_dest->latency_stats;
@@ -3890,8 +3953,10 @@ int ds_update_latency(int group, str *address, int code)
 			gettimeofday(&now, NULL);
 			latency_ms = (now.tv_sec - latency_stats->start.tv_sec) * 1000
 						 + (now.tv_usec - latency_stats->start.tv_usec) / 1000;
-			if(code != 408)
+			if(code != 408) {
 				latency_stats_update(latency_stats, latency_ms);
+				atomic_set_int(&ds_dest->latency, DS_DEST_LATENCY(ds_dest));
+			}
 
 			LM_DBG("[%d]latency[%d]avg[%.2f][%.*s]code[%d]rweight[%d]\n",
 					latency_stats->count, latency_ms, latency_stats->average,
@@ -3950,7 +4015,7 @@ int ds_update_latency(int group, str *address, int code)
 		}
 	}
 
-	lock_release(&idx->lock);
+	lock_release(&idx->slock);
 	if(cc.enabled && cc.apply_rweights) {
 		dp_init_relative_weights(idx);
 		dp_init_priority_weights(idx);
@@ -4013,6 +4078,7 @@ int ds_update_state(sip_msg_t *msg, int group, str *address, str *iuid,
 {
 	int i = 0;
 	int old_state = 0;
+	int new_state = 0;
 	int init_state = 0;
 	ds_set_t *idx = NULL;
 	str *fmatch;
@@ -4048,10 +4114,12 @@ int ds_update_state(sip_msg_t *msg, int group, str *address, str *iuid,
 		if(fmatch->len == vmatch->len
 				&& strncasecmp(fmatch->s, vmatch->s, vmatch->len) == 0) {
 			/* destination address found */
-			old_state = idx->dlist[i].flags;
+			old_state = atomic_get_int(&idx->dlist[i].flags);
 
-			/* reset the bits used for states */
-			idx->dlist[i].flags &= ~(DS_STATES_ALL);
+			/* reset the bits used for states - the new flags are built
+			 * locally and published at once, selection never sees
+			 * intermediate values */
+			new_state = old_state & ~(DS_STATES_ALL);
 
 			/* we need the initial state for inactive counter */
 			init_state = state;
@@ -4065,9 +4133,9 @@ int ds_update_state(sip_msg_t *msg, int group, str *address, str *iuid,
 
 			/* set the new states */
 			if(state & DS_DISABLED_DST) {
-				idx->dlist[i].flags |= DS_DISABLED_DST;
+				new_state |= DS_DISABLED_DST;
 			} else {
-				idx->dlist[i].flags |= state;
+				new_state |= state;
 			}
 
 			if(state & DS_TRYING_DST) {
@@ -4078,8 +4146,8 @@ int ds_update_state(sip_msg_t *msg, int group, str *address, str *iuid,
 				if((mode & DS_STATE_MODE_SET)
 						|| (idx->dlist[i].probing_count >= probing_threshold)) {
 					/* Destination has too many lost messages.. Bringing it to inactive state */
-					idx->dlist[i].flags &= ~DS_TRYING_DST;
-					idx->dlist[i].flags |= DS_INACTIVE_DST;
+					new_state &= ~DS_TRYING_DST;
+					new_state |= DS_INACTIVE_DST;
 					idx->dlist[i].probing_count = 0;
 					LM_DBG("deactivate destination, threshold %d reached\n",
 							probing_threshold);
@@ -4093,10 +4161,10 @@ int ds_update_state(sip_msg_t *msg, int group, str *address, str *iuid,
 							&& (idx->dlist[i].probing_count
 									< inactive_threshold)) {
 						/* Destination has not enough successful replies.. Leaving it into inactive state */
-						idx->dlist[i].flags |= DS_INACTIVE_DST;
+						new_state |= DS_INACTIVE_DST;
 						/* if destination was in probing state, we stay there for now */
 						if((old_state & DS_PROBING_DST) != 0) {
-							idx->dlist[i].flags |= DS_PROBING_DST;
+							new_state |= DS_PROBING_DST;
 						}
 						LM_DBG("destination replied successful %d times, "
 							   "threshold %d\n",
@@ -4112,7 +4180,7 @@ int ds_update_state(sip_msg_t *msg, int group, str *address, str *iuid,
 					idx->dlist[i].probing_count = 0;
 				}
 			}
-
+			atomic_set_int(&idx->dlist[i].flags, new_state);
 
 			if((ds_event_callback_mode == DS_EVRTMODE_RUNTIME)
 					|| (ds_event_callback_mode == DS_EVRTMODE_INIT)
@@ -4138,6 +4206,7 @@ int ds_update_state(sip_msg_t *msg, int group, str *address, str *iuid,
 			if(idx->dlist[i].attrs.rweight > 0)
 				ds_reinit_rweight_on_state_change(
 						old_state, idx->dlist[i].flags, idx);
+			ds_hmap_state_change(old_state, idx->dlist[i].flags, idx);
 
 			ds_put_list(list);
 			LM_DBG("old state was %d, set new state to %d\n", old_state,
@@ -4307,15 +4376,15 @@ int ds_reinit_state(int group, str *address, str *iuid, int state)
 		}
 		if(fmatch->len == vmatch->len
 				&& strncasecmp(fmatch->s, vmatch->s, vmatch->len) == 0) {
-			int old_state = idx->dlist[i].flags;
-			/* reset the bits used for states */
-			idx->dlist[i].flags &= ~(DS_STATES_ALL);
-			/* set the new states */
-			idx->dlist[i].flags |= state;
+			int old_state = atomic_get_int(&idx->dlist[i].flags);
+			/* set the new states, keeping the other bits */
+			atomic_set_int(&idx->dlist[i].flags,
+					(old_state & ~(DS_STATES_ALL)) | state);
 			if(idx->dlist[i].attrs.rweight > 0) {
 				ds_reinit_rweight_on_state_change(
 						old_state, idx->dlist[i].flags, idx);
 			}
+			ds_hmap_state_change(old_state, idx->dlist[i].flags, idx);
 
 			ds_put_list(list);
 			return 0;
@@ -4354,15 +4423,15 @@ int ds_reinit_duid_state(int group, str *vduid, int state)
 		if(idx->dlist[i].attrs.duid.len == vduid->len
 				&& strncasecmp(idx->dlist[i].attrs.duid.s, vduid->s, vduid->len)
 						   == 0) {
-			int old_state = idx->dlist[i].flags;
-			/* reset the bits used for states */
-			idx->dlist[i].flags &= ~(DS_STATES_ALL);
-			/* set the new states */
-			idx->dlist[i].flags |= state;
+			int old_state = atomic_get_int(&idx->dlist[i].flags);
+			/* set the new states, keeping the other bits */
+			atomic_set_int(&idx->dlist[i].flags,
+					(old_state & ~(DS_STATES_ALL)) | state);
 			if(idx->dlist[i].attrs.rweight > 0) {
 				ds_reinit_rweight_on_state_change(
 						old_state, idx->dlist[i].flags, idx);
 			}
+			ds_hmap_state_change(old_state, idx->dlist[i].flags, idx);
 
 			ds_put_list(list);
 			return 0;
@@ -4398,16 +4467,17 @@ int ds_reinit_state_all(int group, int state)
 	}
 
 	for(i = 0; i < idx->nr; i++) {
-		int old_state = idx->dlist[i].flags;
-		/* reset the bits used for states */
-		idx->dlist[i].flags &= ~(DS_STATES_ALL);
-		/* set the new states */
-		idx->dlist[i].flags |= state;
+		int old_state = atomic_get_int(&idx->dlist[i].flags);
+		/* set the new states, keeping the other bits */
+		atomic_set_int(&idx->dlist[i].flags,
+				(old_state & ~(DS_STATES_ALL)) | state);
 		if(idx->dlist[i].attrs.rweight > 0) {
 			ds_reinit_rweight_on_state_change(
 					old_state, idx->dlist[i].flags, idx);
 		}
 	}
+	/* all states are the same now - rebuild the hash mapping only once */
+	ds_hmap_update(idx);
 	ds_put_list(list);
 	return 0;
 }
@@ -5012,6 +5082,31 @@ char *ds_rand_str4(void)
 	return obuf;
 }
 
+/* spreading of keepalives - each destination eligible for probing has an
+ * offset in the ping interval, the second given by its position among the
+ * eligible destinations and the ms inside the second by a hash of its uri;
+ * a timer run probes the destinations with the offset in [from, to) */
+static unsigned int _ds_ping_spread_ms = 0;
+static unsigned int _ds_ping_from = 0;
+static unsigned int _ds_ping_to = 0;
+static unsigned int _ds_ping_pos = 0;
+static unsigned int _ds_ping_seed = 0;
+static unsigned int _ds_ping_ticks = 0;
+
+/**
+ * check if the keepalive of the destination is due in this timer run
+ */
+static int ds_ping_due(ds_dest_t *dp)
+{
+	unsigned int offset;
+
+	offset = (_ds_ping_pos++ % (_ds_ping_spread_ms / 1000)) * 1000
+			 + get_hash1_raw(dp->uri.s, dp->uri.len) % 1000;
+	if(_ds_ping_from <= _ds_ping_to)
+		return (offset >= _ds_ping_from && offset < _ds_ping_to);
+	return (offset >= _ds_ping_from || offset < _ds_ping_to);
+}
+
 /**
  *
  */
@@ -5042,6 +5137,9 @@ void ds_ping_set(ds_set_t *node)
 		/* skip addresses with no-DNS-A flag */
 		if((node->dlist[j].flags & DS_NODNSARES_DST) != 0)
 			continue;
+		/* skip addresses that are not due in this run */
+		if(_ds_ping_spread_ms > 0 && !ds_ping_due(&node->dlist[j]))
+			continue;
 		/* If the Flag of the entry has "Probing set, send a probe:	*/
 		if(ds_ping_result_helper(node, j)) {
 			LM_DBG("probing set #%d, URI %.*s\n", node->id,
@@ -5137,12 +5235,10 @@ void ds_ping_set(ds_set_t *node)
 	}
 }
 
-/*! \brief
- * Timer for checking probing destinations
- *
- * This timer is regularly fired.
+/**
+ * send the keepalives due in this timer run
  */
-void ds_check_timer(unsigned int ticks, void *param)
+static void ds_ping_list(void)
 {
 	ds_list_t *list;
 
@@ -5160,11 +5256,60 @@ void ds_check_timer(unsigned int ticks, void *param)
 		return;
 	}
 
+	_ds_ping_pos = 0;
 	ds_ping_set(list->head);
 
 	ds_put_list(list);
 }
 
+/*! \brief
+ * Timer for checking probing destinations
+ *
+ * This timer is regularly fired.
+ */
+void ds_check_timer(unsigned int ticks, void *param)
+{
+	_ds_ping_spread_ms = 0;
+	ds_ping_list();
+}
+
+/*! \brief
+ * Timer for checking probing destinations spread over the ping interval
+ *
+ * This timer is fired every DS_PING_SPREAD_STEP ms, ticks are in ms and
+ * param is the ping interval in seconds.
+ */
+void ds_check_utimer(unsigned int ticks, void *param)
+{
+	unsigned int now;
+	unsigned int elapsed;
+
+	_ds_ping_spread_ms = (unsigned int)(long)param * 1000;
+	if(_ds_ping_seed == 0) {
+		/* random phase, to not align the probes of different instances */
+		_ds_ping_seed = ksr_xrand() | 1;
+		_ds_ping_ticks = ticks;
+		_ds_ping_to = (ticks + _ds_ping_seed) % _ds_ping_spread_ms;
+		return;
+	}
+
+	now = (ticks + _ds_ping_seed) % _ds_ping_spread_ms;
+	elapsed = ticks - _ds_ping_ticks;
+	_ds_ping_ticks = ticks;
+	if(elapsed == 0)
+		return;
+	if(elapsed >= _ds_ping_spread_ms) {
+		/* late by a whole interval - probe all destinations */
+		_ds_ping_from = 0;
+		_ds_ping_to = _ds_ping_spread_ms;
+	} else {
+		_ds_ping_from = _ds_ping_to;
+		_ds_ping_to = now;
+	}
+	ds_ping_list();
+	_ds_ping_to = now;
+}
+
 /*! \brief
  * Timer for checking expired items in call load dispatching
  *
@@ -5402,7 +5547,8 @@ void ds_avl_destroy(ds_set_t **node_ptr)
 		}
 	}
 	if(node->dlist != NULL)
-		shm_free(node->dlist);
+		ds_dest_free(node->dlist);
+	ds_hmap_free(node);
 	shm_free(node);
 
 	*node_ptr = NULL;
@@ -5439,6 +5585,7 @@ ds_set_t *ds_avl_insert(ds_set_t **root, int id, int *setn)
 		node->longer = AVL_NEITHER;
 		*root = node;
 		lock_init(&node->lock);
+		lock_init(&node->slock);
 		avl_rebalance(rotation_top, id);
 
 		(*setn)++;
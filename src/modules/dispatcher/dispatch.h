@@ -96,6 +96,14 @@
 
 #define DS_SELRES_FAILED (ds_selres_t){0}
 
+#define DS_HMAP_MODULO	0 /*!< hash modulo number of destinations */
+#define DS_HMAP_RING	1 /*!< consistent hashing ring with virtual nodes */
+#define DS_HMAP_MAGLEV	2 /*!< maglev lookup table */
+
+#define DS_CACHELINE_SIZE	64
+
+#define DS_PING_SPREAD_STEP	100 /*!< ms between runs of spread keepalives */
+
 /* clang-format on */
 typedef struct ds_rctx
 {
@@ -122,6 +130,8 @@ extern str ds_dest_attrs_col;
 
 extern int ds_flags;
 extern int ds_use_default;
+extern int ds_hash_mapping;
+extern int ds_hash_vnodes;
 
 extern str ds_xavp_dst;
 extern int ds_xavp_dst_mode;
@@ -203,6 +213,11 @@ int ds_is_addr_from_list(sip_msg_t *_m, int group, str *uri, int mode);
  */
 void ds_check_timer(unsigned int ticks, void *param);
 
+/*! \brief
+ * Timer for checking inactive destinations, spread over the ping interval
+ */
+void ds_check_utimer(unsigned int ticks, void *param);
+
 /*! \brief
  * Timer for checking active calls load
  */
@@ -231,9 +246,10 @@ typedef struct _ds_attrs {
 	int congestion_control;
 	str ping_from;
 	str obproxy;
-	int rpriority;
 } ds_attrs_t;
 
+#define DS_RTT_HIST_SIZE 13 /* power of 2 buckets of ms, <1 ... >=2048 */
+
 typedef struct _ds_latency_stats {
 	struct timeval start;
 	int min;
@@ -244,6 +260,7 @@ typedef struct _ds_latency_stats {
 	double m2;      // sum of squares, used for recursive variance calculation
 	int32_t count;
 	uint32_t timeout;
+	uint32_t rtt_hist[DS_RTT_HIST_SIZE]; // histogram of ping round trip times
 } ds_latency_stats_t;
 
 void latency_stats_init(ds_latency_stats_t *latency_stats, int latency, int count);
@@ -261,11 +278,16 @@ typedef struct _ds_ocdata {
 } ds_ocdata_t;
 
 typedef struct _ds_dest {
+	/* runtime state, updated with atomic operations - aligned and padded
+	 * to own a cache line, apart from the fields read for selection; the
+	 * items must be allocated with ds_dest_alloc() */
+	int flags __attribute__((aligned(DS_CACHELINE_SIZE))); /*!< flags */
+	int dload;        /*!< load */
+	int latency;      /*!< latency for selection in ms (alg 13) */
+	char _pad[DS_CACHELINE_SIZE - 3 * sizeof(int)];
 	str uri;          /*!< address/uri */
 	str host;         /*!< shortcut to host part */
-	int flags;        /*!< flags */
 	int priority;     /*!< priority */
-	int dload;        /*!< load */
 	ds_attrs_t attrs; /*!< the attributes */
 	ds_latency_stats_t latency_stats; /*!< latency statistics */
 	int irmode;       /*!< internal runtime mode (flags) */
@@ -283,6 +305,16 @@ typedef struct _ds_dest {
 	struct _ds_dest *next;
 } ds_dest_t;
 
+typedef struct _ds_hring {
+	unsigned int point; /*!< position on the hash ring */
+	unsigned int idx;	/*!< index of destination in dlist */
+} ds_hring_t;
+
+typedef struct _ds_hmtable {
+	struct _ds_hmtable *next; /*!< table replaced before this one */
+	unsigned short slot[];	  /*!< index of destination for each slot */
+} ds_hmtable_t;
+
 typedef struct _ds_set {
 	int id;				/*!< id of dst set */
 	int nr;				/*!< number of items in dst set */
@@ -297,7 +329,15 @@ typedef struct _ds_set {
 	struct _ds_set *next[2];
 	int longer;
 	int rrserial;		/*!< round-robin or serial flag */
+	ds_hring_t *hring;	/*!< consistent hashing ring, sorted by point */
+	int hring_nr;		/*!< number of points on the ring */
+	ds_hmtable_t *hmtable; /*!< maglev lookup table */
+	ds_hmtable_t *hmtable_old; /*!< replaced tables, freed with the set */
+	int hmtable_size;	/*!< size of maglev table (prime number) */
+	int hmtable_gen;	/*!< number of rebuilds started */
+	int hmtable_pub;	/*!< rebuild of the table in use */
 	gen_lock_t lock;
+	gen_lock_t slock;	/*!< lock for latency stats of destinations */
 } ds_set_t;
 
 typedef struct _ds_list {
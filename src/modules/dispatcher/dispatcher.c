@@ -75,6 +75,8 @@ char *dslistfile = CFG_DIR"dispatcher.list";
 int  ds_force_dst   = 1;
 int  ds_flags       = 0;
 int  ds_use_default = 0;
+int  ds_hash_mapping = DS_HMAP_MODULO;
+int  ds_hash_vnodes = 160;
 str ds_xavp_dst = str_init("_dsdst_");
 int ds_xavp_dst_mode = 0;
 str ds_xavp_ctx = str_init("_dsctx_");
@@ -103,6 +105,7 @@ int inactive_threshold = 1; /* number of replied requests, before a destination
 str ds_ping_method = str_init("OPTIONS");
 str ds_ping_from   = str_init("sip:dispatcher@localhost");
 static int ds_ping_interval = 0;
+static int ds_ping_spread = 0;
 int ds_ping_latency_stats = 0;
 int ds_ping_fr_timeout = 0;
 int ds_retain_latency_stats = 0;
@@ -297,6 +300,8 @@ static param_export_t params[]={
 	{"force_dst",       PARAM_INT, &ds_force_dst},
 	{"flags",           PARAM_INT, &ds_flags},
 	{"use_default",     PARAM_INT, &ds_use_default},
+	{"hash_mapping",    PARAM_INT, &ds_hash_mapping},
+	{"hash_vnodes",     PARAM_INT, &ds_hash_vnodes},
 	{"xavp_dst",        PARAM_STR, &ds_xavp_dst},
 	{"xavp_dst_mode",   PARAM_INT, &ds_xavp_dst_mode},
 	{"xavp_ctx",        PARAM_STR, &ds_xavp_ctx},
@@ -309,6 +314,7 @@ static param_export_t params[]={
 	{"ds_ping_method",     PARAM_STR, &ds_ping_method},
 	{"ds_ping_from",       PARAM_STR, &ds_ping_from},
 	{"ds_ping_interval",   PARAM_INT, &ds_ping_interval},
+	{"ds_ping_spread",     PARAM_INT, &ds_ping_spread},
 	{"ds_ping_fr_timeout", PARAM_INT, &ds_ping_fr_timeout},
 	{"ds_ping_fr_timer", PARAM_INT, &ds_ping_fr_timeout},
 	{"ds_ping_latency_stats", PARAM_INT, &ds_ping_latency_stats},
@@ -376,6 +382,14 @@ static int mod_init(void)
 	if(ds_dns_ttl < 0) {
 		ds_dns_ttl = 0;
 	}
+	if(ds_hash_mapping < DS_HMAP_MODULO || ds_hash_mapping > DS_HMAP_MAGLEV) {
+		LM_ERR("invalid hash mapping parameter: %d\n", ds_hash_mapping);
+		return -1;
+	}
+	if(ds_hash_vnodes < 1 || ds_hash_vnodes > 1024) {
+		LM_WARN("hash vnodes parameter out of range - using 160\n");
+		ds_hash_vnodes = 160;
+	}
 	if(ds_ping_active_init() < 0) {
 		return -1;
 	}
@@ -399,7 +413,10 @@ static int mod_init(void)
 			LM_ERR("could not load the TM-functions - disable DS ping\n");
 			return -1;
 		}
-		if(ds_timer_mode == 1) {
+		if(ds_ping_spread != 0) {
+			/* own ms timer process, forked in child_init() */
+			register_basic_timers(1);
+		} else if(ds_timer_mode == 1) {
 			if(sr_wtimer_add(ds_check_timer, NULL, ds_ping_interval) < 0)
 				return -1;
 		} else {
@@ -579,6 +596,16 @@ static int mod_init(void)
  */
 static int child_init(int rank)
 {
+	if(rank != PROC_MAIN || ds_ping_interval <= 0 || ds_ping_spread == 0)
+		return 0;
+
+	if(fork_basic_utimer(PROC_TIMER, "DISPATCHER PING TIMER", 1 /*socks*/,
+			   ds_check_utimer, (void *)(long)ds_ping_interval,
+			   1000 * DS_PING_SPREAD_STEP /*usec*/)
+			< 0) {
+		LM_ERR("failed to start the keepalive timer process\n");
+		return -1;
+	}
 	return 0;
 }
 
@@ -1878,6 +1905,11 @@ static const char *dispatcher_rpc_list_doc[2] = {
 /**
  *
  */
+/* names of ping round trip time histogram buckets, upper bounds in ms */
+static char *_ds_rtt_hist_names[DS_RTT_HIST_SIZE] = {"LT1", "LT2", "LT4",
+		"LT8", "LT16", "LT32", "LT64", "LT128", "LT256", "LT512", "LT1024",
+		"LT2048", "GE2048"};
+
 int ds_rpc_print_set(
 		ds_set_t *node, rpc_t *rpc, void *ctx, void *rpc_handle, int mode)
 {
@@ -1888,7 +1920,9 @@ int ds_rpc_print_set(
 	void *wh;
 	void *lh;
 	void *dh;
+	void *hh;
 	int j;
+	int k;
 	char c[3];
 	str data = STR_NULL;
 	char ipbuf[IP_ADDR_MAX_STRZ_SIZE];
@@ -2016,6 +2050,18 @@ int ds_rpc_print_set(
 				rpc->fault(ctx, 500, "Internal error creating dest struct");
 				return -1;
 			}
+			if(rpc->struct_add(lh, "{", "RTT", &hh) < 0) {
+				rpc->fault(ctx, 500, "Internal error creating rtt struct");
+				return -1;
+			}
+			for(k = 0; k < DS_RTT_HIST_SIZE; k++) {
+				if(rpc->struct_add(hh, "u", _ds_rtt_hist_names[k],
+						   node->dlist[j].latency_stats.rtt_hist[k])
+						< 0) {
+					rpc->fault(ctx, 500, "Internal error creating rtt attrs");
+					return -1;
+				}
+			}
 		}
 		if(ds_hash_size > 0) {
 			if(rpc->struct_add(vh, "{", "RUNTIME", &dh) < 0) {
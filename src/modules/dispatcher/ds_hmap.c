@@ -0,0 +1,429 @@
+/**
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ * \ingroup dispatcher
+ * \brief Dispatcher :: Mapping of hash values to destinations
+ *
+ * The hash based algorithms select by default the destination at position
+ * hash % nr, therefore when a destination goes down or comes back most of
+ * the hash values are moved to another destination. The mappings here keep
+ * most of the hash values on the same destination:
+ * - consistent hashing ring - each destination has ds_hash_vnodes points on
+ *   the ring, the hash value goes to the first active destination clockwise.
+ *   The ring is built when the set is loaded and never changed.
+ * - maglev - lookup table with a prime size of about 100 slots per
+ *   destination, filled with the active destinations following the
+ *   preference list of each of them. It is rebuilt when the state of a
+ *   destination changes. Lookups read the table without lock, so the
+ *   replaced tables are kept until the set is freed on reload.
+ * The points and the preference lists depend only on destination uri.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/mem.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/atomic_ops.h"
+
+#include "ds_hmap.h"
+
+/* clang-format off */
+/* prime sizes for maglev lookup table */
+static unsigned int _ds_hmap_primes[] = {
+	251, 509, 1021, 2039, 4093, 8191, 16381, 32749, 65521, 0
+};
+/* clang-format on */
+
+#define DS_HMAP_SLOTS 100 /* maglev table slots per destination */
+#define DS_HMAP_EMPTY 0xffff
+
+/**
+ * number of destinations to map hash values on - the last one is skipped
+ * if it is used as default destination
+ */
+static inline int ds_hmap_size(ds_set_t *dset)
+{
+	if(ds_use_default != 0 && dset->nr != 1)
+		return dset->nr - 1;
+	return dset->nr;
+}
+
+/**
+ * murmur3 finalizer - spread the bits of the hash value
+ */
+static inline unsigned int ds_hmap_mix(unsigned int h)
+{
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+/**
+ * fnv-1a hash of destination uri
+ */
+static unsigned int ds_hmap_hash_uri(str *uri, unsigned int seed)
+{
+	unsigned int h;
+	int i;
+
+	h = 2166136261u ^ seed;
+	for(i = 0; i < uri->len; i++) {
+		h ^= (unsigned char)uri->s[i];
+		h *= 16777619u;
+	}
+	return ds_hmap_mix(h);
+}
+
+static int ds_hring_cmp(const void *a, const void *b)
+{
+	const ds_hring_t *ra = (const ds_hring_t *)a;
+	const ds_hring_t *rb = (const ds_hring_t *)b;
+
+	if(ra->point != rb->point)
+		return (ra->point < rb->point) ? -1 : 1;
+	if(ra->idx != rb->idx)
+		return (ra->idx < rb->idx) ? -1 : 1;
+	return 0;
+}
+
+/**
+ * build the consistent hashing ring of the set
+ */
+static int ds_hring_build(ds_set_t *dset)
+{
+	ds_hring_t *ring;
+	unsigned int h;
+	int n;
+	int i;
+	int v;
+	int k;
+
+	n = ds_hmap_size(dset);
+	ring = (ds_hring_t *)shm_malloc(n * ds_hash_vnodes * sizeof(ds_hring_t));
+	if(ring == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	k = 0;
+	for(i = 0; i < n; i++) {
+		h = ds_hmap_hash_uri(&dset->dlist[i].uri, 0);
+		for(v = 0; v < ds_hash_vnodes; v++) {
+			ring[k].point = ds_hmap_mix(h + (unsigned int)v * 0x9e3779b9u);
+			ring[k].idx = (unsigned int)i;
+			k++;
+		}
+	}
+	qsort(ring, k, sizeof(ds_hring_t), ds_hring_cmp);
+	dset->hring = ring;
+	dset->hring_nr = k;
+
+	return 0;
+}
+
+/**
+ * first active destination clockwise on the ring from the hash value
+ */
+static int ds_hring_lookup(ds_set_t *dset, unsigned int hash)
+{
+	unsigned int key;
+	int lo;
+	int hi;
+	int mid;
+	int i;
+	int k;
+
+	key = ds_hmap_mix(hash);
+	lo = 0;
+	hi = dset->hring_nr;
+	while(lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if(dset->hring[mid].point < key) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	for(k = 0; k < dset->hring_nr; k++) {
+		i = lo + k;
+		if(i >= dset->hring_nr)
+			i -= dset->hring_nr;
+		if(!ds_skip_dst(dset->dlist[dset->hring[i].idx].flags))
+			return (int)dset->hring[i].idx;
+	}
+	return -1;
+}
+
+/**
+ * fill the maglev table with the active destinations
+ * - pos and skip are scratch arrays of ds_hmap_size() items
+ * - return the number of active destinations (table not filled if 0)
+ */
+static int ds_hmtable_fill(ds_set_t *dset, unsigned short *table,
+		unsigned int *pos, unsigned int *skip)
+{
+	unsigned int m;
+	unsigned int c;
+	unsigned int filled;
+	int nactive;
+	int n;
+	int i;
+
+	m = (unsigned int)dset->hmtable_size;
+	n = ds_hmap_size(dset);
+	nactive = 0;
+	for(i = 0; i < n; i++) {
+		if(ds_skip_dst(dset->dlist[i].flags)) {
+			skip[i] = 0;
+			continue;
+		}
+		pos[i] = ds_hmap_hash_uri(&dset->dlist[i].uri, 0) % m;
+		skip[i] = ds_hmap_hash_uri(&dset->dlist[i].uri, 0x5bd1e995u) % (m - 1)
+				  + 1;
+		nactive++;
+	}
+	if(nactive == 0)
+		return 0;
+
+	memset(table, 0xff, m * sizeof(unsigned short));
+	filled = 0;
+	while(1) {
+		for(i = 0; i < n; i++) {
+			if(skip[i] == 0)
+				continue;
+			/* next free slot in the preference list of destination */
+			c = pos[i];
+			while(table[c] != DS_HMAP_EMPTY) {
+				c += skip[i];
+				if(c >= m)
+					c -= m;
+			}
+			table[c] = (unsigned short)i;
+			c += skip[i];
+			if(c >= m)
+				c -= m;
+			pos[i] = c;
+			if(++filled == m)
+				return nactive;
+		}
+	}
+}
+
+/**
+ * rebuild the maglev table of the set for the current states
+ * - the new table is filled without lock and replaces the current one
+ *   under the set lock, unless a rebuild started later is already in use
+ * - readers use the table without lock and can hold the replaced one for
+ *   any time, so it is added to the list freed by ds_hmap_free()
+ */
+int ds_hmap_update(ds_set_t *dset)
+{
+	ds_hmtable_t *table;
+	unsigned int *pos;
+	unsigned int *skip;
+	int gen;
+	int n;
+
+	if(dset == NULL || dset->hmtable == NULL)
+		return 0;
+
+	gen = atomic_add_int(&dset->hmtable_gen, 1);
+	n = ds_hmap_size(dset);
+	pos = (unsigned int *)pkg_malloc(2 * n * sizeof(unsigned int));
+	if(pos == NULL) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	skip = pos + n;
+	table = (ds_hmtable_t *)shm_malloc(sizeof(ds_hmtable_t)
+			+ dset->hmtable_size * sizeof(unsigned short));
+	if(table == NULL) {
+		pkg_free(pos);
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	table->next = NULL;
+
+	if(ds_hmtable_fill(dset, table->slot, pos, skip) == 0) {
+		/* no active destination - keep the current table */
+		shm_free(table);
+		table = NULL;
+	}
+	pkg_free(pos);
+
+	lock_get(&dset->lock);
+	if(gen - dset->hmtable_pub > 0) {
+		dset->hmtable_pub = gen;
+		if(table != NULL) {
+			/* table content visible before the pointer to it */
+			membar_write();
+			dset->hmtable->next = dset->hmtable_old;
+			dset->hmtable_old = dset->hmtable;
+			dset->hmtable = table;
+			table = NULL;
+		}
+	}
+	lock_release(&dset->lock);
+
+	/* table of a rebuild started before the one in use */
+	if(table != NULL)
+		shm_free(table);
+	return 0;
+}
+
+/**
+ * build the maglev table of the set
+ */
+static int ds_hmtable_build(ds_set_t *dset)
+{
+	ds_hmtable_t *table;
+	unsigned long sz;
+	unsigned int m;
+	int n;
+	int i;
+
+	n = ds_hmap_size(dset);
+	sz = (unsigned long)n * DS_HMAP_SLOTS;
+	m = 0;
+	for(i = 0; _ds_hmap_primes[i] != 0; i++) {
+		m = _ds_hmap_primes[i];
+		if(m >= sz)
+			break;
+	}
+	if(m < (unsigned int)n) {
+		LM_WARN("too many destinations in set %d for maglev table (%d)"
+				" - using modulo\n",
+				dset->id, n);
+		return 0;
+	}
+
+	table = (ds_hmtable_t *)shm_malloc(
+			sizeof(ds_hmtable_t) + m * sizeof(unsigned short));
+	if(table == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	table->next = NULL;
+	/* valid mapping also when no destination is active */
+	for(i = 0; i < (int)m; i++) {
+		table->slot[i] = (unsigned short)(i % n);
+	}
+	dset->hmtable = table;
+	dset->hmtable_size = (int)m;
+
+	return ds_hmap_update(dset);
+}
+
+/**
+ * build the structure for mapping hash values in the set
+ */
+int ds_hmap_build(ds_set_t *dset)
+{
+	if(dset == NULL || dset->nr <= 0)
+		return 0;
+
+	switch(ds_hash_mapping) {
+		case DS_HMAP_RING:
+			return ds_hring_build(dset);
+		case DS_HMAP_MAGLEV:
+			return ds_hmtable_build(dset);
+	}
+	return 0;
+}
+
+/**
+ * update the mapping if a destination went down or came back
+ */
+int ds_hmap_state_change(int old_state, int new_state, ds_set_t *dset)
+{
+	if(dset == NULL || dset->hmtable == NULL)
+		return 0;
+	if((ds_skip_dst(old_state) && !ds_skip_dst(new_state))
+			|| (!ds_skip_dst(old_state) && ds_skip_dst(new_state))) {
+		return ds_hmap_update(dset);
+	}
+	return 0;
+}
+
+/**
+ *
+ */
+void ds_hmap_free(ds_set_t *dset)
+{
+	ds_hmtable_t *table;
+
+	if(dset->hring != NULL) {
+		shm_free(dset->hring);
+		dset->hring = NULL;
+	}
+	dset->hring_nr = 0;
+	if(dset->hmtable != NULL) {
+		shm_free(dset->hmtable);
+		dset->hmtable = NULL;
+	}
+	while(dset->hmtable_old != NULL) {
+		table = dset->hmtable_old;
+		dset->hmtable_old = table->next;
+		shm_free(table);
+	}
+	dset->hmtable_size = 0;
+}
+
+/**
+ * index of the active destination for the hash value, -1 if none is active
+ */
+int ds_hmap_lookup(ds_set_t *dset, unsigned int hash)
+{
+	ds_hmtable_t *table;
+	int n;
+	int i;
+	int k;
+
+	if(dset->hring != NULL)
+		return ds_hring_lookup(dset, hash);
+
+	n = ds_hmap_size(dset);
+	if(n <= 0)
+		return -1;
+	table = dset->hmtable;
+	if(table != NULL) {
+		i = table->slot[ds_hmap_mix(hash) % dset->hmtable_size];
+	} else {
+		i = hash % n;
+	}
+	if(i >= dset->nr)
+		return -1;
+	/* item can be stale while the maglev table is rebuilt */
+	k = i;
+	do {
+		if(!ds_skip_dst(dset->dlist[k].flags))
+			return k;
+		k = (k + 1) % n;
+	} while(k != i);
+
+	return -1;
+}
@@ -0,0 +1,39 @@
+/**
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ * \ingroup dispatcher
+ * \brief Dispatcher :: Mapping of hash values to destinations
+ */
+
+#ifndef _DS_HMAP_H_
+#define _DS_HMAP_H_
+
+#include "dispatch.h"
+
+int ds_hmap_build(ds_set_t *dset);
+int ds_hmap_state_change(int old_state, int new_state, ds_set_t *dset);
+int ds_hmap_update(ds_set_t *dset);
+void ds_hmap_free(ds_set_t *dset);
+int ds_hmap_lookup(ds_set_t *dset, unsigned int hash);
+
+#endif
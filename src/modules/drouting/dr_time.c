@@ -923,6 +923,77 @@ int dr_check_tmrec(dr_tmrec_p _trp, dr_ac_tm_p _atp, dr_tr_res_p _tsw)
 }
 
 
+/**
+ * the result of dr_check_tmrec() changes only at the start, end and until
+ * bounds of the recurrence, at local midnight and at the start and end of
+ * the daily interval
+ *
+ * return 0 - the result may change at _next
+ *        1 - the result does not change any more
+ *       -1 - error
+ */
+int dr_tmrec_next_change(dr_tmrec_p _trp, dr_ac_tm_p _atp, time_t *_next)
+{
+	struct tm _tm;
+	time_t _t;
+	int _v0, _v1;
+
+	if(!_trp || !_atp || !_next)
+		return -1;
+
+	if(_atp->time < _trp->dtstart) {
+		*_next = _trp->dtstart;
+		return 0;
+	}
+
+	if(!_IS_SET(_trp->duration) && !_IS_SET(_trp->dtend))
+		return 1;
+
+	if(!_IS_SET(_trp->duration))
+		_trp->duration = _trp->dtend - _trp->dtstart;
+
+	if(_atp->time <= _trp->dtstart + _trp->duration) {
+		*_next = _trp->dtstart + _trp->duration + 1;
+		return 0;
+	}
+
+	if((_IS_SET(_trp->until) && _atp->time >= _trp->until + _trp->duration)
+			|| !_IS_SET(_trp->freq))
+		return 1;
+
+	/* next local midnight */
+	memcpy(&_tm, &_atp->t, sizeof(struct tm));
+	_tm.tm_mday++;
+	_tm.tm_hour = _tm.tm_min = _tm.tm_sec = 0;
+	_tm.tm_isdst = -1;
+	*_next = mktime(&_tm);
+	if(*_next == (time_t)-1)
+		return -1;
+
+	if(_IS_SET(_trp->until) && _trp->until + _trp->duration < *_next)
+		*_next = _trp->until + _trp->duration;
+
+	/* start or end of the interval today */
+	_v0 = _trp->ts.tm_hour * 3600 + _trp->ts.tm_min * 60 + _trp->ts.tm_sec;
+	_v1 = _atp->t.tm_hour * 3600 + _atp->t.tm_min * 60 + _atp->t.tm_sec;
+	_v0 = (_v1 < _v0) ? _v0 : _v0 + _trp->duration;
+	if(_v1 >= _v0 || _v0 >= 24 * 3600)
+		return 0;
+	memcpy(&_tm, &_atp->t, sizeof(struct tm));
+	_tm.tm_hour = _v0 / 3600;
+	_tm.tm_min = (_v0 % 3600) / 60;
+	_tm.tm_sec = _v0 % 60;
+	_tm.tm_isdst = -1;
+	_t = mktime(&_tm);
+	if(_t == (time_t)-1)
+		return -1;
+	if(_t < *_next)
+		*_next = _t;
+
+	return 0;
+}
+
+
 int dr_check_freq_interval(dr_tmrec_p _trp, dr_ac_tm_p _atp)
 {
 	uint64_t _t0, _t1;
@@ -164,6 +164,7 @@ dr_tr_byxxx_p dr_ic_parse_byxxx(char *);
 int dr_ic_parse_wkst(char *);
 
 int dr_check_tmrec(dr_tmrec_p, dr_ac_tm_p, dr_tr_res_p);
+int dr_tmrec_next_change(dr_tmrec_p, dr_ac_tm_p, time_t *);
 
 
 #endif
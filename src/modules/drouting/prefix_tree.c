@@ -36,25 +36,51 @@ extern int inode;
 extern int unode;
 
 
-static inline int check_time(dr_tmrec_t *time_rec)
+static inline int check_time(rt_info_t *rt)
 {
+	dr_tmrec_t *time_rec;
 	dr_ac_tm_t att;
+	unsigned long cache;
+	time_t now, next;
+	int ret;
 
+	time_rec = rt->time_rec;
 	/* shortcut: if there is no dstart, timerec is valid */
 	if(time_rec->dtstart == 0)
 		return 1;
 
+	now = time(0);
+
+	/* the result is known until the next time it can change */
+	cache = rt->time_cache;
+	if(cache != 0 && now < (time_t)(cache >> 1))
+		return (int)(cache & 1);
+
 	memset(&att, 0, sizeof(att));
 
 	/* set current time */
-	if(dr_ac_tm_set_time(&att, time(0)))
+	if(dr_ac_tm_set_time(&att, now))
 		return 0;
 
 	/* does the recv_time match the specified interval?  */
-	if(dr_check_tmrec(time_rec, &att, 0) != 0)
-		return 0;
+	ret = (dr_check_tmrec(time_rec, &att, 0) == 0) ? 1 : 0;
+
+	switch(dr_tmrec_next_change(time_rec, &att, &next)) {
+		case 0:
+			if(next > now && (unsigned long)next <= DR_TIME_CACHE_MAX) {
+				rt->time_cache = ((unsigned long)next << 1) | ret;
+				break;
+			}
+			rt->time_cache = 0;
+			break;
+		case 1:
+			rt->time_cache = (DR_TIME_CACHE_MAX << 1) | ret;
+			break;
+		default:
+			rt->time_cache = 0;
+	}
 
-	return 1;
+	return ret;
 }
 
 
@@ -76,7 +102,7 @@ static inline rt_info_t *internal_check_rt(ptree_node_t *ptn, unsigned int rgid)
 		LM_DBG("found rgid %d (rule list %p)\n", rgid, rg[i].rtlw);
 		rtlw = rg[i].rtlw;
 		while(rtlw != NULL) {
-			if(check_time(rtlw->rtl->time_rec))
+			if(check_time(rtlw->rtl))
 				return rtlw->rtl;
 			rtlw = rtlw->next;
 		}
@@ -95,6 +121,7 @@ rt_info_t *check_rt(ptree_node_t *ptn, unsigned int rgid)
 rt_info_t *get_prefix(ptree_t *ptree, str *prefix, unsigned int rgid)
 {
 	rt_info_t *rt = NULL;
+	ptree_node_t *ptn = NULL;
 	char *tmp = NULL;
 	int idx = 0;
 
@@ -115,20 +142,22 @@ rt_info_t *get_prefix(ptree_t *ptree, str *prefix, unsigned int rgid)
 			/* last digit in the prefix string */
 			break;
 		}
-		if(NULL == ptree->ptnode[idx].next) {
+		ptn = get_ptree_node(ptree, idx);
+		if(NULL == ptn || NULL == ptn->next) {
 			/* this is a leaf */
 			break;
 		}
-		ptree = ptree->ptnode[idx].next;
+		ptree = ptn->next;
 		tmp++;
 	}
 	/* go in the tree up to the root trying to match the prefix */
 	while(ptree != NULL) {
 		/* is it a real node or an intermediate one */
 		idx = get_node_index(*tmp);
-		if(idx != -1 && NULL != ptree->ptnode[idx].rg) {
+		ptn = (idx != -1) ? get_ptree_node(ptree, idx) : NULL;
+		if(NULL != ptn && NULL != ptn->rg) {
 			/* real node; check the constraints on the routing info*/
-			if(NULL != (rt = internal_check_rt(&(ptree->ptnode[idx]), rgid)))
+			if(NULL != (rt = internal_check_rt(ptn, rgid)))
 				break;
 		}
 		tmp--;
@@ -158,6 +187,7 @@ err_exit:
 
 int add_prefix(ptree_t *ptree, str *prefix, rt_info_t *r, unsigned int rg)
 {
+	ptree_node_t *ptn = NULL;
 	char *tmp = NULL;
 	int res = 0;
 	if(NULL == ptree)
@@ -171,13 +201,16 @@ int add_prefix(ptree_t *ptree, str *prefix, rt_info_t *r, unsigned int rg)
 			/* unknown character in the prefix string */
 			goto err_exit;
 		}
+		ptn = add_ptree_node(&ptree, insert_index);
+		if(NULL == ptn)
+			goto err_exit;
 		if(tmp == (prefix->s + prefix->len - 1)) {
 			/* last symbol in the prefix string */
 
 			LM_DBG("adding info %p, %d at: "
 				   "%p (%d)\n",
-					r, rg, &(ptree->ptnode[insert_index]), insert_index);
-			res = add_rt_info(&(ptree->ptnode[insert_index]), r, rg);
+					r, rg, ptn, insert_index);
+			res = add_rt_info(ptn, r, rg);
 			if(res < 0)
 				goto err_exit;
 			unode++;
@@ -185,18 +218,17 @@ int add_prefix(ptree_t *ptree, str *prefix, rt_info_t *r, unsigned int rg)
 			goto ok_exit;
 		}
 		/* process the current symbol in the prefix */
-		if(NULL == ptree->ptnode[insert_index].next) {
+		if(NULL == ptn->next) {
 			/* allocate new node */
-			INIT_PTREE_NODE(ptree, ptree->ptnode[insert_index].next);
-			inode += PTREE_CHILDREN;
+			INIT_PTREE_NODE(ptree, ptn->next);
 #if 0
 			printf("new tree node: %p (bp: %p)\n",
-					ptree->ptnode[insert_index].next,
-					ptree->ptnode[insert_index].next->bp
+					ptn->next,
+					ptn->next->bp
 					);
 #endif
 		}
-		ptree = ptree->ptnode[insert_index].next;
+		ptree = ptn->next;
 		tmp++;
 	}
 
@@ -213,7 +245,7 @@ int del_tree(ptree_t *t)
 	if(NULL == t)
 		goto exit;
 	/* delete all the children */
-	for(i = 0; i < PTREE_CHILDREN; i++) {
+	for(i = 0; i < t->nchildren; i++) {
 		/* shm_free the rg array of rt_info */
 		if(NULL != t->ptnode[i].rg) {
 			for(j = 0; j < t->ptnode[i].rg_pos; j++) {
@@ -270,6 +302,47 @@ void print_rt(rt_info_t *rt)
 }
 
 
+/* return the child node for symbol idx, adding it if not there yet; the
+ * node is reallocated then, *ptree and the pointers to it are updated */
+ptree_node_t *add_ptree_node(ptree_t **ptree, int idx)
+{
+	ptree_t *t, *o;
+	int i, n;
+
+	o = *ptree;
+	if(o->pos[idx] != 0)
+		return &o->ptnode[o->pos[idx] - 1];
+
+	n = o->nchildren;
+	t = (ptree_t *)shm_malloc(sizeof(ptree_t) + (n + 1) * sizeof(ptree_node_t));
+	if(NULL == t) {
+		SHM_MEM_ERROR;
+		return NULL;
+	}
+	memcpy(t, o, sizeof(ptree_t) + n * sizeof(ptree_node_t));
+	memset(&t->ptnode[n], 0, sizeof(ptree_node_t));
+	t->pos[idx] = n + 1;
+	t->nchildren = n + 1;
+	for(i = 0; i < n; i++) {
+		if(NULL != t->ptnode[i].next)
+			t->ptnode[i].next->bp = t;
+	}
+	if(NULL != t->bp) {
+		for(i = 0; i < t->bp->nchildren; i++) {
+			if(t->bp->ptnode[i].next == o) {
+				t->bp->ptnode[i].next = t;
+				break;
+			}
+		}
+	}
+	shm_free(o);
+	*ptree = t;
+	tree_size += sizeof(ptree_node_t);
+	inode++;
+	return &t->ptnode[n];
+}
+
+
 int get_node_index(char ch)
 {
 	switch(ch) {
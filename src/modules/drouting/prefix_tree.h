@@ -44,6 +44,23 @@ extern int tree_size;
 		(n)->bp = (p);                                \
 	} while(0);
 
+/* the root node has all the children, so that it is never reallocated */
+#define PTREE_ROOT_SIZE \
+	(sizeof(ptree_t) + PTREE_CHILDREN * sizeof(ptree_node_t))
+
+#define INIT_PTREE_ROOT(n)                                 \
+	do {                                                   \
+		int _i;                                            \
+		(n) = (ptree_t *)shm_malloc(PTREE_ROOT_SIZE);      \
+		if(NULL == (n))                                    \
+			goto err_exit;                                 \
+		tree_size += PTREE_ROOT_SIZE;                      \
+		memset((n), 0, PTREE_ROOT_SIZE);                   \
+		for(_i = 0; _i < PTREE_CHILDREN; _i++)             \
+			(n)->pos[_i] = _i + 1;                         \
+		(n)->nchildren = PTREE_CHILDREN;                   \
+	} while(0);
+
 
 /* list of PSTN gw */
 typedef struct pgw_addr_
@@ -79,10 +96,16 @@ typedef struct pgw_list_
 } pgw_list_t;
 
 /* element containing routing information */
+/* largest time stored in rt_info time_cache */
+#define DR_TIME_CACHE_MAX (((unsigned long)-1) >> 1)
+
 typedef struct rt_info_
 {
 	unsigned int priority;
 	dr_tmrec_t *time_rec;
+	/* time_rec check result (lowest bit), valid until the time stored in
+	 * the other bits; 0 if not set */
+	unsigned long time_cache;
 	/* array of pointers into the PSTN gw list */
 	pgw_list_t *pgwl;
 	/* length of the PSTN gw array */
@@ -113,13 +136,25 @@ typedef struct ptree_node_
 	struct ptree_ *next;
 } ptree_node_t;
 
+/* tree node keeps only the children that are in use, in the order they
+ * were added, pos tells where the child of each of the PTREE_CHILDREN
+ * symbols is in the ptnode array (index + 1, 0 if there is none) */
 typedef struct ptree_
 {
 	/* backpointer */
 	struct ptree_ *bp;
-	ptree_node_t ptnode[PTREE_CHILDREN];
+	unsigned char pos[PTREE_CHILDREN];
+	unsigned char nchildren;
+	ptree_node_t ptnode[];
 } ptree_t;
 
+static inline ptree_node_t *get_ptree_node(ptree_t *ptree, int idx)
+{
+	if(ptree->pos[idx] == 0)
+		return NULL;
+	return &ptree->ptnode[ptree->pos[idx] - 1];
+}
+
 void print_interim(int, int, ptree_t *);
 
 int del_tree(ptree_t *);
@@ -144,4 +179,6 @@ rt_info_t *check_rt(ptree_node_t *ptn, unsigned int rgid);
 
 int get_node_index(char ch);
 
+ptree_node_t *add_ptree_node(ptree_t **ptree, int idx);
+
 #endif
@@ -50,7 +50,7 @@ rt_data_t *build_rt_data(void)
 	}
 	memset(rdata, 0, sizeof(rt_data_t));
 
-	INIT_PTREE_NODE(NULL, rdata->pt);
+	INIT_PTREE_ROOT(rdata->pt);
 
 	return rdata;
 err_exit:
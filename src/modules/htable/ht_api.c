@@ -21,6 +21,7 @@
 
 #include <stddef.h>
 #include <regex.h>
+#include <limits.h>
 
 #include "../../core/mem/shm_mem.h"
 #include "../../core/mem/mem.h"
@@ -34,10 +35,15 @@
 #include "../../core/action.h"
 #include "../../core/route.h"
 #include "../../core/kemi.h"
+#include "../../core/sched_yield.h"
+#ifdef __OS_linux
+#include "../../core/futexlock.h"
+#endif
 
 #include "ht_api.h"
 #include "ht_db.h"
 #include "ht_dmq.h"
+#include "ht_compact.h"
 
 
 extern str ht_event_callback;
@@ -146,10 +152,51 @@ void keyvalue_destroy(keyvalue_t *res)
 	memset(res, 0, sizeof(keyvalue_t));
 }
 
+/* checks of a slot lock state before waiting in the kernel */
+#define HT_RDWAIT_SPINS 1024
+
+/**
+ * wait for the value of v to change from val, woken up by ht_futex_wake()
+ * - without futex support the cpu is yielded instead
+ */
+static inline void ht_futex_wait(atomic_t *v, int val)
+{
+#ifdef HAVE_FUTEX
+	sys_futex(&v->val, FUTEX_WAIT, val, 0, 0, 0);
+#else
+	sched_yield();
+#endif
+}
+
+static inline void ht_futex_wake(atomic_t *v)
+{
+#ifdef HAVE_FUTEX
+	sys_futex(&v->val, FUTEX_WAKE, INT_MAX, 0, 0, 0);
+#endif
+}
+
+/**
+ * wait for the readers of a slot to finish, with the slot lock held and
+ * locker_pid set, so that new readers step back
+ * - the last reader leaving wakes up the writer
+ */
+static void ht_slot_rdwait(ht_t *ht, int idx)
+{
+	int i;
+	int r;
+
+	membar();
+	for(i = 0; (r = mb_atomic_get(&ht->entries[idx].readers)) > 0; i++) {
+		if(i >= HT_RDWAIT_SPINS) {
+			ht_futex_wait(&ht->entries[idx].readers, r);
+		}
+	}
+}
+
 /**
  * recursive/re-entrant lock of the slot in hash table
  */
-void ht_slot_lock(ht_t *ht, int idx)
+static void ht_slot_xlock(ht_t *ht, int idx)
 {
 	int mypid;
 
@@ -157,12 +204,23 @@ void ht_slot_lock(ht_t *ht, int idx)
 	if(likely(atomic_get(&ht->entries[idx].locker_pid) != mypid)) {
 		lock_get(&ht->entries[idx].lock);
 		atomic_set(&ht->entries[idx].locker_pid, mypid);
+		if(unlikely(ht->rwlock)) {
+			ht_slot_rdwait(ht, idx);
+		}
 	} else {
 		/* locked within the same process that executed us */
 		ht->entries[idx].rec_lock_level++;
 	}
 }
 
+/**
+ * recursive/re-entrant lock of the slot for updates
+ */
+void ht_slot_lock(ht_t *ht, int idx)
+{
+	ht_slot_xlock(ht, idx);
+}
+
 /**
  * recursive/re-entrant unlock of the slot in hash table
  */
@@ -170,6 +228,12 @@ void ht_slot_unlock(ht_t *ht, int idx)
 {
 	if(likely(ht->entries[idx].rec_lock_level == 0)) {
 		atomic_set(&ht->entries[idx].locker_pid, 0);
+		if(unlikely(ht->rwlock)) {
+			membar();
+			if(atomic_get(&ht->entries[idx].rdwaiting) > 0) {
+				ht_futex_wake(&ht->entries[idx].locker_pid);
+			}
+		}
 		lock_release(&ht->entries[idx].lock);
 	} else {
 		/* recursive locked => decrease lock count */
@@ -177,6 +241,75 @@ void ht_slot_unlock(ht_t *ht, int idx)
 	}
 }
 
+/**
+ * leave the readers of a slot, waking up the writer waiting for the last
+ */
+static void ht_slot_rdleave(ht_t *ht, int idx)
+{
+	if(mb_atomic_dec_and_test(&ht->entries[idx].readers)
+			&& atomic_get(&ht->entries[idx].locker_pid) != 0) {
+		ht_futex_wake(&ht->entries[idx].readers);
+	}
+}
+
+/**
+ * shared lock of the slot for read-only access
+ * - readers only increment the readers count of the slot and check that
+ *   no writer holds it (locker_pid), stepping back and waiting for the
+ *   writer to be done otherwise, so lookups of the same slot run in
+ *   parallel if the table has rwlock set
+ * - exclusive lock for tables without rwlock
+ */
+void ht_slot_rdlock(ht_t *ht, int idx)
+{
+	int mypid;
+	int pid;
+	int i;
+
+	if(likely(ht->rwlock == 0)) {
+		ht_slot_xlock(ht, idx);
+		return;
+	}
+	mypid = my_pid();
+	if(atomic_get(&ht->entries[idx].locker_pid) == mypid) {
+		/* write locked within the same process */
+		ht->entries[idx].rec_lock_level++;
+		return;
+	}
+	for(i = 0;; i++) {
+		mb_atomic_inc(&ht->entries[idx].readers);
+		if(likely(mb_atomic_get(&ht->entries[idx].locker_pid) == 0)) {
+			return;
+		}
+		/* a writer holds the slot */
+		ht_slot_rdleave(ht, idx);
+		while((pid = mb_atomic_get(&ht->entries[idx].locker_pid)) != 0) {
+			if(i++ < HT_RDWAIT_SPINS) {
+				continue;
+			}
+			mb_atomic_inc(&ht->entries[idx].rdwaiting);
+			ht_futex_wait(&ht->entries[idx].locker_pid, pid);
+			mb_atomic_dec(&ht->entries[idx].rdwaiting);
+		}
+	}
+}
+
+/**
+ * release of the shared lock of the slot
+ */
+void ht_slot_rdunlock(ht_t *ht, int idx)
+{
+	if(likely(ht->rwlock == 0)) {
+		ht_slot_unlock(ht, idx);
+		return;
+	}
+	if(atomic_get(&ht->entries[idx].locker_pid) == my_pid()) {
+		ht->entries[idx].rec_lock_level--;
+		return;
+	}
+	ht_slot_rdleave(ht, idx);
+}
+
 /* returns current wall-clock time in milliseconds */
 static uint64_t ht_now_ms(void)
 {
@@ -270,7 +403,8 @@ ht_t *ht_get_table(str *name)
 
 int ht_add_table(str *name, int autoexp, str *dbtable, str *dbcols, int size,
 		int dbmode, int itype, int_str *ival, int updateexpire,
-		int dmqreplicate, char coldelim, char colnull, int reloadat)
+		int dmqreplicate, char coldelim, char colnull, int reloadat,
+		int rwlock, int csize, int ckeysize, int cvalsize, int snapshot)
 {
 	unsigned int htid;
 	ht_t *ht;
@@ -320,6 +454,27 @@ int ht_add_table(str *name, int autoexp, str *dbtable, str *dbcols, int size,
 	ht->dmqreplicate = dmqreplicate;
 	ht->reloadat = reloadat;
 	ht->last_reload = 0;
+	ht->rwlock = rwlock;
+	ht->snapshot = snapshot;
+	if(csize > 0) {
+		if(dmqreplicate > 0 || dbmode > 0 || reloadat > 0) {
+			LM_ERR("compact htable [%.*s] cannot be replicated, written to or"
+				   " reloaded from database\n",
+					name->len, name->s);
+			shm_free(ht);
+			return -1;
+		}
+		if(ckeysize <= 0 || ckeysize > HT_COMPACT_MAXSIZE || cvalsize < 0
+				|| cvalsize > HT_COMPACT_MAXSIZE) {
+			LM_ERR("invalid key or value size for compact htable [%.*s]\n",
+					name->len, name->s);
+			shm_free(ht);
+			return -1;
+		}
+		ht->csize = csize;
+		ht->ckeysize = ckeysize;
+		ht->cvalsize = cvalsize;
+	}
 
 	if(dbcols != NULL && dbcols->s != NULL && dbcols->len > 0) {
 		ht->scols[0].s = (char *)shm_malloc((1 + dbcols->len) * sizeof(char));
@@ -440,6 +595,12 @@ int ht_init_tables(void)
 		}
 		memset(ht->entries, 0, ht->htsize * sizeof(ht_entry_t));
 
+		if(HT_IS_COMPACT(ht) && ht_compact_init(ht) < 0) {
+			shm_free(ht->entries);
+			ht->entries = NULL;
+			return -1;
+		}
+
 		for(i = 0; i < ht->htsize; i++) {
 			if(lock_init(&ht->entries[i].lock) == 0) {
 				LM_ERR("cannot initialize lock[%d] in [%.*s]\n", i,
@@ -449,6 +610,7 @@ int ht_init_tables(void)
 					lock_destroy(&ht->entries[i].lock);
 					i--;
 				}
+				ht_compact_destroy(ht);
 				shm_free(ht->entries);
 				ht->entries = NULL;
 				return -1;
@@ -485,6 +647,7 @@ int ht_destroy(void)
 				/* free locks */
 				lock_destroy(&ht->entries[i].lock);
 			}
+			ht_compact_destroy(ht);
 			shm_free(ht->entries);
 		}
 		shm_free(ht);
@@ -515,6 +678,8 @@ static int ht_set_cell_core(ht_t *ht, str *name, int type, int_str *val,
 		LM_WARN("invalid name parameter\n");
 		return -1;
 	}
+	if(HT_IS_COMPACT(ht))
+		return ht_compact_set_cell(ht, name, type, val, mode, exv);
 
 	hid = ht_compute_hash(name);
 
@@ -572,6 +737,7 @@ static int ht_set_cell_core(ht_t *ht, str *name, int type, int_str *val,
 						} else {
 							it->expire = now + exv;
 						}
+						HT_SLOT_EXPIRE(ht, idx, it->expire);
 						if(dolm)
 							it->last_modified = newlm;
 					} else {
@@ -592,6 +758,7 @@ static int ht_set_cell_core(ht_t *ht, str *name, int type, int_str *val,
 						} else {
 							cell->expire = now + exv;
 						}
+						HT_SLOT_EXPIRE(ht, idx, cell->expire);
 						if(it->prev)
 							it->prev->next = cell;
 						else
@@ -609,6 +776,7 @@ static int ht_set_cell_core(ht_t *ht, str *name, int type, int_str *val,
 					} else {
 						it->expire = now + exv;
 					}
+					HT_SLOT_EXPIRE(ht, idx, it->expire);
 					if(dolm)
 						it->last_modified = newlm;
 				}
@@ -632,6 +800,7 @@ static int ht_set_cell_core(ht_t *ht, str *name, int type, int_str *val,
 					} else {
 						cell->expire = now + exv;
 					}
+					HT_SLOT_EXPIRE(ht, idx, cell->expire);
 
 					cell->next = it->next;
 					cell->prev = it->prev;
@@ -650,6 +819,7 @@ static int ht_set_cell_core(ht_t *ht, str *name, int type, int_str *val,
 					} else {
 						it->expire = now + exv;
 					}
+					HT_SLOT_EXPIRE(ht, idx, it->expire);
 					if(dolm)
 						it->last_modified = newlm;
 				}
@@ -681,6 +851,7 @@ static int ht_set_cell_core(ht_t *ht, str *name, int type, int_str *val,
 	} else {
 		cell->expire = now + exv;
 	}
+	HT_SLOT_EXPIRE(ht, idx, cell->expire);
 	if(prev == NULL) {
 		if(ht->entries[idx].first != NULL) {
 			cell->next = ht->entries[idx].first;
@@ -787,6 +958,8 @@ int ht_del_cell_confirm(ht_t *ht, str *name)
 		LM_WARN("invalid name parameter\n");
 		return -1;
 	}
+	if(HT_IS_COMPACT(ht))
+		return ht_compact_del_cell(ht, name);
 	hid = ht_compute_hash(name);
 
 	idx = ht_get_entry(hid, ht->htsize);
@@ -830,6 +1003,8 @@ ht_cell_t *ht_cell_value_add(ht_t *ht, str *name, int val, ht_cell_t *old)
 		LM_WARN("invalid name parameter\n");
 		return NULL;
 	}
+	if(HT_IS_COMPACT(ht))
+		return ht_compact_value_add(ht, name, val, old);
 	hid = ht_compute_hash(name);
 
 	idx = ht_get_entry(hid, ht->htsize);
@@ -855,6 +1030,7 @@ ht_cell_t *ht_cell_value_add(ht_t *ht, str *name, int val, ht_cell_t *old)
 				if(it->expire) {
 					it->expire += now;
 				}
+				HT_SLOT_EXPIRE(ht, idx, it->expire);
 				if(ht->flags == PV_VAL_INT) {
 					/* initval is integer, use it to create a fresh entry */
 					it->flags &= ~AVP_VAL_STR;
@@ -872,8 +1048,10 @@ ht_cell_t *ht_cell_value_add(ht_t *ht, str *name, int val, ht_cell_t *old)
 				return NULL;
 			} else {
 				it->value.n += val;
-				if(ht->updateexpire)
+				if(ht->updateexpire) {
 					it->expire = now + ht->htexpire;
+					HT_SLOT_EXPIRE(ht, idx, it->expire);
+				}
 				/* timestamp the inc/dec so replication converges by LWW */
 				/* stamp only on replicated tables */
 				if(ht->dmqreplicate > 0) {
@@ -916,6 +1094,7 @@ ht_cell_t *ht_cell_value_add(ht_t *ht, str *name, int val, ht_cell_t *old)
 	if(ht->dmqreplicate > 0)
 		it->last_modified = ht_now_ms();
 	it->expire = now + ht->htexpire;
+	HT_SLOT_EXPIRE(ht, idx, it->expire);
 	if(prev == NULL) {
 		if(ht->entries[idx].first != NULL) {
 			it->next = ht->entries[idx].first;
@@ -959,6 +1138,8 @@ ht_cell_t *ht_cell_pkg_copy(ht_t *ht, str *name, ht_cell_t *old)
 		LM_WARN("invalid name parameter\n");
 		return NULL;
 	}
+	if(HT_IS_COMPACT(ht))
+		return ht_compact_pkg_copy(ht, name, old);
 	hid = ht_compute_hash(name);
 
 	idx = ht_get_entry(hid, ht->htsize);
@@ -967,7 +1148,7 @@ ht_cell_t *ht_cell_pkg_copy(ht_t *ht, str *name, ht_cell_t *old)
 	if(ht->entries[idx].first == NULL)
 		return NULL;
 
-	ht_slot_lock(ht, idx);
+	ht_slot_rdlock(ht, idx);
 	it = ht->entries[idx].first;
 	while(it != NULL && it->cellid < hid)
 		it = it->next;
@@ -977,13 +1158,13 @@ ht_cell_t *ht_cell_pkg_copy(ht_t *ht, str *name, ht_cell_t *old)
 			/* found */
 			if(ht->htexpire > 0 && it->expire != 0 && it->expire < time(NULL)) {
 				/* entry has expired, return NULL */
-				ht_slot_unlock(ht, idx);
+				ht_slot_rdunlock(ht, idx);
 				return NULL;
 			}
 			if(old != NULL) {
 				if(old->msize >= it->msize) {
 					memcpy(old, it, it->msize);
-					ht_slot_unlock(ht, idx);
+					ht_slot_rdunlock(ht, idx);
 					return old;
 				}
 			}
@@ -996,12 +1177,12 @@ ht_cell_t *ht_cell_pkg_copy(ht_t *ht, str *name, ht_cell_t *old)
 					cell->value.s.s = (char *)cell->name.s + cell->name.len + 1;
 				}
 			}
-			ht_slot_unlock(ht, idx);
+			ht_slot_rdunlock(ht, idx);
 			return cell;
 		}
 		it = it->next;
 	}
-	ht_slot_unlock(ht, idx);
+	ht_slot_rdunlock(ht, idx);
 	return NULL;
 }
 
@@ -1018,6 +1199,8 @@ int ht_cell_exists(ht_t *ht, str *name)
 		LM_WARN("invalid name parameter\n");
 		return -1;
 	}
+	if(HT_IS_COMPACT(ht))
+		return ht_compact_cell_exists(ht, name);
 	hid = ht_compute_hash(name);
 
 	idx = ht_get_entry(hid, ht->htsize);
@@ -1026,7 +1209,7 @@ int ht_cell_exists(ht_t *ht, str *name)
 	if(ht->entries[idx].first == NULL)
 		return 0;
 
-	ht_slot_lock(ht, idx);
+	ht_slot_rdlock(ht, idx);
 	it = ht->entries[idx].first;
 	while(it != NULL && it->cellid < hid)
 		it = it->next;
@@ -1036,15 +1219,15 @@ int ht_cell_exists(ht_t *ht, str *name)
 			/* found */
 			if(ht->htexpire > 0 && it->expire != 0 && it->expire < time(NULL)) {
 				/* entry has expired */
-				ht_slot_unlock(ht, idx);
+				ht_slot_rdunlock(ht, idx);
 				return 0;
 			}
-			ht_slot_unlock(ht, idx);
+			ht_slot_rdunlock(ht, idx);
 			return 1;
 		}
 		it = it->next;
 	}
-	ht_slot_unlock(ht, idx);
+	ht_slot_rdunlock(ht, idx);
 	return 0;
 }
 
@@ -1093,6 +1276,11 @@ int ht_table_spec(char *spec)
 	unsigned int updateexpire = 1;
 	unsigned int dmqreplicate = 0;
 	unsigned int reloadat = 0;
+	unsigned int rwlock = 0;
+	unsigned int csize = 0;
+	unsigned int ckeysize = HT_COMPACT_KEYSIZE;
+	unsigned int cvalsize = HT_COMPACT_VALSIZE;
+	unsigned int snapshot = 0;
 	char coldelim = ',';
 	char colnull = '*';
 	str in;
@@ -1187,6 +1375,34 @@ int ht_table_spec(char *spec)
 				goto error;
 			LM_DBG("htable [%.*s] - reloadat [%u]\n", name.len, name.s,
 					reloadat);
+		} else if(pit->name.len == 6
+				  && strncmp(pit->name.s, "rwlock", 6) == 0) {
+			if(str2int(&tok, &rwlock) != 0)
+				goto error;
+			LM_DBG("htable [%.*s] - rwlock [%u]\n", name.len, name.s, rwlock);
+		} else if(pit->name.len == 7
+				  && strncmp(pit->name.s, "compact", 7) == 0) {
+			if(str2int(&tok, &csize) != 0)
+				goto error;
+			LM_DBG("htable [%.*s] - compact [%u]\n", name.len, name.s, csize);
+		} else if(pit->name.len == 7
+				  && strncmp(pit->name.s, "keysize", 7) == 0) {
+			if(str2int(&tok, &ckeysize) != 0)
+				goto error;
+			LM_DBG("htable [%.*s] - keysize [%u]\n", name.len, name.s,
+					ckeysize);
+		} else if(pit->name.len == 7
+				  && strncmp(pit->name.s, "valsize", 7) == 0) {
+			if(str2int(&tok, &cvalsize) != 0)
+				goto error;
+			LM_DBG("htable [%.*s] - valsize [%u]\n", name.len, name.s,
+					cvalsize);
+		} else if(pit->name.len == 8
+				  && strncmp(pit->name.s, "snapshot", 8) == 0) {
+			if(str2int(&tok, &snapshot) != 0)
+				goto error;
+			LM_DBG("htable [%.*s] - snapshot [%u]\n", name.len, name.s,
+					snapshot);
 		} else {
 			goto error;
 		}
@@ -1194,7 +1410,7 @@ int ht_table_spec(char *spec)
 
 	return ht_add_table(&name, autoexpire, &dbtable, &dbcols, size, dbmode,
 			itype, &ival, updateexpire, dmqreplicate, coldelim, colnull,
-			reloadat);
+			reloadat, rwlock, csize, ckeysize, cvalsize, snapshot);
 
 error:
 	LM_ERR("invalid htable parameter [%.*s]\n", in.len, in.s);
@@ -1207,7 +1423,13 @@ int ht_db_load_tables(void)
 
 	ht = _ht_root;
 	while(ht) {
-		if(ht->dbtable.len > 0) {
+		if(ht->dbtable.len > 0 && ht->snapload != 0) {
+			LM_DBG("ht [%.*s] restored from snapshot, skip loading db table"
+				   " [%.*s]\n",
+					ht->name.len, ht->name.s, ht->dbtable.len, ht->dbtable.s);
+			/* snapshot has the content to write back to db */
+			ht->dbload = 1;
+		} else if(ht->dbtable.len > 0) {
 			LM_DBG("loading db table [%.*s] in ht [%.*s]\n", ht->dbtable.len,
 					ht->dbtable.s, ht->name.len, ht->name.s);
 			if(ht_db_load_table(ht, &ht->dbtable, 0) != 0)
@@ -1262,9 +1484,13 @@ void ht_timer(unsigned int ticks, void *param)
 	ht_cell_t *it;
 	ht_cell_t *it0;
 	time_t now;
+	time_t nexp;
 	int i;
 	int istart;
 	int istep;
+	int nslots;
+	int nexamined;
+	int nexpired;
 
 	if(_ht_root == NULL)
 		return;
@@ -1280,12 +1506,26 @@ void ht_timer(unsigned int ticks, void *param)
 	ht = _ht_root;
 	while(ht) {
 		if(ht->htexpire > 0) {
+			nslots = 0;
+			nexamined = 0;
+			nexpired = 0;
 			for(i = istart; i < ht->htsize; i += istep) {
+				/* skip slots without items to expire yet */
+				if(ht->entries[i].next_expire == 0
+						|| ht->entries[i].next_expire >= now)
+					continue;
 				/* free entries */
-				ht_slot_lock(ht, i);
+				ht_slot_xlock(ht, i);
+				nslots++;
+				ht->entries[i].next_expire = 0;
+				nexp = 0;
+				if(HT_IS_COMPACT(ht))
+					ht_compact_expire_slot(
+							ht, i, now, &nexamined, &nexpired, &nexp);
 				it = ht->entries[i].first;
 				while(it) {
 					it0 = it->next;
+					nexamined++;
 					if(it->expire != 0 && it->expire < now) {
 						/* expired */
 						ht_handle_expired_record(ht, it);
@@ -1298,12 +1538,27 @@ void ht_timer(unsigned int ticks, void *param)
 								it->next->prev = it->prev;
 							ht->entries[i].esize--;
 							ht_cell_free(it);
+							nexpired++;
+							it = it0;
+							continue;
 						}
 					}
+					if(it->expire != 0 && (nexp == 0 || it->expire < nexp))
+						nexp = it->expire;
 					it = it0;
 				}
+				/* the event route may have set expire times meanwhile */
+				HT_SLOT_EXPIRE(ht, i, nexp);
 				ht_slot_unlock(ht, i);
 			}
+			if(nslots > 0) {
+				atomic_add(&ht->exp_slots, nslots);
+				atomic_add(&ht->exp_examined, nexamined);
+				atomic_add(&ht->exp_expired, nexpired);
+			}
+			LM_DBG("htable [%.*s] expire run - slots: %d examined: %d"
+				   " expired: %d\n",
+					ht->name.len, ht->name.s, nslots, nexamined, nexpired);
 		}
 
 		/* check if table needs reloading */
@@ -1459,6 +1714,8 @@ int ht_set_cell_expire(ht_t *ht, str *name, int type, int_str *val)
 	if(val->n > 0)
 		now = time(NULL) + val->n;
 	LM_DBG("set auto-expire to %llu (%ld)\n", (unsigned long long)now, val->n);
+	if(HT_IS_COMPACT(ht))
+		return ht_compact_set_expire(ht, name, now);
 
 	ht_slot_lock(ht, idx);
 	it = ht->entries[idx].first;
@@ -1469,6 +1726,7 @@ int ht_set_cell_expire(ht_t *ht, str *name, int type, int_str *val)
 				&& strncmp(name->s, it->name.s, name->len) == 0) {
 			/* update value */
 			it->expire = now;
+			HT_SLOT_EXPIRE(ht, idx, it->expire);
 			ht_slot_unlock(ht, idx);
 			return 0;
 		}
@@ -1497,12 +1755,14 @@ int ht_get_cell_expire(ht_t *ht, str *name, unsigned int *val)
 		LM_WARN("invalid name parameter\n");
 		return -1;
 	}
+	if(HT_IS_COMPACT(ht))
+		return ht_compact_get_expire(ht, name, val);
 	hid = ht_compute_hash(name);
 
 	idx = ht_get_entry(hid, ht->htsize);
 
 	now = time(NULL);
-	ht_slot_lock(ht, idx);
+	ht_slot_rdlock(ht, idx);
 	it = ht->entries[idx].first;
 	while(it != NULL && it->cellid < hid)
 		it = it->next;
@@ -1511,12 +1771,12 @@ int ht_get_cell_expire(ht_t *ht, str *name, unsigned int *val)
 				&& strncmp(name->s, it->name.s, name->len) == 0) {
 			/* update value */
 			*val = (unsigned int)(it->expire - now);
-			ht_slot_unlock(ht, idx);
+			ht_slot_rdunlock(ht, idx);
 			return 0;
 		}
 		it = it->next;
 	}
-	ht_slot_unlock(ht, idx);
+	ht_slot_rdunlock(ht, idx);
 	return 0;
 }
 
@@ -1531,6 +1791,11 @@ int ht_rm_cell_re(str *sre, ht_t *ht, int mode)
 
 	if(sre == NULL || sre->len <= 0 || ht == NULL)
 		return -1;
+	if(HT_IS_COMPACT(ht)) {
+		LM_ERR("operation not supported for compact htable [%.*s]\n",
+				ht->name.len, ht->name.s);
+		return -1;
+	}
 
 	if(regcomp(&re, sre->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE)) {
 		LM_ERR("bad re %s\n", sre->s);
@@ -1579,6 +1844,11 @@ int ht_rm_cell_op(str *sre, ht_t *ht, int mode, int op)
 
 	if(sre == NULL || sre->len <= 0 || ht == NULL)
 		return -1;
+	if(HT_IS_COMPACT(ht)) {
+		LM_ERR("operation not supported for compact htable [%.*s]\n",
+				ht->name.len, ht->name.s);
+		return -1;
+	}
 
 	for(i = 0; i < ht->htsize; i++) {
 		/* free entries */
@@ -1662,6 +1932,11 @@ int ht_match_cell_op_str(str *sre, ht_t *ht, int mode, int op)
 
 	if(sre == NULL || sre->len <= 0 || ht == NULL)
 		return -1;
+	if(HT_IS_COMPACT(ht)) {
+		LM_ERR("operation not supported for compact htable [%.*s]\n",
+				ht->name.len, ht->name.s);
+		return -1;
+	}
 
 	if(op == HT_RM_OP_RE) {
 		if(regcomp(&re, sre->s, REG_EXTENDED | REG_ICASE | REG_NEWLINE)) {
@@ -1672,7 +1947,7 @@ int ht_match_cell_op_str(str *sre, ht_t *ht, int mode, int op)
 
 	for(i = 0; i < ht->htsize; i++) {
 		/* free entries */
-		ht_slot_lock(ht, i);
+		ht_slot_rdlock(ht, i);
 		it = ht->entries[i].first;
 		while(it) {
 			nomatch = 0;
@@ -1712,14 +1987,14 @@ int ht_match_cell_op_str(str *sre, ht_t *ht, int mode, int op)
 						}
 						break;
 					default:
-						ht_slot_unlock(ht, i);
+						ht_slot_rdunlock(ht, i);
 						LM_ERR("unsupported matching operator: %d\n", op);
 						return -1;
 				}
 			}
 			it = it->next;
 		}
-		ht_slot_unlock(ht, i);
+		ht_slot_rdunlock(ht, i);
 	}
 	if(op == HT_RM_OP_RE) {
 		regfree(&re);
@@ -1727,7 +2002,7 @@ int ht_match_cell_op_str(str *sre, ht_t *ht, int mode, int op)
 	return -1;
 
 matched:
-	ht_slot_unlock(ht, i);
+	ht_slot_rdunlock(ht, i);
 	if(op == HT_RM_OP_RE) {
 		regfree(&re);
 	}
@@ -1746,6 +2021,8 @@ int ht_reset_content(ht_t *ht)
 	for(i = 0; i < ht->htsize; i++) {
 		/* free entries */
 		ht_slot_lock(ht, i);
+		if(HT_IS_COMPACT(ht))
+			ht_compact_reset_slot(ht, i);
 		it = ht->entries[i].first;
 		while(it) {
 			it0 = it->next;
@@ -1780,6 +2057,11 @@ int ht_count_cells_re(str *sre, ht_t *ht, int mode)
 
 	if(sre == NULL || sre->len <= 0 || ht == NULL)
 		return 0;
+	if(HT_IS_COMPACT(ht)) {
+		LM_ERR("operation not supported for compact htable [%.*s]\n",
+				ht->name.len, ht->name.s);
+		return 0;
+	}
 
 	if(sre->len >= 2) {
 		switch(sre->s[0]) {
@@ -1859,7 +2141,7 @@ int ht_count_cells_re(str *sre, ht_t *ht, int mode)
 	tnow = time(NULL);
 	for(i = 0; i < ht->htsize; i++) {
 		/* free entries */
-		ht_slot_lock(ht, i);
+		ht_slot_rdlock(ht, i);
 		it = ht->entries[i].first;
 		while(it) {
 			if(ht->htexpire > 0 && it->expire != 0 && it->expire < tnow) {
@@ -1910,7 +2192,7 @@ int ht_count_cells_re(str *sre, ht_t *ht, int mode)
 			}
 			it = it0;
 		}
-		ht_slot_unlock(ht, i);
+		ht_slot_rdunlock(ht, i);
 	}
 	if(op == 1)
 		regfree(&re);
@@ -1992,6 +2274,12 @@ int ht_iterator_start(str *iname, str *hname)
 		LM_ERR("cannot get hash table [%.*s]\n", hname->len, hname->s);
 		return -1;
 	}
+	if(HT_IS_COMPACT(_ht_iterators[k].ht)) {
+		LM_ERR("iterator not supported for compact htable [%.*s]\n",
+				hname->len, hname->s);
+		_ht_iterators[k].ht = NULL;
+		return -1;
+	}
 	return 0;
 }
 
@@ -2136,6 +2424,8 @@ int ht_iterator_sets(str *iname, str *sval)
 
 			if(_ht_iterators[k].ht->updateexpire) {
 				itb->expire = time(NULL) + _ht_iterators[k].ht->htexpire;
+				HT_SLOT_EXPIRE(_ht_iterators[k].ht, _ht_iterators[k].slot,
+						itb->expire);
 			}
 			return 0;
 		}
@@ -2157,6 +2447,7 @@ int ht_iterator_sets(str *iname, str *sval)
 	} else {
 		cell->expire = itb->expire;
 	}
+	HT_SLOT_EXPIRE(_ht_iterators[k].ht, _ht_iterators[k].slot, cell->expire);
 	if(itb->prev)
 		itb->prev->next = cell;
 	else
@@ -2198,6 +2489,8 @@ int ht_iterator_seti(str *iname, int ival)
 
 	if(_ht_iterators[k].ht->updateexpire) {
 		itb->expire = time(NULL) + _ht_iterators[k].ht->htexpire;
+		HT_SLOT_EXPIRE(
+				_ht_iterators[k].ht, _ht_iterators[k].slot, itb->expire);
 	}
 	return 0;
 }
@@ -2225,6 +2518,7 @@ int ht_iterator_setex(str *iname, int exval)
 
 	/* update expire */
 	itb->expire = time(NULL) + exval;
+	HT_SLOT_EXPIRE(_ht_iterators[k].ht, _ht_iterators[k].slot, itb->expire);
 
 	return 0;
 }
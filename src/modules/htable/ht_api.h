@@ -53,6 +53,10 @@ typedef struct _ht_entry
 	gen_lock_t lock;	 /* mutex to access items in the slot */
 	atomic_t locker_pid; /* pid of the process that holds the lock */
 	int rec_lock_level;	 /* recursive lock count */
+	atomic_t readers;	 /* readers inside the slot (rwlock tables) */
+	atomic_t rdwaiting;	 /* readers waiting for a writer (rwlock tables) */
+	time_t next_expire;	 /* lowest expire of the items, 0 if none */
+	unsigned int cspan;	 /* compact layout - positions holding the items */
 } ht_entry_t;
 
 #define HT_MAX_COLS 8
@@ -79,6 +83,17 @@ typedef struct _ht
 	str evex_name;
 	unsigned int reloadat;
 	time_t last_reload;
+	int rwlock;
+	atomic_t exp_slots;	   /* slots walked by the expire timer */
+	atomic_t exp_examined; /* items checked by the expire timer */
+	atomic_t exp_expired;  /* items removed by the expire timer */
+	unsigned int csize;	   /* compact layout - items per slot, 0 if unset */
+	unsigned int ckeysize; /* compact layout - max length of keys */
+	unsigned int cvalsize; /* compact layout - max length of str values */
+	unsigned int ccellsize; /* compact layout - size of an item */
+	char *cdata;			/* compact layout - items of all slots */
+	int snapshot;			/* save and restore content with snapshots */
+	int snapload;			/* content restored from snapshot */
 	int evex_reload_index;
 	char evex_reload_name_buf[HT_EVEX_NAME_SIZE];
 	str evex_reload_name;
@@ -95,7 +110,8 @@ typedef struct _ht_pv
 
 int ht_add_table(str *name, int autoexp, str *dbtable, str *dbcols, int size,
 		int dbmode, int itype, int_str *ival, int updateexpire,
-		int dmqreplicate, char coldelim, char colnull, int reloadat);
+		int dmqreplicate, char coldelim, char colnull, int reloadat,
+		int rwlock, int csize, int ckeysize, int cvalsize, int snapshot);
 int ht_init_tables(void);
 int ht_destroy(void);
 int ht_set_cell(ht_t *ht, str *name, int type, int_str *val, int mode);
@@ -158,6 +174,8 @@ ht_cell_t *ht_iterator_get_current(str *iname);
 
 void ht_slot_lock(ht_t *ht, int idx);
 void ht_slot_unlock(ht_t *ht, int idx);
+void ht_slot_rdlock(ht_t *ht, int idx);
+void ht_slot_rdunlock(ht_t *ht, int idx);
 
 #define HT_UPDATE_EXPIRE(ht, it, now)                                     \
 	do {                                                                  \
@@ -173,5 +191,15 @@ void ht_slot_unlock(ht_t *ht, int idx);
 			it->expire = src->expire;                                     \
 		}                                                                 \
 	} while(0)
+/* lowers the earliest expire time of slot idx to exp, the expire time
+ * set to an item of the slot, with the slot locked */
+#define HT_SLOT_EXPIRE(ht, idx, exp)                                    \
+	do {                                                                \
+		if((exp) != 0                                                   \
+				&& ((ht)->entries[idx].next_expire == 0                 \
+						|| (exp) < (ht)->entries[idx].next_expire)) {   \
+			(ht)->entries[idx].next_expire = (exp);                     \
+		}                                                               \
+	} while(0)
 
 #endif
@@ -0,0 +1,563 @@
+/**
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ * \brief compact layout of hash tables
+ *
+ * The items of the table are stored inline in one shm block, a fixed
+ * number of them after the position of each slot. The key and the value
+ * are kept in the item, up to the configured sizes. A slot adds its items
+ * in the first free positions after its own, over the items of the next
+ * slots when its items are used, so adding fails only when all the items
+ * of the table are used. Each item keeps the slot it belongs to, taken
+ * with an atomic operation as the slots have their own locks, and each
+ * slot keeps the number of positions after its own holding its items.
+ */
+
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/mem/mem.h"
+#include "../../core/hashes.h"
+#include "../../core/pvar.h"
+
+#include "ht_compact.h"
+
+static ht_cell_t *_ht_compact_expired = NULL;
+
+#define ht_compact_items(ht) ((size_t)(ht)->htsize * (ht)->csize)
+#define ht_compact_cell(ht, idx, pos)                                       \
+	((ht_ccell_t *)((ht)->cdata                                             \
+					+ (((size_t)(idx) * (ht)->csize + (pos))                \
+							  % ht_compact_items(ht))                       \
+							  * (ht)->ccellsize))
+#define ht_compact_key(c) ((char *)(c) + sizeof(ht_ccell_t))
+#define ht_compact_val(ht, c) (ht_compact_key(c) + (ht)->ckeysize + 1)
+
+/**
+ * allocate the items of a compact table
+ */
+int ht_compact_init(ht_t *ht)
+{
+	unsigned int vsize;
+	size_t dsize;
+
+	vsize = ht->cvalsize + 1;
+	if(vsize < sizeof(long))
+		vsize = sizeof(long);
+	ht->ccellsize = sizeof(ht_ccell_t) + ht->ckeysize + 1 + vsize;
+	ht->ccellsize = (ht->ccellsize + sizeof(long) - 1) & ~(sizeof(long) - 1);
+
+	dsize = ht_compact_items(ht) * ht->ccellsize;
+	ht->cdata = (char *)shm_malloc(dsize);
+	if(ht->cdata == NULL) {
+		SHM_MEM_ERROR_FMT("for compact htable [%.*s] (%lu bytes)\n",
+				ht->name.len, ht->name.s, (unsigned long)dsize);
+		return -1;
+	}
+	memset(ht->cdata, 0, dsize);
+	LM_DBG("compact htable [%.*s] - items: %lu item size: %u\n", ht->name.len,
+			ht->name.s, (unsigned long)ht_compact_items(ht), ht->ccellsize);
+	return 0;
+}
+
+void ht_compact_destroy(ht_t *ht)
+{
+	if(ht->cdata != NULL) {
+		shm_free(ht->cdata);
+		ht->cdata = NULL;
+	}
+}
+
+/**
+ * search the key in the items of the slot - the slot must be locked
+ * - return the position of the item or -1 if not found
+ */
+static int ht_compact_find(ht_t *ht, int idx, unsigned int hid, str *name)
+{
+	ht_ccell_t *c;
+	unsigned int pos;
+	unsigned int n;
+
+	n = 0;
+	for(pos = 0; pos < ht->entries[idx].cspan && n < ht->entries[idx].esize;
+			pos++) {
+		c = ht_compact_cell(ht, idx, pos);
+		if(atomic_get_int(&c->slot) != idx + 1)
+			continue;
+		n++;
+		if(c->cellid == hid && c->klen == name->len
+				&& memcmp(ht_compact_key(c), name->s, name->len) == 0) {
+			return (int)pos;
+		}
+	}
+	return -1;
+}
+
+/**
+ * take the first free item after the position of the slot - the slot must
+ * be locked
+ * - return the position of the item or -1 if the table is full
+ */
+static int ht_compact_claim(ht_t *ht, int idx)
+{
+	ht_ccell_t *c;
+	size_t pos;
+
+	for(pos = 0; pos < ht_compact_items(ht); pos++) {
+		c = ht_compact_cell(ht, idx, pos);
+		if(atomic_get_int(&c->slot) != 0
+				|| mb_atomic_cmpxchg_int(&c->slot, 0, idx + 1) != 0)
+			continue;
+		if(pos >= ht->entries[idx].cspan)
+			ht->entries[idx].cspan = (unsigned int)pos + 1;
+		ht->entries[idx].esize++;
+		return (int)pos;
+	}
+	return -1;
+}
+
+/**
+ * remove the item at position - the slot must be locked
+ */
+static void ht_compact_release(ht_t *ht, int idx, int pos)
+{
+	ht_entry_t *e;
+
+	e = &ht->entries[idx];
+	membar_write();
+	atomic_set_int(&ht_compact_cell(ht, idx, pos)->slot, 0);
+	e->esize--;
+	if(e->esize == 0) {
+		e->cspan = 0;
+		return;
+	}
+	while(e->cspan > 0
+			&& atomic_get_int(&ht_compact_cell(ht, idx, e->cspan - 1)->slot)
+					   != idx + 1)
+		e->cspan--;
+}
+
+static void ht_compact_set_value(
+		ht_t *ht, ht_ccell_t *c, int type, int_str *val)
+{
+	if(type & AVP_VAL_STR) {
+		c->flags = AVP_VAL_STR;
+		c->vlen = val->s.len;
+		memcpy(ht_compact_val(ht, c), val->s.s, val->s.len);
+		ht_compact_val(ht, c)[val->s.len] = '\0';
+	} else {
+		c->flags = 0;
+		c->vlen = 0;
+		memcpy(ht_compact_val(ht, c), &val->n, sizeof(val->n));
+	}
+}
+
+/**
+ * clone the item in a pkg cell, reusing old if it is large enough
+ */
+static ht_cell_t *ht_compact_cell_clone(ht_t *ht, ht_ccell_t *c, ht_cell_t *old)
+{
+	ht_cell_t *cell;
+	unsigned int msize;
+
+	msize = sizeof(ht_cell_t) + c->klen + 1;
+	if(c->flags & AVP_VAL_STR)
+		msize += c->vlen + 1;
+	if(old != NULL && old->msize >= msize) {
+		cell = old;
+		msize = old->msize;
+	} else {
+		cell = (ht_cell_t *)pkg_malloc(msize);
+		if(cell == NULL) {
+			PKG_MEM_ERROR;
+			return NULL;
+		}
+	}
+	memset(cell, 0, sizeof(ht_cell_t));
+	cell->msize = msize;
+	cell->cellid = c->cellid;
+	cell->flags = c->flags;
+	cell->expire = c->expire;
+	cell->name.s = (char *)cell + sizeof(ht_cell_t);
+	cell->name.len = c->klen;
+	memcpy(cell->name.s, ht_compact_key(c), c->klen);
+	cell->name.s[c->klen] = '\0';
+	if(c->flags & AVP_VAL_STR) {
+		cell->value.s.s = cell->name.s + c->klen + 1;
+		cell->value.s.len = c->vlen;
+		memcpy(cell->value.s.s, ht_compact_val(ht, c), c->vlen);
+		cell->value.s.s[c->vlen] = '\0';
+	} else {
+		memcpy(&cell->value.n, ht_compact_val(ht, c), sizeof(cell->value.n));
+	}
+	return cell;
+}
+
+static inline int ht_compact_expired(ht_t *ht, ht_ccell_t *c, time_t now)
+{
+	return (ht->htexpire > 0 && c->expire != 0 && (time_t)c->expire < now);
+}
+
+int ht_compact_set_cell(
+		ht_t *ht, str *name, int type, int_str *val, int mode, int exv)
+{
+	unsigned int idx;
+	unsigned int hid;
+	ht_ccell_t *c;
+	time_t now;
+	int pos;
+
+	if(name->len > ht->ckeysize) {
+		LM_ERR("key too long for compact htable [%.*s] (%d > %u)\n",
+				ht->name.len, ht->name.s, name->len, ht->ckeysize);
+		return -1;
+	}
+	if((type & AVP_VAL_STR) && val->s.len > ht->cvalsize) {
+		LM_ERR("value too long for compact htable [%.*s] (%d > %u)\n",
+				ht->name.len, ht->name.s, val->s.len, ht->cvalsize);
+		return -1;
+	}
+	hid = ht_compute_hash(name);
+	idx = ht_get_entry(hid, ht->htsize);
+
+	now = 0;
+	if(ht->htexpire > 0)
+		now = time(NULL);
+	if(mode)
+		ht_slot_lock(ht, idx);
+	pos = ht_compact_find(ht, idx, hid, name);
+	if(pos >= 0) {
+		c = ht_compact_cell(ht, idx, pos);
+		ht_compact_set_value(ht, c, type, val);
+		if(exv > 0) {
+			c->expire = (unsigned int)(now + exv);
+		} else if(ht->updateexpire
+				  || (now && c->expire && (time_t)c->expire < now)) {
+			c->expire = (unsigned int)(now + ht->htexpire);
+		}
+		HT_SLOT_EXPIRE(ht, idx, (time_t)c->expire);
+		if(mode)
+			ht_slot_unlock(ht, idx);
+		return 0;
+	}
+	pos = ht_compact_claim(ht, idx);
+	if(pos < 0) {
+		LM_ERR("compact htable [%.*s] is full\n", ht->name.len, ht->name.s);
+		if(mode)
+			ht_slot_unlock(ht, idx);
+		return -1;
+	}
+	c = ht_compact_cell(ht, idx, pos);
+	c->cellid = hid;
+	c->klen = name->len;
+	memcpy(ht_compact_key(c), name->s, name->len);
+	ht_compact_key(c)[name->len] = '\0';
+	ht_compact_set_value(ht, c, type, val);
+	c->expire = (unsigned int)(now + ((exv > 0) ? exv : ht->htexpire));
+	HT_SLOT_EXPIRE(ht, idx, (time_t)c->expire);
+	if(mode)
+		ht_slot_unlock(ht, idx);
+	return 0;
+}
+
+int ht_compact_del_cell(ht_t *ht, str *name)
+{
+	unsigned int idx;
+	unsigned int hid;
+	int pos;
+
+	hid = ht_compute_hash(name);
+	idx = ht_get_entry(hid, ht->htsize);
+
+	/* head test and return */
+	if(ht->entries[idx].esize == 0)
+		return 0;
+
+	ht_slot_lock(ht, idx);
+	pos = ht_compact_find(ht, idx, hid, name);
+	if(pos < 0) {
+		ht_slot_unlock(ht, idx);
+		return 0;
+	}
+	ht_compact_release(ht, idx, pos);
+	ht_slot_unlock(ht, idx);
+	return 1;
+}
+
+ht_cell_t *ht_compact_value_add(ht_t *ht, str *name, int val, ht_cell_t *old)
+{
+	unsigned int idx;
+	unsigned int hid;
+	ht_ccell_t *c;
+	ht_cell_t *cell;
+	int_str isval;
+	time_t now;
+	long n;
+	int pos;
+
+	if(name->len > ht->ckeysize) {
+		LM_ERR("key too long for compact htable [%.*s] (%d > %u)\n",
+				ht->name.len, ht->name.s, name->len, ht->ckeysize);
+		return NULL;
+	}
+	hid = ht_compute_hash(name);
+	idx = ht_get_entry(hid, ht->htsize);
+
+	now = 0;
+	if(ht->htexpire > 0)
+		now = time(NULL);
+	ht_slot_lock(ht, idx);
+	pos = ht_compact_find(ht, idx, hid, name);
+	if(pos >= 0) {
+		c = ht_compact_cell(ht, idx, pos);
+		if(now > 0 && c->expire != 0 && (time_t)c->expire < now) {
+			/* entry has expired */
+			c->expire = (unsigned int)(now + ht->htexpire);
+			HT_SLOT_EXPIRE(ht, idx, (time_t)c->expire);
+			if(ht->flags != PV_VAL_INT) {
+				ht_slot_unlock(ht, idx);
+				return NULL;
+			}
+			/* initval is integer, use it to create a fresh entry */
+			isval.n = ht->initval.n;
+			ht_compact_set_value(ht, c, 0, &isval);
+		}
+		if(c->flags & AVP_VAL_STR) {
+			/* string value cannot be incremented */
+			ht_slot_unlock(ht, idx);
+			return NULL;
+		}
+		memcpy(&n, ht_compact_val(ht, c), sizeof(n));
+		n += val;
+		memcpy(ht_compact_val(ht, c), &n, sizeof(n));
+		if(ht->updateexpire) {
+			c->expire = (unsigned int)(now + ht->htexpire);
+			HT_SLOT_EXPIRE(ht, idx, (time_t)c->expire);
+		}
+		cell = ht_compact_cell_clone(ht, c, old);
+		ht_slot_unlock(ht, idx);
+		return cell;
+	}
+	/* add val if htable has an integer init value */
+	if(ht->flags != PV_VAL_INT) {
+		ht_slot_unlock(ht, idx);
+		return NULL;
+	}
+	pos = ht_compact_claim(ht, idx);
+	if(pos < 0) {
+		LM_ERR("compact htable [%.*s] is full\n", ht->name.len, ht->name.s);
+		ht_slot_unlock(ht, idx);
+		return NULL;
+	}
+	c = ht_compact_cell(ht, idx, pos);
+	c->cellid = hid;
+	c->klen = name->len;
+	memcpy(ht_compact_key(c), name->s, name->len);
+	ht_compact_key(c)[name->len] = '\0';
+	isval.n = ht->initval.n + val;
+	ht_compact_set_value(ht, c, 0, &isval);
+	c->expire = (unsigned int)(now + ht->htexpire);
+	HT_SLOT_EXPIRE(ht, idx, (time_t)c->expire);
+	cell = ht_compact_cell_clone(ht, c, old);
+	ht_slot_unlock(ht, idx);
+	return cell;
+}
+
+ht_cell_t *ht_compact_pkg_copy(ht_t *ht, str *name, ht_cell_t *old)
+{
+	unsigned int idx;
+	unsigned int hid;
+	ht_ccell_t *c;
+	ht_cell_t *cell;
+	int pos;
+
+	hid = ht_compute_hash(name);
+	idx = ht_get_entry(hid, ht->htsize);
+
+	/* head test and return */
+	if(ht->entries[idx].esize == 0)
+		return NULL;
+
+	ht_slot_rdlock(ht, idx);
+	pos = ht_compact_find(ht, idx, hid, name);
+	if(pos < 0) {
+		ht_slot_rdunlock(ht, idx);
+		return NULL;
+	}
+	c = ht_compact_cell(ht, idx, pos);
+	if(ht_compact_expired(ht, c, time(NULL))) {
+		/* entry has expired, return NULL */
+		ht_slot_rdunlock(ht, idx);
+		return NULL;
+	}
+	cell = ht_compact_cell_clone(ht, c, old);
+	ht_slot_rdunlock(ht, idx);
+	return cell;
+}
+
+int ht_compact_cell_exists(ht_t *ht, str *name)
+{
+	unsigned int idx;
+	unsigned int hid;
+	int pos;
+	int ret;
+
+	hid = ht_compute_hash(name);
+	idx = ht_get_entry(hid, ht->htsize);
+
+	/* head test and return */
+	if(ht->entries[idx].esize == 0)
+		return 0;
+
+	ht_slot_rdlock(ht, idx);
+	pos = ht_compact_find(ht, idx, hid, name);
+	ret = 0;
+	if(pos >= 0
+			&& !ht_compact_expired(
+					ht, ht_compact_cell(ht, idx, pos), time(NULL))) {
+		ret = 1;
+	}
+	ht_slot_rdunlock(ht, idx);
+	return ret;
+}
+
+int ht_compact_set_expire(ht_t *ht, str *name, time_t expire)
+{
+	unsigned int idx;
+	unsigned int hid;
+	int pos;
+
+	hid = ht_compute_hash(name);
+	idx = ht_get_entry(hid, ht->htsize);
+
+	ht_slot_lock(ht, idx);
+	pos = ht_compact_find(ht, idx, hid, name);
+	if(pos >= 0) {
+		ht_compact_cell(ht, idx, pos)->expire = (unsigned int)expire;
+		HT_SLOT_EXPIRE(ht, idx, expire);
+	}
+	ht_slot_unlock(ht, idx);
+	return 0;
+}
+
+int ht_compact_get_expire(ht_t *ht, str *name, unsigned int *val)
+{
+	unsigned int idx;
+	unsigned int hid;
+	time_t now;
+	int pos;
+
+	hid = ht_compute_hash(name);
+	idx = ht_get_entry(hid, ht->htsize);
+
+	now = time(NULL);
+	ht_slot_rdlock(ht, idx);
+	pos = ht_compact_find(ht, idx, hid, name);
+	if(pos >= 0) {
+		*val = (unsigned int)(ht_compact_cell(ht, idx, pos)->expire - now);
+	}
+	ht_slot_rdunlock(ht, idx);
+	return 0;
+}
+
+/**
+ * remove the expired items of the slot - the slot must be locked
+ * - nexp is set to the lowest expire of the items left in the slot
+ */
+void ht_compact_expire_slot(ht_t *ht, int idx, time_t now, int *nexamined,
+		int *nexpired, time_t *nexp)
+{
+	ht_ccell_t *c;
+	ht_cell_t *cell;
+	unsigned int pos;
+
+	*nexp = 0;
+	for(pos = 0; pos < ht->entries[idx].cspan; pos++) {
+		c = ht_compact_cell(ht, idx, pos);
+		if(atomic_get_int(&c->slot) != idx + 1)
+			continue;
+		(*nexamined)++;
+		if(c->expire != 0 && (time_t)c->expire < now) {
+			/* expired */
+			cell = ht_compact_cell_clone(ht, c, _ht_compact_expired);
+			if(cell != NULL) {
+				_ht_compact_expired = cell;
+				ht_handle_expired_record(ht, cell);
+			}
+			if(atomic_get_int(&c->slot) == idx + 1 && c->expire != 0
+					&& (time_t)c->expire < now) {
+				ht_compact_release(ht, idx, pos);
+				(*nexpired)++;
+				continue;
+			}
+		}
+		if(atomic_get_int(&c->slot) == idx + 1 && c->expire != 0
+				&& (*nexp == 0 || (time_t)c->expire < *nexp))
+			*nexp = c->expire;
+	}
+}
+
+/**
+ * drop all items of the slot - the slot must be locked
+ */
+void ht_compact_reset_slot(ht_t *ht, int idx)
+{
+	unsigned int pos;
+
+	for(pos = 0; pos < ht->entries[idx].cspan; pos++) {
+		if(atomic_get_int(&ht_compact_cell(ht, idx, pos)->slot) == idx + 1)
+			atomic_set_int(&ht_compact_cell(ht, idx, pos)->slot, 0);
+	}
+	ht->entries[idx].esize = 0;
+	ht->entries[idx].cspan = 0;
+}
+
+/**
+ * get the item at position after the one of the slot - the slot must be
+ * locked, positions of its items are below the cspan of the slot
+ * - name and string value point inside the item
+ * - return 0 if the item is used, -1 otherwise
+ */
+int ht_compact_get_item(ht_t *ht, int idx, int pos, str *name, int_str *val,
+		int *flags, time_t *expire)
+{
+	ht_ccell_t *c;
+
+	if(pos < 0 || (unsigned int)pos >= ht->entries[idx].cspan)
+		return -1;
+	c = ht_compact_cell(ht, idx, pos);
+	if(atomic_get_int(&c->slot) != idx + 1)
+		return -1;
+	name->s = ht_compact_key(c);
+	name->len = c->klen;
+	*flags = c->flags;
+	if(expire != NULL)
+		*expire = c->expire;
+	if(c->flags & AVP_VAL_STR) {
+		val->s.s = ht_compact_val(ht, c);
+		val->s.len = c->vlen;
+	} else {
+		memcpy(&val->n, ht_compact_val(ht, c), sizeof(val->n));
+	}
+	return 0;
+}
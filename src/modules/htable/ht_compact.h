@@ -0,0 +1,65 @@
+/**
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HT_COMPACT_H_
+#define _HT_COMPACT_H_
+
+#include "ht_api.h"
+
+#define HT_COMPACT_KEYSIZE 32
+#define HT_COMPACT_VALSIZE 32
+#define HT_COMPACT_MAXSIZE 4096
+
+/**
+ * header of an item in compact tables, followed in the same block by the
+ * key (keysize+1 bytes) and the value (valsize+1 bytes or a long)
+ */
+typedef struct _ht_ccell
+{
+	int slot; /* index of the slot owning the item plus 1, 0 if free */
+	unsigned int cellid;
+	unsigned int expire;
+	unsigned short klen;
+	unsigned short vlen;
+	unsigned char flags;
+} ht_ccell_t;
+
+#define HT_IS_COMPACT(ht) ((ht)->csize > 0)
+
+int ht_compact_init(ht_t *ht);
+void ht_compact_destroy(ht_t *ht);
+
+int ht_compact_set_cell(
+		ht_t *ht, str *name, int type, int_str *val, int mode, int exv);
+int ht_compact_del_cell(ht_t *ht, str *name);
+ht_cell_t *ht_compact_value_add(ht_t *ht, str *name, int val, ht_cell_t *old);
+ht_cell_t *ht_compact_pkg_copy(ht_t *ht, str *name, ht_cell_t *old);
+int ht_compact_cell_exists(ht_t *ht, str *name);
+int ht_compact_set_expire(ht_t *ht, str *name, time_t expire);
+int ht_compact_get_expire(ht_t *ht, str *name, unsigned int *val);
+
+void ht_compact_expire_slot(ht_t *ht, int idx, time_t now, int *nexamined,
+		int *nexpired, time_t *nexp);
+void ht_compact_reset_slot(ht_t *ht, int idx);
+int ht_compact_get_item(ht_t *ht, int idx, int pos, str *name, int_str *val,
+		int *flags, time_t *expire);
+
+#endif
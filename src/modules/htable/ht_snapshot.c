@@ -0,0 +1,371 @@
+/**
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ * \brief binary snapshots of hash tables
+ *
+ * The items of a table are written in a file with a fixed size header
+ * per item followed by the key and the string value. The file is mapped
+ * in memory at startup and the items are added directly to the table.
+ * The format uses the byte order and sizes of the host.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/mem.h"
+#include "../../core/ut.h"
+#include "../../core/pt.h"
+
+#include "ht_snapshot.h"
+#include "ht_compact.h"
+
+#define HT_SNAPSHOT_MAGIC "KHTS"
+#define HT_SNAPSHOT_VERSION 1
+#define HT_SNAPSHOT_SUFFIX ".htsnap"
+#define HT_SNAPSHOT_ALIGN(x) (((x) + 7) & ~((size_t)7))
+
+str ht_snapshot_dir = STR_NULL;
+
+typedef struct ht_snapshot_hdr
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t nitems;
+	uint32_t htsize;
+	int64_t created;
+} ht_snapshot_hdr_t;
+
+typedef struct ht_snapshot_rec
+{
+	uint32_t klen;
+	uint32_t vlen;
+	int32_t flags;
+	uint32_t reserved;
+	int64_t expire;
+	int64_t n;
+} ht_snapshot_rec_t;
+
+/**
+ * build the path of the snapshot file of a table
+ */
+static int ht_snapshot_path(ht_t *ht, char *tmp, char *buf, int size)
+{
+	int n;
+
+	n = snprintf(buf, size, "%.*s/%.*s%s%s", ht_snapshot_dir.len,
+			ht_snapshot_dir.s, ht->name.len, ht->name.s, HT_SNAPSHOT_SUFFIX,
+			(tmp != NULL) ? tmp : "");
+	if(n < 0 || n >= size) {
+		LM_ERR("snapshot path too long for htable [%.*s]\n", ht->name.len,
+				ht->name.s);
+		return -1;
+	}
+	return 0;
+}
+
+static int ht_snapshot_write_item(FILE *f, str *name, int flags, int_str *val,
+		time_t expire)
+{
+	static char pad[8] = {0};
+	ht_snapshot_rec_t rec;
+	size_t len;
+
+	memset(&rec, 0, sizeof(ht_snapshot_rec_t));
+	rec.klen = name->len;
+	rec.flags = flags;
+	rec.expire = expire;
+	if(flags & AVP_VAL_STR) {
+		rec.vlen = val->s.len;
+	} else {
+		rec.n = val->n;
+	}
+	len = name->len + rec.vlen;
+	if(fwrite(&rec, sizeof(ht_snapshot_rec_t), 1, f) != 1)
+		return -1;
+	if(name->len > 0 && fwrite(name->s, name->len, 1, f) != 1)
+		return -1;
+	if(rec.vlen > 0 && fwrite(val->s.s, rec.vlen, 1, f) != 1)
+		return -1;
+	if(HT_SNAPSHOT_ALIGN(len) > len
+			&& fwrite(pad, HT_SNAPSHOT_ALIGN(len) - len, 1, f) != 1)
+		return -1;
+	return 0;
+}
+
+/**
+ * write the items of the table in the snapshot file
+ * - the file is written with a temporary name and renamed at the end, the
+ *   name being unique to the process and the call, as several processes
+ *   can save the same table at once (e.g., htable.snapshot rpc commands)
+ */
+int ht_snapshot_save(ht_t *ht)
+{
+	static unsigned int tcount = 0;
+	char path[512];
+	char tpath[512];
+	char tsuffix[32];
+	ht_snapshot_hdr_t hdr;
+	ht_cell_t *it;
+	str name;
+	int_str val;
+	time_t expire;
+	int flags;
+	FILE *f;
+	int i;
+	int k;
+
+	if(ht_snapshot_dir.len <= 0 || ht->entries == NULL)
+		return -1;
+	snprintf(tsuffix, sizeof(tsuffix), ".tmp.%d.%u", my_pid(), ++tcount);
+	if(ht_snapshot_path(ht, NULL, path, sizeof(path)) < 0
+			|| ht_snapshot_path(ht, tsuffix, tpath, sizeof(tpath)) < 0)
+		return -1;
+
+	f = fopen(tpath, "w");
+	if(f == NULL) {
+		LM_ERR("cannot open snapshot file [%s] (%d/%s)\n", tpath, errno,
+				strerror(errno));
+		return -1;
+	}
+	setvbuf(f, NULL, _IOFBF, 64 * 1024);
+
+	memset(&hdr, 0, sizeof(ht_snapshot_hdr_t));
+	memcpy(hdr.magic, HT_SNAPSHOT_MAGIC, 4);
+	hdr.version = HT_SNAPSHOT_VERSION;
+	hdr.htsize = ht->htsize;
+	hdr.created = (int64_t)time(NULL);
+	if(fwrite(&hdr, sizeof(ht_snapshot_hdr_t), 1, f) != 1)
+		goto error;
+
+	for(i = 0; i < ht->htsize; i++) {
+		ht_slot_rdlock(ht, i);
+		if(HT_IS_COMPACT(ht)) {
+			for(k = 0; k < ht->entries[i].cspan; k++) {
+				if(ht_compact_get_item(ht, i, k, &name, &val, &flags, &expire)
+						< 0)
+					continue;
+				if(ht_snapshot_write_item(f, &name, flags, &val, expire) < 0) {
+					ht_slot_rdunlock(ht, i);
+					goto error;
+				}
+				hdr.nitems++;
+			}
+		}
+		for(it = ht->entries[i].first; it != NULL; it = it->next) {
+			if(ht_snapshot_write_item(
+					   f, &it->name, it->flags, &it->value, it->expire)
+					< 0) {
+				ht_slot_rdunlock(ht, i);
+				goto error;
+			}
+			hdr.nitems++;
+		}
+		ht_slot_rdunlock(ht, i);
+	}
+
+	if(fseek(f, 0, SEEK_SET) != 0
+			|| fwrite(&hdr, sizeof(ht_snapshot_hdr_t), 1, f) != 1)
+		goto error;
+	if(fclose(f) != 0) {
+		f = NULL;
+		goto error;
+	}
+	if(rename(tpath, path) < 0) {
+		LM_ERR("cannot rename snapshot file [%s] (%d/%s)\n", tpath, errno,
+				strerror(errno));
+		unlink(tpath);
+		return -1;
+	}
+	LM_DBG("htable [%.*s] - %u items written in snapshot [%s]\n",
+			ht->name.len, ht->name.s, hdr.nitems, path);
+	return 0;
+
+error:
+	LM_ERR("failed writing snapshot file [%s] (%d/%s)\n", tpath, errno,
+			strerror(errno));
+	if(f != NULL)
+		fclose(f);
+	unlink(tpath);
+	return -1;
+}
+
+/**
+ * add the items from the snapshot file to the table
+ * - items expired meanwhile are skipped
+ * - return 1 if items were loaded, 0 if no snapshot file, -1 on error
+ */
+int ht_snapshot_load(ht_t *ht)
+{
+	char path[512];
+	ht_snapshot_hdr_t *hdr;
+	ht_snapshot_rec_t *rec;
+	struct stat st;
+	char *map;
+	char *p;
+	char *end;
+	str name;
+	int_str val;
+	int_str eval;
+	time_t now;
+	unsigned int n;
+	unsigned int nload;
+	int exv;
+	int fd;
+	int ret;
+
+	if(ht_snapshot_dir.len <= 0 || ht->entries == NULL)
+		return -1;
+	if(ht_snapshot_path(ht, NULL, path, sizeof(path)) < 0)
+		return -1;
+
+	fd = open(path, O_RDONLY);
+	if(fd < 0) {
+		if(errno == ENOENT) {
+			LM_DBG("no snapshot file [%s]\n", path);
+			return 0;
+		}
+		LM_ERR("cannot open snapshot file [%s] (%d/%s)\n", path, errno,
+				strerror(errno));
+		return -1;
+	}
+	if(fstat(fd, &st) < 0 || st.st_size < sizeof(ht_snapshot_hdr_t)) {
+		LM_ERR("invalid snapshot file [%s]\n", path);
+		close(fd);
+		return -1;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED) {
+		LM_ERR("cannot map snapshot file [%s] (%d/%s)\n", path, errno,
+				strerror(errno));
+		return -1;
+	}
+	madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+	ret = -1;
+	hdr = (ht_snapshot_hdr_t *)map;
+	if(memcmp(hdr->magic, HT_SNAPSHOT_MAGIC, 4) != 0
+			|| hdr->version != HT_SNAPSHOT_VERSION) {
+		LM_ERR("invalid snapshot file format [%s]\n", path);
+		goto done;
+	}
+
+	now = time(NULL);
+	nload = 0;
+	p = map + sizeof(ht_snapshot_hdr_t);
+	end = map + st.st_size;
+	for(n = 0; n < hdr->nitems; n++) {
+		rec = (ht_snapshot_rec_t *)p;
+		if(p + sizeof(ht_snapshot_rec_t) > end
+				|| p + sizeof(ht_snapshot_rec_t)
+								   + HT_SNAPSHOT_ALIGN(
+										   (size_t)rec->klen + rec->vlen)
+						   > end) {
+			LM_ERR("truncated snapshot file [%s] at item %u\n", path, n);
+			goto done;
+		}
+		p += sizeof(ht_snapshot_rec_t);
+		name.s = p;
+		name.len = rec->klen;
+		p += HT_SNAPSHOT_ALIGN((size_t)rec->klen + rec->vlen);
+		if(ht->htexpire > 0 && rec->expire != 0 && rec->expire <= now) {
+			/* expired while being stored */
+			continue;
+		}
+		if(rec->flags & AVP_VAL_STR) {
+			val.s.s = name.s + rec->klen;
+			val.s.len = rec->vlen;
+		} else {
+			val.n = (long)rec->n;
+		}
+		exv = 0;
+		if(ht->htexpire > 0 && rec->expire != 0)
+			exv = (int)(rec->expire - now);
+		if(ht_set_cell_ex(ht, &name, rec->flags & AVP_VAL_STR, &val, 1, exv)
+				< 0) {
+			LM_ERR("cannot add item [%.*s] from snapshot [%s]\n", name.len,
+					name.s, path);
+			goto done;
+		}
+		if(ht->htexpire > 0 && rec->expire == 0) {
+			/* item without expire time */
+			eval.n = 0;
+			ht_set_cell_expire(ht, &name, 0, &eval);
+		}
+		nload++;
+	}
+	LM_INFO("htable [%.*s] - %u items loaded from snapshot [%s] (%u "
+			"expired)\n",
+			ht->name.len, ht->name.s, nload, path, hdr->nitems - nload);
+	ret = 1;
+
+done:
+	munmap(map, st.st_size);
+	return ret;
+}
+
+int ht_snapshot_save_tables(void)
+{
+	ht_t *ht;
+	int ret;
+
+	ret = 0;
+	for(ht = ht_get_root(); ht != NULL; ht = ht->next) {
+		if(ht->snapshot == 0)
+			continue;
+		if(ht_snapshot_save(ht) < 0) {
+			LM_ERR("failed saving snapshot of htable [%.*s]\n", ht->name.len,
+					ht->name.s);
+			ret = -1;
+		}
+	}
+	return ret;
+}
+
+int ht_snapshot_load_tables(void)
+{
+	ht_t *ht;
+	int ret;
+
+	for(ht = ht_get_root(); ht != NULL; ht = ht->next) {
+		if(ht->snapshot == 0)
+			continue;
+		ret = ht_snapshot_load(ht);
+		if(ret < 0) {
+			LM_ERR("failed loading snapshot of htable [%.*s]\n", ht->name.len,
+					ht->name.s);
+			return -1;
+		}
+		if(ret > 0) {
+			/* content restored, no initial load from database */
+			ht->snapload = 1;
+		}
+	}
+	return 0;
+}
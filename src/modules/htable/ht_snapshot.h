@@ -0,0 +1,34 @@
+/**
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _HT_SNAPSHOT_H_
+#define _HT_SNAPSHOT_H_
+
+#include "ht_api.h"
+
+extern str ht_snapshot_dir;
+
+int ht_snapshot_save(ht_t *ht);
+int ht_snapshot_load(ht_t *ht);
+int ht_snapshot_save_tables(void);
+int ht_snapshot_load_tables(void);
+
+#endif
@@ -47,6 +47,8 @@
 #include "ht_var.h"
 #include "api.h"
 #include "ht_dmq.h"
+#include "ht_compact.h"
+#include "ht_snapshot.h"
 
 
 MODULE_VERSION
@@ -196,6 +198,7 @@ static param_export_t params[] = {
 	{"event_callback", PARAM_STR, &ht_event_callback},
 	{"event_callback_mode", PARAM_INT, &ht_event_callback_mode},
 	{"dmq_peer_id", PARAM_STR, &ht_dmq_peer_id},
+	{"snapshot_dir", PARAM_STR, &ht_snapshot_dir},
 	{0, 0, 0}
 };
 
@@ -229,6 +232,9 @@ static int mod_init(void)
 		return -1;
 	ht_db_init_params();
 
+	if(ht_snapshot_dir.len > 0 && ht_snapshot_load_tables() != 0)
+		return -1;
+
 	if(ht_db_url.len > 0) {
 		if(ht_db_init_con() != 0)
 			return -1;
@@ -347,6 +353,10 @@ done:
  */
 static void destroy(void)
 {
+	/* save snapshots */
+	if(ht_snapshot_dir.len > 0) {
+		ht_snapshot_save_tables();
+	}
 	/* sync back to db */
 	if(ht_db_url.len > 0) {
 		if(ht_db_init_con() == 0) {
@@ -1656,6 +1666,10 @@ static const char *htable_store_doc[2] = {
 	"Store hash table to database.",
 	0
 };
+static const char *htable_snapshot_doc[2] = {
+	"Save hash table to snapshot file.",
+	0
+};
 static const char *htable_dmqsync_doc[2] = {
 	"Perform DMQ sync action.",
 	0
@@ -1915,6 +1929,64 @@ static void htable_rpc_setxi(rpc_t *rpc, void *c)
 }
 
 /*! \brief RPC htable.dump command to print content of a hash table */
+static void htable_rpc_dump_compact(rpc_t *rpc, void *c, ht_t *ht)
+{
+	str name;
+	int_str val;
+	int flags;
+	int i;
+	int k;
+	void *th;
+	void *ih;
+	void *vh;
+
+	for(i = 0; i < ht->htsize; i++) {
+		ht_slot_rdlock(ht, i);
+		if(ht->entries[i].esize > 0) {
+			/* add entry node */
+			if(rpc->add(c, "{", &th) < 0) {
+				rpc->fault(c, 500, "Internal error creating rpc");
+				goto error;
+			}
+			if(rpc->struct_add(th, "dd[", "entry", i, "size",
+					   (int)ht->entries[i].esize, "slot", &ih)
+					< 0) {
+				rpc->fault(c, 500, "Internal error creating rpc");
+				goto error;
+			}
+			for(k = 0; k < ht->entries[i].cspan; k++) {
+				if(ht_compact_get_item(ht, i, k, &name, &val, &flags, NULL) < 0)
+					continue;
+				if(rpc->array_add(ih, "{", &vh) < 0) {
+					rpc->fault(c, 500, "Internal error creating rpc");
+					goto error;
+				}
+				if(flags & AVP_VAL_STR) {
+					if(rpc->struct_add(vh, "SSs", "name", &name, "value",
+							   &val.s, "type", "str")
+							< 0) {
+						rpc->fault(c, 500, "Internal error adding item");
+						goto error;
+					}
+				} else {
+					if(rpc->struct_add(vh, "Sds", "name", &name, "value",
+							   (int)val.n, "type", "int")
+							< 0) {
+						rpc->fault(c, 500, "Internal error adding item");
+						goto error;
+					}
+				}
+			}
+		}
+		ht_slot_rdunlock(ht, i);
+	}
+
+	return;
+
+error:
+	ht_slot_rdunlock(ht, i);
+}
+
 static void htable_rpc_dump(rpc_t *rpc, void *c)
 {
 	str htname;
@@ -1934,8 +2006,12 @@ static void htable_rpc_dump(rpc_t *rpc, void *c)
 		rpc->fault(c, 500, "No such htable");
 		return;
 	}
+	if(HT_IS_COMPACT(ht)) {
+		htable_rpc_dump_compact(rpc, c, ht);
+		return;
+	}
 	for(i = 0; i < ht->htsize; i++) {
-		ht_slot_lock(ht, i);
+		ht_slot_rdlock(ht, i);
 		it = ht->entries[i].first;
 		if(it) {
 			/* add entry node */
@@ -1972,13 +2048,13 @@ static void htable_rpc_dump(rpc_t *rpc, void *c)
 				it = it->next;
 			}
 		}
-		ht_slot_unlock(ht, i);
+		ht_slot_rdunlock(ht, i);
 	}
 
 	return;
 
 error:
-	ht_slot_unlock(ht, i);
+	ht_slot_rdunlock(ht, i);
 }
 
 static void htable_rpc_list(rpc_t *rpc, void *c)
@@ -2007,13 +2083,15 @@ static void htable_rpc_list(rpc_t *rpc, void *c)
 			dbname[0] = '\0';
 		}
 
-		if(rpc->struct_add(th, "Ssddddd", "name", &ht->name, /* String */
-				   "dbtable", &dbname,						 /* Char * */
-				   "dbmode", (int)ht->dbmode,				 /* u int */
-				   "expire", (int)ht->htexpire,				 /* u int */
-				   "updateexpire", ht->updateexpire,		 /* int */
-				   "size", (int)ht->htsize,					 /* u int */
-				   "dmqreplicate", ht->dmqreplicate			 /* int */
+		if(rpc->struct_add(th, "Ssddddddd", "name", &ht->name, /* String */
+				   "dbtable", &dbname,						   /* Char * */
+				   "dbmode", (int)ht->dbmode,				   /* u int */
+				   "expire", (int)ht->htexpire,				   /* u int */
+				   "updateexpire", ht->updateexpire,		   /* int */
+				   "size", (int)ht->htsize,					   /* u int */
+				   "dmqreplicate", ht->dmqreplicate,		   /* int */
+				   "rwlock", ht->rwlock,					   /* int */
+				   "compact", (int)ht->csize				   /* u int */
 				   )
 				< 0) {
 			rpc->fault(c, 500, "Internal error creating data rpc");
@@ -2050,20 +2128,24 @@ static void htable_rpc_stats(rpc_t *rpc, void *c)
 		max = 0;
 		min = 4294967295U;
 		for(i = 0; i < ht->htsize; i++) {
-			ht_slot_lock(ht, i);
+			ht_slot_rdlock(ht, i);
 			if(ht->entries[i].esize < min)
 				min = ht->entries[i].esize;
 			if(ht->entries[i].esize > max)
 				max = ht->entries[i].esize;
 			all += ht->entries[i].esize;
-			ht_slot_unlock(ht, i);
+			ht_slot_rdunlock(ht, i);
 		}
 
-		if(rpc->struct_add(th, "Sdddd", "name", &ht->name, /* str */
-				   "slots", (int)ht->htsize,			   /* uint */
-				   "all", (int)all,						   /* uint */
-				   "min", (int)min,						   /* uint */
-				   "max", (int)max						   /* uint */
+		if(rpc->struct_add(th, "Sddddddd", "name", &ht->name, /* str */
+				   "slots", (int)ht->htsize,				  /* uint */
+				   "all", (int)all,							  /* uint */
+				   "min", (int)min,							  /* uint */
+				   "max", (int)max,							  /* uint */
+				   "expire_slots", atomic_get(&ht->exp_slots),  /* int */
+				   "expire_examined",
+				   atomic_get(&ht->exp_examined),		   /* int */
+				   "expire_expired", atomic_get(&ht->exp_expired) /* int */
 				   )
 				< 0) {
 			rpc->fault(c, 500, "Internal error creating rpc structure");
@@ -2257,6 +2339,33 @@ static void htable_rpc_store(rpc_t *rpc, void *c)
 	return;
 }
 
+/*! \brief RPC htable.snapshot command to save a hash table to snapshot file */
+static void htable_rpc_snapshot(rpc_t *rpc, void *c)
+{
+	str htname;
+	ht_t *ht;
+
+	if(ht_snapshot_dir.len <= 0) {
+		rpc->fault(c, 500, "No htable snapshot_dir");
+		return;
+	}
+	if(rpc->scan(c, "S", &htname) < 1) {
+		rpc->fault(c, 500, "No htable name given");
+		return;
+	}
+	ht = ht_get_table(&htname);
+	if(ht == NULL) {
+		rpc->fault(c, 500, "No such htable");
+		return;
+	}
+	if(ht_snapshot_save(ht) < 0) {
+		rpc->fault(c, 500, "Saving htable snapshot failed");
+		return;
+	}
+	rpc->rpl_printf(c, "Ok. Htable snapshot saved.");
+	return;
+}
+
 /*! \brief RPC htable.dmqsync command to sync a hash table via dmq */
 static void htable_rpc_dmqsync(rpc_t *rpc, void *c)
 {
@@ -2313,6 +2422,7 @@ rpc_export_t htable_rpc[] = {
 	{"htable.listTables", htable_rpc_list, htable_list_doc, RET_ARRAY},
 	{"htable.reload", htable_rpc_reload, htable_reload_doc, 0},
 	{"htable.store", htable_rpc_store, htable_store_doc, 0},
+	{"htable.snapshot", htable_rpc_snapshot, htable_snapshot_doc, 0},
 	{"htable.stats", htable_rpc_stats, htable_stats_doc, RET_ARRAY},
 	{"htable.flush", htable_rpc_flush, htable_flush_doc, 0},
 	{"htable.dmqsync", htable_rpc_dmqsync, htable_dmqsync_doc, 0},
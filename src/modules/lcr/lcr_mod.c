@@ -69,6 +69,7 @@
 #include "../../core/rand/kam_rand.h"
 #include "../../core/kemi.h"
 #include "hash.h"
+#include "rule_index.h"
 #include "lcr_rpc.h"
 #include "../../core/rpc_lookup.h"
 #include "../../modules/tm/tm_load.h"
@@ -120,6 +121,9 @@ MODULE_VERSION
 #define DEF_LCR_GW_COUNT 128
 #define DEF_FETCH_ROWS 1024
 
+/* Number of from_uri pattern results remembered by load_gws() */
+#define LCR_FROM_URI_MEMO 16
+
 /*
  * Database variables
  */
@@ -210,6 +214,11 @@ str mtree_param = {"lcr", 3};
 static pcre2_general_context *lcr_gctx = NULL;
 static pcre2_compile_context *lcr_ctx = NULL;
 
+/* per process match data and rule marks of load_gws() */
+static pcre2_match_data *lcr_pcre_md = NULL;
+static unsigned char *lcr_rule_marks = NULL;
+static unsigned int lcr_rule_marks_size = 0;
+
 /*
  * Other module types and variables
  */
@@ -752,6 +761,17 @@ static int mod_init(void)
 		memset(rule_pt[i], 0,
 				sizeof(struct rule_info *) * (lcr_rule_hash_size_param + 1));
 	}
+	/* rule index pointer table */
+	/* pointer at index 0 points to temp rule index */
+	rule_index_pt = (struct rule_index **)shm_malloc(
+			sizeof(struct rule_index *) * (lcr_count_param + 1));
+	if(rule_index_pt == 0) {
+		SHM_MEM_ERROR_FMT("for rule index pointer table\n");
+		goto err;
+	}
+	memset(rule_index_pt, 0,
+			sizeof(struct rule_index *) * (lcr_count_param + 1));
+
 	/* gw shared memory */
 
 	/* gw table pointer table */
@@ -852,6 +872,13 @@ static void free_shared_memory(void)
 		shm_free(rule_pt);
 		rule_pt = 0;
 	}
+	if(rule_index_pt) {
+		for(i = 0; i <= lcr_count_param; i++) {
+			rule_index_free(rule_index_pt[i]);
+		}
+		shm_free(rule_index_pt);
+		rule_index_pt = 0;
+	}
 	for(i = 0; i <= lcr_count_param; i++) {
 		if(gw_pt && gw_pt[i]) {
 			shm_free(gw_pt[i]);
@@ -1453,6 +1480,7 @@ int reload_tables()
 	pcre2_code *from_uri_re, *request_uri_re;
 	struct gw_info *gws, *gw_pt_tmp;
 	struct rule_info **rules, **rule_pt_tmp;
+	struct rule_index *rule_index_tmp;
 
 	key_cols[0] = &lcr_id_col;
 	op[0] = OP_EQ;
@@ -1509,6 +1537,8 @@ int reload_tables()
 		rules = rule_pt[0];
 		rule_hash_table_contents_free(rules);
 		rule_id_hash_table_contents_free();
+		rule_index_free(rule_index_pt[0]);
+		rule_index_pt[0] = NULL;
 
 		if(lcr_dbf.use_table(dbh, &lcr_rule_table) < 0) {
 			LM_ERR("error while trying to use lcr_rule table\n");
@@ -1886,13 +1916,23 @@ int reload_tables()
 		lcr_dbf.free_result(dbh, res);
 		res = NULL;
 
+		/* Build prefix index of rules */
+		rule_index_pt[0] = rule_index_build(rules);
+		if(rule_index_pt[0] == NULL) {
+			LM_ERR("failed to build rule index\n");
+			goto err;
+		}
+
 		/* Swap tables */
 		rule_pt_tmp = rule_pt[lcr_id];
 		gw_pt_tmp = gw_pt[lcr_id];
+		rule_index_tmp = rule_index_pt[lcr_id];
 		rule_pt[lcr_id] = rules;
 		gw_pt[lcr_id] = gws;
+		rule_index_pt[lcr_id] = rule_index_pt[0];
 		rule_pt[0] = rule_pt_tmp;
 		gw_pt[0] = gw_pt_tmp;
+		rule_index_pt[0] = rule_index_tmp;
 	}
 
 	lcr_db_close();
@@ -2159,40 +2199,29 @@ void add_gws_into_avps(struct gw_info *gws, struct matched_gw_info *matched_gws,
 
 
 /*
- * Loads ids matching GWs in priority order into gw_indexes array.
- * Returns the number of entries in the array.
+ * Collect gateways of rules in idx that match ruri_user, from_uri and
+ * request_uri into matched_gws array, in the order of comp_matched(),
+ * with duplicate gateways marked. Returns the number of entries in the
+ * array or -1 on error.
  */
-int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
-		unsigned int *gw_indexes)
+static int match_gws(sip_msg_t *_m, struct rule_index *idx,
+		struct gw_info *gws, str *ruri_user, str *from_uri, str *request_uri,
+		struct matched_gw_info *matched_gws)
 {
-	int i, j, rc;
-	unsigned int gw_index, now, dex;
-	struct rule_info **rules, *rule, *pl;
-	struct gw_info *gws;
-	struct target *t;
-	pcre2_match_data *pcre_md = NULL;
-	struct matched_gw_info matched_gws[MAX_NO_OF_GWS + 1];
+	int i, j, k, n, rc, mt_rc, stop, gw_cnt, start;
+	unsigned int now, dex, weight, memo_id[LCR_FROM_URI_MEMO];
+	int memo_rc[LCR_FROM_URI_MEMO], memo_cnt;
+	struct rule_index_node *nodes[MAX_PREFIX_LEN + 1], *node;
+	unsigned short lens[MAX_PREFIX_LEN + 1];
+	struct rule_index_rule *ir;
+	struct rule_index_target *it;
+	struct rule_info *rule;
+	struct matched_gw_info mgw;
 	struct sip_uri furi;
 	struct usr_avp *avp;
 	struct search_state st;
 	int_str val;
-	sip_msg_t msg;
-
-	memset(&msg, 0, sizeof(sip_msg_t));
-
-	if((lcr_id < 1) || (lcr_id > lcr_count_param)) {
-		LM_ERR("invalid lcr_id parameter value %d\n", lcr_id);
-		return -1;
-	}
-
-	LM_DBG("load_gws_dummy(%u, %.*s, %.*s, %.*s)\n", lcr_id, ruri_user->len,
-			ruri_user->s, from_uri->len, from_uri->s, request_uri->len,
-			request_uri->s);
-
-	rules = rule_pt[lcr_id];
-	gws = gw_pt[lcr_id];
-	pl = rules[lcr_rule_hash_size_param];
-	gw_index = 0;
+	unsigned char *marks;
 
 	if((from_uri->len > 0) && mt_pv_values_param) {
 		if(parse_uri(from_uri->s, from_uri->len, &furi) < 0) {
@@ -2201,45 +2230,84 @@ int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
 		}
 	}
 
-	now = time((time_t *)NULL);
+	if(idx == NULL)
+		return 0;
 
-	while(pl) {
-		if(ruri_user->len < pl->prefix_len) {
-			pl = pl->next;
-			continue;
+	if(idx->max_node_rules > lcr_rule_marks_size) {
+		marks = (unsigned char *)pkg_realloc(
+				lcr_rule_marks, idx->max_node_rules);
+		if(marks == NULL) {
+			PKG_MEM_ERROR_FMT("for rule marks\n");
+			return -1;
 		}
-		rule = rule_hash_table_lookup(rules, pl->prefix_len, ruri_user->s);
-		while(rule) {
+		lcr_rule_marks = marks;
+		lcr_rule_marks_size = idx->max_node_rules;
+	}
+	marks = lcr_rule_marks;
 
-			if((rule->prefix_len != pl->prefix_len)
-					|| strncmp(rule->prefix, ruri_user->s, pl->prefix_len))
-				goto next;
+	if(lcr_pcre_md == NULL) {
+		lcr_pcre_md = pcre2_match_data_create(1, NULL);
+		if(lcr_pcre_md == NULL) {
+			LM_ERR("failed to allocate pcre2 match data\n");
+			return -1;
+		}
+	}
 
-			if(rule->from_uri_len != 0) {
-				pcre_md = pcre2_match_data_create_from_pattern(
-						rule->from_uri_re, NULL);
-				if(pcre_md == NULL) {
-					LM_ERR("failed to allocate pcre2 match data for "
-						   "from_uri\n");
-					return -1;
+	now = time((time_t *)NULL);
+	n = rule_index_match(idx, ruri_user, nodes, lens);
+	gw_cnt = 0;
+	stop = 0;
+	mt_rc = 0;
+	memo_cnt = 0;
+
+	/* check prefixes from longest to shortest */
+	for(k = n - 1; k >= 0 && !stop; k--) {
+		node = nodes[k];
+		memset(marks, 0, node->nrules);
+		for(i = 0; i < node->nrules; i++) {
+			ir = &idx->rules[node->rule + i];
+			rule = ir->rule;
+
+			/* Match from uri, each distinct pattern once */
+			if(ir->from_uri_id != 0) {
+				for(j = 0; j < memo_cnt && j < LCR_FROM_URI_MEMO; j++) {
+					if(memo_id[j] == ir->from_uri_id)
+						break;
+				}
+				if(j < memo_cnt && j < LCR_FROM_URI_MEMO) {
+					rc = memo_rc[j];
+				} else {
+					rc = pcre2_match(rule->from_uri_re,
+							(PCRE2_SPTR)from_uri->s, (PCRE2_SIZE)from_uri->len,
+							0, 0, lcr_pcre_md, NULL);
+					j = memo_cnt++ % LCR_FROM_URI_MEMO;
+					memo_id[j] = ir->from_uri_id;
+					memo_rc[j] = rc;
 				}
-				rc = pcre2_match(rule->from_uri_re, (PCRE2_SPTR)from_uri->s,
-						(PCRE2_SIZE)from_uri->len, 0, 0, pcre_md, NULL);
-				if(pcre_md) {
-					pcre2_match_data_free(pcre_md);
-					pcre_md = NULL;
+				if(rc < 0) {
+					LM_DBG("from uri <%.*s> did not match to from regex "
+						   "<%.*s>\n",
+							from_uri->len, from_uri->s, rule->from_uri_len,
+							rule->from_uri);
+					continue;
 				}
-				if(rc < 0)
-					goto next;
 			}
+
+			/* Match from uri user */
 			if((from_uri->len > 0) && (rule->mt_tvalue_len > 0)) {
-				if(mtree_api.mt_match(&msg, &mtree_param, &(furi.user), 2)
-						== -1) {
-					LM_DBG("from uri user <%.*s> was not found in mtree "
-						   "<%.*s>\n",
-							furi.user.len, furi.user.s, mtree_param.len,
-							mtree_param.s);
-					goto next;
+				/* mtree lookup result is same for all rules */
+				if(mt_rc == 0) {
+					if(mtree_api.mt_match(_m, &mtree_param, &(furi.user), 2)
+							== -1) {
+						mt_rc = -1;
+					} else {
+						mt_rc = 1;
+					}
+				}
+				if(mt_rc == -1) {
+					LM_DBG("from uri user <%.*s> was not found in mtree\n",
+							furi.user.len, furi.user.s);
+					continue;
 				}
 				for(avp = search_first_avp(
 							mt_pv_values_avp_type, mt_pv_values_avp, &val, &st);
@@ -2254,65 +2322,89 @@ int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
 						   "<%.*s>\n",
 							furi.user.len, furi.user.s, rule->mt_tvalue_len,
 							rule->mt_tvalue);
-					goto next;
+					continue;
 				}
 			}
 
+			/* Match request uri */
 			if(rule->request_uri_len != 0) {
 				if(request_uri->len == 0) {
 					LM_ERR("lcr_rule has non-null request_uri and request_uri "
 						   "param has not been given.\n");
 					return -1;
 				}
-				pcre_md = pcre2_match_data_create_from_pattern(
-						rule->request_uri_re, NULL);
-				if(pcre_md == NULL) {
-					LM_ERR("failed to allocate pcre2 match data for "
-						   "request_uri\n");
-					return -1;
-				}
 				rc = pcre2_match(rule->request_uri_re,
 						(PCRE2_SPTR)request_uri->s,
-						(PCRE2_SIZE)request_uri->len, 0, 0, pcre_md, NULL);
-				if(pcre_md) {
-					pcre2_match_data_free(pcre_md);
-					pcre_md = NULL;
+						(PCRE2_SIZE)request_uri->len, 0, 0, lcr_pcre_md, NULL);
+				if(rc < 0) {
+					LM_DBG("request uri <%.*s> did not match to request regex "
+						   "<%.*s>\n",
+							request_uri->len, request_uri->s,
+							rule->request_uri_len, rule->request_uri);
+					continue;
 				}
-				if(rc < 0)
-					goto next;
 			}
 
-			t = rule->targets;
-			while(t) {
-				if((gws[t->gw_index].defunct_until > now)
-						|| (gws[t->gw_index].state == GW_INACTIVE))
-					goto skip_gw;
-				matched_gws[gw_index].gw_index = t->gw_index;
-				matched_gws[gw_index].rule_id = rule->rule_id;
-				matched_gws[gw_index].prefix_len = pl->prefix_len;
-				matched_gws[gw_index].priority = t->priority;
-				matched_gws[gw_index].weight = t->weight * (kam_rand() >> 8);
-				matched_gws[gw_index].duplicate = 0;
-				LM_DBG("added matched_gws[%d]=[%u, %u, %u, %u]\n", gw_index,
-						t->gw_index, pl->prefix_len, t->priority,
-						matched_gws[gw_index].weight);
-				gw_index++;
-			skip_gw:
-				t = t->next;
+			marks[i] = 1;
+			/* Do not look further if this matching rule was stopper */
+			if(rule->stopper == 1) {
+				stop = 1;
+				break;
 			}
-			if(rule->stopper == 1)
-				goto done;
+		}
 
-		next:
-			rule = rule->next;
+		/* Load gws of matching rules, targets are sorted by priority */
+		start = gw_cnt;
+		for(i = 0; i < node->ntargets; i++) {
+			it = &idx->targets[node->target + i];
+			if(marks[it->rule_pos] == 0)
+				continue;
+			/* If this gw is defunct or inactive, skip it */
+			if((gws[it->gw_index].defunct_until > now)
+					|| (gws[it->gw_index].state == GW_INACTIVE))
+				continue;
+			if(gw_cnt >= MAX_NO_OF_GWS) {
+				LM_WARN("too many matching gateways\n");
+				break;
+			}
+			/* keep gws of equal priority in randomized weight order */
+			weight = it->weight * (kam_rand() >> 8);
+			for(j = gw_cnt; j > start
+							&& matched_gws[j - 1].priority == it->priority
+							&& matched_gws[j - 1].weight < weight;
+					j--) {
+				matched_gws[j] = matched_gws[j - 1];
+			}
+			matched_gws[j].gw_index = it->gw_index;
+			matched_gws[j].rule_id = idx->rules[node->rule + it->rule_pos]
+											 .rule->rule_id;
+			matched_gws[j].prefix_len = lens[k];
+			matched_gws[j].priority = it->priority;
+			matched_gws[j].weight = weight;
+			matched_gws[j].duplicate = 0;
+			LM_DBG("added matched_gws[%d]=[%u, %u, %u, %u]\n", gw_cnt,
+					it->gw_index, lens[k], it->priority, weight);
+			gw_cnt++;
 		}
-		pl = pl->next;
 	}
 
-done:
-	qsort(matched_gws, gw_index, sizeof(struct matched_gw_info), comp_matched);
+	if(priority_ordering_param) {
+		/* Sort gateways in reverse order based on priority and randomized
+		 * weight */
+		qsort(matched_gws, gw_cnt, sizeof(struct matched_gw_info),
+				comp_matched);
+	} else {
+		/* Gateways are already ordered by prefix_len, priority and
+		 * randomized weight, reverse them */
+		for(i = 0, j = gw_cnt - 1; i < j; i++, j--) {
+			mgw = matched_gws[i];
+			matched_gws[i] = matched_gws[j];
+			matched_gws[j] = mgw;
+		}
+	}
 
-	for(i = gw_index - 1; i >= 0; i--) {
+	/* Remove duplicate gws */
+	for(i = gw_cnt - 1; i >= 0; i--) {
 		if(matched_gws[i].duplicate == 1)
 			continue;
 		dex = matched_gws[i].gw_index;
@@ -2323,8 +2415,39 @@ done:
 		}
 	}
 
+	return gw_cnt;
+}
+
+
+/*
+ * Loads ids matching GWs in priority order into gw_indexes array.
+ * Returns the number of entries in the array.
+ */
+int load_gws_dummy(int lcr_id, str *ruri_user, str *from_uri, str *request_uri,
+		unsigned int *gw_indexes)
+{
+	int i, j, gw_cnt;
+	struct matched_gw_info matched_gws[MAX_NO_OF_GWS + 1];
+	sip_msg_t msg;
+
+	memset(&msg, 0, sizeof(sip_msg_t));
+
+	if((lcr_id < 1) || (lcr_id > lcr_count_param)) {
+		LM_ERR("invalid lcr_id parameter value %d\n", lcr_id);
+		return -1;
+	}
+
+	LM_DBG("load_gws_dummy(%u, %.*s, %.*s, %.*s)\n", lcr_id, ruri_user->len,
+			ruri_user->s, from_uri->len, from_uri->s, request_uri->len,
+			request_uri->s);
+
+	gw_cnt = match_gws(&msg, rule_index_pt[lcr_id], gw_pt[lcr_id], ruri_user,
+			from_uri, request_uri, matched_gws);
+	if(gw_cnt < 0)
+		return -1;
+
 	j = 0;
-	for(i = gw_index - 1; i >= 0; i--) {
+	for(i = gw_cnt - 1; i >= 0; i--) {
 		if(matched_gws[i].duplicate == 1)
 			continue;
 		gw_indexes[j] = matched_gws[i].gw_index;
@@ -2342,190 +2465,39 @@ static int ki_load_gws_furi(
 		sip_msg_t *_m, int lcr_id, str *ruri_user, str *from_uri)
 {
 	str *request_uri;
-	int i, j, rc;
-	unsigned int gw_index, now, dex;
+	int gw_cnt;
 	int_str val;
-	pcre2_match_data *pcre_md = NULL;
 	struct matched_gw_info matched_gws[MAX_NO_OF_GWS + 1];
-	struct rule_info **rules, *rule, *pl;
 	struct gw_info *gws;
-	struct target *t;
-	struct sip_uri furi;
-	struct usr_avp *avp;
-	struct search_state st;
 
 	LM_DBG("load_gws(%u, %.*s, %.*s)\n", lcr_id, ruri_user->len,
 			ZSW(ruri_user->s), from_uri->len, ZSW(from_uri->s));
 
 	request_uri = GET_RURI(_m);
 
-	if((from_uri->len > 0) && mt_pv_values_param) {
-		if(parse_uri(from_uri->s, from_uri->len, &furi) < 0) {
-			LM_ERR("error while parsing caller_uri\n");
-			return -1;
-		}
-	}
-
 	if((lcr_id < 1) || (lcr_id > lcr_count_param)) {
 		LM_ERR("invalid lcr_id parameter value %d\n", lcr_id);
 		return -1;
 	}
 
 	/* Use rules and gws with index lcr_id */
-	rules = rule_pt[lcr_id];
 	gws = gw_pt[lcr_id];
 
-	/*
-     * Find lcr entries that match based on prefix and from_uri and collect
-     * gateways of matching entries into matched_gws array so that each
-     * gateway appears in the array only once.
-     */
-
-	pl = rules[lcr_rule_hash_size_param];
-	gw_index = 0;
-
 	if(defunct_capability_param > 0) {
 		delete_avp(defunct_gw_avp_type, defunct_gw_avp);
 	}
 
-	now = time((time_t *)NULL);
-
-	/* check prefixes in from longest to shortest */
-	while(pl) {
-		if(ruri_user->len < pl->prefix_len) {
-			pl = pl->next;
-			continue;
-		}
-		rule = rule_hash_table_lookup(rules, pl->prefix_len, ruri_user->s);
-		while(rule) {
-			/* Match prefix */
-			if((rule->prefix_len != pl->prefix_len)
-					|| (strncmp(rule->prefix, ruri_user->s, pl->prefix_len)))
-				goto next;
-
-			/* Match from uri */
-			if(rule->from_uri_len != 0) {
-				pcre_md = pcre2_match_data_create_from_pattern(
-						rule->from_uri_re, NULL);
-				if(pcre_md == NULL) {
-					LM_ERR("failed to allocate pcre2 match data for "
-						   "from_uri\n");
-					return -1;
-				}
-				rc = pcre2_match(rule->from_uri_re, (PCRE2_SPTR)from_uri->s,
-						(PCRE2_SIZE)from_uri->len, 0, 0, pcre_md, NULL);
-				if(pcre_md) {
-					pcre2_match_data_free(pcre_md);
-					pcre_md = NULL;
-				}
-				if(rc < 0) {
-					LM_DBG("from uri <%.*s> did not match to from regex "
-						   "<%.*s>\n",
-							from_uri->len, from_uri->s, rule->from_uri_len,
-							rule->from_uri);
-					goto next;
-				}
-			}
-
-			/* Match from uri user */
-			if((from_uri->len > 0) && (rule->mt_tvalue_len > 0)) {
-				if(mtree_api.mt_match(_m, &mtree_param, &(furi.user), 2)
-						== -1) {
-					LM_DBG("from uri user <%.*s> was not found in mtree\n",
-							furi.user.len, furi.user.s);
-					goto next;
-				}
-				for(avp = search_first_avp(
-							mt_pv_values_avp_type, mt_pv_values_avp, &val, &st);
-						avp; avp = search_next_avp(&st, &val)) {
-					if((val.s.len == rule->mt_tvalue_len)
-							&& strncmp(val.s.s, rule->mt_tvalue, val.s.len)
-									   == 0)
-						break;
-				}
-				if(avp == NULL) {
-					LM_DBG("from uri user <%.*s> did not match mt_tvalue "
-						   "<%.*s>\n",
-							furi.user.len, furi.user.s, rule->mt_tvalue_len,
-							rule->mt_tvalue);
-					goto next;
-				}
-			}
-
-			/* Match request uri */
-			if(rule->request_uri_len != 0) {
-				pcre_md = pcre2_match_data_create_from_pattern(
-						rule->request_uri_re, NULL);
-				if(pcre_md == NULL) {
-					LM_ERR("failed to allocate pcre2 match data for "
-						   "request_uri\n");
-					return -1;
-				}
-				rc = pcre2_match(rule->request_uri_re,
-						(PCRE2_SPTR)request_uri->s,
-						(PCRE2_SIZE)request_uri->len, 0, 0, pcre_md, NULL);
-				if(pcre_md) {
-					pcre2_match_data_free(pcre_md);
-					pcre_md = NULL;
-				}
-				if(rc < 0) {
-					LM_DBG("request uri <%.*s> did not match to request regex "
-						   "<%.*s>\n",
-							request_uri->len, request_uri->s,
-							rule->request_uri_len, rule->request_uri);
-					goto next;
-				}
-			}
-
-			/* Load gws associated with this rule */
-			t = rule->targets;
-			while(t) {
-				/* If this gw is defunct or inactive, skip it */
-				if((gws[t->gw_index].defunct_until > now)
-						|| (gws[t->gw_index].state == GW_INACTIVE))
-					goto skip_gw;
-				matched_gws[gw_index].gw_index = t->gw_index;
-				matched_gws[gw_index].rule_id = rule->rule_id;
-				matched_gws[gw_index].prefix_len = pl->prefix_len;
-				matched_gws[gw_index].priority = t->priority;
-				matched_gws[gw_index].weight = t->weight * (kam_rand() >> 8);
-				matched_gws[gw_index].duplicate = 0;
-				LM_DBG("added matched_gws[%d]=[%u, %u, %u, %u]\n", gw_index,
-						t->gw_index, pl->prefix_len, t->priority,
-						matched_gws[gw_index].weight);
-				gw_index++;
-			skip_gw:
-				t = t->next;
-			}
-			/* Do not look further if this matching rule was stopper */
-			if(rule->stopper == 1)
-				goto done;
-
-		next:
-			rule = rule->next;
-		}
-		pl = pl->next;
-	}
-
-done:
-	/* Sort gateways in reverse order based on prefix_len, priority,
-       and randomized weight */
-	qsort(matched_gws, gw_index, sizeof(struct matched_gw_info), comp_matched);
-
-	/* Remove duplicate gws */
-	for(i = gw_index - 1; i >= 0; i--) {
-		if(matched_gws[i].duplicate == 1)
-			continue;
-		dex = matched_gws[i].gw_index;
-		for(j = i - 1; j >= 0; j--) {
-			if(matched_gws[j].gw_index == dex) {
-				matched_gws[j].duplicate = 1;
-			}
-		}
-	}
+	/*
+     * Find lcr entries that match based on prefix and from_uri and collect
+     * gateways of matching entries into matched_gws array.
+     */
+	gw_cnt = match_gws(_m, rule_index_pt[lcr_id], gws, ruri_user, from_uri,
+			request_uri, matched_gws);
+	if(gw_cnt < 0)
+		return -1;
 
 	/* Add gateways into gw_uris_avp */
-	add_gws_into_avps(gws, matched_gws, gw_index, ruri_user);
+	add_gws_into_avps(gws, matched_gws, gw_cnt, ruri_user);
 
 	/* Add lcr_id into AVP */
 	if((defunct_capability_param > 0) || (ping_interval_param > 0)) {
@@ -2534,7 +2506,7 @@ done:
 		add_avp(lcr_id_avp_type, lcr_id_avp, val);
 	}
 
-	if(gw_index > 0) {
+	if(gw_cnt > 0) {
 		return 1;
 	} else {
 		return 2;
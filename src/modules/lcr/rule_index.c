@@ -0,0 +1,399 @@
+/*
+ * Prefix index of lcr rules
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*!
+ * \file
+ * \brief Kamailio lcr :: Prefix index of lcr rules
+ * \ingroup lcr
+ * Module: \ref lcr
+ *
+ * The index is built from the rule hash table of an lcr instance after
+ * its rules and targets have been loaded and is swapped together with it.
+ * It is a single shared memory block that holds a trie of the rule
+ * prefixes, the rules of each prefix and their targets, pre-sorted by
+ * priority, so that load_gws() only walks the prefixes of the user part.
+ */
+
+#include <stdlib.h>
+
+#include "../../core/mem/mem.h"
+#include "../../core/mem/shm_mem.h"
+#include "rule_index.h"
+
+/* Pointer to rule index pointer table, index 0 holds the temp index */
+struct rule_index **rule_index_pt = (struct rule_index **)NULL;
+
+struct rule_index_src
+{
+	struct rule_info *rule;
+	unsigned int seq;
+};
+
+struct rule_index_tsrc
+{
+	struct target *t;
+	unsigned int rule_pos;
+	unsigned int seq;
+};
+
+struct rule_index_build
+{
+	struct rule_index *idx;
+	struct rule_index_src *src;
+	unsigned int next_node;
+	unsigned int next_rule;
+	unsigned int next_target;
+	struct rule_index_tsrc *tsrc;
+};
+
+/*
+ * Order rules by prefix, shorter prefix first, keeping the hash table
+ * order of rules with the same prefix.
+ */
+static int rule_index_src_cmp(const void *s1, const void *s2)
+{
+	struct rule_index_src *r1 = (struct rule_index_src *)s1;
+	struct rule_index_src *r2 = (struct rule_index_src *)s2;
+	unsigned short len;
+	int ret;
+
+	len = (r1->rule->prefix_len < r2->rule->prefix_len) ? r1->rule->prefix_len
+														: r2->rule->prefix_len;
+	ret = memcmp(r1->rule->prefix, r2->rule->prefix, len);
+	if(ret != 0)
+		return ret;
+	if(r1->rule->prefix_len != r2->rule->prefix_len)
+		return (r1->rule->prefix_len < r2->rule->prefix_len) ? -1 : 1;
+	return (r1->seq < r2->seq) ? -1 : 1;
+}
+
+static int rule_index_tsrc_cmp(const void *s1, const void *s2)
+{
+	struct rule_index_tsrc *t1 = (struct rule_index_tsrc *)s1;
+	struct rule_index_tsrc *t2 = (struct rule_index_tsrc *)s2;
+
+	if(t1->t->priority != t2->t->priority)
+		return (t1->t->priority < t2->t->priority) ? -1 : 1;
+	return (t1->seq < t2->seq) ? -1 : 1;
+}
+
+static int rule_index_from_uri_cmp(const void *s1, const void *s2)
+{
+	struct rule_index_rule *r1 = *(struct rule_index_rule **)s1;
+	struct rule_index_rule *r2 = *(struct rule_index_rule **)s2;
+
+	return strcmp(r1->rule->from_uri, r2->rule->from_uri);
+}
+
+/* Set rules and targets of node from src rules [lo, hi) */
+static void rule_index_set_rules(
+		struct rule_index_build *b, unsigned int n, int lo, int hi)
+{
+	struct rule_index_node *node;
+	struct target *t;
+	unsigned int i, nt;
+
+	node = &b->idx->nodes[n];
+	node->rule = b->next_rule;
+	node->nrules = hi - lo;
+	if(node->nrules > b->idx->max_node_rules)
+		b->idx->max_node_rules = node->nrules;
+	nt = 0;
+	for(i = 0; i < node->nrules; i++) {
+		b->idx->rules[b->next_rule + i].rule = b->src[lo + i].rule;
+		for(t = b->src[lo + i].rule->targets; t; t = t->next) {
+			b->tsrc[nt].t = t;
+			b->tsrc[nt].rule_pos = i;
+			b->tsrc[nt].seq = nt;
+			nt++;
+		}
+	}
+	b->next_rule += node->nrules;
+
+	qsort(b->tsrc, nt, sizeof(struct rule_index_tsrc), rule_index_tsrc_cmp);
+	node->target = b->next_target;
+	node->ntargets = nt;
+	for(i = 0; i < nt; i++) {
+		b->idx->targets[b->next_target + i].gw_index = b->tsrc[i].t->gw_index;
+		b->idx->targets[b->next_target + i].priority = b->tsrc[i].t->priority;
+		b->idx->targets[b->next_target + i].weight = b->tsrc[i].t->weight;
+		b->idx->targets[b->next_target + i].rule_pos = b->tsrc[i].rule_pos;
+	}
+	b->next_target += nt;
+}
+
+/*
+ * Place children of node n. Src rules [lo, hi) share the prefix of the
+ * node, of length depth, and are longer than it.
+ */
+static void rule_index_place(struct rule_index_build *b, unsigned int n,
+		int lo, int hi, unsigned short depth)
+{
+	struct rule_index_node *node;
+	unsigned int child;
+	unsigned char c;
+	int i, j, k;
+
+	node = &b->idx->nodes[n];
+	node->child = b->next_node;
+	for(i = lo; i < hi; i = j) {
+		c = (unsigned char)b->src[i].rule->prefix[depth];
+		for(j = i; j < hi
+				   && (unsigned char)b->src[j].rule->prefix[depth] == c;
+				j++)
+			;
+		b->idx->nodes[b->next_node].c = c;
+		b->next_node++;
+		node->nchildren++;
+	}
+	for(i = lo, child = node->child; i < hi; i = j, child++) {
+		c = (unsigned char)b->src[i].rule->prefix[depth];
+		for(j = i; j < hi
+				   && (unsigned char)b->src[j].rule->prefix[depth] == c;
+				j++)
+			;
+		/* rules ending at this char come first */
+		for(k = i; k < j && b->src[k].rule->prefix_len == depth + 1; k++)
+			;
+		if(k > i)
+			rule_index_set_rules(b, child, i, k);
+		if(k < j)
+			rule_index_place(b, child, k, j, depth + 1);
+	}
+}
+
+/*
+ * Build prefix index of rules in hash table. Returns index in shared
+ * memory or NULL on error.
+ */
+struct rule_index *rule_index_build(struct rule_info **hash_table)
+{
+	struct rule_index_build b;
+	struct rule_index *idx;
+	struct rule_index_rule **from_uris = NULL;
+	struct rule_info *r;
+	struct target *t;
+	unsigned int i, nrules, nnodes, ntargets, maxtargets, nt, lcp, id;
+	int lo;
+	unsigned short len;
+	char *p;
+
+	memset(&b, 0, sizeof(struct rule_index_build));
+
+	nrules = 0;
+	for(i = 0; i < lcr_rule_hash_size_param; i++) {
+		for(r = hash_table[i]; r; r = r->next)
+			nrules++;
+	}
+
+	if(nrules > 0) {
+		b.src = (struct rule_index_src *)pkg_malloc(
+				nrules * sizeof(struct rule_index_src));
+		if(b.src == NULL) {
+			PKG_MEM_ERROR_FMT("for rule index build\n");
+			return NULL;
+		}
+	}
+	nrules = 0;
+	for(i = 0; i < lcr_rule_hash_size_param; i++) {
+		for(r = hash_table[i]; r; r = r->next) {
+			b.src[nrules].rule = r;
+			b.src[nrules].seq = nrules;
+			nrules++;
+		}
+	}
+	if(nrules > 0)
+		qsort(b.src, nrules, sizeof(struct rule_index_src),
+				rule_index_src_cmp);
+
+	/* count trie nodes and targets */
+	nnodes = 1;
+	ntargets = 0;
+	maxtargets = 0;
+	nt = 0;
+	for(i = 0; i < nrules; i++) {
+		r = b.src[i].rule;
+		lcp = 0;
+		if(i > 0) {
+			len = (b.src[i - 1].rule->prefix_len < r->prefix_len)
+						  ? b.src[i - 1].rule->prefix_len
+						  : r->prefix_len;
+			while(lcp < len
+					&& b.src[i - 1].rule->prefix[lcp] == r->prefix[lcp])
+				lcp++;
+			/* targets are counted per prefix */
+			if(lcp != r->prefix_len
+					|| r->prefix_len != b.src[i - 1].rule->prefix_len)
+				nt = 0;
+		}
+		nnodes += r->prefix_len - lcp;
+		for(t = r->targets; t; t = t->next) {
+			ntargets++;
+			nt++;
+		}
+		if(nt > maxtargets)
+			maxtargets = nt;
+	}
+
+	if(maxtargets > 0) {
+		b.tsrc = (struct rule_index_tsrc *)pkg_malloc(
+				maxtargets * sizeof(struct rule_index_tsrc));
+		if(b.tsrc == NULL) {
+			PKG_MEM_ERROR_FMT("for rule index build\n");
+			goto error;
+		}
+	}
+
+	idx = (struct rule_index *)shm_malloc(
+			sizeof(struct rule_index) + nnodes * sizeof(struct rule_index_node)
+			+ nrules * sizeof(struct rule_index_rule)
+			+ ntargets * sizeof(struct rule_index_target));
+	if(idx == NULL) {
+		SHM_MEM_ERROR_FMT("for rule index\n");
+		goto error;
+	}
+	memset(idx, 0,
+			sizeof(struct rule_index) + nnodes * sizeof(struct rule_index_node)
+					+ nrules * sizeof(struct rule_index_rule));
+	p = (char *)idx + sizeof(struct rule_index);
+	idx->nodes = (struct rule_index_node *)p;
+	idx->nnodes = nnodes;
+	p += nnodes * sizeof(struct rule_index_node);
+	idx->rules = (struct rule_index_rule *)p;
+	idx->nrules = nrules;
+	p += nrules * sizeof(struct rule_index_rule);
+	idx->targets = (struct rule_index_target *)p;
+	idx->ntargets = ntargets;
+	b.idx = idx;
+	b.next_node = 1;
+
+	/* rules with empty prefix belong to root */
+	for(lo = 0; lo < nrules && b.src[lo].rule->prefix_len == 0; lo++)
+		;
+	if(lo > 0)
+		rule_index_set_rules(&b, 0, 0, lo);
+	if(lo < nrules)
+		rule_index_place(&b, 0, lo, nrules, 0);
+
+	/* give equal from_uri patterns the same id, to match them once */
+	nt = 0;
+	for(i = 0; i < nrules; i++) {
+		if(idx->rules[i].rule->from_uri_len > 0)
+			nt++;
+	}
+	if(nt > 0) {
+		from_uris = (struct rule_index_rule **)pkg_malloc(
+				nt * sizeof(struct rule_index_rule *));
+		if(from_uris == NULL) {
+			PKG_MEM_ERROR_FMT("for rule index build\n");
+			shm_free(idx);
+			goto error;
+		}
+		nt = 0;
+		for(i = 0; i < nrules; i++) {
+			if(idx->rules[i].rule->from_uri_len > 0)
+				from_uris[nt++] = &idx->rules[i];
+		}
+		qsort(from_uris, nt, sizeof(struct rule_index_rule *),
+				rule_index_from_uri_cmp);
+		id = 0;
+		for(i = 0; i < nt; i++) {
+			if(i == 0
+					|| rule_index_from_uri_cmp(&from_uris[i - 1], &from_uris[i])
+							   != 0)
+				id++;
+			from_uris[i]->from_uri_id = id;
+		}
+		idx->nfrom_uris = id;
+		pkg_free(from_uris);
+	}
+
+	if(b.tsrc)
+		pkg_free(b.tsrc);
+	if(b.src)
+		pkg_free(b.src);
+
+	LM_DBG("built rule index with <%u> nodes, <%u> rules, <%u> targets and "
+		   "<%u> from_uri patterns\n",
+			idx->nnodes, idx->nrules, idx->ntargets, idx->nfrom_uris);
+	return idx;
+
+error:
+	if(b.tsrc)
+		pkg_free(b.tsrc);
+	if(b.src)
+		pkg_free(b.src);
+	return NULL;
+}
+
+void rule_index_free(struct rule_index *idx)
+{
+	if(idx)
+		shm_free(idx);
+}
+
+/*
+ * Find nodes of rule prefixes matching the beginning of user, shortest
+ * first. Nodes and their prefix lengths are stored into nodes and lens
+ * arrays, which have room for MAX_PREFIX_LEN + 1 entries. Returns the
+ * number of found nodes.
+ */
+int rule_index_match(struct rule_index *idx, str *user,
+		struct rule_index_node **nodes, unsigned short *lens)
+{
+	struct rule_index_node *node, *children;
+	unsigned char c;
+	int n, d, l, h, m;
+
+	n = 0;
+	node = &idx->nodes[0];
+	for(d = 0;; d++) {
+		if(node->nrules > 0) {
+			nodes[n] = node;
+			lens[n] = d;
+			n++;
+		}
+		if(d >= user->len || node->nchildren == 0)
+			break;
+		c = (unsigned char)user->s[d];
+		children = &idx->nodes[node->child];
+		l = 0;
+		h = node->nchildren - 1;
+		node = NULL;
+		while(l <= h) {
+			m = (l + h) >> 1;
+			if(children[m].c == c) {
+				node = &children[m];
+				break;
+			}
+			if(children[m].c < c)
+				l = m + 1;
+			else
+				h = m - 1;
+		}
+		if(node == NULL)
+			break;
+	}
+	return n;
+}
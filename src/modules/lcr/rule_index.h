@@ -0,0 +1,90 @@
+/*
+ * Header file for prefix index of lcr rules
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*!
+ * \file
+ * \brief Kamailio lcr :: Header file for prefix index of lcr rules
+ * \ingroup lcr
+ * Module: \ref lcr
+ */
+
+#ifndef _LCR_RULE_INDEX_H_
+#define _LCR_RULE_INDEX_H_
+
+#include "lcr_mod.h"
+
+/*
+ * Trie node of a rule prefix. Children of a node are stored next to each
+ * other, sorted by char. Rules of the node are in the order they are
+ * checked by load_gws() and targets of all these rules are sorted by
+ * priority.
+ */
+struct rule_index_node
+{
+	unsigned int child; /* first child node */
+	unsigned short nchildren;
+	unsigned char c;
+	unsigned char pad;
+	unsigned int rule; /* first rule of the node */
+	unsigned int nrules;
+	unsigned int target; /* first target of the node */
+	unsigned int ntargets;
+};
+
+struct rule_index_rule
+{
+	struct rule_info *rule;
+	unsigned int from_uri_id; /* distinct from_uri pattern id + 1, or 0 */
+};
+
+struct rule_index_target
+{
+	unsigned short gw_index;
+	unsigned short priority;
+	unsigned short weight;
+	unsigned int rule_pos; /* position of the rule within the node */
+};
+
+struct rule_index
+{
+	struct rule_index_node *nodes; /* node 0 is root, for empty prefix */
+	unsigned int nnodes;
+	struct rule_index_rule *rules;
+	unsigned int nrules;
+	struct rule_index_target *targets;
+	unsigned int ntargets;
+	unsigned int nfrom_uris;	 /* number of distinct from_uri patterns */
+	unsigned int max_node_rules; /* largest number of rules in a node */
+};
+
+extern struct rule_index **rule_index_pt;
+
+struct rule_index *rule_index_build(struct rule_info **hash_table);
+
+void rule_index_free(struct rule_index *idx);
+
+int rule_index_match(struct rule_index *idx, str *user,
+		struct rule_index_node **nodes, unsigned short *lens);
+
+#endif
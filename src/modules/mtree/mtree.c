@@ -27,8 +27,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "../../core/dprint.h"
+#include "../../core/mem/mem.h"
 #include "../../core/mem/shm_mem.h"
 #include "../../core/parser/parse_param.h"
 #include "../../core/ut.h"
@@ -38,6 +43,7 @@
 #include "../../core/shm_init.h"
 
 #include "mtree.h"
+#include "mtree_mfile.h"
 
 extern str mt_char_list;
 extern pv_spec_t pv_value;
@@ -48,6 +54,7 @@ extern pv_spec_t pv_count;
 extern int _mt_tree_type;
 extern int _mt_ignore_duplicates;
 extern int _mt_allow_duplicates;
+extern int _mt_compact_mode;
 
 /** structures containing prefix-value pairs */
 static m_tree_t **_ptree = NULL;
@@ -59,6 +66,8 @@ static unsigned char _mt_char_table[MT_CHAR_TABLE_SIZE];
 
 static int _mt_char_table_ready = 0;
 
+static int mt_cstage_add(m_tree_t *pt, str *sp, mt_is_t *tvalues);
+
 /**
  *
  */
@@ -87,6 +96,292 @@ int mt_char_table_init(int nset)
 }
 
 
+static mt_node_t _mt_empty_node;
+
+/* prebuilt tree file mapped in the current process */
+typedef struct _mt_mfile
+{
+	m_tree_t *pt;		  /* tree using the file */
+	unsigned int version; /* mversion of the tree when mapped */
+	void *addr;
+	size_t size;
+	int type;
+	mt_ctree_t ct;
+	mt_mfile_hdr_t *hdr;
+	mt_mvalue_t *values;
+	mt_mitem_t *items;
+	mt_mdw_t *dw;
+	char *strs;
+	struct _mt_mfile *next;
+} mt_mfile_t;
+
+static mt_mfile_t *_mt_mfile_list = NULL;
+
+/* per depth buffers for the values of the walked nodes */
+typedef struct _mt_mfile_buf
+{
+	mt_node_t node;
+	mt_is_t *is;
+	unsigned int nis;
+	mt_dw_t *dw;
+	unsigned int ndw;
+} mt_mfile_buf_t;
+
+static mt_mfile_buf_t _mt_mfile_buf[MT_MAX_DEPTH + 1];
+
+/**
+ * map the file and check its header against the tree definition
+ */
+static int mt_mfile_map(m_tree_t *pt, mt_mfile_t *mf)
+{
+	mt_mfile_view_t v;
+	mt_mfile_hdr_t *hdr;
+	uint64_t msize;
+	int ret;
+
+	memset(mf, 0, sizeof(mt_mfile_t));
+	ret = mt_mfile_mmap(pt->mfile.s, &mf->addr, &msize);
+	if(ret == -1) {
+		LM_ERR("cannot map file [%s] for tree [%.*s] (%d - %s)\n",
+				pt->mfile.s, pt->tname.len, pt->tname.s, errno,
+				strerror(errno));
+		return -1;
+	}
+	if(ret < 0) {
+		LM_ERR("invalid file [%s] for tree [%.*s]\n", pt->mfile.s,
+				pt->tname.len, pt->tname.s);
+		return -1;
+	}
+	mf->size = msize;
+
+	ret = mt_mfile_view_init(&v, mf->addr, mf->size);
+	if(ret == -1) {
+		LM_ERR("file [%s] is not a supported mtree file\n", pt->mfile.s);
+		goto error;
+	}
+	if(ret < 0) {
+		LM_ERR("file [%s] has invalid size\n", pt->mfile.s);
+		goto error;
+	}
+	hdr = v.hdr;
+	if(hdr->type != pt->type) {
+		LM_ERR("file [%s] has type %u - tree [%.*s] has type %d\n",
+				pt->mfile.s, hdr->type, pt->tname.len, pt->tname.s, pt->type);
+		goto error;
+	}
+	if(mt_mfile_view_chars(&v, mt_char_list.s, mt_char_list.len) < 0) {
+		LM_ERR("file [%s] was built for another char list\n", pt->mfile.s);
+		goto error;
+	}
+
+	mf->pt = pt;
+	mf->version = pt->mversion;
+	mf->type = pt->type;
+	mf->hdr = hdr;
+	mf->ct.cells = (mt_ccell_t *)v.cells;
+	mf->ct.ncells = hdr->ncells;
+	mf->ct.nvalues = hdr->nvalues;
+	mf->ct.size = mf->size;
+	mf->ct.mf = mf;
+	mf->values = v.values;
+	mf->items = v.items;
+	mf->dw = v.dw;
+	mf->strs = v.strs;
+	return 0;
+
+error:
+	munmap(mf->addr, mf->size);
+	mf->addr = NULL;
+	return -1;
+}
+
+/**
+ * return the compact tree of the file mapped for pt in this process,
+ * mapping it again if the file was reloaded
+ */
+static mt_ctree_t *mt_mfile_get(m_tree_t *pt)
+{
+	mt_mfile_t *mf;
+	mt_mfile_t nmf;
+
+	for(mf = _mt_mfile_list; mf != NULL; mf = mf->next) {
+		if(mf->pt == pt)
+			break;
+	}
+	if(mf != NULL && mf->version == pt->mversion) {
+		return (mf->addr != NULL) ? &mf->ct : NULL;
+	}
+	if(mf == NULL) {
+		mf = (mt_mfile_t *)pkg_malloc(sizeof(mt_mfile_t));
+		if(mf == NULL) {
+			PKG_MEM_ERROR;
+			return NULL;
+		}
+		memset(mf, 0, sizeof(mt_mfile_t));
+		mf->pt = pt;
+		mf->next = _mt_mfile_list;
+		_mt_mfile_list = mf;
+	}
+	if(mt_mfile_map(pt, &nmf) < 0) {
+		/* keep serving the previous mapping until the next reload */
+		mf->version = pt->mversion;
+		return (mf->addr != NULL) ? &mf->ct : NULL;
+	}
+	if(mf->addr != NULL) {
+		munmap(mf->addr, mf->size);
+	}
+	nmf.next = mf->next;
+	memcpy(mf, &nmf, sizeof(mt_mfile_t));
+	mf->ct.mf = mf;
+	LM_DBG("mapped file [%s] version %u for tree [%.*s]\n", pt->mfile.s,
+			mf->version, pt->tname.len, pt->tname.s);
+	return &mf->ct;
+}
+
+/**
+ * build in the buffers of the walk depth the node for value v of the file
+ */
+static mt_node_t *mt_mfile_node(mt_mfile_t *mf, unsigned int v, unsigned int d)
+{
+	mt_mfile_buf_t *mb;
+	mt_mvalue_t *mv;
+	mt_mitem_t *mi;
+	void *p;
+	unsigned int i;
+
+	if(d > MT_MAX_DEPTH || v >= mf->hdr->nvalues)
+		return &_mt_empty_node;
+	mv = &mf->values[v];
+	if(mv->nitems == 0 || mv->item + mv->nitems > mf->hdr->nitems
+			|| mv->dw + mv->ndw > mf->hdr->ndw) {
+		return &_mt_empty_node;
+	}
+	mb = &_mt_mfile_buf[d];
+	if(mb->nis < mv->nitems) {
+		p = pkg_realloc(mb->is, mv->nitems * sizeof(mt_is_t));
+		if(p == NULL) {
+			PKG_MEM_ERROR;
+			return &_mt_empty_node;
+		}
+		mb->is = (mt_is_t *)p;
+		mb->nis = mv->nitems;
+	}
+	if(mb->ndw < mv->ndw) {
+		p = pkg_realloc(mb->dw, mv->ndw * sizeof(mt_dw_t));
+		if(p == NULL) {
+			PKG_MEM_ERROR;
+			return &_mt_empty_node;
+		}
+		mb->dw = (mt_dw_t *)p;
+		mb->ndw = mv->ndw;
+	}
+	for(i = 0; i < mv->nitems; i++) {
+		mi = &mf->items[mv->item + i];
+		if(mf->type == MT_TREE_IVAL) {
+			mb->is[i].tvalue.n = mi->n;
+		} else {
+			if(mi->soff + mi->slen >= mf->hdr->strsize)
+				return &_mt_empty_node;
+			mb->is[i].tvalue.s.s = mf->strs + mi->soff;
+			mb->is[i].tvalue.s.len = mi->slen;
+		}
+		mb->is[i].next = (i + 1 < mv->nitems) ? &mb->is[i + 1] : NULL;
+	}
+	for(i = 0; i < mv->ndw; i++) {
+		mb->dw[i].dstid = mf->dw[mv->dw + i].dstid;
+		mb->dw[i].weight = mf->dw[mv->dw + i].weight;
+		mb->dw[i].next = (i + 1 < mv->ndw) ? &mb->dw[i + 1] : NULL;
+	}
+	mb->node.tvalues = mb->is;
+	mb->node.data = (mv->ndw > 0) ? (void *)mb->dw : NULL;
+	mb->node.child = NULL;
+	return &mb->node;
+}
+
+/**
+ * check the prebuilt file of the tree and make the processes map it again
+ */
+int mt_mfile_reload(m_tree_t *pt)
+{
+	mt_mfile_t mf;
+
+	if(pt->mfile.s == NULL) {
+		LM_ERR("no file for tree [%.*s]\n", pt->tname.len, pt->tname.s);
+		return -1;
+	}
+	if(mt_mfile_map(pt, &mf) < 0) {
+		return -1;
+	}
+	pt->nrnodes = mf.hdr->ncells;
+	pt->nritems = mf.hdr->nitems;
+	pt->memsize = 0;
+	munmap(mf.addr, mf.size);
+
+	pt->reload_count++;
+	pt->reload_time = (uint64_t)time(NULL);
+	pt->mversion++;
+	LM_DBG("tree [%.*s] uses file [%s] version %u\n", pt->tname.len,
+			pt->tname.s, pt->mfile.s, pt->mversion);
+	return 0;
+}
+
+/**
+ * start a walk from the root of the tree
+ */
+void mt_walk_init(m_tree_t *pt, mt_walk_t *w)
+{
+	w->itn = pt->head;
+	w->ct = pt->chead;
+	if(pt->mode == MT_MODE_MFILE) {
+		w->itn = NULL;
+		w->ct = mt_mfile_get(pt);
+	}
+	w->cell = MT_CCELL_NONE;
+	w->depth = 0;
+	if(w->ct != NULL && w->ct->cells[0].base != 0) {
+		w->cell = 0;
+	}
+}
+
+/**
+ * return the node for char index mtch at the walk position w and set cw
+ * to the position of its children - w and cw can be the same
+ */
+mt_node_t *mt_walk_child(mt_walk_t *w, unsigned char mtch, mt_walk_t *cw)
+{
+	mt_ctree_t *ct;
+	mt_ccell_t *cc;
+	mt_node_t *itn;
+	unsigned int t;
+	unsigned int d;
+
+	ct = w->ct;
+	d = w->depth;
+	cw->depth = d + 1;
+	if(ct == NULL) {
+		itn = &w->itn[mtch];
+		cw->ct = NULL;
+		cw->itn = itn->child;
+		return itn;
+	}
+	t = ct->cells[w->cell].base + mtch;
+	cw->ct = ct;
+	cw->itn = NULL;
+	if(t >= ct->ncells || ct->cells[t].check != w->cell) {
+		cw->cell = MT_CCELL_NONE;
+		return &_mt_empty_node;
+	}
+	cc = &ct->cells[t];
+	cw->cell = (cc->base != 0) ? t : MT_CCELL_NONE;
+	if(cc->vidx == 0) {
+		return &_mt_empty_node;
+	}
+	if(ct->mf != NULL) {
+		return mt_mfile_node(ct->mf, cc->vidx - 1, d);
+	}
+	return &ct->values[cc->vidx - 1];
+}
+
 /**
  *
  */
@@ -210,6 +505,39 @@ m_tree_t *mt_init_tree(
 	return pt;
 }
 
+/**
+ * new value item for svalue, in shm
+ */
+static mt_is_t *mt_new_tvalue(m_tree_t *pt, str *svalue, int ivalue)
+{
+	mt_is_t *tvalues;
+
+	tvalues = (mt_is_t *)shm_malloc(sizeof(mt_is_t));
+	if(tvalues == NULL) {
+		LM_ERR("no more shm mem for tvalue\n");
+		return NULL;
+	}
+	memset(tvalues, 0, sizeof(mt_is_t));
+
+	if(pt->type == MT_TREE_IVAL) {
+		tvalues->tvalue.n = ivalue;
+	} else { /* pt->type == MT_TREE_SVAL or MT_TREE_DW */
+		tvalues->tvalue.s.s =
+				(char *)shm_malloc((svalue->len + 1) * sizeof(char));
+		if(tvalues->tvalue.s.s == NULL) {
+			LM_ERR("no more shm mem for string\n");
+			shm_free(tvalues);
+			return NULL;
+		}
+		tvalues->tvalue.s.len = svalue->len;
+		pt->memsize += (svalue->len + 1) * sizeof(char);
+		pt->nritems++;
+		strncpy(tvalues->tvalue.s.s, svalue->s, svalue->len);
+		tvalues->tvalue.s.s[svalue->len] = '\0';
+	}
+	return tvalues;
+}
+
 int mt_add_to_tree(m_tree_t *pt, str *sp, str *svalue)
 {
 	int l, ivalue = 0;
@@ -217,8 +545,8 @@ int mt_add_to_tree(m_tree_t *pt, str *sp, str *svalue)
 	mt_is_t *tvalues;
 	unsigned char mtch;
 
-	if(pt == NULL || sp == NULL || sp->s == NULL || svalue == NULL
-			|| svalue->s == NULL) {
+	if(pt == NULL || sp == NULL || sp->s == NULL || sp->len <= 0
+			|| svalue == NULL || svalue->s == NULL) {
 		LM_ERR("bad parameters\n");
 		return -1;
 	}
@@ -228,6 +556,12 @@ int mt_add_to_tree(m_tree_t *pt, str *sp, str *svalue)
 		return -1;
 	}
 
+	if(pt->chead != NULL || pt->mode == MT_MODE_MFILE) {
+		LM_ERR("tree <%.*s> is in compact layout\n", pt->tname.len,
+				pt->tname.s);
+		return -1;
+	}
+
 	mt_char_table_init(0);
 
 	LM_DBG("adding to tree <%.*s> of type <%d>\n", pt->tname.len, pt->tname.s,
@@ -238,6 +572,20 @@ int mt_add_to_tree(m_tree_t *pt, str *sp, str *svalue)
 		return -1;
 	}
 
+	if(_mt_compact_mode != 0 && pt->head == NULL) {
+		/* kept as record, the tree is built by mt_compact_tree() */
+		tvalues = mt_new_tvalue(pt, svalue, ivalue);
+		if(tvalues == NULL)
+			return -1;
+		if(mt_cstage_add(pt, sp, tvalues) < 0) {
+			if(pt->type != MT_TREE_IVAL)
+				shm_free(tvalues->tvalue.s.s);
+			shm_free(tvalues);
+			return -1;
+		}
+		return 0;
+	}
+
 	l = 0;
 	if(pt->head == NULL) {
 		pt->head = (mt_node_t *)shm_malloc(MT_NODE_SIZE * sizeof(mt_node_t));
@@ -295,28 +643,9 @@ int mt_add_to_tree(m_tree_t *pt, str *sp, str *svalue)
 		}
 	}
 
-	tvalues = (mt_is_t *)shm_malloc(sizeof(mt_is_t));
-	if(tvalues == NULL) {
-		LM_ERR("no more shm mem for tvalue\n");
+	tvalues = mt_new_tvalue(pt, svalue, ivalue);
+	if(tvalues == NULL)
 		return -1;
-	}
-	memset(tvalues, 0, sizeof(mt_is_t));
-
-	if(pt->type == MT_TREE_IVAL) {
-		tvalues->tvalue.n = ivalue;
-	} else { /* pt->type == MT_TREE_SVAL or MT_TREE_DW */
-		tvalues->tvalue.s.s =
-				(char *)shm_malloc((svalue->len + 1) * sizeof(char));
-		if(tvalues->tvalue.s.s == NULL) {
-			LM_ERR("no more shm mem for string\n");
-			return -1;
-		}
-		tvalues->tvalue.s.len = svalue->len;
-		pt->memsize += (svalue->len + 1) * sizeof(char);
-		pt->nritems++;
-		strncpy(tvalues->tvalue.s.s, svalue->s, svalue->len);
-		tvalues->tvalue.s.s[svalue->len] = '\0';
-	}
 	tvalues->next = itn0[mtch].tvalues;
 	itn0[mtch].tvalues = tvalues;
 	mt_node_set_payload(&itn0[mtch], pt->type);
@@ -362,6 +691,7 @@ is_t *mt_get_tvalue(m_tree_t *pt, str *tomatch, int *len)
 {
 	int l;
 	mt_node_t *itn;
+	mt_walk_t w;
 	is_t *tvalue;
 
 	if(pt == NULL || tomatch == NULL || tomatch->s == NULL || len == NULL) {
@@ -370,10 +700,10 @@ is_t *mt_get_tvalue(m_tree_t *pt, str *tomatch, int *len)
 	}
 
 	l = 0;
-	itn = pt->head;
+	mt_walk_init(pt, &w);
 	tvalue = NULL;
 
-	while(itn != NULL && l < tomatch->len && l < MT_MAX_DEPTH) {
+	while(!MT_WALK_END(&w) && l < tomatch->len && l < MT_MAX_DEPTH) {
 		unsigned char mtch = _mt_char_table[(unsigned char)tomatch->s[l]];
 
 		/* check validity */
@@ -383,11 +713,11 @@ is_t *mt_get_tvalue(m_tree_t *pt, str *tomatch, int *len)
 			return NULL;
 		}
 
-		if(itn[mtch].tvalues != NULL) {
-			tvalue = &itn[mtch].tvalues->tvalue;
+		itn = mt_walk_child(&w, mtch, &w);
+		if(itn->tvalues != NULL) {
+			tvalue = &itn->tvalues->tvalue;
 		}
 
-		itn = itn[mtch].child;
 		l++;
 	}
 
@@ -400,6 +730,7 @@ int mt_add_tvalues(struct sip_msg *msg, m_tree_t *pt, str *tomatch)
 {
 	int l, n;
 	mt_node_t *itn;
+	mt_walk_t w;
 	avp_value_t val;
 	avp_name_t values_avp_name;
 	avp_flags_t values_name_type;
@@ -419,9 +750,9 @@ int mt_add_tvalues(struct sip_msg *msg, m_tree_t *pt, str *tomatch)
 	destroy_avps(values_name_type, values_avp_name, 1);
 
 	l = n = 0;
-	itn = pt->head;
+	mt_walk_init(pt, &w);
 
-	while(itn != NULL && l < tomatch->len && l < MT_MAX_DEPTH) {
+	while(!MT_WALK_END(&w) && l < tomatch->len && l < MT_MAX_DEPTH) {
 		unsigned char mtch = _mt_char_table[(unsigned char)tomatch->s[l]];
 
 		/* check validity */
@@ -430,7 +761,8 @@ int mt_add_tvalues(struct sip_msg *msg, m_tree_t *pt, str *tomatch)
 					tomatch->s);
 			return -1;
 		}
-		tvalues = itn[mtch].tvalues;
+		itn = mt_walk_child(&w, mtch, &w);
+		tvalues = itn->tvalues;
 		while(tvalues != NULL) {
 			if(pt->type == MT_TREE_IVAL) {
 				val.n = tvalues->tvalue.n;
@@ -448,7 +780,6 @@ int mt_add_tvalues(struct sip_msg *msg, m_tree_t *pt, str *tomatch)
 			tvalues = tvalues->next;
 		}
 
-		itn = itn[mtch].child;
 		l++;
 	}
 
@@ -463,6 +794,7 @@ int mt_match_prefix(struct sip_msg *msg, m_tree_t *it, str *tomatch, int mode)
 	int l, len, n;
 	int i, j, k = 0;
 	mt_node_t *itn;
+	mt_walk_t w;
 	is_t *tvalue;
 	avp_name_t dstid_avp_name;
 	avp_flags_t dstid_name_type;
@@ -523,10 +855,10 @@ int mt_match_prefix(struct sip_msg *msg, m_tree_t *it, str *tomatch, int mode)
 		return -1;
 	}
 
-	itn = it->head;
+	mt_walk_init(it, &w);
 	memset(tmp_list, 0, sizeof(unsigned int) * 2 * (MT_MAX_DST_LIST + 1));
 
-	while(itn != NULL && l < tomatch->len && l < MT_MAX_DEPTH) {
+	while(!MT_WALK_END(&w) && l < tomatch->len && l < MT_MAX_DEPTH) {
 		unsigned char mtch = _mt_char_table[(unsigned char)tomatch->s[l]];
 
 		/* check validity */
@@ -536,8 +868,9 @@ int mt_match_prefix(struct sip_msg *msg, m_tree_t *it, str *tomatch, int mode)
 			return -1;
 		}
 
-		if(itn[mtch].tvalues != NULL) {
-			dw = (mt_dw_t *)itn[mtch].data;
+		itn = mt_walk_child(&w, mtch, &w);
+		if(itn->tvalues != NULL) {
+			dw = (mt_dw_t *)itn->data;
 			while(dw) {
 				tmp_list[2 * n] = dw->dstid;
 				tmp_list[2 * n + 1] = dw->weight;
@@ -551,7 +884,6 @@ int mt_match_prefix(struct sip_msg *msg, m_tree_t *it, str *tomatch, int mode)
 		if(n == MT_MAX_DST_LIST)
 			break;
 
-		itn = itn[mtch].child;
 		l++;
 	}
 
@@ -598,28 +930,35 @@ int mt_match_prefix(struct sip_msg *msg, m_tree_t *it, str *tomatch, int mode)
 	return 0;
 }
 
+static void mt_free_node_values(mt_node_t *pn, int type)
+{
+	mt_is_t *tvalues, *next;
+
+	tvalues = pn->tvalues;
+	while(tvalues != NULL) {
+		if((type == MT_TREE_SVAL) && (tvalues->tvalue.s.s != NULL)) {
+			shm_free(tvalues->tvalue.s.s);
+			tvalues->tvalue.s.s = NULL;
+			tvalues->tvalue.s.len = 0;
+		}
+		next = tvalues->next;
+		shm_free(tvalues);
+		tvalues = next;
+	}
+	pn->tvalues = NULL;
+	if(type == MT_TREE_DW)
+		mt_node_unset_payload(pn, type);
+}
+
 void mt_free_node(mt_node_t *pn, int type)
 {
 	int i;
-	mt_is_t *tvalues, *next;
 
 	if(pn == NULL)
 		return;
 
 	for(i = 0; i < MT_NODE_SIZE; i++) {
-		tvalues = pn[i].tvalues;
-		while(tvalues != NULL) {
-			if((type == MT_TREE_SVAL) && (tvalues->tvalue.s.s != NULL)) {
-				shm_free(tvalues->tvalue.s.s);
-				tvalues->tvalue.s.s = NULL;
-				tvalues->tvalue.s.len = 0;
-			}
-			next = tvalues->next;
-			shm_free(tvalues);
-			tvalues = next;
-		}
-		if(type == MT_TREE_DW)
-			mt_node_unset_payload(&pn[i], type);
+		mt_free_node_values(&pn[i], type);
 		if(pn[i].child != NULL) {
 			mt_free_node(pn[i].child, type);
 			pn[i].child = NULL;
@@ -638,29 +977,436 @@ void mt_free_tree(m_tree_t *pt)
 
 	if(pt->head != NULL)
 		mt_free_node(pt->head, pt->type);
+	if(pt->chead != NULL)
+		mt_free_ctree(pt->chead, pt->type);
+	mt_free_cstage(pt);
 	if(pt->next != NULL)
 		mt_free_tree(pt->next);
 	if(pt->dbtable.s != NULL)
 		shm_free(pt->dbtable.s);
 	if(pt->tname.s != NULL)
 		shm_free(pt->tname.s);
+	if(pt->mfile.s != NULL)
+		shm_free(pt->mfile.s);
 
 	shm_free(pt);
 	pt = NULL;
 	return;
 }
 
-int mt_print_node(mt_node_t *pn, char *code, int len, int type)
+/* prefix-value record loaded for the compact layout */
+typedef struct _mt_crec
+{
+	size_t koff;	   /* prefix as char list indexes, in keys */
+	unsigned int klen; /* prefix length */
+	unsigned int seq;  /* load order */
+	mt_is_t *tvalue;
+} mt_crec_t;
+
+/* records of a tree loaded for the compact layout - they are sorted by
+ * prefix and placed in the double-array trie without node arrays */
+typedef struct _mt_cstage
+{
+	mt_crec_t *recs;
+	size_t nrecs;
+	size_t arecs;
+	unsigned char *keys;
+	size_t nkeys;
+	size_t akeys;
+} mt_cstage_t;
+
+typedef struct _mt_cbuild
+{
+	mt_ccell_t *cells;
+	size_t ncells; /* allocated cells */
+	size_t nused;  /* highest used cell + 1 */
+	size_t nfree;  /* all cells below are used */
+	mt_node_t *values;
+	size_t nvalues;
+	mt_crec_t *recs;
+	unsigned char *keys;
+	int type;
+} mt_cbuild_t;
+
+/* keys of the records sorted by mt_crec_cmp() */
+static unsigned char *_mt_cstage_keys = NULL;
+
+static int mt_cstage_add(m_tree_t *pt, str *sp, mt_is_t *tvalues)
+{
+	mt_cstage_t *cs;
+	unsigned char mtch;
+	void *p;
+	size_t n;
+	int l;
+
+	if(pt->cstage == NULL) {
+		pt->cstage = (mt_cstage_t *)shm_mallocxz(sizeof(mt_cstage_t));
+		if(pt->cstage == NULL) {
+			SHM_MEM_ERROR;
+			return -1;
+		}
+	}
+	cs = pt->cstage;
+	if(cs->nrecs == cs->arecs) {
+		n = (cs->arecs < 1024) ? 1024 : cs->arecs + cs->arecs / 2;
+		p = shm_realloc(cs->recs, n * sizeof(mt_crec_t));
+		if(p == NULL) {
+			SHM_MEM_ERROR;
+			return -1;
+		}
+		cs->recs = (mt_crec_t *)p;
+		cs->arecs = n;
+	}
+	if(cs->nkeys + sp->len > cs->akeys) {
+		n = (cs->akeys < 16384) ? 16384 : cs->akeys + cs->akeys / 2;
+		if(n < cs->nkeys + sp->len)
+			n = cs->nkeys + sp->len;
+		p = shm_realloc(cs->keys, n);
+		if(p == NULL) {
+			SHM_MEM_ERROR;
+			return -1;
+		}
+		cs->keys = (unsigned char *)p;
+		cs->akeys = n;
+	}
+	for(l = 0; l < sp->len; l++) {
+		mtch = _mt_char_table[(unsigned char)sp->s[l]];
+		if(mtch == MT_CHAR_TABLE_NOTSET) {
+			LM_ERR("invalid char at %d in [%.*s]\n", l, sp->len, sp->s);
+			return -1;
+		}
+		cs->keys[cs->nkeys + l] = mtch;
+	}
+	cs->recs[cs->nrecs].koff = cs->nkeys;
+	cs->recs[cs->nrecs].klen = sp->len;
+	cs->recs[cs->nrecs].seq = cs->nrecs;
+	cs->recs[cs->nrecs].tvalue = tvalues;
+	cs->nrecs++;
+	cs->nkeys += sp->len;
+	return 0;
+}
+
+/**
+ * free the records loaded for the compact layout, with the values not
+ * linked in the tree
+ */
+void mt_free_cstage(m_tree_t *pt)
+{
+	mt_cstage_t *cs;
+	size_t i;
+
+	if(pt == NULL || pt->cstage == NULL)
+		return;
+	cs = pt->cstage;
+	for(i = 0; i < cs->nrecs; i++) {
+		if(cs->recs[i].tvalue == NULL)
+			continue;
+		if(pt->type != MT_TREE_IVAL && cs->recs[i].tvalue->tvalue.s.s != NULL)
+			shm_free(cs->recs[i].tvalue->tvalue.s.s);
+		shm_free(cs->recs[i].tvalue);
+	}
+	if(cs->recs != NULL)
+		shm_free(cs->recs);
+	if(cs->keys != NULL)
+		shm_free(cs->keys);
+	shm_free(cs);
+	pt->cstage = NULL;
+}
+
+static int mt_crec_same(unsigned char *keys, mt_crec_t *ra, mt_crec_t *rb)
+{
+	return (ra->klen == rb->klen
+			&& memcmp(keys + ra->koff, keys + rb->koff, ra->klen) == 0);
+}
+
+/* length of the common prefix of two records */
+static unsigned int mt_crec_common(
+		unsigned char *keys, mt_crec_t *ra, mt_crec_t *rb)
+{
+	unsigned int i;
+
+	for(i = 0; i < ra->klen && i < rb->klen; i++) {
+		if(keys[ra->koff + i] != keys[rb->koff + i])
+			break;
+	}
+	return i;
+}
+
+static int mt_crec_cmp(const void *a, const void *b)
+{
+	const mt_crec_t *ra = (const mt_crec_t *)a;
+	const mt_crec_t *rb = (const mt_crec_t *)b;
+	unsigned int n;
+	int r;
+
+	n = (ra->klen < rb->klen) ? ra->klen : rb->klen;
+	r = memcmp(_mt_cstage_keys + ra->koff, _mt_cstage_keys + rb->koff, n);
+	if(r != 0)
+		return r;
+	if(ra->klen != rb->klen)
+		return (ra->klen < rb->klen) ? -1 : 1;
+	/* newest record first, like the values lists of the node arrays */
+	return (ra->seq < rb->seq) ? 1 : -1;
+}
+
+static int mt_compact_grow(mt_cbuild_t *cb, size_t n)
+{
+	mt_ccell_t *cells;
+	size_t i;
+
+	if(n < cb->ncells + cb->ncells / 2)
+		n = cb->ncells + cb->ncells / 2;
+	if(n >= MT_CCELL_NONE) {
+		LM_ERR("too many cells for the compact layout\n");
+		return -1;
+	}
+	cells = (mt_ccell_t *)shm_realloc(cb->cells, n * sizeof(mt_ccell_t));
+	if(cells == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	for(i = cb->ncells; i < n; i++) {
+		cells[i].base = 0;
+		cells[i].check = MT_CCELL_NONE;
+		cells[i].vidx = 0;
+	}
+	cb->cells = cells;
+	cb->ncells = n;
+	return 0;
+}
+
+/**
+ * link the values of the records [lo, hi) - same prefix, newest first - to
+ * cell t, applying the duplicates policy
+ */
+static int mt_compact_values(mt_cbuild_t *cb, size_t t, size_t lo, size_t hi)
+{
+	char code[MT_MAX_DEPTH + 1];
+	mt_crec_t *rec;
+	mt_node_t *pn;
+	size_t i;
+
+	if(hi - lo > 1
+			&& (_mt_ignore_duplicates != 0 || _mt_allow_duplicates == 0)) {
+		rec = &cb->recs[lo];
+		for(i = 0; i < rec->klen; i++)
+			code[i] = mt_char_list.s[cb->keys[rec->koff + i]];
+		if(_mt_ignore_duplicates == 0) {
+			LM_ERR("prefix already allocated [%.*s] (%lu records)\n",
+					(int)rec->klen, code, (unsigned long)(hi - lo));
+			return -1;
+		}
+		LM_NOTICE("prefix already allocated [%.*s] - keeping the first of"
+				  " %lu records\n",
+				(int)rec->klen, code, (unsigned long)(hi - lo));
+		lo = hi - 1;
+	}
+	pn = &cb->values[cb->nvalues];
+	pn->tvalues = NULL;
+	pn->data = NULL;
+	pn->child = NULL;
+	for(i = hi; i > lo; i--) {
+		rec = &cb->recs[i - 1];
+		rec->tvalue->next = pn->tvalues;
+		pn->tvalues = rec->tvalue;
+		rec->tvalue = NULL;
+	}
+	cb->nvalues++;
+	cb->cells[t].vidx = cb->nvalues;
+	mt_node_set_payload(pn, cb->type);
+	return 0;
+}
+
+/**
+ * place the children of cell s, using the lowest base for which all their
+ * cells are free - the sorted records [lo, hi) have the prefix of s and
+ * are longer than d
+ */
+static int mt_compact_place(
+		mt_cbuild_t *cb, size_t s, size_t lo, size_t hi, unsigned int d)
+{
+	unsigned char used[MT_CHAR_TABLE_SIZE];
+	unsigned char ch;
+	size_t b, t, i, j, k;
+	int c, cmin, cmax;
+
+	memset(used, 0, MT_NODE_SIZE);
+	for(i = lo; i < hi; i++)
+		used[cb->keys[cb->recs[i].koff + d]] = 1;
+	cmin = cb->keys[cb->recs[lo].koff + d];
+	cmax = cb->keys[cb->recs[hi - 1].koff + d];
+
+	b = (cb->nfree > (size_t)cmin + 1) ? cb->nfree - cmin : 1;
+	while(1) {
+		if(b + cmax >= cb->ncells) {
+			if(mt_compact_grow(cb, b + cmax + 1) < 0)
+				return -1;
+		}
+		for(c = cmin; c <= cmax; c++) {
+			if(used[c] && cb->cells[b + c].check != MT_CCELL_NONE)
+				break;
+		}
+		if(c > cmax)
+			break;
+		b++;
+	}
+
+	cb->cells[s].base = b;
+	for(c = cmin; c <= cmax; c++) {
+		if(!used[c])
+			continue;
+		cb->cells[b + c].check = s;
+		if(b + c >= cb->nused)
+			cb->nused = b + c + 1;
+	}
+	while(cb->nfree < cb->ncells && cb->cells[cb->nfree].check != MT_CCELL_NONE)
+		cb->nfree++;
+
+	/* one group of records per child char */
+	for(i = lo; i < hi; i = j) {
+		ch = cb->keys[cb->recs[i].koff + d];
+		t = b + ch;
+		for(j = i; j < hi && cb->keys[cb->recs[j].koff + d] == ch; j++)
+			;
+		/* records ending at this char come first */
+		for(k = i; k < j && cb->recs[k].klen == d + 1; k++)
+			;
+		if(k > i && mt_compact_values(cb, t, i, k) < 0)
+			return -1;
+		if(k < j && mt_compact_place(cb, t, k, j, d + 1) < 0)
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * build the compact layout of the tree from its loaded records, sorted by
+ * prefix - the records are released, also on failure
+ */
+int mt_compact_tree(m_tree_t *pt)
+{
+	mt_cbuild_t cb;
+	mt_cstage_t *cs;
+	mt_ctree_t *ct;
+	mt_ccell_t *cells;
+	size_t nvalues, nnodes, i;
+
+	if(pt == NULL || pt->chead != NULL)
+		return 0;
+	if(pt->head != NULL) {
+		LM_WARN("tree [%.*s] has items added before mt_compact_mode was set"
+				" - keeping the default layout\n",
+				pt->tname.len, pt->tname.s);
+		mt_free_cstage(pt);
+		return 0;
+	}
+	if(pt->cstage == NULL)
+		return 0;
+
+	cs = pt->cstage;
+	_mt_cstage_keys = cs->keys;
+	qsort(cs->recs, cs->nrecs, sizeof(mt_crec_t), mt_crec_cmp);
+	/* prefixes with values and trie nodes, for sizing the arrays */
+	nvalues = 0;
+	nnodes = 1;
+	for(i = 0; i < cs->nrecs; i++) {
+		if(i > 0 && mt_crec_same(cs->keys, &cs->recs[i - 1], &cs->recs[i]))
+			continue;
+		nvalues++;
+		nnodes += cs->recs[i].klen;
+		if(i > 0)
+			nnodes -= mt_crec_common(cs->keys, &cs->recs[i - 1], &cs->recs[i]);
+	}
+
+	memset(&cb, 0, sizeof(mt_cbuild_t));
+	cb.recs = cs->recs;
+	cb.keys = cs->keys;
+	cb.type = pt->type;
+	if(mt_compact_grow(&cb, nnodes + nnodes / 16 + MT_NODE_SIZE) < 0)
+		goto error;
+	cb.values = (mt_node_t *)shm_malloc((nvalues + 1) * sizeof(mt_node_t));
+	if(cb.values == NULL) {
+		SHM_MEM_ERROR;
+		goto error;
+	}
+	cb.cells[0].check = 0;
+	cb.nused = 1;
+	cb.nfree = 1;
+	if(cs->nrecs > 0 && mt_compact_place(&cb, 0, 0, cs->nrecs, 0) < 0)
+		goto error;
+	/* all values are linked in cb.values now */
+	mt_free_cstage(pt);
+
+	/* the arrays are used as built, only the spare cells are released */
+	if(cb.nused < cb.ncells) {
+		cells = (mt_ccell_t *)shm_realloc(
+				cb.cells, cb.nused * sizeof(mt_ccell_t));
+		if(cells != NULL) {
+			cb.cells = cells;
+			cb.ncells = cb.nused;
+		}
+	}
+	ct = (mt_ctree_t *)shm_mallocxz(sizeof(mt_ctree_t));
+	if(ct == NULL) {
+		SHM_MEM_ERROR;
+		goto error;
+	}
+	ct->cells = cb.cells;
+	ct->values = cb.values;
+	ct->ncells = cb.nused;
+	ct->nvalues = cb.nvalues;
+	ct->size = sizeof(mt_ctree_t) + cb.nvalues * sizeof(mt_node_t)
+			   + cb.nused * sizeof(mt_ccell_t);
+
+	LM_DBG("compact tree [%.*s] - cells: %u values: %u size: %lu\n",
+			pt->tname.len, pt->tname.s, ct->ncells, ct->nvalues,
+			(unsigned long)ct->size);
+
+	pt->nrnodes = ct->ncells;
+	pt->memsize += ct->size;
+	pt->chead = ct;
+	return 0;
+
+error:
+	LM_ERR("cannot build compact layout of tree [%.*s]\n", pt->tname.len,
+			pt->tname.s);
+	if(cb.values != NULL) {
+		for(i = 0; i < cb.nvalues; i++)
+			mt_free_node_values(&cb.values[i], pt->type);
+		shm_free(cb.values);
+	}
+	if(cb.cells != NULL)
+		shm_free(cb.cells);
+	mt_free_cstage(pt);
+	return -1;
+}
+
+void mt_free_ctree(mt_ctree_t *ct, int type)
+{
+	unsigned int i;
+
+	if(ct == NULL)
+		return;
+	for(i = 0; i < ct->nvalues; i++) {
+		mt_free_node_values(&ct->values[i], type);
+	}
+	shm_free(ct->values);
+	shm_free(ct->cells);
+	shm_free(ct);
+}
+
+int mt_print_node(mt_walk_t *w, char *code, int len, int type)
 {
 	int i;
 	mt_is_t *tvalues;
+	mt_walk_t cw;
 
-	if(pn == NULL || code == NULL || len >= MT_MAX_DEPTH)
+	if(MT_WALK_END(w) || code == NULL || len >= MT_MAX_DEPTH)
 		return 0;
 
 	for(i = 0; i < MT_NODE_SIZE; i++) {
 		code[len] = mt_char_list.s[i];
-		tvalues = pn[i].tvalues;
+		tvalues = mt_walk_child(w, i, &cw)->tvalues;
 		while(tvalues != NULL) {
 			if(type == MT_TREE_IVAL) {
 				LM_INFO("[%.*s] [i:%d]\n", len + 1, code, tvalues->tvalue.n);
@@ -670,7 +1416,7 @@ int mt_print_node(mt_node_t *pn, char *code, int len, int type)
 			}
 			tvalues = tvalues->next;
 		}
-		mt_print_node(pn[i].child, code, len + 1, type);
+		mt_print_node(&cw, code, len + 1, type);
 	}
 
 	return 0;
@@ -680,6 +1426,7 @@ static char mt_code_buf[MT_MAX_DEPTH + 1];
 int mt_print_tree(m_tree_t *pt)
 {
 	int len;
+	mt_walk_t w;
 
 	if(pt == NULL) {
 		LM_DBG("tree is empty\n");
@@ -688,7 +1435,8 @@ int mt_print_tree(m_tree_t *pt)
 
 	LM_INFO("[%.*s]\n", pt->tname.len, pt->tname.s);
 	len = 0;
-	mt_print_node(pt->head, mt_code_buf, len, pt->type);
+	mt_walk_init(pt, &w);
+	mt_print_node(&w, mt_code_buf, len, pt->type);
 	return mt_print_tree(pt->next);
 }
 
@@ -799,6 +1547,9 @@ int mt_table_spec(char *val)
 				  && strncasecmp(pit->name.s, "cols", 4) == 0) {
 			tmp.ncols = 1;
 			tmp.scols[0] = pit->body;
+		} else if(pit->name.len == 4
+				  && strncasecmp(pit->name.s, "file", 4) == 0) {
+			tmp.mfile = pit->body;
 		}
 	}
 	if(tmp.tname.s == NULL) {
@@ -811,6 +1562,15 @@ int mt_table_spec(char *val)
 			goto error;
 		}
 	}
+	if(tmp.mode == MT_MODE_MFILE) {
+		if(tmp.mfile.s == NULL || tmp.mfile.len <= 0) {
+			LM_ERR("no file provided\n");
+			goto error;
+		}
+	} else if(tmp.mode != MT_MODE_DB && tmp.mode != MT_MODE_MEMORY) {
+		LM_ERR("unknown tree mode <%d>\n", tmp.mode);
+		goto error;
+	}
 	if((tmp.type != 0) && (tmp.type != 1) && (tmp.type != 2)) {
 		LM_ERR("unknown tree type <%d>\n", tmp.type);
 		goto error;
@@ -853,6 +1613,17 @@ int mt_table_spec(char *val)
 			LM_ERR("cannot init the tree [%.*s]\n", tmp.tname.len, tmp.tname.s);
 			goto error;
 		}
+		if(tmp.mode == MT_MODE_MFILE) {
+			ndl->mfile.s = (char *)shm_malloc(tmp.mfile.len + 1);
+			if(ndl->mfile.s == NULL) {
+				SHM_MEM_ERROR;
+				mt_free_tree(ndl);
+				goto error;
+			}
+			memcpy(ndl->mfile.s, tmp.mfile.s, tmp.mfile.len);
+			ndl->mfile.s[tmp.mfile.len] = '\0';
+			ndl->mfile.len = tmp.mfile.len;
+		}
 
 		ndl->next = it;
 
@@ -1006,6 +1777,7 @@ int mt_rpc_add_tvalues(rpc_t *rpc, void *ctx, m_tree_t *pt, str *tomatch)
 {
 	int l;
 	mt_node_t *itn;
+	mt_walk_t w;
 	mt_is_t *tvalues;
 	void *vstruct = NULL;
 	str prefix = STR_NULL;
@@ -1017,9 +1789,9 @@ int mt_rpc_add_tvalues(rpc_t *rpc, void *ctx, m_tree_t *pt, str *tomatch)
 	prefix = *tomatch;
 
 	l = 0;
-	itn = pt->head;
+	mt_walk_init(pt, &w);
 
-	while(itn != NULL && l < tomatch->len && l < MT_MAX_DEPTH) {
+	while(!MT_WALK_END(&w) && l < tomatch->len && l < MT_MAX_DEPTH) {
 		unsigned char mtch = _mt_char_table[(unsigned char)tomatch->s[l]];
 
 		/* check validity */
@@ -1028,7 +1800,8 @@ int mt_rpc_add_tvalues(rpc_t *rpc, void *ctx, m_tree_t *pt, str *tomatch)
 					tomatch->s);
 			return -1;
 		}
-		tvalues = itn[mtch].tvalues;
+		itn = mt_walk_child(&w, mtch, &w);
+		tvalues = itn->tvalues;
 		while(tvalues != NULL) {
 			prefix.len = l + 1;
 			if(rpc->add(ctx, "{", &vstruct) < 0) {
@@ -1055,7 +1828,6 @@ int mt_rpc_add_tvalues(rpc_t *rpc, void *ctx, m_tree_t *pt, str *tomatch)
 			tvalues = tvalues->next;
 		}
 
-		itn = itn[mtch].child;
 		l++;
 	}
 
@@ -1071,6 +1843,7 @@ int mt_rpc_match_prefix(
 	int l, len, n;
 	int i, j;
 	mt_node_t *itn;
+	mt_walk_t w;
 	is_t *tvalue;
 	mt_dw_t *dw;
 	int tprefix_len = 0;
@@ -1129,10 +1902,10 @@ int mt_rpc_match_prefix(
 	if(it->type != MT_TREE_DW)
 		return -1; /* wrong tree type */
 
-	itn = it->head;
+	mt_walk_init(it, &w);
 	memset(tmp_list, 0, sizeof(unsigned int) * 2 * (MT_MAX_DST_LIST + 1));
 
-	while(itn != NULL && l < tomatch->len && l < MT_MAX_DEPTH) {
+	while(!MT_WALK_END(&w) && l < tomatch->len && l < MT_MAX_DEPTH) {
 		unsigned char mtch = _mt_char_table[(unsigned char)tomatch->s[l]];
 
 		/* check validity */
@@ -1142,8 +1915,9 @@ int mt_rpc_match_prefix(
 			return -1;
 		}
 
-		if(itn[mtch].tvalues != NULL) {
-			dw = (mt_dw_t *)itn[mtch].data;
+		itn = mt_walk_child(&w, mtch, &w);
+		if(itn->tvalues != NULL) {
+			dw = (mt_dw_t *)itn->data;
 			while(dw) {
 				tmp_list[2 * n] = dw->dstid;
 				tmp_list[2 * n + 1] = dw->weight;
@@ -1157,7 +1931,6 @@ int mt_rpc_match_prefix(
 		if(n == MT_MAX_DST_LIST)
 			break;
 
-		itn = itn[mtch].child;
 		l++;
 	}
 
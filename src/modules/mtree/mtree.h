@@ -35,6 +35,10 @@
 #define MT_TREE_DW 1
 #define MT_TREE_IVAL 2
 
+#define MT_MODE_DB 0
+#define MT_MODE_MEMORY 1
+#define MT_MODE_MFILE 2 /* prebuilt file mapped in each process */
+
 typedef union
 {
 	int n;
@@ -61,6 +65,42 @@ typedef struct _mt_node
 	struct _mt_node *child;
 } mt_node_t;
 
+/* cell of a compact tree (double-array trie): child of cell s for char c
+ * is cell base(s)+c if its check is s */
+typedef struct _mt_ccell
+{
+	unsigned int base;	/* offset of children cells, 0 if no children */
+	unsigned int check; /* parent cell */
+	unsigned int vidx;	/* position+1 in values, 0 if no values */
+} mt_ccell_t;
+
+struct _mt_mfile;
+struct _mt_cstage;
+
+typedef struct _mt_ctree
+{
+	unsigned int ncells;
+	unsigned int nvalues;
+	size_t size;	   /* shm size of header, cells and values */
+	mt_ccell_t *cells; /* cell 0 is the root */
+	mt_node_t *values; /* tvalues and payload of prefixes with values */
+	struct _mt_mfile *mf; /* mapped file, providing the values instead */
+} mt_ctree_t;
+
+/* position while walking a tree, for either layout */
+typedef struct _mt_walk
+{
+	mt_node_t *itn;	   /* current node array */
+	mt_ctree_t *ct;	   /* compact tree, if used */
+	unsigned int cell; /* current cell in compact tree */
+	unsigned int depth;
+} mt_walk_t;
+
+#define MT_CCELL_NONE 0xffffffff
+
+#define MT_WALK_END(w) \
+	(((w)->ct != NULL) ? ((w)->cell == MT_CCELL_NONE) : ((w)->itn == NULL))
+
 #define MT_MAX_DEPTH 64
 
 #define MT_NODE_SIZE mt_char_list.len
@@ -78,10 +118,14 @@ typedef struct _m_tree
 	char pack[4];
 	unsigned int nrnodes;
 	unsigned int nritems;
-	unsigned int memsize;
+	unsigned long memsize;
 	unsigned int reload_count;
 	uint64_t reload_time;
 	mt_node_t *head;
+	mt_ctree_t *chead; /* compact layout, replacing head if set */
+	struct _mt_cstage *cstage; /* records loaded for the compact layout */
+	str mfile;		   /* prebuilt file for MT_MODE_MFILE */
+	unsigned int mversion; /* incremented when mfile has to be remapped */
 	struct _m_tree *next;
 } m_tree_t;
 
@@ -101,6 +145,15 @@ void mt_free_tree(m_tree_t *pt);
 int mt_print_tree(m_tree_t *pt);
 void mt_free_node(mt_node_t *pn, int type);
 
+int mt_compact_tree(m_tree_t *pt);
+void mt_free_cstage(m_tree_t *pt);
+int mt_mfile_reload(m_tree_t *pt);
+void mt_free_ctree(mt_ctree_t *ct, int type);
+
+void mt_walk_init(m_tree_t *pt, mt_walk_t *w);
+mt_node_t *mt_walk_child(
+		mt_walk_t *w, unsigned char mtch, mt_walk_t *cw);
+
 int mt_char_table_init(int nset);
 int mt_node_set_payload(mt_node_t *node, int type);
 int mt_node_unset_payload(mt_node_t *node, int type);
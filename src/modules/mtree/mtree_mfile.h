@@ -0,0 +1,236 @@
+/**
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Layout of prebuilt mtree files, written by utils/mtbuild and mapped
+ * read-only by the module for trees with mode=2, and by the pdt and
+ * prefix_route modules when they are set to use files (string trees).
+ * This header is shared with the tool, therefore it must not include core
+ * headers.
+ *
+ * The file is the header followed by the sections, in this order:
+ *   - cells[ncells]   - double-array trie, cell 0 is the root
+ *   - values[nvalues] - values of the prefixes, referenced by cells
+ *   - items[nitems]   - all values, newest first for each prefix
+ *   - dw[ndw]         - dstid/weight pairs of type 1 trees
+ *   - strs[strsize]   - zero terminated string values
+ */
+
+#ifndef _MTREE_MFILE_H_
+#define _MTREE_MFILE_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MT_MFILE_MAGIC "KSRMTREE"
+#define MT_MFILE_VERSION 1
+#define MT_MFILE_CHARS 256
+
+typedef struct _mt_mfile_hdr
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t type; /* tree type - 0 string, 1 dstid/weight, 2 integer */
+	uint32_t ncells;
+	uint32_t nvalues;
+	uint32_t nitems;
+	uint32_t ndw;
+	uint32_t strsize;
+	uint32_t nchars;
+	char chars[MT_MFILE_CHARS]; /* prefix char list, cell offsets index it */
+	uint64_t size;				/* size of the file */
+} mt_mfile_hdr_t;
+
+/* same layout as mt_ccell_t */
+typedef struct _mt_mcell
+{
+	uint32_t base;	/* offset of children cells, 0 if no children */
+	uint32_t check; /* parent cell */
+	uint32_t vidx;	/* position+1 in values, 0 if no values */
+} mt_mcell_t;
+
+typedef struct _mt_mvalue
+{
+	uint32_t item; /* first item */
+	uint32_t nitems;
+	uint32_t dw; /* first dstid/weight pair */
+	uint32_t ndw;
+} mt_mvalue_t;
+
+typedef struct _mt_mitem
+{
+	int32_t n;		/* integer value */
+	uint32_t soff;	/* string value offset in strs */
+	uint32_t slen;	/* string value length */
+} mt_mitem_t;
+
+typedef struct _mt_mdw
+{
+	uint32_t dstid;
+	uint32_t weight;
+} mt_mdw_t;
+
+#define MT_MFILE_SIZE(h)                                                      \
+	(sizeof(mt_mfile_hdr_t) + (uint64_t)(h)->ncells * sizeof(mt_mcell_t)      \
+			+ (uint64_t)(h)->nvalues * sizeof(mt_mvalue_t)                    \
+			+ (uint64_t)(h)->nitems * sizeof(mt_mitem_t)                      \
+			+ (uint64_t)(h)->ndw * sizeof(mt_mdw_t) + (uint64_t)(h)->strsize)
+
+#define MT_MFILE_CELL_NONE 0xffffffff
+
+/* sections of a file mapped in memory */
+typedef struct _mt_mfile_view
+{
+	mt_mfile_hdr_t *hdr;
+	mt_mcell_t *cells;
+	mt_mvalue_t *values;
+	mt_mitem_t *items;
+	mt_mdw_t *dw;
+	char *strs;
+} mt_mfile_view_t;
+
+/**
+ * map read-only the file at path, to be released with munmap(addr, size)
+ * - returns 0 if mapped, -1 if it cannot be opened or mapped (errno is set),
+ *   -2 if it is too small to be a file of this layout
+ */
+static inline int mt_mfile_mmap(const char *path, void **addr, uint64_t *size)
+{
+	struct stat st;
+	int fd;
+	int err;
+
+	*addr = NULL;
+	*size = 0;
+	fd = open(path, O_RDONLY);
+	if(fd < 0)
+		return -1;
+	if(fstat(fd, &st) < 0) {
+		err = errno;
+		close(fd);
+		errno = err;
+		return -1;
+	}
+	if(st.st_size < (off_t)sizeof(mt_mfile_hdr_t)) {
+		close(fd);
+		return -2;
+	}
+	*addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	err = errno;
+	close(fd);
+	if(*addr == MAP_FAILED) {
+		*addr = NULL;
+		errno = err;
+		return -1;
+	}
+	*size = st.st_size;
+	return 0;
+}
+
+/**
+ * check the header of the file mapped at addr and set the sections of v
+ * - returns 0 if valid, -1 if not a supported file, -2 for a bad size
+ */
+static inline int mt_mfile_view_init(
+		mt_mfile_view_t *v, void *addr, uint64_t size)
+{
+	mt_mfile_hdr_t *hdr;
+	char *p;
+
+	memset(v, 0, sizeof(mt_mfile_view_t));
+	if(size < sizeof(mt_mfile_hdr_t))
+		return -2;
+	hdr = (mt_mfile_hdr_t *)addr;
+	if(memcmp(hdr->magic, MT_MFILE_MAGIC, sizeof(hdr->magic)) != 0
+			|| hdr->version != MT_MFILE_VERSION)
+		return -1;
+	if(hdr->size != size || MT_MFILE_SIZE(hdr) != size || hdr->ncells == 0
+			|| hdr->strsize == 0)
+		return -2;
+	p = (char *)addr + sizeof(mt_mfile_hdr_t);
+	v->hdr = hdr;
+	v->cells = (mt_mcell_t *)p;
+	p += (uint64_t)hdr->ncells * sizeof(mt_mcell_t);
+	v->values = (mt_mvalue_t *)p;
+	p += (uint64_t)hdr->nvalues * sizeof(mt_mvalue_t);
+	v->items = (mt_mitem_t *)p;
+	p += (uint64_t)hdr->nitems * sizeof(mt_mitem_t);
+	v->dw = (mt_mdw_t *)p;
+	p += (uint64_t)hdr->ndw * sizeof(mt_mdw_t);
+	v->strs = p;
+	return 0;
+}
+
+/**
+ * check that the file was built for the char list chars of nchars
+ */
+static inline int mt_mfile_view_chars(
+		mt_mfile_view_t *v, const char *chars, uint32_t nchars)
+{
+	return (v->hdr->nchars == nchars
+				   && memcmp(v->hdr->chars, chars, nchars) == 0)
+				   ? 0
+				   : -1;
+}
+
+/**
+ * child of cell s for the char index c, MT_MFILE_CELL_NONE if not set
+ */
+static inline uint32_t mt_mfile_view_child(
+		mt_mfile_view_t *v, uint32_t s, unsigned int c)
+{
+	uint32_t t;
+
+	if(s >= v->hdr->ncells || v->cells[s].base == 0)
+		return MT_MFILE_CELL_NONE;
+	t = v->cells[s].base + c;
+	if(t >= v->hdr->ncells || v->cells[t].check != s)
+		return MT_MFILE_CELL_NONE;
+	return t;
+}
+
+/**
+ * string of the first (newest) value of cell s, NULL if s has no value
+ */
+static inline char *mt_mfile_view_str(
+		mt_mfile_view_t *v, uint32_t s, uint32_t *len)
+{
+	mt_mvalue_t *mv;
+	mt_mitem_t *mi;
+
+	if(v->cells[s].vidx == 0 || v->cells[s].vidx > v->hdr->nvalues)
+		return NULL;
+	mv = &v->values[v->cells[s].vidx - 1];
+	if(mv->nitems == 0 || mv->item >= v->hdr->nitems)
+		return NULL;
+	mi = &v->items[mv->item];
+	if((uint64_t)mi->soff + mi->slen >= v->hdr->strsize)
+		return NULL;
+	*len = mi->slen;
+	return v->strs + mi->soff;
+}
+
+#endif
@@ -57,6 +57,7 @@ static int mt_connect_mode = 0;
 /** database connection */
 static db1_con_t *db_con = NULL;
 static db_func_t mt_dbf;
+static int mt_db_needed = 1;
 
 #if 0
 INSERT INTO version (table_name, table_version) values ('mtree','1');
@@ -101,6 +102,7 @@ pv_spec_t pv_count;
 int _mt_tree_type = MT_TREE_SVAL;
 int _mt_ignore_duplicates = 0;
 int _mt_allow_duplicates = 0;
+int _mt_compact_mode = 0;
 
 /* lock, ref counter and flag used for reloading the date */
 static gen_lock_t *mt_lock = 0;
@@ -123,6 +125,7 @@ static int bind_mtree(mtree_api_t *api);
 static int mt_match(sip_msg_t *msg, str *tname, str *tomatch, int mval);
 
 static int mt_load_db(m_tree_t *pt);
+static int mt_check_db_needed(void);
 static int mt_load_db_trees();
 
 /* clang-format off */
@@ -153,6 +156,7 @@ static param_export_t params[] = {
 	{"mt_tree_type", PARAM_INT, &_mt_tree_type},
 	{"mt_ignore_duplicates", PARAM_INT, &_mt_ignore_duplicates},
 	{"mt_allow_duplicates", PARAM_INT, &_mt_allow_duplicates},
+	{"mt_compact_mode", PARAM_INT, &_mt_compact_mode},
 	{0, 0, 0}
 };
 
@@ -212,26 +216,31 @@ static int mod_init(void)
 	if(mt_fetch_rows <= 0)
 		mt_fetch_rows = 1000;
 
-	/* binding to database module */
-	if(db_bind_mod(&db_url, &mt_dbf)) {
-		LM_ERR("database module not found\n");
-		return -1;
-	}
+	mt_db_needed = mt_check_db_needed();
+	if(mt_db_needed == 0) {
+		LM_DBG("no tree is loaded from database - db_url not used\n");
+	} else {
+		/* binding to database module */
+		if(db_bind_mod(&db_url, &mt_dbf)) {
+			LM_ERR("database module not found\n");
+			return -1;
+		}
 
-	if(!DB_CAPABILITY(mt_dbf, DB_CAP_ALL)) {
-		LM_ERR("database module does not "
-			   "implement all functions needed by the module\n");
-		return -1;
-	}
+		if(!DB_CAPABILITY(mt_dbf, DB_CAP_ALL)) {
+			LM_ERR("database module does not "
+				   "implement all functions needed by the module\n");
+			return -1;
+		}
 
-	/* open a connection with the database */
-	db_con = mt_dbf.init(&db_url);
-	if(db_con == NULL) {
-		LM_ERR("failed to connect to the database\n");
-		return -1;
-	}
+		/* open a connection with the database */
+		db_con = mt_dbf.init(&db_url);
+		if(db_con == NULL) {
+			LM_ERR("failed to connect to the database\n");
+			return -1;
+		}
 
-	LM_DBG("database connection opened successfully\n");
+		LM_DBG("database connection opened successfully\n");
+	}
 
 	if((mt_lock = lock_alloc()) == 0) {
 		LM_CRIT("failed to alloc lock\n");
@@ -275,7 +284,8 @@ static int mod_init(void)
 			goto error1;
 		}
 	}
-	mt_dbf.close(db_con);
+	if(db_con != NULL)
+		mt_dbf.close(db_con);
 	db_con = 0;
 
 #if 0
@@ -307,6 +317,9 @@ static int child_init(int rank)
 	if(rank == PROC_INIT || rank == PROC_MAIN || rank == PROC_TCP_MAIN)
 		return 0;
 
+	if(mt_db_needed == 0)
+		return 0;
+
 	if(mt_connect_mode == 1) {
 		LM_DBG("mtree: database connection deferred until reload "
 			   "(connect_mode=1) "
@@ -527,6 +540,23 @@ static int mt_pack_values(
 	return 0;
 }
 
+/**
+ * the database is not used when all trees are in-memory only or served
+ * from prebuilt files
+ */
+static int mt_check_db_needed(void)
+{
+	m_tree_t *pt;
+
+	if(!mt_defined_trees())
+		return 1;
+	for(pt = mt_get_first_tree(); pt != NULL; pt = pt->next) {
+		if(pt->mode == MT_MODE_DB)
+			return 1;
+	}
+	return 0;
+}
+
 static int mt_load_db(m_tree_t *pt)
 {
 	db_key_t db_cols[MT_MAX_COLS] = {&tprefix_column, &tvalue_column};
@@ -539,10 +569,18 @@ static int mt_load_db(m_tree_t *pt)
 	m_tree_t new_tree;
 	m_tree_t *old_tree = NULL;
 	mt_node_t *bk_head = NULL;
+	mt_ctree_t *bk_chead = NULL;
 
+	if(pt->mode == MT_MODE_MFILE) {
+		/* readers map the checked file again on next use */
+		return mt_mfile_reload(pt);
+	}
 	if(pt->mode == 1) {
 		LM_DBG("skip loading db records - in-memory only tree: [%.*s]\n",
 				pt->tname.len, pt->tname.s);
+		if(_mt_compact_mode != 0 && mt_compact_tree(pt) < 0) {
+			return -1;
+		}
 		return 0;
 	}
 	if(pt->ncols > 0) {
@@ -583,6 +621,8 @@ static int mt_load_db(m_tree_t *pt)
 	}
 	memcpy(&new_tree, old_tree, sizeof(m_tree_t));
 	new_tree.head = 0;
+	new_tree.chead = 0;
+	new_tree.cstage = 0;
 	new_tree.next = 0;
 	new_tree.nrnodes = 0;
 	new_tree.nritems = 0;
@@ -678,6 +718,12 @@ static int mt_load_db(m_tree_t *pt)
 dbreloaded:
 	mt_dbf.free_result(db_con, db_res);
 
+	if(_mt_compact_mode != 0) {
+		/* built before blocking the readers */
+		if(mt_compact_tree(&new_tree) < 0) {
+			return -1;
+		}
+	}
 
 	/* block all readers */
 	lock_get(mt_lock);
@@ -689,7 +735,9 @@ dbreloaded:
 	}
 
 	bk_head = old_tree->head;
+	bk_chead = old_tree->chead;
 	old_tree->head = new_tree.head;
+	old_tree->chead = new_tree.chead;
 	old_tree->nrnodes = new_tree.nrnodes;
 	old_tree->nritems = new_tree.nritems;
 	old_tree->memsize = new_tree.memsize;
@@ -701,6 +749,8 @@ dbreloaded:
 	/* free old data */
 	if(bk_head != NULL)
 		mt_free_node(bk_head, new_tree.type);
+	if(bk_chead != NULL)
+		mt_free_ctree(bk_chead, new_tree.type);
 
 	return 0;
 
@@ -708,6 +758,7 @@ error:
 	mt_dbf.free_result(db_con, db_res);
 	if(new_tree.head != NULL)
 		mt_free_node(new_tree.head, new_tree.type);
+	mt_free_cstage(&new_tree);
 	return -1;
 }
 
@@ -816,6 +867,15 @@ static int mt_load_db_trees()
 	} while(RES_ROW_N(db_res) > 0);
 	mt_dbf.free_result(db_con, db_res);
 
+	if(_mt_compact_mode != 0) {
+		for(new_tree = new_head; new_tree != NULL; new_tree = new_tree->next) {
+			if(mt_compact_tree(new_tree) < 0) {
+				mt_free_tree(new_head);
+				return -1;
+			}
+		}
+	}
+
 	/* block all readers */
 	lock_get(mt_lock);
 	mt_reload_flag = 1;
@@ -887,7 +947,7 @@ void rpc_mtree_summary(rpc_t *rpc, void *c)
 				rpc->fault(c, 500, "Internal error adding type");
 				return;
 			}
-			if(rpc->struct_add(ih, "d", "memsize", pt->memsize) < 0) {
+			if(rpc->struct_add(ih, "j", "memsize", pt->memsize) < 0) {
 				rpc->fault(c, 500, "Internal error adding memsize");
 				return;
 			}
@@ -1038,21 +1098,22 @@ static const char *rpc_mtree_match_doc[6] = {"Match prefix value against mtree",
 		"prefix - prefix for matching", "mode - mode for matching (0 or 2)", 0};
 
 
-int rpc_mtree_print_node(rpc_t *rpc, void *ctx, m_tree_t *tree, mt_node_t *pt,
+int rpc_mtree_print_node(rpc_t *rpc, void *ctx, m_tree_t *tree, mt_walk_t *w,
 		char *code, int len)
 {
 	int i;
 	mt_is_t *tvalues;
+	mt_walk_t cw;
 	str val;
 	void *th = NULL;
 	void *ih = NULL;
 
-	if(pt == NULL || len >= MT_MAX_DEPTH)
+	if(MT_WALK_END(w) || len >= MT_MAX_DEPTH)
 		return 0;
 
 	for(i = 0; i < MT_NODE_SIZE; i++) {
 		code[len] = mt_char_list.s[i];
-		tvalues = pt[i].tvalues;
+		tvalues = mt_walk_child(w, i, &cw)->tvalues;
 		if(tvalues != NULL) {
 			/* add structure node */
 			if(rpc->add(ctx, "{", &th) < 0) {
@@ -1085,7 +1146,7 @@ int rpc_mtree_print_node(rpc_t *rpc, void *ctx, m_tree_t *tree, mt_node_t *pt,
 				tvalues = tvalues->next;
 			}
 		}
-		if(rpc_mtree_print_node(rpc, ctx, tree, pt[i].child, code, len + 1) < 0)
+		if(rpc_mtree_print_node(rpc, ctx, tree, &cw, code, len + 1) < 0)
 			goto error;
 	}
 	return 0;
@@ -1105,6 +1166,7 @@ void rpc_mtree_list(rpc_t *rpc, void *ctx)
 	m_tree_t *pt;
 	static char code_buf[MT_MAX_DEPTH + 1];
 	int len;
+	mt_walk_t w;
 
 	if(!mt_defined_trees()) {
 		rpc->fault(ctx, 500, "Empty tree list.");
@@ -1124,8 +1186,8 @@ void rpc_mtree_list(rpc_t *rpc, void *ctx)
 						&& strncmp(pt->tname.s, tname.s, tname.len) == 0)) {
 			len = 0;
 			code_buf[0] = '\0';
-			if(rpc_mtree_print_node(rpc, ctx, pt, pt->head, code_buf, len)
-					< 0) {
+			mt_walk_init(pt, &w);
+			if(rpc_mtree_print_node(rpc, ctx, pt, &w, code_buf, len) < 0) {
 				goto error;
 			}
 		}
@@ -49,6 +49,7 @@
 #include "../../core/kemi.h"
 
 #include "pdtree.h"
+#include "pdt_mfile.h"
 
 MODULE_VERSION
 
@@ -123,6 +124,7 @@ static param_export_t params[] = {
 	{"fetch_rows", PARAM_INT, &pdt_fetch_rows},
 	{"check_domain", PARAM_INT, &pdt_check_domain},
 	{"mode", PARAM_INT, &_pdt_mode},
+	{"file", PARAM_STRING | PARAM_USE_FUNC, (void *)pdt_mfile_param},
 	{0, 0, 0}
 };
 
@@ -160,6 +162,15 @@ static int mod_init(void)
 	}
 	LM_INFO("pdt_char_list=%s \n", pdt_char_list.s);
 
+	if(pdt_mfile_defined()) {
+		/* prefix-domain pairs served from files - database not used */
+		if(pdt_mfile_init() < 0) {
+			LM_ERR("cannot map the pdt files\n");
+			return -1;
+		}
+		return 0;
+	}
+
 	/* binding to mysql module */
 	if(db_bind_mod(&db_url, &pdt_dbf)) {
 		LM_ERR("database module not found\n");
@@ -242,6 +253,9 @@ static int child_init(int rank)
 	if(rank == PROC_INIT || rank == PROC_MAIN || rank == PROC_TCP_MAIN)
 		return 0; /* do nothing for the main process */
 
+	if(pdt_mfile_defined())
+		return 0;
+
 	if(pdt_init_db() < 0) {
 		LM_ERR("cannot initialize database connection\n");
 		return -1;
@@ -370,6 +384,24 @@ static int pd_translate(sip_msg_t *msg, str *sdomain, int rmode, int fmode)
 	p.s = msg->parsed_uri.user.s + pdt_prefix.len;
 	p.len = msg->parsed_uri.user.len - pdt_prefix.len;
 
+	if(pdt_mfile_defined()) {
+		/* the mapping of the files is private to the process */
+		if((d = pdt_mfile_get_domain(sdomain, &p, &plen)) == NULL) {
+			plen = 0;
+			if((fmode == 0)
+					|| (d = pdt_mfile_get_domain(&sdall, &p, &plen))
+							   == NULL) {
+				LM_INFO("no prefix PDT prefix matched [%.*s]\n", p.len, p.s);
+				return -1;
+			}
+		}
+		if(update_new_uri(msg, plen, d, rmode) < 0) {
+			LM_ERR("new_uri cannot be updated\n");
+			return -1;
+		}
+		return 1;
+	}
+
 again:
 	lock_get(pdt_lock);
 	if(pdt_reload_flag) {
@@ -675,6 +707,13 @@ static const char *pdt_rpc_reload_doc[2] = {"Reload PDT database records", 0};
  */
 static void pdt_rpc_reload(rpc_t *rpc, void *ctx)
 {
+	if(pdt_mfile_defined()) {
+		if(pdt_mfile_reload() < 0) {
+			LM_ERR("cannot re-load pdt files\n");
+			rpc->fault(ctx, 500, "Reload Failed");
+		}
+		return;
+	}
 	if(pdt_load_db() < 0) {
 		LM_ERR("cannot re-load pdt records from database\n");
 		rpc->fault(ctx, 500, "Reload Failed");
@@ -687,6 +726,27 @@ static void pdt_rpc_reload(rpc_t *rpc, void *ctx)
 static const char *pdt_rpc_list_doc[2] = {"List PDT memory records", 0};
 
 
+/**
+ * return 1 if the record (prefix in code[0..len]) matches the filters
+ */
+static int pdt_rpc_match(
+		str *domain, char *code, int len, str *tdomain, str *tprefix)
+{
+	return ((tprefix->s == NULL && tdomain->s == NULL)
+			|| (tprefix->s == NULL
+					&& (tdomain->s != NULL && domain->len == tdomain->len
+							&& strncasecmp(domain->s, tdomain->s, tdomain->len)
+									   == 0))
+			|| (tdomain->s == NULL
+					&& (len + 1 >= tprefix->len
+							&& strncmp(code, tprefix->s, tprefix->len) == 0))
+			|| ((tprefix->s != NULL && len + 1 >= tprefix->len
+						&& strncmp(code, tprefix->s, tprefix->len) == 0)
+					&& (tdomain->s != NULL && domain->len >= tdomain->len
+							&& strncasecmp(domain->s, tdomain->s, tdomain->len)
+									   == 0)));
+}
+
 int pdt_rpc_print_node(rpc_t *rpc, void *ctx, void *ih, pdt_node_t *pt,
 		char *code, int len, str *sdomain, str *tdomain, str *tprefix)
 {
@@ -703,24 +763,7 @@ int pdt_rpc_print_node(rpc_t *rpc, void *ctx, void *ih, pdt_node_t *pt,
 	for(i = 0; i < cl->len; i++) {
 		code[len] = cl->s[i];
 		if(pt[i].domain.s != NULL) {
-			if((tprefix->s == NULL && tdomain->s == NULL)
-					|| (tprefix->s == NULL
-							&& (tdomain->s != NULL
-									&& pt[i].domain.len == tdomain->len
-									&& strncasecmp(pt[i].domain.s, tdomain->s,
-											   tdomain->len)
-											   == 0))
-					|| (tdomain->s == NULL
-							&& (len + 1 >= tprefix->len
-									&& strncmp(code, tprefix->s, tprefix->len)
-											   == 0))
-					|| ((tprefix->s != NULL && len + 1 >= tprefix->len
-								&& strncmp(code, tprefix->s, tprefix->len) == 0)
-							&& (tdomain->s != NULL
-									&& pt[i].domain.len >= tdomain->len
-									&& strncasecmp(pt[i].domain.s, tdomain->s,
-											   tdomain->len)
-											   == 0))) {
+			if(pdt_rpc_match(&pt[i].domain, code, len, tdomain, tprefix)) {
 				if(rpc->struct_add(ih, "{", "ENTRY", &vh) < 0) {
 					LM_ERR("Internal error creating entry\n");
 					return -1;
@@ -745,6 +788,49 @@ error:
 	return -1;
 }
 
+/**
+ * add the records of the file below cell s to the RPC reply
+ */
+static int pdt_rpc_print_mfile(rpc_t *rpc, void *ih, pdt_mfile_t *mf,
+		uint32_t s, char *code, int len, str *tdomain, str *tprefix)
+{
+	uint32_t t, dlen;
+	str domain;
+	str prefix;
+	void *vh;
+	int i;
+
+	if(len >= PDT_MAX_DEPTH)
+		return 0;
+
+	for(i = 0; i < pdt_char_list.len; i++) {
+		t = mt_mfile_view_child(&mf->v, s, i);
+		if(t == MT_MFILE_CELL_NONE)
+			continue;
+		code[len] = pdt_char_list.s[i];
+		domain.s = mt_mfile_view_str(&mf->v, t, &dlen);
+		domain.len = dlen;
+		if(domain.s != NULL
+				&& pdt_rpc_match(&domain, code, len, tdomain, tprefix)) {
+			if(rpc->struct_add(ih, "{", "ENTRY", &vh) < 0) {
+				LM_ERR("Internal error creating entry\n");
+				return -1;
+			}
+			prefix.s = code;
+			prefix.len = len + 1;
+			if(rpc->struct_add(vh, "SS", "DOMAIN", &domain, "PREFIX", &prefix)
+					< 0) {
+				LM_ERR("Internal error filling entry struct\n");
+				return -1;
+			}
+		}
+		if(pdt_rpc_print_mfile(rpc, ih, mf, t, code, len + 1, tdomain, tprefix)
+				< 0)
+			return -1;
+	}
+	return 0;
+}
+
 /*
  * RPC command to list pdt memory records
  */
@@ -776,12 +862,14 @@ static void pdt_rpc_list(rpc_t *rpc, void *ctx)
 	int len;
 	str *cl;
 	pdt_tree_t **ptree;
+	pdt_mfile_t *mf;
 	void *th;
 	void *ih;
 
 	ptree = pdt_get_ptree();
+	mf = pdt_mfile_get_list();
 
-	if(ptree == NULL || *ptree == NULL) {
+	if(mf == NULL && (ptree == NULL || *ptree == NULL)) {
 		LM_ERR("empty domain list\n");
 		rpc->fault(ctx, 404, "No records");
 		return;
@@ -820,12 +908,30 @@ static void pdt_rpc_list(rpc_t *rpc, void *ctx)
 		tdomain.s = 0;
 	}
 
-	pt = *ptree;
-
 	if(rpc->add(ctx, "{", &th) < 0) {
 		rpc->fault(ctx, 500, "Internal error root reply");
 		return;
 	}
+	for(; mf != NULL; mf = mf->next) {
+		if(mf->addr == NULL
+				|| (sdomain.s != NULL
+						&& (mf->sdomain.len < sdomain.len
+								|| strncmp(mf->sdomain.s, sdomain.s,
+										   sdomain.len)
+										   != 0)))
+			continue;
+		if(rpc->struct_add(th, "S{", "SDOMAIN", &mf->sdomain, "RECORDS", &ih)
+				< 0) {
+			rpc->fault(ctx, 500, "Internal error creating sdomain structure");
+			return;
+		}
+		if(pdt_rpc_print_mfile(
+				   rpc, ih, mf, 0, code_buf, 0, &tdomain, &tprefix)
+				< 0)
+			goto error;
+	}
+
+	pt = (ptree != NULL) ? *ptree : NULL;
 	while(pt != NULL) {
 		LM_ERR("---- 1 (%d [%.*s])\n", sdomain.len, sdomain.len, sdomain.s);
 		if(sdomain.s == NULL
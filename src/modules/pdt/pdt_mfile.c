@@ -0,0 +1,295 @@
+/**
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Prefix-domain files mapped read-only instead of the shm trees loaded
+ * from database. Each process maps the files of the source domains, the
+ * reload checks them and increments a version in shm, then each process
+ * maps them again at its next lookup.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/mem.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/parser/parse_param.h"
+
+#include "pdtree.h"
+#include "pdt_mfile.h"
+
+extern str pdt_char_list;
+
+static pdt_mfile_t *_pdt_mfile_list = NULL;
+
+/* incremented by each reload, in shm */
+static unsigned int *_pdt_mfile_version = NULL;
+
+/**
+ * add the file of a source domain - "sdomain=<sdomain>;file=<path>"
+ */
+int pdt_mfile_param(modparam_t type, void *val)
+{
+	param_t *params_list = NULL;
+	param_hooks_t phooks;
+	param_t *pit;
+	pdt_mfile_t *mf;
+	str sdomain = STR_NULL;
+	str path = STR_NULL;
+	str s;
+
+	if(val == NULL)
+		return -1;
+
+	s.s = (char *)val;
+	s.len = strlen(s.s);
+	if(s.len > 0 && s.s[s.len - 1] == ';')
+		s.len--;
+	if(parse_params(&s, CLASS_ANY, &phooks, &params_list) < 0) {
+		LM_ERR("cannot parse file parameter [%.*s]\n", s.len, s.s);
+		return -1;
+	}
+	for(pit = params_list; pit; pit = pit->next) {
+		if(pit->name.len == 7 && strncasecmp(pit->name.s, "sdomain", 7) == 0) {
+			sdomain = pit->body;
+		} else if(pit->name.len == 4
+				  && strncasecmp(pit->name.s, "file", 4) == 0) {
+			path = pit->body;
+		}
+	}
+	free_params(params_list);
+	if(sdomain.s == NULL || sdomain.len <= 0 || path.s == NULL
+			|| path.len <= 0) {
+		LM_ERR("sdomain and file are required in [%.*s]\n", s.len, s.s);
+		return -1;
+	}
+	for(mf = _pdt_mfile_list; mf != NULL; mf = mf->next) {
+		if(str_strcmp(&mf->sdomain, &sdomain) == 0) {
+			LM_ERR("sdomain [%.*s] has already a file\n", sdomain.len,
+					sdomain.s);
+			return -1;
+		}
+	}
+
+	mf = (pdt_mfile_t *)pkg_malloc(
+			sizeof(pdt_mfile_t) + sdomain.len + 1 + path.len + 1);
+	if(mf == NULL) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	memset(mf, 0, sizeof(pdt_mfile_t));
+	mf->sdomain.s = (char *)mf + sizeof(pdt_mfile_t);
+	memcpy(mf->sdomain.s, sdomain.s, sdomain.len);
+	mf->sdomain.s[sdomain.len] = '\0';
+	mf->sdomain.len = sdomain.len;
+	mf->path = mf->sdomain.s + sdomain.len + 1;
+	memcpy(mf->path, path.s, path.len);
+	mf->path[path.len] = '\0';
+	mf->next = _pdt_mfile_list;
+	_pdt_mfile_list = mf;
+	return 0;
+}
+
+/**
+ * return 1 if the prefix-domain pairs are served from files
+ */
+int pdt_mfile_defined(void)
+{
+	return (_pdt_mfile_list != NULL) ? 1 : 0;
+}
+
+/**
+ * map the file of mf in nmf and check it was built for pdt
+ */
+static int pdt_mfile_map(pdt_mfile_t *mf, pdt_mfile_t *nmf)
+{
+	int ret;
+
+	memcpy(nmf, mf, sizeof(pdt_mfile_t));
+	ret = mt_mfile_mmap(mf->path, &nmf->addr, &nmf->size);
+	if(ret == -1) {
+		LM_ERR("cannot map file [%s] for sdomain [%.*s] (%d - %s)\n",
+				mf->path, mf->sdomain.len, mf->sdomain.s, errno,
+				strerror(errno));
+		return -1;
+	}
+	if(ret < 0) {
+		LM_ERR("invalid file [%s] for sdomain [%.*s]\n", mf->path,
+				mf->sdomain.len, mf->sdomain.s);
+		return -1;
+	}
+	ret = mt_mfile_view_init(&nmf->v, nmf->addr, nmf->size);
+	if(ret == -1) {
+		LM_ERR("file [%s] is not a supported tree file\n", mf->path);
+		goto error;
+	}
+	if(ret < 0) {
+		LM_ERR("file [%s] has invalid size\n", mf->path);
+		goto error;
+	}
+	if(nmf->v.hdr->type != 0) {
+		LM_ERR("file [%s] has type %u - string tree (0) expected\n",
+				mf->path, nmf->v.hdr->type);
+		goto error;
+	}
+	if(mt_mfile_view_chars(&nmf->v, pdt_char_list.s, pdt_char_list.len)
+			< 0) {
+		LM_ERR("file [%s] was built for another char list\n", mf->path);
+		goto error;
+	}
+	return 0;
+
+error:
+	munmap(nmf->addr, nmf->size);
+	nmf->addr = NULL;
+	return -1;
+}
+
+/**
+ * map the files in the main process, inherited by the children
+ */
+int pdt_mfile_init(void)
+{
+	pdt_mfile_t *mf;
+	pdt_mfile_t nmf;
+
+	_pdt_mfile_version = (unsigned int *)shm_malloc(sizeof(unsigned int));
+	if(_pdt_mfile_version == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	*_pdt_mfile_version = 1;
+
+	for(mf = _pdt_mfile_list; mf != NULL; mf = mf->next) {
+		if(pdt_mfile_map(mf, &nmf) < 0)
+			return -1;
+		memcpy(mf, &nmf, sizeof(pdt_mfile_t));
+		mf->version = *_pdt_mfile_version;
+		LM_DBG("sdomain [%.*s] uses file [%s] with %u cells\n",
+				mf->sdomain.len, mf->sdomain.s, mf->path,
+				mf->v.hdr->ncells);
+	}
+	return 0;
+}
+
+/**
+ * check all files and make the processes map them again
+ */
+int pdt_mfile_reload(void)
+{
+	pdt_mfile_t *mf;
+	pdt_mfile_t nmf;
+
+	if(_pdt_mfile_version == NULL)
+		return -1;
+	for(mf = _pdt_mfile_list; mf != NULL; mf = mf->next) {
+		if(pdt_mfile_map(mf, &nmf) < 0)
+			return -1;
+		munmap(nmf.addr, nmf.size);
+	}
+	(*_pdt_mfile_version)++;
+	LM_DBG("pdt files version %u\n", *_pdt_mfile_version);
+	return 0;
+}
+
+/**
+ * return the files, mapped again in this process if they were reloaded
+ */
+pdt_mfile_t *pdt_mfile_get_list(void)
+{
+	pdt_mfile_t *mf;
+	pdt_mfile_t nmf;
+	unsigned int version;
+
+	if(_pdt_mfile_version == NULL)
+		return NULL;
+	version = *_pdt_mfile_version;
+	for(mf = _pdt_mfile_list; mf != NULL; mf = mf->next) {
+		if(mf->version == version)
+			continue;
+		/* keep serving the previous mapping if the file is broken again */
+		mf->version = version;
+		if(pdt_mfile_map(mf, &nmf) < 0)
+			continue;
+		if(mf->addr != NULL)
+			munmap(mf->addr, mf->size);
+		memcpy(mf, &nmf, sizeof(pdt_mfile_t));
+		LM_DBG("mapped file [%s] version %u for sdomain [%.*s]\n", mf->path,
+				version, mf->sdomain.len, mf->sdomain.s);
+	}
+	return _pdt_mfile_list;
+}
+
+/**
+ * longest prefix of code in the file of sdomain, as get_domain() does in
+ * the tree - the domain is zero terminated in the file
+ */
+str *pdt_mfile_get_domain(str *sdomain, str *code, int *plen)
+{
+	static str domain;
+	pdt_mfile_t *mf;
+	uint32_t s, dlen;
+	char *d, *p;
+	int l, len;
+	str *ret;
+
+	if(sdomain == NULL || sdomain->s == NULL || code == NULL
+			|| code->s == NULL) {
+		LM_INFO("bad parameters\n");
+		return NULL;
+	}
+
+	for(mf = pdt_mfile_get_list(); mf != NULL; mf = mf->next) {
+		if(str_strcmp(&mf->sdomain, sdomain) == 0)
+			break;
+	}
+	if(mf == NULL || mf->addr == NULL)
+		return NULL;
+
+	ret = NULL;
+	len = 0;
+	s = 0;
+	for(l = 0; l < code->len && l < PDT_MAX_DEPTH; l++) {
+		p = strchr(pdt_char_list.s, code->s[l]);
+		if(p == NULL) {
+			LM_ERR("invalid char at %d in [%.*s]\n", l, code->len, code->s);
+			return NULL;
+		}
+		s = mt_mfile_view_child(
+				&mf->v, s, (p - pdt_char_list.s) % PDT_NODE_SIZE);
+		if(s == MT_MFILE_CELL_NONE)
+			break;
+		d = mt_mfile_view_str(&mf->v, s, &dlen);
+		if(d != NULL) {
+			domain.s = d;
+			domain.len = dlen;
+			ret = &domain;
+			len = l + 1;
+		}
+	}
+
+	if(plen != NULL)
+		*plen = len;
+
+	return ret;
+}
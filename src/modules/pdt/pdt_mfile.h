@@ -0,0 +1,49 @@
+/**
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * This file is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * This file is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef _PDT_MFILE_H_
+#define _PDT_MFILE_H_
+
+#include "../../core/str.h"
+#include "../../core/sr_module.h"
+#include "../mtree/mtree_mfile.h"
+
+/* prebuilt prefix-domain file of a source domain, built with utils/mtbuild
+ * as string tree and mapped read-only in each process */
+typedef struct _pdt_mfile
+{
+	str sdomain;
+	char *path;
+	unsigned int version; /* version of the mapping in this process */
+	void *addr;
+	uint64_t size;
+	mt_mfile_view_t v;
+	struct _pdt_mfile *next;
+} pdt_mfile_t;
+
+int pdt_mfile_param(modparam_t type, void *val);
+int pdt_mfile_defined(void);
+int pdt_mfile_init(void);
+int pdt_mfile_reload(void);
+pdt_mfile_t *pdt_mfile_get_list(void);
+str *pdt_mfile_get_domain(str *sdomain, str *code, int *plen);
+
+#endif
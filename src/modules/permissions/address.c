@@ -501,6 +501,9 @@ int reload_address_table(void)
 		return ret;
 	}
 
+	/* a table without index is still matched by linear scan */
+	subnet_table_index(atg.subnet_table);
+
 	*perm_addr_table = atg.address_table;
 	*perm_subnet_table = atg.subnet_table;
 	*perm_domain_table = atg.domain_table;
@@ -51,6 +51,151 @@ extern int _perm_subnet_match_mode;
 
 #define PERM_MAX_SUBNETS _perm_max_subnets
 
+#define PERM_RE_CACHE_SIZE 256
+#define PERM_RE_CACHE_MAX 16384
+#define PERM_RE_GROUP_SIZE 64
+
+/*
+ * Regular expression compiled by a process (regcomp() allocates in the
+ * private memory of the process, so it cannot be shared in the trusted
+ * hash table), with the result of the last matching for each subject
+ */
+typedef struct perm_re_item
+{
+	unsigned int hid;
+	char *pattern;
+	int valid;
+	regex_t re;
+	unsigned int mcheck[2];
+	int mresult[2];
+	struct perm_re_item *next;
+} perm_re_item_t;
+
+static perm_re_item_t *_perm_re_cache[PERM_RE_CACHE_SIZE];
+static int _perm_re_cache_items = 0;
+static unsigned int _perm_re_cache_version = 0;
+static unsigned int _perm_re_check = 0;
+
+
+/*
+ * Free the regular expressions compiled by the process
+ */
+static void perm_re_cache_flush(void)
+{
+	int i;
+	perm_re_item_t *it, *it0;
+
+	for(i = 0; i < PERM_RE_CACHE_SIZE; i++) {
+		it = _perm_re_cache[i];
+		while(it) {
+			it0 = it;
+			it = it->next;
+			if(it0->valid) {
+				regfree(&it0->re);
+			}
+			pkg_free(it0);
+		}
+		_perm_re_cache[i] = NULL;
+	}
+	_perm_re_cache_items = 0;
+}
+
+
+/*
+ * Start a new matching - the results of the previous one are not used
+ * anymore and the compiled expressions are dropped if the trusted table
+ * was reloaded meanwhile
+ */
+void perm_re_check_start(void)
+{
+	unsigned int version;
+
+	version = (perm_trust_version != NULL) ? *perm_trust_version : 0;
+	if(version != _perm_re_cache_version
+			|| _perm_re_cache_items > PERM_RE_CACHE_MAX) {
+		perm_re_cache_flush();
+		_perm_re_cache_version = version;
+	}
+	_perm_re_check++;
+	if(_perm_re_check == 0) {
+		/* wrap around - 0 marks items without result */
+		perm_re_cache_flush();
+		_perm_re_check = 1;
+	}
+}
+
+
+/*
+ * Match the subject (0 - From URI, 1 - Request URI) against the pattern,
+ * the expression being compiled once per process, and the result being
+ * reused for other entries with the same pattern during the same matching.
+ * Returns 1 if matching, 0 if not matching and -1 for invalid expression.
+ */
+int perm_re_match(char *pattern, unsigned int hid, char *subject, int sidx)
+{
+	perm_re_item_t *it;
+	int len;
+
+	len = strlen(pattern);
+	if(hid == 0) {
+		hid = get_hash1_raw(pattern, len);
+	}
+
+	for(it = _perm_re_cache[hid & (PERM_RE_CACHE_SIZE - 1)]; it != NULL;
+			it = it->next) {
+		if(it->hid == hid && strcmp(it->pattern, pattern) == 0) {
+			break;
+		}
+	}
+	if(it == NULL) {
+		it = (perm_re_item_t *)pkg_malloc(sizeof(perm_re_item_t) + len + 1);
+		if(it == NULL) {
+			PKG_MEM_ERROR;
+			return -1;
+		}
+		memset(it, 0, sizeof(perm_re_item_t));
+		it->hid = hid;
+		it->pattern = (char *)it + sizeof(perm_re_item_t);
+		memcpy(it->pattern, pattern, len + 1);
+		if(regcomp(&it->re, pattern, REG_NOSUB) == 0) {
+			it->valid = 1;
+		} else {
+			LM_ERR("invalid regular expression [%s]\n", pattern);
+		}
+		it->next = _perm_re_cache[hid & (PERM_RE_CACHE_SIZE - 1)];
+		_perm_re_cache[hid & (PERM_RE_CACHE_SIZE - 1)] = it;
+		_perm_re_cache_items++;
+	}
+
+	if(!it->valid) {
+		return -1;
+	}
+	if(it->mcheck[sidx] != _perm_re_check) {
+		if(regexec(&it->re, subject, 0, (regmatch_t *)0, 0) == 0) {
+			it->mresult[sidx] = 1;
+		} else {
+			it->mresult[sidx] = 0;
+		}
+		it->mcheck[sidx] = _perm_re_check;
+	}
+	return it->mresult[sidx];
+}
+
+
+/*
+ * Check the regular expression when loading the trusted table
+ */
+static int perm_re_validate(char *pattern)
+{
+	regex_t preg;
+
+	if(regcomp(&preg, pattern, REG_NOSUB)) {
+		return -1;
+	}
+	regfree(&preg);
+	return 0;
+}
+
 /*
  * Parse and set tag AVP specs
  */
@@ -186,8 +331,15 @@ int hash_table_insert(struct trusted_list **table, char *src_ip, char *proto,
 			return -1;
 		}
 		(void)strcpy(np->pattern, pattern);
+		np->pattern_hid = get_hash1_raw(pattern, strlen(pattern));
+		if(perm_re_validate(pattern) < 0) {
+			LM_ERR("invalid regular expression [%s] for source [%s] - "
+				   "entry not matching\n",
+					pattern, src_ip);
+		}
 	} else {
 		np->pattern = 0;
+		np->pattern_hid = 0;
 	}
 
 	if(ruri_pattern) {
@@ -199,8 +351,15 @@ int hash_table_insert(struct trusted_list **table, char *src_ip, char *proto,
 			return -1;
 		}
 		(void)strcpy(np->ruri_pattern, ruri_pattern);
+		np->ruri_hid = get_hash1_raw(ruri_pattern, strlen(ruri_pattern));
+		if(perm_re_validate(ruri_pattern) < 0) {
+			LM_ERR("invalid regular expression [%s] for source [%s] - "
+				   "entry not matching\n",
+					ruri_pattern, src_ip);
+		}
 	} else {
 		np->ruri_pattern = 0;
+		np->ruri_hid = 0;
 	}
 
 	if(tag) {
@@ -222,6 +381,7 @@ int hash_table_insert(struct trusted_list **table, char *src_ip, char *proto,
 	}
 
 	np->priority = priority;
+	np->group = NULL;
 
 	hash_val = perm_hash(np->src_ip);
 	if(table[hash_val] == NULL) {
@@ -249,6 +409,126 @@ int hash_table_insert(struct trusted_list **table, char *src_ip, char *proto,
 }
 
 
+/*
+ * Check if the pattern can be an alternative of a combined expression -
+ * the back-references would refer to other subexpressions
+ */
+static int perm_re_groupable(char *pattern)
+{
+	char *p;
+
+	for(p = pattern; *p != '\0'; p++) {
+		if(*p == '\\') {
+			if(p[1] >= '1' && p[1] <= '9') {
+				return 0;
+			}
+			if(p[1] == '\0') {
+				return 0;
+			}
+			p++;
+		}
+	}
+	return 1;
+}
+
+
+/*
+ * Group up to PERM_RE_GROUP_SIZE entries of a list with the same src_ip as
+ * the first one, not grouped yet, combining their From patterns into one
+ * basic regular expression \(p1\)\|\(p2\)\|... (GNU alternation). The combined
+ * pattern is not set if an entry has no From pattern (it matches any From
+ * URI). Entries with invalid patterns never match and are left out.
+ */
+static int hash_table_group_list(struct trusted_list *head)
+{
+	struct trusted_group *g;
+	struct trusted_list *np;
+	char *p;
+	int len;
+	int single;
+
+	g = (struct trusted_group *)shm_malloc(sizeof(struct trusted_group));
+	if(g == NULL) {
+		LM_ERR("cannot allocate shm memory for trusted group\n");
+		return -1;
+	}
+	memset(g, 0, sizeof(struct trusted_group));
+	len = 0;
+	single = 0;
+	for(np = head; np != NULL && g->count < PERM_RE_GROUP_SIZE;
+			np = np->next) {
+		if(np->group != NULL || np->src_ip.len != head->src_ip.len
+				|| strncmp(np->src_ip.s, head->src_ip.s, head->src_ip.len)
+						   != 0) {
+			continue;
+		}
+		np->group = g;
+		g->count++;
+		if(np->pattern == NULL || !perm_re_groupable(np->pattern)) {
+			single = 1;
+		} else {
+			len += strlen(np->pattern) + 6;
+		}
+	}
+	if(single || g->count < 2) {
+		return 0;
+	}
+
+	g->pattern = (char *)shm_malloc(len + 1);
+	if(g->pattern == NULL) {
+		LM_ERR("cannot allocate shm memory for group pattern\n");
+		return -1;
+	}
+	p = g->pattern;
+	for(np = head; np != NULL; np = np->next) {
+		if(np->group != g || perm_re_validate(np->pattern) < 0) {
+			continue;
+		}
+		if(p != g->pattern) {
+			memcpy(p, "\\|", 2);
+			p += 2;
+		}
+		memcpy(p, "\\(", 2);
+		p += 2;
+		len = strlen(np->pattern);
+		memcpy(p, np->pattern, len);
+		p += len;
+		memcpy(p, "\\)", 2);
+		p += 2;
+	}
+	*p = '\0';
+	if(p == g->pattern || perm_re_validate(g->pattern) < 0) {
+		/* no valid pattern - the entries are matched one by one */
+		shm_free(g->pattern);
+		g->pattern = NULL;
+		return 0;
+	}
+	g->hid = get_hash1_raw(g->pattern, p - g->pattern);
+	return 0;
+}
+
+
+/*
+ * Group the entries of the hash table with the same src_ip, so that a From
+ * URI is matched against the patterns of a group with one regexec(), the
+ * patterns of the entries being matched only if the combined one does
+ */
+int hash_table_group(struct trusted_list **table)
+{
+	struct trusted_list *np;
+	int i;
+
+	for(i = 0; i < PERM_HASH_SIZE; i++) {
+		for(np = table[i]; np != NULL; np = np->next) {
+			if(np->group == NULL && hash_table_group_list(np) < 0) {
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+
 /*
  * Check if an entry exists in hash table that has given src_ip and protocol
  * value and pattern that matches to From URI.  If an entry exists and tag_avp
@@ -262,8 +542,9 @@ int match_hash_table(struct trusted_list **table, struct sip_msg *msg,
 			proto, from_uri);
 	str ruri;
 	char ruri_string[MAX_URI_SIZE];
-	regex_t preg;
 	struct trusted_list *np;
+	struct trusted_group *group = NULL;
+	int gmatch = 0;
 	str src_ip;
 	int_str val;
 	int count = 0;
@@ -281,6 +562,7 @@ int match_hash_table(struct trusted_list **table, struct sip_msg *msg,
 		ruri_string[ruri.len] = (char)0;
 	}
 
+	perm_re_check_start();
 	for(np = table[perm_hash(src_ip)]; np != NULL; np = np->next) {
 		if((np->src_ip.len == src_ip.len)
 				&& (strncmp(np->src_ip.s, src_ip.s, src_ip.len) == 0)
@@ -293,29 +575,29 @@ int match_hash_table(struct trusted_list **table, struct sip_msg *msg,
 					(np->tag.s ? np->tag.s : "null"));
 
 			if(IS_SIP(msg)) {
-				if(np->pattern) {
-					if(regcomp(&preg, np->pattern, REG_NOSUB)) {
-						LM_ERR("invalid regular expression\n");
-						if(!np->pattern) {
-							continue;
-						}
+				if(np->group && np->group->pattern) {
+					/* From patterns of the group checked at once */
+					if(np->group != group) {
+						group = np->group;
+						gmatch = perm_re_match(
+								group->pattern, group->hid, from_uri, 0);
 					}
-					if(regexec(&preg, from_uri, 0, (regmatch_t *)0, 0)) {
-						regfree(&preg);
+					if(gmatch <= 0) {
 						continue;
 					}
-					regfree(&preg);
 				}
-				if(np->ruri_pattern) {
-					if(regcomp(&preg, np->ruri_pattern, REG_NOSUB)) {
-						LM_ERR("invalid regular expression\n");
+				if(np->pattern) {
+					if(perm_re_match(np->pattern, np->pattern_hid, from_uri, 0)
+							<= 0) {
 						continue;
 					}
-					if(regexec(&preg, ruri_string, 0, (regmatch_t *)0, 0)) {
-						regfree(&preg);
+				}
+				if(np->ruri_pattern) {
+					if(perm_re_match(
+							   np->ruri_pattern, np->ruri_hid, ruri_string, 1)
+							<= 0) {
 						continue;
 					}
-					regfree(&preg);
 				}
 			}
 			/* Found a match */
@@ -401,6 +683,11 @@ void empty_hash_table(struct trusted_list **table)
 				shm_free(np->ruri_pattern);
 			if(np->tag.s)
 				shm_free(np->tag.s);
+			if(np->group && --np->group->count == 0) {
+				if(np->group->pattern)
+					shm_free(np->group->pattern);
+				shm_free(np->group);
+			}
 			next = np->next;
 			shm_free(np);
 			np = next;
@@ -691,6 +978,283 @@ int subnet_table_insert(struct subnet *table, unsigned int grp,
 }
 
 
+/*
+ * Longest prefix match index of a subnet table: for each address family the
+ * distinct mask lengths in use, longest first, and an open addressing table
+ * keyed by <family, mask, network prefix>. Each slot refers to the ascending
+ * list of subnet records with that prefix, so a lookup costs one probe per
+ * mask length in use instead of a scan over all records. Records with mask 0
+ * are not in the slots but in a list of their own: the linear scan never
+ * selects them, but with subnet_match_mode 0 the first of them matching the
+ * port ends the scan without result, whatever the address family.
+ */
+typedef struct subnet_lpm_slot
+{
+	unsigned char prefix[16]; /* network prefix with host bits cleared */
+	unsigned short af;		  /* address family */
+	unsigned short mask;	  /* mask length */
+	unsigned int start;		  /* first position in index list */
+	unsigned int count;		  /* number of records, 0 for free slot */
+} subnet_lpm_slot_t;
+
+typedef struct subnet_lpm
+{
+	unsigned int nslots; /* size of slots table, power of two */
+	int nlens[2];		 /* number of mask lengths for IPv4, IPv6 */
+	unsigned char lens[2][129]; /* mask lengths in use, longest first */
+	unsigned int zstart;		/* first position of mask 0 records */
+	unsigned int zcount;		/* number of mask 0 records */
+	subnet_lpm_slot_t *slots;
+	unsigned int *idx; /* record indexes, grouped per slot */
+} subnet_lpm_t;
+
+#define SUBNET_LPM_FAMILY(af) (((af) == AF_INET6) ? 1 : 0)
+
+/*
+ * Copy the first mask bits of addr into prefix, clearing the rest
+ */
+static void subnet_lpm_prefix(
+		ip_addr_t *addr, unsigned int mask, unsigned char *prefix)
+{
+	unsigned int mbytes;
+
+	memset(prefix, 0, 16);
+	mbytes = mask / 8;
+	memcpy(prefix, addr->u.addr, mbytes);
+	if(mask % 8) {
+		prefix[mbytes] =
+				addr->u.addr[mbytes] & (~((1 << (8 - (mask % 8))) - 1));
+	}
+}
+
+static unsigned int subnet_lpm_hash(
+		unsigned short af, unsigned short mask, unsigned char *prefix)
+{
+	return get_hash1_raw((char *)prefix, (mask + 7) / 8)
+		   ^ ((unsigned int)mask * 0x9e3779b1) ^ af;
+}
+
+/*
+ * Return the slot for <af, mask, prefix>, either the used one or the
+ * free one where it has to be added
+ */
+static subnet_lpm_slot_t *subnet_lpm_slot(subnet_lpm_t *lpm, unsigned short af,
+		unsigned short mask, unsigned char *prefix)
+{
+	unsigned int h;
+	subnet_lpm_slot_t *slot;
+
+	h = subnet_lpm_hash(af, mask, prefix) & (lpm->nslots - 1);
+	while(1) {
+		slot = &lpm->slots[h];
+		if(slot->count == 0
+				|| (slot->af == af && slot->mask == mask
+						&& memcmp(slot->prefix, prefix, 16) == 0)) {
+			return slot;
+		}
+		h = (h + 1) & (lpm->nslots - 1);
+	}
+}
+
+/*
+ * Build the prefix index of the subnet table
+ */
+int subnet_table_index(struct subnet *table)
+{
+	unsigned int count, i, n, nslots, pos;
+	unsigned int *sidx = NULL;
+	unsigned short af;
+	unsigned char prefix[16];
+	unsigned char used[2][129];
+	subnet_lpm_slot_t *slot;
+	subnet_lpm_t *lpm;
+	int f, m;
+
+	count = table[PERM_MAX_SUBNETS].grp;
+	if(table[PERM_MAX_SUBNETS].lpm != NULL) {
+		shm_free(table[PERM_MAX_SUBNETS].lpm);
+		table[PERM_MAX_SUBNETS].lpm = NULL;
+	}
+	if(count == 0) {
+		return 0;
+	}
+
+	nslots = 16;
+	while(nslots < 2 * count) {
+		nslots <<= 1;
+	}
+	lpm = (subnet_lpm_t *)shm_malloc(sizeof(subnet_lpm_t)
+									 + nslots * sizeof(subnet_lpm_slot_t)
+									 + count * sizeof(unsigned int));
+	if(lpm == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	sidx = (unsigned int *)pkg_malloc(count * sizeof(unsigned int));
+	if(sidx == NULL) {
+		PKG_MEM_ERROR;
+		shm_free(lpm);
+		return -1;
+	}
+	memset(lpm, 0, sizeof(subnet_lpm_t) + nslots * sizeof(subnet_lpm_slot_t));
+	lpm->nslots = nslots;
+	lpm->slots = (subnet_lpm_slot_t *)((char *)lpm + sizeof(subnet_lpm_t));
+	lpm->idx = (unsigned int *)((char *)lpm->slots
+								+ nslots * sizeof(subnet_lpm_slot_t));
+	memset(used, 0, sizeof(used));
+
+	/* first pass - count records per prefix */
+	for(i = 0; i < count; i++) {
+		sidx[i] = nslots;
+		if(table[i].mask == 0) {
+			sidx[i] = nslots + 1;
+			lpm->zcount++;
+			continue;
+		} else if((table[i].subnet.af == AF_INET && table[i].mask <= 32)
+				  || (table[i].subnet.af == AF_INET6
+						  && table[i].mask <= 128)) {
+			af = table[i].subnet.af;
+			used[SUBNET_LPM_FAMILY(af)][table[i].mask] = 1;
+		} else {
+			/* never matched by ip_addr_match_net() */
+			continue;
+		}
+		subnet_lpm_prefix(&table[i].subnet, table[i].mask, prefix);
+		slot = subnet_lpm_slot(lpm, af, table[i].mask, prefix);
+		if(slot->count == 0) {
+			slot->af = af;
+			slot->mask = table[i].mask;
+			memcpy(slot->prefix, prefix, 16);
+		}
+		slot->count++;
+		sidx[i] = slot - lpm->slots;
+	}
+
+	/* assign list positions, then fill them in ascending record order */
+	pos = 0;
+	for(n = 0; n < nslots; n++) {
+		lpm->slots[n].start = pos;
+		pos += lpm->slots[n].count;
+		lpm->slots[n].count = 0;
+	}
+	lpm->zstart = pos;
+	n = 0;
+	for(i = 0; i < count; i++) {
+		if(sidx[i] == nslots) {
+			continue;
+		}
+		if(sidx[i] == nslots + 1) {
+			lpm->idx[lpm->zstart + n] = i;
+			n++;
+			continue;
+		}
+		slot = &lpm->slots[sidx[i]];
+		lpm->idx[slot->start + slot->count] = i;
+		slot->count++;
+	}
+	pkg_free(sidx);
+
+	for(f = 0; f < 2; f++) {
+		for(m = 128; m > 0; m--) {
+			if(used[f][m]) {
+				lpm->lens[f][lpm->nlens[f]++] = (unsigned char)m;
+			}
+		}
+	}
+
+	table[PERM_MAX_SUBNETS].lpm = lpm;
+	LM_DBG("subnet index built - records: %u ipv4 masks: %d ipv6 masks: %d"
+		   " mask 0 records: %u\n",
+			count, lpm->nlens[0], lpm->nlens[1], lpm->zcount);
+	return 0;
+}
+
+/*
+ * Return the first of the records at positions [start, start + count) of
+ * the index list matching grp (any if anygrp is set) and port, provided it
+ * is before record limit (none if negative), or -1
+ */
+static int subnet_lpm_first(struct subnet *table, subnet_lpm_t *lpm,
+		unsigned int start, unsigned int count, unsigned int grp, int anygrp,
+		unsigned int port, int limit)
+{
+	unsigned int k, lo, hi, mid, i;
+
+	lo = start;
+	hi = start + count;
+	if(!anygrp) {
+		/* records are ordered by group */
+		while(lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if(table[lpm->idx[mid]].grp < grp) {
+				lo = mid + 1;
+			} else {
+				hi = mid;
+			}
+		}
+		hi = start + count;
+	}
+	for(k = lo; k < hi; k++) {
+		i = lpm->idx[k];
+		if(!anygrp && table[i].grp != grp) {
+			break;
+		}
+		if(limit >= 0 && i >= (unsigned int)limit) {
+			break;
+		}
+		if((table[i].port == port) || (table[i].port == 0)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Find in the prefix index the subnet record matching addr and port, limited
+ * to group grp if anygrp is 0. Returns the same record as the linear scan
+ * for the current match mode, or -1 if there is no match.
+ */
+static int subnet_lpm_lookup(struct subnet *table, subnet_lpm_t *lpm,
+		unsigned int grp, int anygrp, ip_addr_t *addr, unsigned int port)
+{
+	unsigned char prefix[16];
+	subnet_lpm_slot_t *slot;
+	unsigned int mask;
+	int f, l, i;
+	int best_idx = -1;
+
+	if(addr->af != AF_INET && addr->af != AF_INET6) {
+		return -1;
+	}
+	f = SUBNET_LPM_FAMILY(addr->af);
+	for(l = 0; l < lpm->nlens[f]; l++) {
+		mask = lpm->lens[f][l];
+		subnet_lpm_prefix(addr, mask, prefix);
+		slot = subnet_lpm_slot(lpm, addr->af, mask, prefix);
+		if(slot->count == 0) {
+			continue;
+		}
+		i = subnet_lpm_first(table, lpm, slot->start, slot->count, grp,
+				anygrp, port, best_idx);
+		if(i >= 0) {
+			best_idx = i;
+			if(_perm_subnet_match_mode != 0) {
+				/* longest prefix found */
+				break;
+			}
+		}
+	}
+	if(_perm_subnet_match_mode == 0 && lpm->zcount > 0
+			&& subnet_lpm_first(table, lpm, lpm->zstart, lpm->zcount, grp,
+					   anygrp, port, best_idx)
+					   >= 0) {
+		/* the scan stops at this mask 0 record, which it does not select */
+		return -1;
+	}
+	return best_idx;
+}
+
+
 /*
  * Check if an entry exists in subnet table that matches given group, ip_addr,
  * and port.  Port 0 in subnet table matches any port.
@@ -706,12 +1270,14 @@ int match_subnet_table(struct subnet *table, unsigned int grp, ip_addr_t *addr,
 	count = table[PERM_MAX_SUBNETS].grp;
 
 	i = 0;
+	if(table[PERM_MAX_SUBNETS].lpm != NULL) {
+		best_idx = subnet_lpm_lookup(
+				table, table[PERM_MAX_SUBNETS].lpm, grp, 0, addr, port);
+		i = count;
+	}
 	while((i < count) && (table[i].grp < grp))
 		i++;
 
-	if(i == count)
-		return -1;
-
 	while((i < count) && (table[i].grp == grp)) {
 		if(((table[i].port == port) || (table[i].port == 0))
 				&& (ip_addr_match_net(addr, &table[i].subnet, table[i].mask)
@@ -759,6 +1325,11 @@ int find_group_in_subnet_table(
 	count = table[PERM_MAX_SUBNETS].grp;
 
 	i = 0;
+	if(table[PERM_MAX_SUBNETS].lpm != NULL) {
+		best_idx = subnet_lpm_lookup(
+				table, table[PERM_MAX_SUBNETS].lpm, 0, 1, addr, port);
+		i = count;
+	}
 	while(i < count) {
 		if(((table[i].port == port) || (table[i].port == 0))
 				&& (ip_addr_match_net(addr, &table[i].subnet, table[i].mask)
@@ -838,6 +1409,10 @@ void empty_subnet_table(struct subnet *table)
 {
 	int i;
 	table[PERM_MAX_SUBNETS].grp = 0;
+	if(table[PERM_MAX_SUBNETS].lpm != NULL) {
+		shm_free(table[PERM_MAX_SUBNETS].lpm);
+		table[PERM_MAX_SUBNETS].lpm = NULL;
+	}
 	for(i = 0; i < PERM_MAX_SUBNETS; i++) {
 		if(table[i].tag.s != NULL) {
 			shm_free(table[i].tag.s);
@@ -856,6 +1431,9 @@ void free_subnet_table(struct subnet *table)
 	int i;
 	if(!table)
 		return;
+	if(table[PERM_MAX_SUBNETS].lpm != NULL) {
+		shm_free(table[PERM_MAX_SUBNETS].lpm);
+	}
 	for(i = 0; i < PERM_MAX_SUBNETS; i++) {
 		if(table[i].tag.s != NULL) {
 			shm_free(table[i].tag.s);
@@ -33,21 +33,54 @@
 
 #define PERM_HASH_SIZE 128
 
+/*
+ * Entries of the trusted hash table with the same source address, their
+ * From patterns combined as alternatives of one regular expression
+ */
+struct trusted_group
+{
+	char *pattern;	  /* Combined From pattern, 0 if none */
+	unsigned int hid; /* Hash id of pattern */
+	int count;		  /* Number of entries in the group */
+};
+
 /*
  * Structure stored in trusted hash table
  */
 struct trusted_list
 {
-	str src_ip;				   /* Source IP of SIP message */
-	int proto;				   /* Protocol -- UDP, TCP, TLS, or SCTP */
-	char *pattern;			   /* Pattern matching From header field */
-	char *ruri_pattern;		   /* Pattern matching Request URI */
-	str tag;				   /* Tag to be assigned to AVP */
-	int priority;			   /* priority */
-	struct trusted_list *next; /* Next element in the list */
+	str src_ip;					 /* Source IP of SIP message */
+	int proto;					 /* Protocol -- UDP, TCP, TLS, or SCTP */
+	char *pattern;				 /* Pattern matching From header field */
+	char *ruri_pattern;			 /* Pattern matching Request URI */
+	unsigned int pattern_hid;	 /* Hash id of pattern */
+	unsigned int ruri_hid;		 /* Hash id of ruri_pattern */
+	str tag;					 /* Tag to be assigned to AVP */
+	int priority;				 /* priority */
+	struct trusted_group *group; /* Group of the entry, 0 if none */
+	struct trusted_list *next;	 /* Next element in the list */
 };
 
 
+/*
+ * Version of the trusted hash table, incremented on reload
+ */
+extern unsigned int *perm_trust_version;
+
+
+/*
+ * Start a new matching with regular expressions compiled by the process
+ */
+void perm_re_check_start(void);
+
+
+/*
+ * Match a subject (0 - From URI, 1 - Request URI) against a regular
+ * expression compiled once per process
+ */
+int perm_re_match(char *pattern, unsigned int hid, char *subject, int sidx);
+
+
 /*
  * Parse and init tag avp specification
  */
@@ -87,6 +120,13 @@ int hash_table_insert(struct trusted_list **hash_table, char *src_ip,
 		int priority);
 
 
+/*
+ * Group the entries of the hash table with the same src_ip, combining
+ * their From patterns
+ */
+int hash_table_group(struct trusted_list **hash_table);
+
+
 /*
  * Check if an entry exists in hash table that has given src_ip and protocol
  * value and pattern or ruri_pattern that matches to provided URI.
@@ -178,6 +218,8 @@ void empty_addr_hash_table(struct addr_list **hash_table);
 /*
  * Structure used to store a subnet
  */
+struct subnet_lpm;
+
 struct subnet
 {
 	unsigned int grp; /* address group, subnet count in last record */
@@ -186,6 +228,7 @@ struct subnet
 	unsigned int port; /* port or 0 */
 	unsigned int mask; /* how many bits belong to network part */
 	str tag;
+	struct subnet_lpm *lpm; /* prefix index, set only in last record */
 };
 
 
@@ -211,6 +254,12 @@ int match_subnet_table(struct subnet *table, unsigned int group,
 int find_group_in_subnet_table(
 		struct subnet *table, ip_addr_t *addr, unsigned int port);
 
+/*
+ * Build the longest prefix match index of a subnet table, to be done
+ * once all records are inserted and before the table is published
+ */
+int subnet_table_index(struct subnet *table);
+
 /*
  * Empty contents of subnet table
  */
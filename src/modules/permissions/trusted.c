@@ -44,6 +44,7 @@ struct trusted_list ***perm_trust_table =
 		0; /* Pointer to current hash table pointer */
 struct trusted_list **perm_trust_table_1 = 0; /* Pointer to hash table 1 */
 struct trusted_list **perm_trust_table_2 = 0; /* Pointer to hash table 2 */
+unsigned int *perm_trust_version = 0; /* Incremented on table reload */
 
 
 static db1_con_t *perm_db_handle = 0;
@@ -268,7 +269,16 @@ int reload_trusted_table(void)
 
 	perm_dbf.free_result(perm_db_handle, res);
 
+	if(hash_table_group(new_hash_table) < 0) {
+		LM_WARN("trusted entries not all grouped - their From patterns are "
+				"matched one by one\n");
+	}
+
 	*perm_trust_table = new_hash_table;
+	if(perm_trust_version) {
+		/* processes drop their compiled regular expressions */
+		(*perm_trust_version)++;
+	}
 
 	LM_DBG("trusted table reloaded successfully.\n");
 
@@ -339,6 +349,11 @@ int init_trusted(void)
 
 		*perm_trust_table = perm_trust_table_1;
 
+		perm_trust_version = (unsigned int *)shm_malloc(sizeof(unsigned int));
+		if(!perm_trust_version)
+			goto error;
+		*perm_trust_version = 0;
+
 		if(reload_trusted_table() == -1) {
 			LM_CRIT("reload of trusted table failed\n");
 			goto error;
@@ -365,6 +380,10 @@ error:
 		shm_free(perm_trust_table);
 		perm_trust_table = 0;
 	}
+	if(perm_trust_version) {
+		shm_free(perm_trust_version);
+		perm_trust_version = 0;
+	}
 	perm_dbf.close(perm_db_handle);
 	perm_db_handle = 0;
 	return -1;
@@ -432,6 +451,8 @@ void clean_trusted(void)
 		free_hash_table(perm_trust_table_2);
 	if(perm_trust_table)
 		shm_free(perm_trust_table);
+	if(perm_trust_version)
+		shm_free(perm_trust_version);
 }
 
 
@@ -508,7 +529,6 @@ static int match_res(struct sip_msg *msg, int proto, db1_res_t *_r, char *uri)
 	char ruri_string[MAX_URI_SIZE + 1];
 	db_row_t *row;
 	db_val_t *val;
-	regex_t preg;
 	int_str tag_avp, avp_val;
 	int count = 0;
 
@@ -527,6 +547,7 @@ static int match_res(struct sip_msg *msg, int proto, db1_res_t *_r, char *uri)
 
 	LM_DBG("match_res: row numbers %d\n", RES_ROW_N(_r));
 
+	perm_re_check_start();
 	for(i = 0; i < RES_ROW_N(_r); i++) {
 		val = ROW_VALUES(row + i);
 		if((ROW_N(row + i) == 4) && (VAL_TYPE(val) == DB1_STRING)
@@ -546,28 +567,17 @@ static int match_res(struct sip_msg *msg, int proto, db1_res_t *_r, char *uri)
 
 			if(IS_SIP(msg)) {
 				if(!VAL_NULL(val + 1)) {
-					if(regcomp(&preg, (char *)VAL_STRING(val + 1), REG_NOSUB)) {
-						LM_ERR("invalid regular expression\n");
-						if(VAL_NULL(val + 2)) {
-							continue;
-						}
-					}
-					if(regexec(&preg, uri, 0, (regmatch_t *)0, 0)) {
-						regfree(&preg);
+					if(perm_re_match((char *)VAL_STRING(val + 1), 0, uri, 0)
+							<= 0) {
 						continue;
 					}
-					regfree(&preg);
 				}
 				if(!VAL_NULL(val + 2)) {
-					if(regcomp(&preg, (char *)VAL_STRING(val + 2), REG_NOSUB)) {
-						LM_ERR("invalid regular expression\n");
-						continue;
-					}
-					if(regexec(&preg, ruri_string, 0, (regmatch_t *)0, 0)) {
-						regfree(&preg);
+					if(perm_re_match(
+							   (char *)VAL_STRING(val + 2), 0, ruri_string, 1)
+							<= 0) {
 						continue;
 					}
-					regfree(&preg);
 				}
 			}
 			/* Found a match */
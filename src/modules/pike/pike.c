@@ -42,6 +42,7 @@
 #include "ip_tree.h"
 #include "timer.h"
 #include "pike_funcs.h"
+#include "pike_sketch.h"
 #include "../../core/rpc_lookup.h"
 #include "pike_rpc.h"
 
@@ -57,6 +58,11 @@ static int pike_time_unit = 2;
 static int pike_max_reqs = 30;
 int pike_timeout = 120;
 int pike_log_level = L_WARN;
+static int pike_sketch_width = 0;
+static int pike_sketch_depth = 4;
+static int pike_sketch_top_size = 64;
+int pike_ipv4_prefix = 32;
+int pike_ipv6_prefix = 128;
 
 /* global variables */
 gen_lock_t *pike_timer_lock = 0;
@@ -76,6 +82,11 @@ static param_export_t params[] = {
 	{"reqs_density_per_unit", PARAM_INT, &pike_max_reqs},
 	{"remove_latency", PARAM_INT, &pike_timeout},
 	{"pike_log_level", PARAM_INT, &pike_log_level},
+	{"sketch_width", PARAM_INT, &pike_sketch_width},
+	{"sketch_depth", PARAM_INT, &pike_sketch_depth},
+	{"sketch_top_size", PARAM_INT, &pike_sketch_top_size},
+	{"ipv4_prefix", PARAM_INT, &pike_ipv4_prefix},
+	{"ipv6_prefix", PARAM_INT, &pike_ipv6_prefix},
 	{0, 0, 0}
 };
 
@@ -102,6 +113,22 @@ static int pike_init(void)
 		return -1;
 	}
 
+	if(pike_sketch_width > 0) {
+		/* bounded memory counting, no ip tree and no cleaning timer */
+		if(pike_sketch_init(pike_sketch_width, pike_sketch_depth,
+				   pike_sketch_top_size, pike_max_reqs, pike_timeout)
+				!= 0) {
+			LM_ERR("sketch creation failed!\n");
+			return -1;
+		}
+		if(register_timer(pike_sketch_swap, 0, pike_time_unit) < 0) {
+			LM_ERR("failed to register timer\n");
+			return -1;
+		}
+		pike_counter_init();
+		return 0;
+	}
+
 	/* alloc the timer lock */
 	pike_timer_lock = lock_alloc();
 	if(pike_timer_lock == 0) {
@@ -36,6 +36,7 @@
 #include "../../core/mod_fix.h"
 #include "ip_tree.h"
 #include "pike_funcs.h"
+#include "pike_sketch.h"
 #include "timer.h"
 
 
@@ -43,6 +44,8 @@ extern gen_lock_t *pike_timer_lock;
 extern pike_list_link_t *pike_timer;
 extern int pike_timeout;
 extern int pike_log_level;
+extern int pike_ipv4_prefix;
+extern int pike_ipv6_prefix;
 
 counter_handle_t blocked;
 
@@ -53,11 +56,43 @@ void pike_counter_init()
 }
 
 
-int pike_check_ipaddr(sip_msg_t *msg, ip_addr_t *ip)
+/* keep only the prefix bits of the address, to count per network */
+static void pike_ip_prefix_mask(ip_addr_t *ip)
+{
+	int prefix;
+	int i;
+
+	prefix = (ip->af == AF_INET6) ? pike_ipv6_prefix : pike_ipv4_prefix;
+	if(prefix <= 0 || prefix >= ip->len * 8)
+		return;
+	ip->u.addr[prefix >> 3] &= (0xff << (8 - (prefix & 0x07))) & 0xff;
+	for(i = (prefix >> 3) + 1; i < ip->len; i++)
+		ip->u.addr[i] = 0;
+}
+
+int pike_check_ipaddr(sip_msg_t *msg, ip_addr_t *ipaddr)
 {
 	pike_ip_node_t *node;
 	pike_ip_node_t *father;
 	unsigned char flags;
+	ip_addr_t ipbuf;
+	ip_addr_t *ip;
+	int ret;
+
+	ip = ipaddr;
+	if((ip->af == AF_INET6 && pike_ipv6_prefix < 128)
+			|| (ip->af == AF_INET && pike_ipv4_prefix < 32)) {
+		memcpy(&ipbuf, ipaddr, sizeof(ip_addr_t));
+		pike_ip_prefix_mask(&ipbuf);
+		ip = &ipbuf;
+	}
+
+	if(pike_sketch_enabled()) {
+		ret = pike_sketch_check(ip);
+		if(ret == -2)
+			counter_inc(blocked);
+		return ret;
+	}
 
 	/* first lock the proper tree branch and mark the IP with one more hit*/
 	lock_tree_branch(ip->u.addr[0]);
@@ -30,6 +30,7 @@
 #include "../../core/dprint.h"
 #include "../../core/ut.h"
 #include "pike_top.h"
+#include "pike_sketch.h"
 
 #include <stdlib.h>
 #include <unistd.h>
@@ -145,14 +146,19 @@ static void pike_top(rpc_t *rpc, void *c)
 	}
 
 
-	print_tree(0);
-
-	collect_data(options);
+	if(pike_sketch_enabled()) {
+		pike_sketch_collect(options);
+	} else {
+		print_tree(0);
+		collect_data(options);
+	}
 	top_list_root = pike_top_get_root();
 	DBG("pike_top: top_list_root = %p", top_list_root);
 
 	rpc->add(c, "{", &handle);
-	rpc->struct_add(handle, "d[", "max_hits", get_max_hits(), "list", &list);
+	rpc->struct_add(handle, "d[", "max_hits",
+			pike_sketch_enabled() ? pike_sketch_max_hits() : get_max_hits(),
+			"list", &list);
 	i = 0; // it is passed as number of rows
 	if(top_list_root == 0) {
 		DBG("pike_top: no data");
@@ -0,0 +1,381 @@
+/*
+ * PIKE module
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*! \file
+ * \brief count-min sketch of the request rate per source address
+ *
+ * The hits of an address (or address prefix) are counted in a matrix of
+ * depth rows with width counters, one counter per row selected by a
+ * different hash of the address, the estimate being the minimum of them.
+ * Two matrices are kept, for the current and the previous sampling time
+ * unit. The memory does not grow with the number of sources and the
+ * counters are updated with atomic operations, without locking. The
+ * addresses that get warm or hot are recorded in a small table of top
+ * offenders, protected by a lock, used for blocking state and reporting.
+ */
+
+#include <string.h>
+
+#include "../../core/dprint.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/locking.h"
+#include "../../core/atomic_ops.h"
+#include "../../core/timer.h"
+#include "pike_sketch.h"
+#include "pike_top.h"
+
+extern int pike_log_level;
+
+typedef struct pike_sketch_top
+{
+	unsigned char addr[16];
+	unsigned char len; /* 0 for unused entry */
+	unsigned char red;
+	unsigned int expires;
+} pike_sketch_top_t;
+
+typedef struct pike_sketch
+{
+	unsigned int width;
+	unsigned int depth;
+	unsigned int max_hits;
+	unsigned int timeout;
+	atomic_t window; /* index of the matrix for current time unit */
+	atomic_t *counters;
+	gen_lock_t lock; /* lock for top offenders */
+	unsigned int top_size;
+	pike_sketch_top_t *top;
+} pike_sketch_t;
+
+static pike_sketch_t *_pike_sketch = NULL;
+
+static const unsigned int _pike_sketch_seeds[PIKE_SKETCH_MAX_DEPTH] = {
+		0x9e3779b9, 0x85ebca6b, 0xc2b2ae35, 0x27d4eb2f, 0x165667b1,
+		0xd3a2646c, 0xfd7046c5, 0xb55a4f09};
+
+#define pike_sketch_cell(sk, w, r, i) \
+	(&(sk)->counters[((w) * (sk)->depth + (r)) * (sk)->width + (i)])
+
+#define pike_sketch_is_hot(_prev, _curr, _max)                \
+	((_prev) >= (_max) || (_curr) >= (_max)                   \
+			|| (((_prev) + (_curr)) >> 1) >= (_max))
+
+#define pike_sketch_is_warm(_curr, _max) ((_curr) >= (_max) >> 2)
+
+int pike_sketch_init(
+		int width, int depth, int top_size, int max_hits, int timeout)
+{
+	unsigned int size;
+
+	if(depth <= 0 || depth > PIKE_SKETCH_MAX_DEPTH) {
+		LM_ERR("invalid sketch depth %d (max %d)\n", depth,
+				PIKE_SKETCH_MAX_DEPTH);
+		return -1;
+	}
+	if(top_size <= 0) {
+		LM_ERR("invalid sketch top size %d\n", top_size);
+		return -1;
+	}
+	_pike_sketch = (pike_sketch_t *)shm_malloc(sizeof(pike_sketch_t));
+	if(_pike_sketch == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	memset(_pike_sketch, 0, sizeof(pike_sketch_t));
+
+	/* width is rounded up to a power of 2 */
+	for(size = 1; size < width; size <<= 1)
+		;
+	_pike_sketch->width = size;
+	_pike_sketch->depth = depth;
+	_pike_sketch->max_hits = max_hits;
+	_pike_sketch->timeout = timeout;
+	_pike_sketch->top_size = top_size;
+
+	size = 2 * _pike_sketch->depth * _pike_sketch->width * sizeof(atomic_t);
+	_pike_sketch->counters = (atomic_t *)shm_malloc(size);
+	if(_pike_sketch->counters == NULL) {
+		SHM_MEM_ERROR_FMT("for sketch counters (%u bytes)\n", size);
+		goto error;
+	}
+	memset(_pike_sketch->counters, 0, size);
+
+	size = top_size * sizeof(pike_sketch_top_t);
+	_pike_sketch->top = (pike_sketch_top_t *)shm_malloc(size);
+	if(_pike_sketch->top == NULL) {
+		SHM_MEM_ERROR_FMT("for sketch top entries\n");
+		goto error;
+	}
+	memset(_pike_sketch->top, 0, size);
+
+	if(lock_init(&_pike_sketch->lock) == 0) {
+		LM_ERR("cannot init sketch lock\n");
+		goto error;
+	}
+	LM_INFO("sketch with %u x %u counters and %u top entries\n",
+			_pike_sketch->depth, _pike_sketch->width, _pike_sketch->top_size);
+	return 0;
+
+error:
+	pike_sketch_destroy();
+	return -1;
+}
+
+void pike_sketch_destroy(void)
+{
+	if(_pike_sketch == NULL)
+		return;
+	if(_pike_sketch->counters != NULL)
+		shm_free(_pike_sketch->counters);
+	if(_pike_sketch->top != NULL)
+		shm_free(_pike_sketch->top);
+	shm_free(_pike_sketch);
+	_pike_sketch = NULL;
+}
+
+int pike_sketch_enabled(void)
+{
+	return (_pike_sketch != NULL);
+}
+
+unsigned int pike_sketch_max_hits(void)
+{
+	return (_pike_sketch != NULL) ? _pike_sketch->max_hits : 0;
+}
+
+static inline unsigned int pike_sketch_hash(
+		unsigned char *addr, int len, unsigned int seed)
+{
+	unsigned int h;
+	int i;
+
+	h = seed ^ 2166136261U;
+	for(i = 0; i < len; i++) {
+		h ^= addr[i];
+		h *= 16777619U;
+	}
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	return h;
+}
+
+/**
+ * estimate the hits of the address in previous and current time unit
+ * - if inc is set, the address gets one more hit in current time unit
+ */
+static void pike_sketch_estimate(unsigned char *addr, int len,
+		unsigned int *prev, unsigned int *curr, int inc)
+{
+	pike_sketch_t *sk = _pike_sketch;
+	unsigned int idx;
+	unsigned int vp;
+	unsigned int vc;
+	unsigned int r;
+	int w;
+
+	w = atomic_get(&sk->window);
+	*prev = *curr = 0xffffffffU;
+	for(r = 0; r < sk->depth; r++) {
+		idx = pike_sketch_hash(addr, len, _pike_sketch_seeds[r])
+			  & (sk->width - 1);
+		if(inc)
+			vc = (unsigned int)atomic_add(pike_sketch_cell(sk, w, r, idx), 1);
+		else
+			vc = (unsigned int)atomic_get(pike_sketch_cell(sk, w, r, idx));
+		vp = (unsigned int)atomic_get(pike_sketch_cell(sk, w ^ 1, r, idx));
+		if(vc < *curr)
+			*curr = vc;
+		if(vp < *prev)
+			*prev = vp;
+	}
+}
+
+/**
+ * record the address in the top offenders
+ * - return 1 if the address got blocked now, 0 otherwise
+ */
+static int pike_sketch_top_mark(unsigned char *addr, int len, int hot)
+{
+	pike_sketch_t *sk = _pike_sketch;
+	pike_sketch_top_t *e;
+	unsigned int vmin;
+	unsigned int vp;
+	unsigned int vc;
+	int found;
+	int k;
+	int ret;
+
+	found = -1;
+	lock_get(&sk->lock);
+	for(k = 0; k < sk->top_size; k++) {
+		e = &sk->top[k];
+		if(e->len == len && memcmp(e->addr, addr, len) == 0) {
+			found = k;
+			break;
+		}
+		if(e->len == 0 && found < 0)
+			found = k;
+	}
+	if(found < 0) {
+		/* no free entry - replace the one with lowest rate, if not blocked */
+		vmin = 0;
+		for(k = 0; k < sk->top_size; k++) {
+			e = &sk->top[k];
+			if(e->red)
+				continue;
+			pike_sketch_estimate(e->addr, e->len, &vp, &vc, 0);
+			if(found < 0 || vp + vc < vmin) {
+				found = k;
+				vmin = vp + vc;
+			}
+		}
+		if(found < 0) {
+			lock_release(&sk->lock);
+			return 0;
+		}
+	}
+	e = &sk->top[found];
+	if(e->len != len || memcmp(e->addr, addr, len) != 0) {
+		memset(e, 0, sizeof(pike_sketch_top_t));
+		memcpy(e->addr, addr, len);
+		e->len = len;
+	}
+	e->expires = get_ticks() + sk->timeout;
+	ret = 0;
+	if(hot && !e->red) {
+		e->red = 1;
+		ret = 1;
+	}
+	lock_release(&sk->lock);
+	return ret;
+}
+
+/**
+ * count one more hit for the address
+ * - return 1 if not blocked, -1 if blocked and -2 if blocked now
+ */
+int pike_sketch_check(ip_addr_t *ip)
+{
+	unsigned int prev;
+	unsigned int curr;
+	unsigned int max;
+
+	max = _pike_sketch->max_hits;
+	pike_sketch_estimate(ip->u.addr, ip->len, &prev, &curr, 1);
+
+	if(pike_sketch_is_hot(prev, curr, max)) {
+		/* mark the top entry when getting hot in the time unit, on its
+		 * first hit and from time to time after - not for each packet of
+		 * a hot source, the top list being under a global lock */
+		if(curr == 1 || !pike_sketch_is_hot(prev, curr - 1, max)
+				|| (curr & 63) == 0) {
+			if(pike_sketch_top_mark(ip->u.addr, ip->len, 1) == 1) {
+				LM_GEN1(pike_log_level, "PIKE - BLOCKing ip %s (hits %u/%u)\n",
+						ip_addr2a(ip), prev, curr);
+				return -2;
+			}
+		}
+		return -1;
+	}
+	if(curr == (max >> 2)) {
+		/* got warm */
+		pike_sketch_top_mark(ip->u.addr, ip->len, 0);
+	}
+	return 1;
+}
+
+/**
+ * start a new sampling time unit
+ */
+void pike_sketch_swap(unsigned int ticks, void *param)
+{
+	pike_sketch_t *sk = _pike_sketch;
+	pike_sketch_top_t *e;
+	unsigned int prev;
+	unsigned int curr;
+	int w;
+	int k;
+
+	if(sk == NULL)
+		return;
+
+	w = atomic_get(&sk->window) ^ 1;
+	memset((void *)pike_sketch_cell(sk, w, 0, 0), 0,
+			sk->depth * sk->width * sizeof(atomic_t));
+	membar_write();
+	atomic_set(&sk->window, w);
+
+	lock_get(&sk->lock);
+	for(k = 0; k < sk->top_size; k++) {
+		e = &sk->top[k];
+		if(e->len == 0)
+			continue;
+		pike_sketch_estimate(e->addr, e->len, &prev, &curr, 0);
+		if(pike_sketch_is_hot(prev, curr, sk->max_hits))
+			continue;
+		if(e->red) {
+			e->red = 0;
+			LM_GEN1(pike_log_level, "PIKE - UNBLOCKing entry %d\n", k);
+		}
+		if(!pike_sketch_is_warm(prev, sk->max_hits) && e->expires < ticks) {
+			e->len = 0;
+		}
+	}
+	lock_release(&sk->lock);
+}
+
+/**
+ * add the top offenders with matching status to the rpc result list
+ */
+void pike_sketch_collect(int options)
+{
+	pike_sketch_t *sk = _pike_sketch;
+	pike_sketch_top_t *e;
+	unsigned short hits[2];
+	unsigned int prev;
+	unsigned int curr;
+	pike_node_status_t ns;
+	int k;
+
+	lock_get(&sk->lock);
+	for(k = 0; k < sk->top_size; k++) {
+		e = &sk->top[k];
+		if(e->len == 0)
+			continue;
+		pike_sketch_estimate(e->addr, e->len, &prev, &curr, 0);
+		if(pike_sketch_is_hot(prev, curr, sk->max_hits))
+			ns = NODE_STATUS_HOT;
+		else if(pike_sketch_is_warm(curr, sk->max_hits))
+			ns = NODE_STATUS_WARM;
+		else
+			ns = NODE_STATUS_OK;
+		if(options != NODE_STATUS_ALL && (ns & options) == 0)
+			continue;
+		hits[PREV_POS] = (prev > 0xffff) ? 0xffff : prev;
+		hits[CURR_POS] = (curr > 0xffff) ? 0xffff : curr;
+		pike_top_add_entry(
+				e->addr, e->len, hits, hits, e->expires - get_ticks(), ns);
+	}
+	lock_release(&sk->lock);
+}
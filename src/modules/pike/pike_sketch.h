@@ -0,0 +1,40 @@
+/*
+ * PIKE module
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+#ifndef _PIKE_SKETCH_H
+#define _PIKE_SKETCH_H
+
+#include "../../core/ip_addr.h"
+#include "ip_tree.h"
+
+#define PIKE_SKETCH_MAX_DEPTH 8
+
+int pike_sketch_init(
+		int width, int depth, int top_size, int max_hits, int timeout);
+void pike_sketch_destroy(void);
+int pike_sketch_enabled(void);
+unsigned int pike_sketch_max_hits(void);
+int pike_sketch_check(ip_addr_t *ip);
+void pike_sketch_swap(unsigned int ticks, void *param);
+void pike_sketch_collect(int options);
+
+#endif
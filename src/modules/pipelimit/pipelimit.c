@@ -62,6 +62,7 @@
 #include "pl_statistics.h"
 #include "pl_ht.h"
 #include "pl_db.h"
+#include "pl_dmq.h"
 
 MODULE_VERSION
 
@@ -119,6 +120,11 @@ static int pl_timer_interval = PL_TIMER_INTERVAL_DEFAULT;
 static int pl_timer_mode = 0;
 int _pl_cfg_setpoint = 0; /* desired load, used when reading modparams */
 int pl_clean_unused = 0;
+static int pl_gcra_burst = 0; /* GCRA burst size, 0 - use the pipe limit */
+int pl_enable_dmq = 0;
+str pl_dmq_peer_id = str_init("pipelimit");
+int pl_dmq_full_sync = 6;
+int pl_dmq_node_expire = 0;
 
 /* === */
 
@@ -168,6 +174,11 @@ static param_export_t params[] = {
 	{"hash_size", PARAM_INT, &pl_hash_size},
 	{"load_fetch", PARAM_INT, &pl_load_fetch},
 	{"clean_unused", PARAM_INT, &pl_clean_unused},
+	{"gcra_burst", PARAM_INT, &pl_gcra_burst},
+	{"enable_dmq", PARAM_INT, &pl_enable_dmq},
+	{"dmq_peer_id", PARAM_STR, &pl_dmq_peer_id},
+	{"dmq_full_sync", PARAM_INT, &pl_dmq_full_sync},
+	{"dmq_node_expire", PARAM_INT, &pl_dmq_node_expire},
 
 	{0, 0, 0}
 };
@@ -399,6 +410,7 @@ static void pl_cleanup(void)
 		timer_free(pl_timer);
 		pl_timer = NULL;
 	}
+	pl_dmq_destroy();
 	pl_destroy_htable();
 }
 
@@ -430,6 +442,15 @@ static int mod_init(void)
 		LM_ERR("could not load pipes description\n");
 		goto error;
 	}
+	if(pl_enable_dmq > 0) {
+		if(pl_dmq_node_expire <= 0) {
+			pl_dmq_node_expire = 3 * pl_timer_interval;
+		}
+		if(pl_dmq_init() < 0) {
+			LM_ERR("failed to initialize dmq integration\n");
+			goto error;
+		}
+	}
 
 	/* bind the SL API */
 	if(sl_load_api(&_pl_slb) != 0) {
@@ -637,7 +658,8 @@ static int pipe_push_direct(pl_pipe_t *pipe)
 			ret = 2;
 			break;
 		case PIPE_ALGO_TAILDROP:
-			ret = (pipe->counter <= pipe->limit) ? 1 : -1;
+			/* rcounter - consumed by the other nodes in cluster mode */
+			ret = (pipe->counter <= pipe->limit - pipe->rcounter) ? 1 : -1;
 			break;
 		case PIPE_ALGO_RED:
 			if(pipe->load == 0)
@@ -652,10 +674,16 @@ static int pipe_push_direct(pl_pipe_t *pipe)
 		case PIPE_ALGO_NETWORK:
 			ret = -1 * pipe->load;
 			break;
+		case PIPE_ALGO_GCRA:
+			ret = pl_pipe_gcra_check(pipe, pl_timer_interval, pl_gcra_burst);
+			break;
 		default:
 			LM_ERR("unknown ratelimit algorithm: %d\n", pipe->algo);
 			ret = 1;
 	}
+	if(ret == 1 && pipe->accepted < INT_MAX) {
+		pipe->accepted++;
+	}
 	LM_DBG("pipe=%.*s algo=%d limit=%d pkg_load=%d counter=%d "
 		   "load=%2.1lf network_load=%d => %s\n",
 			pipe->name.len, pipe->name.s, pipe->algo, pipe->limit, pipe->load,
@@ -0,0 +1,507 @@
+/*
+ * pipelimit module
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+
+/*! \file
+ * \ingroup pipelimit
+ * \brief pipelimit :: pl_dmq - sharing of pipe counters in the cluster
+ *
+ * Each node broadcasts at every timer interval the counters of its pipes
+ * for the interval that just ended, the requests they accepted averaged
+ * with the previous intervals. Only the counters that changed since
+ * the previous update are sent, with a full update every dmq_full_sync
+ * intervals. The update is sent even if there is no changed counter, being
+ * the keepalive of the node - the counters of a node that is not heard of
+ * for dmq_node_expire seconds are discarded.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../core/dprint.h"
+#include "../../core/ut.h"
+#include "../../core/hashes.h"
+#include "../../core/locking.h"
+#include "../../core/mem/shm_mem.h"
+
+#include "pl_ht.h"
+#include "pl_dmq.h"
+
+typedef struct _pl_dmq_node
+{
+	unsigned int nodeid;
+	unsigned int epoch;
+	time_t last_seen;
+	struct _pl_dmq_node *next;
+} pl_dmq_node_t;
+
+typedef struct _pl_dmq_batch
+{
+	int count;
+	int size;
+	int full;
+	srjson_doc_t jdoc;
+	srjson_t *jpipes;
+} pl_dmq_batch_t;
+
+static str pl_dmq_content_type = str_init("application/json");
+static str dmq_200_rpl = str_init("OK");
+static str dmq_400_rpl = str_init("Bad Request");
+static str dmq_500_rpl = str_init("Server Internal Error");
+/* {"node":"","epoch":,"full":,"pipes":[]} plus the numbers */
+static int pl_dmq_batch_empty_size = 64;
+static int pl_dmq_batch_max_size = 60000;
+
+static dmq_api_t pl_dmqb;
+static dmq_peer_t *pl_dmq_peer = NULL;
+
+static pl_dmq_node_t **_pl_dmq_nodes = NULL;
+static gen_lock_t *_pl_dmq_lock = NULL;
+static unsigned int _pl_dmq_epoch = 0;
+
+/* updates are built only by the process running the pipelimit timer */
+static unsigned int _pl_dmq_updates = 0;
+static pl_dmq_batch_t _pl_dmq_batch;
+
+/**
+ * register the dmq peer for pipelimit
+ */
+int pl_dmq_init(void)
+{
+	dmq_peer_t not_peer;
+
+	if(dmq_load_api(&pl_dmqb) != 0) {
+		LM_ERR("cannot load dmq api\n");
+		return -1;
+	}
+
+	_pl_dmq_nodes = (pl_dmq_node_t **)shm_malloc(sizeof(pl_dmq_node_t *));
+	if(_pl_dmq_nodes == NULL) {
+		LM_ERR("no more shm\n");
+		return -1;
+	}
+	*_pl_dmq_nodes = NULL;
+
+	_pl_dmq_lock = lock_alloc();
+	if(_pl_dmq_lock == NULL || lock_init(_pl_dmq_lock) == 0) {
+		LM_ERR("cannot initialize the dmq nodes lock\n");
+		if(_pl_dmq_lock != NULL) {
+			lock_dealloc(_pl_dmq_lock);
+			_pl_dmq_lock = NULL;
+		}
+		shm_free(_pl_dmq_nodes);
+		_pl_dmq_nodes = NULL;
+		return -1;
+	}
+
+	not_peer.callback = pl_dmq_handle_msg;
+	not_peer.init_callback = NULL;
+	not_peer.peer_id = pl_dmq_peer_id;
+	not_peer.description = pl_dmq_peer_id;
+	pl_dmq_peer = pl_dmqb.register_dmq_peer(&not_peer);
+	if(pl_dmq_peer == NULL) {
+		LM_ERR("error in register_dmq_peer\n");
+		return -1;
+	}
+
+	/* identifies the current run of this node, so the peers can discard
+	 * the counters reported before a restart */
+	_pl_dmq_epoch = (unsigned int)time(NULL);
+
+	LM_DBG("dmq peer registered - epoch %u\n", _pl_dmq_epoch);
+	return 0;
+}
+
+void pl_dmq_destroy(void)
+{
+	pl_dmq_node_t *nd, *nd0;
+
+	if(_pl_dmq_nodes != NULL) {
+		nd = *_pl_dmq_nodes;
+		while(nd != NULL) {
+			nd0 = nd;
+			nd = nd->next;
+			shm_free(nd0);
+		}
+		shm_free(_pl_dmq_nodes);
+		_pl_dmq_nodes = NULL;
+	}
+	if(_pl_dmq_lock != NULL) {
+		lock_destroy(_pl_dmq_lock);
+		lock_dealloc(_pl_dmq_lock);
+		_pl_dmq_lock = NULL;
+	}
+}
+
+/**
+ * update the state of a cluster node on receiving its counters
+ * \return 1 if the counters of the node have to be discarded first, 0 if
+ * not, -1 on error
+ */
+static int pl_dmq_node_update(unsigned int nodeid, unsigned int epoch, int full)
+{
+	pl_dmq_node_t *nd;
+	int ret = 0;
+
+	lock_get(_pl_dmq_lock);
+	for(nd = *_pl_dmq_nodes; nd != NULL; nd = nd->next) {
+		if(nd->nodeid == nodeid) {
+			break;
+		}
+	}
+	if(nd == NULL) {
+		nd = (pl_dmq_node_t *)shm_malloc(sizeof(pl_dmq_node_t));
+		if(nd == NULL) {
+			lock_release(_pl_dmq_lock);
+			LM_ERR("no more shm\n");
+			return -1;
+		}
+		memset(nd, 0, sizeof(pl_dmq_node_t));
+		nd->nodeid = nodeid;
+		nd->epoch = epoch;
+		nd->next = *_pl_dmq_nodes;
+		*_pl_dmq_nodes = nd;
+		LM_DBG("new cluster node %u (epoch %u)\n", nodeid, epoch);
+	} else if(nd->epoch != epoch || full) {
+		nd->epoch = epoch;
+		ret = 1;
+	}
+	nd->last_seen = time(NULL);
+	lock_release(_pl_dmq_lock);
+
+	return ret;
+}
+
+/**
+ * discard the counters of the nodes not heard of for dmq_node_expire
+ */
+void pl_dmq_nodes_expire(void)
+{
+	pl_dmq_node_t *nd, *prev, *expired;
+	time_t now;
+
+	if(_pl_dmq_nodes == NULL) {
+		return;
+	}
+
+	now = time(NULL);
+	expired = NULL;
+	prev = NULL;
+	lock_get(_pl_dmq_lock);
+	nd = *_pl_dmq_nodes;
+	while(nd != NULL) {
+		if(nd->last_seen + pl_dmq_node_expire < now) {
+			if(prev == NULL) {
+				*_pl_dmq_nodes = nd->next;
+			} else {
+				prev->next = nd->next;
+			}
+			nd->next = expired;
+			expired = nd;
+			nd = (prev == NULL) ? *_pl_dmq_nodes : prev->next;
+			continue;
+		}
+		prev = nd;
+		nd = nd->next;
+	}
+	lock_release(_pl_dmq_lock);
+
+	while(expired != NULL) {
+		nd = expired;
+		expired = expired->next;
+		LM_INFO("no update from cluster node %u for %d seconds - discarding "
+				"its counters\n",
+				nd->nodeid, (int)(now - nd->last_seen));
+		pl_pipe_rcounter_reset(nd->nodeid);
+		shm_free(nd);
+	}
+}
+
+static void pl_dmq_batch_reset(void)
+{
+	srjson_DestroyDoc(&_pl_dmq_batch.jdoc);
+	_pl_dmq_batch.jpipes = NULL;
+	_pl_dmq_batch.count = 0;
+	_pl_dmq_batch.size = pl_dmq_batch_empty_size;
+}
+
+static int pl_dmq_batch_new(void)
+{
+	srjson_InitDoc(&_pl_dmq_batch.jdoc, NULL);
+	_pl_dmq_batch.jdoc.root = srjson_CreateObject(&_pl_dmq_batch.jdoc);
+	if(_pl_dmq_batch.jdoc.root == NULL) {
+		LM_ERR("cannot create json root object\n");
+		pl_dmq_batch_reset();
+		return -1;
+	}
+	_pl_dmq_batch.jpipes = srjson_CreateArray(&_pl_dmq_batch.jdoc);
+	if(_pl_dmq_batch.jpipes == NULL) {
+		LM_ERR("cannot create json pipes array\n");
+		pl_dmq_batch_reset();
+		return -1;
+	}
+	srjson_AddItemToObject(&_pl_dmq_batch.jdoc, _pl_dmq_batch.jdoc.root,
+			"pipes", _pl_dmq_batch.jpipes);
+	_pl_dmq_batch.count = 0;
+	_pl_dmq_batch.size = pl_dmq_batch_empty_size;
+	return 0;
+}
+
+/**
+ * start building the update for the current timer interval
+ * \return 1 for a full update, 0 for an update with the changed counters,
+ * -1 on error
+ */
+int pl_dmq_batch_init(void)
+{
+	if(pl_dmq_peer == NULL) {
+		return -1;
+	}
+	if(pl_dmq_batch_new() < 0) {
+		return -1;
+	}
+	_pl_dmq_batch.full = (pl_dmq_full_sync <= 1
+								 || _pl_dmq_updates % pl_dmq_full_sync == 0)
+								 ? 1
+								 : 0;
+	_pl_dmq_updates++;
+
+	return _pl_dmq_batch.full;
+}
+
+/**
+ * add the counter of a pipe to the update
+ */
+int pl_dmq_batch_add(str *pipeid, int counter)
+{
+	srjson_doc_t *jdoc = &_pl_dmq_batch.jdoc;
+	srjson_t *jpipe;
+
+	if(_pl_dmq_batch.jpipes == NULL) {
+		return -1;
+	}
+	jpipe = srjson_CreateObject(jdoc);
+	if(jpipe == NULL) {
+		LM_ERR("cannot create json pipe object\n");
+		return -1;
+	}
+	srjson_AddStrToObject(jdoc, jpipe, "n", pipeid->s, pipeid->len);
+	srjson_AddNumberToObject(jdoc, jpipe, "c", counter);
+	srjson_AddItemToArray(jdoc, _pl_dmq_batch.jpipes, jpipe);
+
+	/* {"n":"","c":}, plus max int length */
+	_pl_dmq_batch.size += 14 + pipeid->len + 11;
+	_pl_dmq_batch.count++;
+
+	return 0;
+}
+
+/**
+ * broadcast the update if it is large enough or if forced (end of the
+ * timer interval)
+ */
+int pl_dmq_batch_flush(int force)
+{
+	srjson_doc_t *jdoc = &_pl_dmq_batch.jdoc;
+	str node;
+	int ret = 0;
+
+	if(_pl_dmq_batch.jpipes == NULL) {
+		return -1;
+	}
+	if(!force && _pl_dmq_batch.size < pl_dmq_batch_max_size) {
+		return 0;
+	}
+
+	node = pl_dmqb.get_dmq_server_socket();
+	if(node.s == NULL || node.len <= 0) {
+		LM_ERR("dmq server socket not available\n");
+		ret = -1;
+		goto done;
+	}
+
+	srjson_AddStrToObject(jdoc, jdoc->root, "node", node.s, node.len);
+	srjson_AddNumberToObject(jdoc, jdoc->root, "epoch", _pl_dmq_epoch);
+	srjson_AddNumberToObject(jdoc, jdoc->root, "full", _pl_dmq_batch.full);
+
+	jdoc->buf.s = srjson_PrintUnformatted(jdoc, jdoc->root);
+	if(jdoc->buf.s == NULL) {
+		LM_ERR("unable to serialize data\n");
+		ret = -1;
+		goto done;
+	}
+	jdoc->buf.len = strlen(jdoc->buf.s);
+
+	LM_DBG("sending %d pipe counters (full: %d) - %.*s\n",
+			_pl_dmq_batch.count, _pl_dmq_batch.full, jdoc->buf.len,
+			jdoc->buf.s);
+	if(pl_dmqb.bcast_message(pl_dmq_peer, &jdoc->buf, 0, NULL, 1,
+			   &pl_dmq_content_type)
+			!= 0) {
+		LM_ERR("unable to broadcast the pipe counters\n");
+		ret = -1;
+	}
+	jdoc->free_fn(jdoc->buf.s);
+	jdoc->buf.s = NULL;
+
+done:
+	pl_dmq_batch_reset();
+	if(!force) {
+		/* continue the update in a new message - only the first message
+		 * of a full update resets the state of the node on the peers */
+		if(pl_dmq_batch_new() < 0) {
+			return -1;
+		}
+		_pl_dmq_batch.full = 0;
+	}
+	return ret;
+}
+
+/**
+ * dmq callback - counters received from a cluster node
+ */
+int pl_dmq_handle_msg(
+		struct sip_msg *msg, peer_reponse_t *resp, dmq_node_t *dmq_node)
+{
+	int content_length;
+	str body;
+	str node = STR_NULL;
+	str pipeid;
+	unsigned int nodeid;
+	unsigned int epoch = 0;
+	int full = 0;
+	int counter;
+	int reset;
+	srjson_doc_t jdoc;
+	srjson_t *it = NULL;
+	srjson_t *jpipes = NULL;
+	srjson_t *jp = NULL;
+
+	srjson_InitDoc(&jdoc, NULL);
+
+	if(!msg->content_length) {
+		LM_ERR("no content length header found\n");
+		goto invalid;
+	}
+	content_length = get_content_length(msg);
+	if(!content_length) {
+		LM_DBG("content length is 0\n");
+		goto invalid;
+	}
+
+	body.s = get_body(msg);
+	body.len = content_length;
+	if(!body.s) {
+		LM_ERR("unable to get body\n");
+		goto error;
+	}
+
+	LM_DBG("body: %.*s\n", body.len, body.s);
+	jdoc.buf = body;
+	jdoc.root = srjson_Parse(&jdoc, jdoc.buf.s);
+	if(jdoc.root == NULL) {
+		LM_ERR("invalid json doc [[%.*s]]\n", body.len, body.s);
+		goto invalid;
+	}
+
+	for(it = jdoc.root->child; it; it = it->next) {
+		if(it->string == NULL) {
+			continue;
+		}
+		if(strcmp(it->string, "node") == 0) {
+			if(it->valuestring == NULL) {
+				goto invalid;
+			}
+			node.s = it->valuestring;
+			node.len = strlen(node.s);
+		} else if(strcmp(it->string, "epoch") == 0) {
+			epoch = SRJSON_GET_UINT(it);
+		} else if(strcmp(it->string, "full") == 0) {
+			full = SRJSON_GET_INT(it);
+		} else if(strcmp(it->string, "pipes") == 0) {
+			jpipes = it;
+		} else {
+			LM_WARN("unrecognized field in json object: %s\n", it->string);
+		}
+	}
+	if(node.len <= 0) {
+		LM_ERR("missing node field\n");
+		goto invalid;
+	}
+
+	nodeid = get_hash1_raw(node.s, node.len);
+	reset = pl_dmq_node_update(nodeid, epoch, full);
+	if(reset < 0) {
+		goto error;
+	}
+	if(reset == 1) {
+		pl_pipe_rcounter_reset(nodeid);
+	}
+	if(jpipes == NULL) {
+		goto done;
+	}
+
+	for(jp = jpipes->child; jp; jp = jp->next) {
+		pipeid.s = NULL;
+		pipeid.len = 0;
+		counter = 0;
+		for(it = jp->child; it; it = it->next) {
+			if(it->string == NULL) {
+				continue;
+			}
+			if(strcmp(it->string, "n") == 0 && it->valuestring != NULL) {
+				pipeid.s = it->valuestring;
+				pipeid.len = strlen(pipeid.s);
+			} else if(strcmp(it->string, "c") == 0) {
+				counter = SRJSON_GET_INT(it);
+			}
+		}
+		if(pipeid.len <= 0) {
+			LM_WARN("pipe without name from node [%.*s]\n", node.len, node.s);
+			continue;
+		}
+		if(pl_pipe_rcounter_set(&pipeid, nodeid, counter) < 0) {
+			goto error;
+		}
+	}
+
+done:
+	srjson_DestroyDoc(&jdoc);
+	resp->reason = dmq_200_rpl;
+	resp->resp_code = 200;
+	return 0;
+
+invalid:
+	srjson_DestroyDoc(&jdoc);
+	resp->reason = dmq_400_rpl;
+	resp->resp_code = 400;
+	return 0;
+
+error:
+	srjson_DestroyDoc(&jdoc);
+	resp->reason = dmq_500_rpl;
+	resp->resp_code = 500;
+	return 0;
+}
@@ -0,0 +1,53 @@
+/*
+ * pipelimit module
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*! \file
+ * \ingroup pipelimit
+ * \brief pipelimit :: pl_dmq - sharing of pipe counters in the cluster
+ */
+
+#ifndef _PL_DMQ_H_
+#define _PL_DMQ_H_
+
+#include "../dmq/bind_dmq.h"
+#include "../../core/utils/srjson.h"
+#include "../../core/parser/msg_parser.h"
+#include "../../core/parser/parse_content.h"
+
+extern int pl_enable_dmq;
+extern str pl_dmq_peer_id;
+extern int pl_dmq_full_sync;
+extern int pl_dmq_node_expire;
+
+int pl_dmq_init(void);
+void pl_dmq_destroy(void);
+int pl_dmq_handle_msg(
+		struct sip_msg *msg, peer_reponse_t *resp, dmq_node_t *dmq_node);
+
+int pl_dmq_batch_init(void);
+int pl_dmq_batch_add(str *pipeid, int counter);
+int pl_dmq_batch_flush(int force);
+void pl_dmq_nodes_expire(void);
+
+#endif
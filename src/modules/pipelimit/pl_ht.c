@@ -32,6 +32,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <limits.h>
 
 #include "../../core/dprint.h"
 #include "../../core/ut.h"
@@ -41,6 +43,7 @@
 #include "../../core/rpc_lookup.h"
 
 #include "pl_ht.h"
+#include "pl_dmq.h"
 
 static rlp_htable_t *_pl_pipes_ht = NULL;
 extern int pl_clean_unused;
@@ -51,6 +54,7 @@ str_map_t algo_names[] = {
 		{str_init("TAILDROP"), PIPE_ALGO_TAILDROP},
 		{str_init("FEEDBACK"), PIPE_ALGO_FEEDBACK},
 		{str_init("NETWORK"), PIPE_ALGO_NETWORK},
+		{str_init("GCRA"), PIPE_ALGO_GCRA},
 		{{0, 0}, 0},
 };
 
@@ -102,6 +106,14 @@ int pl_init_htable(unsigned int hsize)
 
 void pl_pipe_free(pl_pipe_t *it)
 {
+	pl_rcounter_t *rc, *rc0;
+
+	rc = it->rcounters;
+	while(rc) {
+		rc0 = rc;
+		rc = rc->next;
+		shm_free(rc0);
+	}
 	shm_free(it);
 	return;
 }
@@ -367,11 +379,17 @@ int pl_pipe_check_feedback_setpoints(int *cfgsp)
 void pl_pipe_timer_update(int interval, int netload)
 {
 	int i;
+	int dmqfull = -1;
 	pl_pipe_t *it, *it0;
 
 	if(_pl_pipes_ht == NULL)
 		return;
 
+	if(pl_enable_dmq > 0) {
+		pl_dmq_nodes_expire();
+		dmqfull = pl_dmq_batch_init();
+	}
+
 	for(i = 0; i < _pl_pipes_ht->htsize; i++) {
 		lock_get(&_pl_pipes_ht->slots[i].lock);
 		it = _pl_pipes_ht->slots[i].first;
@@ -405,16 +423,189 @@ void pl_pipe_timer_update(int interval, int netload)
 				if(it->algo == PIPE_ALGO_NETWORK) {
 					it->load = (netload > it->limit) ? 1 : -1;
 				} else if(it->limit && interval) {
-					it->load = it->counter / it->limit;
+					it->load = (int)(((long long)it->counter + it->rcounter)
+									 / it->limit);
+				}
+				/* the accepted requests are shared, not the offered ones that
+				 * would make each node drop the traffic accepted by the
+				 * others, averaged with the previous intervals so the nodes
+				 * do not swing around the limit adjusting to each other */
+				it->accepted_avg =
+						(int)(((long long)it->accepted_avg + it->accepted) / 2);
+				if(dmqfull > 0
+						|| (dmqfull == 0 && it->accepted_avg != it->dmq_sent)) {
+					if(pl_dmq_batch_add(&it->name, it->accepted_avg) == 0) {
+						it->dmq_sent = it->accepted_avg;
+					}
 				}
 				it->last_counter = it->counter;
 				it->counter = 0;
+				it->accepted = 0;
 			}
 
 			it = it->next;
 		}
 		lock_release(&_pl_pipes_ht->slots[i].lock);
+		if(dmqfull >= 0) {
+			pl_dmq_batch_flush(0);
+		}
+	}
+	if(dmqfull >= 0) {
+		/* sent also when there is no counter, as keepalive */
+		pl_dmq_batch_flush(1);
+	}
+}
+
+static void pl_pipe_rcounter_sum(pl_pipe_t *it)
+{
+	pl_rcounter_t *rc;
+	long long sum = 0;
+
+	for(rc = it->rcounters; rc != NULL; rc = rc->next) {
+		sum += rc->counter;
+	}
+	it->rcounter = (sum > INT_MAX) ? INT_MAX : (int)sum;
+}
+
+/**
+ * set the last interval counter reported by a cluster node for a pipe
+ * \return	0 on success or if the pipe does not exist, -1 on error
+ */
+int pl_pipe_rcounter_set(str *pipeid, unsigned int nodeid, int counter)
+{
+	pl_pipe_t *it;
+	pl_rcounter_t *rc, *prc;
+
+	it = pl_pipe_get(pipeid, 1);
+	if(it == NULL) {
+		LM_DBG("no local pipe [%.*s]\n", pipeid->len, pipeid->s);
+		return 0;
+	}
+
+	prc = NULL;
+	for(rc = it->rcounters; rc != NULL; rc = rc->next) {
+		if(rc->nodeid == nodeid) {
+			break;
+		}
+		prc = rc;
+	}
+	if(counter <= 0) {
+		if(rc != NULL) {
+			if(prc == NULL) {
+				it->rcounters = rc->next;
+			} else {
+				prc->next = rc->next;
+			}
+			shm_free(rc);
+		}
+	} else {
+		if(rc == NULL) {
+			rc = (pl_rcounter_t *)shm_malloc(sizeof(pl_rcounter_t));
+			if(rc == NULL) {
+				pl_pipe_release(pipeid);
+				LM_ERR("no more shm\n");
+				return -1;
+			}
+			memset(rc, 0, sizeof(pl_rcounter_t));
+			rc->nodeid = nodeid;
+			rc->next = it->rcounters;
+			it->rcounters = rc;
+		}
+		rc->counter = counter;
+	}
+	pl_pipe_rcounter_sum(it);
+	pl_pipe_release(pipeid);
+
+	return 0;
+}
+
+/**
+ * discard the counters reported by a cluster node
+ */
+void pl_pipe_rcounter_reset(unsigned int nodeid)
+{
+	int i;
+	pl_pipe_t *it;
+	pl_rcounter_t *rc, *prc;
+
+	if(_pl_pipes_ht == NULL)
+		return;
+
+	for(i = 0; i < _pl_pipes_ht->htsize; i++) {
+		lock_get(&_pl_pipes_ht->slots[i].lock);
+		for(it = _pl_pipes_ht->slots[i].first; it != NULL; it = it->next) {
+			prc = NULL;
+			for(rc = it->rcounters; rc != NULL; rc = rc->next) {
+				if(rc->nodeid == nodeid) {
+					break;
+				}
+				prc = rc;
+			}
+			if(rc == NULL) {
+				continue;
+			}
+			if(prc == NULL) {
+				it->rcounters = rc->next;
+			} else {
+				prc->next = rc->next;
+			}
+			shm_free(rc);
+			pl_pipe_rcounter_sum(it);
+		}
+		lock_release(&_pl_pipes_ht->slots[i].lock);
+	}
+}
+
+/**
+ * monotonic time in microseconds for GCRA pipes
+ */
+static unsigned long long pl_gcra_now(void)
+{
+	struct timespec ts;
+
+	if(clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+		return 0;
+	}
+	return (unsigned long long)ts.tv_sec * 1000000ULL
+		   + (unsigned long long)ts.tv_nsec / 1000ULL;
+}
+
+/**
+ * GCRA (virtual scheduling) decision for a pipe - each accepted request
+ * moves the theoretical arrival time by interval/limit, a request is
+ * dropped if it comes earlier than allowed by the burst tolerance
+ * (the limit is per timer interval, not per second as in ratelimit)
+ * (expects the slot lock to be taken)
+ * \return	1 if allowed, -1 if drop needed
+ */
+int pl_pipe_gcra_check(pl_pipe_t *it, int interval, int burst)
+{
+	unsigned long long now;
+	unsigned long long tinc;
+	unsigned long long tat;
+	int limit;
+
+	/* in cluster mode, the other nodes consume from the limit */
+	limit = it->limit - it->rcounter;
+	if(limit <= 0 || interval <= 0) {
+		return -1;
+	}
+	tinc = ((unsigned long long)interval * 1000000ULL) / limit;
+	if(tinc == 0) {
+		tinc = 1;
+	}
+	if(burst <= 0) {
+		burst = limit;
+	}
+
+	now = pl_gcra_now();
+	tat = (it->tat > now) ? it->tat : now;
+	tat += tinc;
+	if(tat - now > (unsigned long long)burst * tinc) {
+		return -1;
 	}
+	it->tat = tat;
+	return 1;
 }
 
 extern int _pl_cfg_setpoint;
@@ -516,9 +707,10 @@ int rpc_pl_list_pipe(rpc_t *rpc, void *c, pl_pipe_t *it)
 		rpc->fault(c, 500, "Internal pipe structure");
 		return -1;
 	}
-	if(rpc->struct_add(th, "ssdddd", "name", it->name.s, "algorithm", algo.s,
+	if(rpc->struct_add(th, "ssddddd", "name", it->name.s, "algorithm", algo.s,
 			   "limit", it->limit, "counter", it->counter, "last_counter",
-			   it->last_counter, "unused_intervals", it->unused_intervals)
+			   it->last_counter, "unused_intervals", it->unused_intervals,
+			   "cluster_counter", it->rcounter)
 			< 0) {
 		rpc->fault(c, 500, "Internal error address list structure");
 		return -1;
@@ -622,8 +814,10 @@ void rpc_pl_reset_pipe(rpc_t *rpc, void *c)
 
 	it->counter = 0;
 	it->last_counter = 0;
+	it->accepted = 0;
 	it->load = 0;
 	it->unused_intervals = 0;
+	it->tat = 0;
 
 	pl_pipe_release(&pipeid);
 }
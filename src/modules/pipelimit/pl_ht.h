@@ -34,6 +34,14 @@
 
 #include "../../core/str.h"
 
+/* counter of a pipe reported by a cluster node */
+typedef struct _pl_rcounter
+{
+	unsigned int nodeid;
+	int counter;
+	struct _pl_rcounter *next;
+} pl_rcounter_t;
+
 typedef struct _pl_pipe
 {
 	unsigned int cellid;
@@ -48,6 +56,16 @@ typedef struct _pl_pipe
 	int last_counter;
 	int load;
 	int unused_intervals;
+	unsigned long long tat; /* GCRA theoretical arrival time (usec) */
+
+	/* cluster mode - requests accepted in the interval, their average
+	 * over the intervals sent to the other nodes, and the sum of the
+	 * averages received from them */
+	int accepted;
+	int accepted_avg;
+	int rcounter;
+	int dmq_sent;
+	pl_rcounter_t *rcounters;
 
 	struct _pl_pipe *prev;
 	struct _pl_pipe *next;
@@ -74,6 +92,9 @@ int pl_pipe_add(str *pipeid, str *algorithm, int limit);
 int pl_print_pipes(void);
 int pl_pipe_check_feedback_setpoints(int *cfgsp);
 void pl_pipe_timer_update(int interval, int netload);
+int pl_pipe_gcra_check(pl_pipe_t *it, int interval, int burst);
+int pl_pipe_rcounter_set(str *pipeid, unsigned int nodeid, int counter);
+void pl_pipe_rcounter_reset(unsigned int nodeid);
 
 void rpl_pipe_lock(int slot);
 void rpl_pipe_release(int slot);
@@ -82,6 +103,10 @@ void rpl_pipe_release(int slot);
  * negative feedback according to the PID controller model
  *
  * <http://en.wikipedia.org/wiki/PID_controller>
+ *
+ * PIPE_ALGO_GCRA spaces the requests at limit/interval rate using the
+ * generic cell rate algorithm (virtual scheduling), deciding per request
+ * without waiting for the timer
  */
 enum
 {
@@ -89,7 +114,8 @@ enum
 	PIPE_ALGO_RED,
 	PIPE_ALGO_TAILDROP,
 	PIPE_ALGO_FEEDBACK,
-	PIPE_ALGO_NETWORK
+	PIPE_ALGO_NETWORK,
+	PIPE_ALGO_GCRA
 };
 
 typedef struct str_map
@@ -32,4 +32,5 @@
 extern rpc_export_t pr_rpc[];
 
 int pr_db_load(void);
+int pr_reload(void);
 #endif
@@ -38,7 +38,8 @@
 
 
 static const char *rpc_dump_doc[2] = {"Dump the prefix route tree", NULL};
-static const char *rpc_reload_doc[2] = {"Reload prefix routes from DB", NULL};
+static const char *rpc_reload_doc[2] = {
+		"Reload prefix routes from DB or file", NULL};
 
 
 /**
@@ -74,14 +75,14 @@ static void rpc_dump(rpc_t *rpc, void *c)
 
 
 /**
- * RPC command - reload prefix tree from database
+ * RPC command - reload prefix tree from database or file
  */
 static void rpc_reload(rpc_t *rpc, void *c)
 {
-	LM_NOTICE("Reloading prefix route tree from DB\n");
+	LM_NOTICE("Reloading prefix route tree\n");
 
-	if(0 != pr_db_load()) {
-		LM_ERR("db load failed\n");
+	if(0 != pr_reload()) {
+		LM_ERR("reload failed\n");
 		rpc->fault(c, 400, "failed to reload prefix routes");
 	} else {
 		rpc->rpl_printf(c, "Prefix routes reloaded successfully");
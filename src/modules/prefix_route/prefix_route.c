@@ -60,6 +60,7 @@ MODULE_VERSION
 static char *db_url = DEFAULT_DB_URL;
 static char *db_table = "prefix_route";
 static int prefix_route_exit = 1;
+static char *prefix_route_file = NULL;
 
 static int add_route(
 		struct tree_item *root, const char *prefix, const char *route)
@@ -196,11 +197,33 @@ out:
 }
 
 
+/**
+ * Reload prefix rules from the file or from database
+ */
+int pr_reload(void)
+{
+	if(prefix_route_file != NULL)
+		return tree_mfile_reload();
+
+	return pr_db_load();
+}
+
+
 /**
  * Initialize module
  */
 static int mod_init(void)
 {
+	/* Serve prefixes from file, database is not used */
+	if(prefix_route_file != NULL && *prefix_route_file != '\0') {
+		if(0 != tree_mfile_init(prefix_route_file)) {
+			LM_CRIT("file load failed\n\n");
+			return -1;
+		}
+		return 0;
+	}
+	prefix_route_file = NULL;
+
 	/* Initialise tree */
 	if(0 != tree_init()) {
 		LM_CRIT("tree init failed\n\n");
@@ -339,6 +362,7 @@ static param_export_t params[] = {
 	{"db_url", PARAM_STRING, &db_url},
 	{"db_table", PARAM_STRING, &db_table},
 	{"exit", PARAM_INT, &prefix_route_exit},
+	{"file", PARAM_STRING, &prefix_route_file},
 	{0, 0, 0}
 };
 
@@ -388,6 +388,10 @@ int tree_route_get(const str *user)
 	struct tree *tree;
 	int route;
 
+	/* Prefix routes served from a file */
+	if(tree_mfile_enabled())
+		return tree_mfile_route_get(user);
+
 	/* Find match in tree */
 	tree = tree_ref();
 	if(NULL == tree) {
@@ -405,6 +409,11 @@ void tree_print(FILE *f)
 {
 	struct tree *tree;
 
+	if(tree_mfile_enabled()) {
+		tree_mfile_print(f);
+		return;
+	}
+
 	tree = tree_ref();
 
 	fprintf(f, "Prefix route tree:\n");
@@ -46,4 +46,11 @@ void tree_close(void);
 int tree_swap(struct tree_item *root);
 int tree_route_get(const str *user);
 void tree_print(FILE *f);
+
+
+int tree_mfile_init(const char *path);
+int tree_mfile_reload(void);
+int tree_mfile_enabled(void);
+int tree_mfile_route_get(const str *user);
+void tree_mfile_print(FILE *f);
 #endif
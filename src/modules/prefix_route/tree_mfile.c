@@ -0,0 +1,331 @@
+/*
+ * Prefix Route Module - prebuilt prefix file
+ *
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+/*! \file
+ * \brief Prefix Route Module - prebuilt prefix file
+ * \ingroup prefix_route
+ *
+ * The prefix routes are served from a file built with utils/mtbuild (string
+ * tree of digits, the value is the route name), mapped read-only in each
+ * process instead of the tree in shared memory. A reload checks the file
+ * and increments a version in shared memory, then each process maps it
+ * again at its next lookup.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include "../../core/dprint.h"
+#include "../../core/mem/mem.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/str.h"
+#include "../../core/route.h"
+#include "../mtree/mtree_mfile.h"
+#include "tree.h"
+
+
+#define TREE_MFILE_CHARS "0123456789"
+#define TREE_MFILE_DIGITS 10
+
+
+/** Defines the prefix file mapped in this process */
+struct tree_mfile
+{
+	char *path;			  /**< File name                      */
+	unsigned int version; /**< Version of the mapping         */
+	void *addr;			  /**< Mapping of the file            */
+	uint64_t size;		  /**< Size of the mapping            */
+	mt_mfile_view_t v;	  /**< Sections of the file           */
+	int *routes;		  /**< Route number of each value     */
+};
+
+
+/* Local variables */
+static struct tree_mfile pr_mfile;
+static unsigned int *shared_mfile_version = NULL;
+
+
+/**
+ * Map the file and resolve the route names of its values
+ */
+static int tree_mfile_map(const char *path, struct tree_mfile *mf)
+{
+	char *name;
+	uint32_t i, len;
+	int ret;
+
+	memset(mf, 0, sizeof(*mf));
+	ret = mt_mfile_mmap(path, &mf->addr, &mf->size);
+	if(ret == -1) {
+		LM_ERR("cannot map file [%s] (%d - %s)\n", path, errno,
+				strerror(errno));
+		return -1;
+	}
+	if(ret < 0) {
+		LM_ERR("invalid file [%s]\n", path);
+		return -1;
+	}
+	ret = mt_mfile_view_init(&mf->v, mf->addr, mf->size);
+	if(ret == -1) {
+		LM_ERR("file [%s] is not a supported tree file\n", path);
+		goto error;
+	}
+	if(ret < 0) {
+		LM_ERR("file [%s] has invalid size\n", path);
+		goto error;
+	}
+	if(mf->v.hdr->type != 0) {
+		LM_ERR("file [%s] has type %u - string tree (0) expected\n", path,
+				mf->v.hdr->type);
+		goto error;
+	}
+	if(mt_mfile_view_chars(&mf->v, TREE_MFILE_CHARS, TREE_MFILE_DIGITS) < 0) {
+		LM_ERR("file [%s] was not built for the char list %s\n", path,
+				TREE_MFILE_CHARS);
+		goto error;
+	}
+
+	/* route numbers are cached like in the tree, avoiding route_lookup()
+	 * in the prefix_route() routing function */
+	mf->routes = (int *)pkg_malloc((mf->v.hdr->nvalues + 1) * sizeof(int));
+	if(mf->routes == NULL) {
+		PKG_MEM_ERROR;
+		goto error;
+	}
+	for(i = 0; i < mf->v.hdr->nvalues; i++) {
+		mf->routes[i] = 0;
+		if(mf->v.values[i].nitems == 0
+				|| mf->v.values[i].item >= mf->v.hdr->nitems)
+			continue;
+		name = mf->v.strs + mf->v.items[mf->v.values[i].item].soff;
+		len = mf->v.items[mf->v.values[i].item].slen;
+		if((uint64_t)mf->v.items[mf->v.values[i].item].soff + len
+				>= mf->v.hdr->strsize) {
+			LM_ERR("file [%s] has invalid values\n", path);
+			goto error;
+		}
+		ret = route_lookup(&main_rt, name);
+		if(ret < 0) {
+			LM_CRIT("route name '%s' is not defined\n", name);
+			goto error;
+		}
+		if(ret == 0) {
+			LM_CRIT("route name '%s' is the main route\n", name);
+			goto error;
+		}
+		if(ret >= main_rt.entries) {
+			LM_CRIT("route %d > n_entries (%d)\n", ret, main_rt.entries);
+			goto error;
+		}
+		mf->routes[i] = ret;
+	}
+
+	mf->path = (char *)path;
+	return 0;
+
+error:
+	if(mf->routes != NULL)
+		pkg_free(mf->routes);
+	munmap(mf->addr, mf->size);
+	memset(mf, 0, sizeof(*mf));
+	return -1;
+}
+
+
+static void tree_mfile_unmap(struct tree_mfile *mf)
+{
+	if(mf->routes != NULL)
+		pkg_free(mf->routes);
+	if(mf->addr != NULL)
+		munmap(mf->addr, mf->size);
+	memset(mf, 0, sizeof(*mf));
+}
+
+
+/**
+ * Return the file mapped in this process, mapped again if it was reloaded
+ */
+static struct tree_mfile *tree_mfile_get(void)
+{
+	struct tree_mfile nmf;
+	unsigned int version;
+
+	if(NULL == shared_mfile_version)
+		return NULL;
+
+	version = *shared_mfile_version;
+	if(pr_mfile.version != version) {
+		/* Keep serving the previous mapping if the file is broken again */
+		pr_mfile.version = version;
+		if(0 == tree_mfile_map(pr_mfile.path, &nmf)) {
+			nmf.version = version;
+			tree_mfile_unmap(&pr_mfile);
+			memcpy(&pr_mfile, &nmf, sizeof(nmf));
+			LM_DBG("mapped file [%s] version %u\n", pr_mfile.path, version);
+		}
+	}
+
+	return (pr_mfile.addr != NULL) ? &pr_mfile : NULL;
+}
+
+
+/**
+ * Map the file in the main process, inherited by the children
+ */
+int tree_mfile_init(const char *path)
+{
+	shared_mfile_version = (unsigned int *)shm_malloc(sizeof(unsigned int));
+	if(NULL == shared_mfile_version) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	*shared_mfile_version = 1;
+
+	if(0 != tree_mfile_map(path, &pr_mfile)) {
+		shm_free(shared_mfile_version);
+		shared_mfile_version = NULL;
+		return -1;
+	}
+	pr_mfile.version = *shared_mfile_version;
+
+	LM_NOTICE("Prefix routes served from file %s (%u prefixes)\n", path,
+			pr_mfile.v.hdr->nvalues);
+
+	return 0;
+}
+
+
+/**
+ * Check the file and make the processes map it again
+ */
+int tree_mfile_reload(void)
+{
+	struct tree_mfile mf;
+
+	if(NULL == shared_mfile_version)
+		return -1;
+
+	if(0 != tree_mfile_map(pr_mfile.path, &mf))
+		return -1;
+	tree_mfile_unmap(&mf);
+
+	(*shared_mfile_version)++;
+
+	return 0;
+}
+
+
+int tree_mfile_enabled(void)
+{
+	return (NULL != shared_mfile_version);
+}
+
+
+/**
+ * Get route number from username, as tree_item_get() does in the tree
+ */
+int tree_mfile_route_get(const str *user)
+{
+	struct tree_mfile *mf;
+	const char *p, *pmax;
+	uint32_t s, t;
+	int route = 0;
+
+	mf = tree_mfile_get();
+	if(NULL == mf || NULL == user || NULL == user->s || !user->len)
+		return -1;
+
+	pmax = user->s + user->len;
+	s = 0;
+	for(p = user->s; p < pmax; p++) {
+		if(!isdigit(*p)) {
+			continue;
+		}
+
+		/* Update route with best match so far */
+		if(mf->v.cells[s].vidx > 0 && mf->v.cells[s].vidx <= mf->v.hdr->nvalues
+				&& mf->routes[mf->v.cells[s].vidx - 1] > 0) {
+			route = mf->routes[mf->v.cells[s].vidx - 1];
+		}
+
+		/* exist? */
+		t = mt_mfile_view_child(&mf->v, s, *p - '0');
+		if(MT_MFILE_CELL_NONE == t) {
+			break;
+		}
+
+		s = t;
+	}
+
+	return route;
+}
+
+
+/**
+ * Print the items of the file below cell s, as tree_item_print() does
+ */
+static void tree_mfile_item_print(
+		struct tree_mfile *mf, uint32_t s, FILE *f, int level)
+{
+	char *name;
+	uint32_t t, len;
+	int i;
+
+	name = mt_mfile_view_str(&mf->v, s, &len);
+	if(name != NULL) {
+		fprintf(f, " \t--> route[%.*s] ", (int)len, name);
+	}
+
+	for(i = 0; i < TREE_MFILE_DIGITS; i++) {
+		int j;
+
+		t = mt_mfile_view_child(&mf->v, s, i);
+		if(MT_MFILE_CELL_NONE == t) {
+			continue;
+		}
+
+		fputc('\n', f);
+		for(j = 0; j < level; j++)
+			fputc(' ', f);
+
+		fprintf(f, "%d ", i);
+		tree_mfile_item_print(mf, t, f, level + 1);
+	}
+}
+
+
+void tree_mfile_print(FILE *f)
+{
+	struct tree_mfile *mf;
+
+	mf = tree_mfile_get();
+
+	fprintf(f, "Prefix route file:\n");
+
+	if(mf) {
+		fprintf(f, " file: %s version: %u\n", mf->path, mf->version);
+		tree_mfile_item_print(mf, 0, f, 0);
+	} else {
+		fprintf(f, " (no file)\n");
+	}
+}
@@ -29,6 +29,7 @@
 #include <sys/types.h>
 #include <regex.h>
 #include <math.h>
+#include <time.h>
 
 
 #include "../../core/mem/mem.h"
@@ -39,6 +40,7 @@
 #include "../../core/timer_ticks.h"
 #include "../../core/ut.h"
 #include "../../core/locking.h"
+#include "../../core/atomic_ops.h"
 #include "../../core/mod_fix.h"
 #include "../../core/data_lump.h"
 #include "../../core/data_lump_rpl.h"
@@ -58,6 +60,13 @@ MODULE_VERSION
  */
 #define RL_TIMER_INTERVAL 10
 
+/*
+ * upper bound of GCRA burst tolerance in microseconds, keeps the
+ * theoretical arrival time comparable on platforms with 32bit long
+ */
+#define RL_GCRA_TAU_MAX 600000000L
+#define RL_GCRA_DIFF(a, b) ((long)((unsigned long)(a) - (unsigned long)(b)))
+
 #define RXLS(m, str, i) (int)((m)[i].rm_eo - (m)[i].rm_so), (str) + (m)[i].rm_so
 #define RXL(m, str, i) (int)((m)[i].rm_eo - (m)[i].rm_so)
 #define RXS(m, str, i) (str) + (m)[i].rm_so
@@ -75,6 +84,10 @@ static int str_map_int(const str_map_t *map, int key, str *ret);
  * negative feedback according to the PID controller model
  *
  * <http://en.wikipedia.org/wiki/PID_controller>
+ *
+ * PIPE_ALGO_GCRA spaces the requests at limit per second using the
+ * generic cell rate algorithm, deciding per request with a CAS on the
+ * theoretical arrival time, without taking rl_lock
  */
 enum
 {
@@ -82,7 +95,8 @@ enum
 	PIPE_ALGO_RED,
 	PIPE_ALGO_TAILDROP,
 	PIPE_ALGO_FEEDBACK,
-	PIPE_ALGO_NETWORK
+	PIPE_ALGO_NETWORK,
+	PIPE_ALGO_GCRA
 };
 
 str_map_t algo_names[] = {
@@ -91,6 +105,7 @@ str_map_t algo_names[] = {
 		{str_init("TAILDROP"), PIPE_ALGO_TAILDROP},
 		{str_init("FEEDBACK"), PIPE_ALGO_FEEDBACK},
 		{str_init("NETWORK"), PIPE_ALGO_NETWORK},
+		{str_init("GCRA"), PIPE_ALGO_GCRA},
 		{{0, 0}, 0},
 };
 
@@ -126,6 +141,7 @@ typedef struct pipe
 	int *counter;
 	int *last_counter;
 	int *load;
+	long *tat; /* GCRA theoretical arrival time (usec) */
 } pipe_t;
 
 typedef struct rl_queue
@@ -175,6 +191,8 @@ static str *rl_dbg_str = NULL;
 /* these only change in the mod_init() process -- no locking needed */
 static int timer_interval = RL_TIMER_INTERVAL;
 static int cfg_setpoint; /* desired load, used when reading modparams */
+static int rl_gcra_burst = 0; /* GCRA burst size, 0 - use the pipe limit */
+static unsigned long long rl_gcra_base = 0; /* GCRA time origin (usec) */
 /* === */
 
 #ifndef RL_DEBUG_LOCKS
@@ -202,6 +220,8 @@ static regex_t queue_params_regex;
 
 /** module functions */
 static int mod_init(void);
+static unsigned long long rl_gcra_clock(void);
+static long rl_gcra_now(void);
 static ticks_t rl_timer_handle(ticks_t, struct timer_ln *, void *);
 static int w_rl_check_default(struct sip_msg *, char *, char *);
 static int w_rl_check_forced(struct sip_msg *, char *, char *);
@@ -228,6 +248,7 @@ static param_export_t params[] = {
 	{"timer_interval", PARAM_INT, &timer_interval},
 	{"queue", PARAM_STRING | PARAM_USE_FUNC, (void *)add_queue_params},
 	{"pipe", PARAM_STRING | PARAM_USE_FUNC, (void *)add_pipe_params},
+	{"gcra_burst", PARAM_INT, &rl_gcra_burst},
 	/* RESERVED for future use
 	{"load_source",    PARAM_STRING|PARAM_USE_FUNC, (void *)set_load_source},
 	*/
@@ -536,6 +557,7 @@ static int mod_init(void)
 	*nqueues = nqueues_mp;
 	rl_dbg_str->s = NULL;
 	rl_dbg_str->len = 0;
+	rl_gcra_base = rl_gcra_clock();
 
 	for(i = 0; i < MAX_PIPES; i++) {
 		pipes[i].algo = shm_malloc(sizeof(int));
@@ -563,11 +585,17 @@ static int mod_init(void)
 			LM_ERR("oom for pipes[%d].last_counter\n", i);
 			return -1;
 		}
+		pipes[i].tat = shm_malloc(sizeof(long));
+		if(pipes[i].tat == NULL) {
+			LM_ERR("oom for pipes[%d].tat\n", i);
+			return -1;
+		}
 		*pipes[i].algo = pipes[i].algo_mp;
 		*pipes[i].limit = pipes[i].limit_mp;
 		*pipes[i].load = 0;
 		*pipes[i].counter = 0;
 		*pipes[i].last_counter = 0;
+		*pipes[i].tat = 0;
 	}
 
 	for(i = 0; i < *nqueues; i++) {
@@ -744,6 +772,70 @@ int hash[100] = {18, 50, 51, 39, 49, 68, 8, 78, 61, 75, 53, 32, 45, 77, 31, 12,
 		71, 23, 2, 67, 36, 65, 27, 1, 19, 59, 89, 48};
 
 
+/**
+ * monotonic time in microseconds
+ */
+static unsigned long long rl_gcra_clock(void)
+{
+	struct timespec ts;
+
+	if(clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+		return 0;
+	}
+	return (unsigned long long)ts.tv_sec * 1000000ULL
+		   + (unsigned long long)ts.tv_nsec / 1000ULL;
+}
+
+/**
+ * microseconds since module initialization, it wraps around on platforms
+ * with 32bit long (compare the values with RL_GCRA_DIFF())
+ */
+static long rl_gcra_now(void)
+{
+	return (long)(unsigned long)(rl_gcra_clock() - rl_gcra_base);
+}
+
+/**
+ * GCRA (virtual scheduling) decision for a pipe - each accepted request
+ * moves the theoretical arrival time by 1/limit seconds, a request is
+ * dropped if it comes earlier than allowed by the burst tolerance
+ * (does not need rl_lock, the tat is updated with compare-and-swap)
+ * \return	-1 if drop needed, 1 if allowed
+ */
+static int rl_gcra_push(int id)
+{
+	long now, tat, ntat, tinc, tau;
+	long long v;
+	int limit;
+
+	atomic_inc_int(pipes[id].counter);
+
+	limit = *pipes[id].limit;
+	if(limit <= 0) {
+		return -1;
+	}
+	/* limit is per second, as for TAILDROP (limit * timer_interval per
+	 * timer interval) */
+	tinc = 1000000L / limit;
+	if(tinc == 0) {
+		tinc = 1;
+	}
+	v = (long long)((rl_gcra_burst > 0) ? rl_gcra_burst : limit) * tinc;
+	tau = (v > RL_GCRA_TAU_MAX) ? RL_GCRA_TAU_MAX : (long)v;
+
+	now = rl_gcra_now();
+	do {
+		tat = atomic_get_long(pipes[id].tat);
+		ntat = (RL_GCRA_DIFF(tat, now) > 0) ? tat : now;
+		ntat = (long)((unsigned long)ntat + (unsigned long)tinc);
+		if(RL_GCRA_DIFF(ntat, now) > tau) {
+			return -1;
+		}
+	} while(atomic_cmpxchg_long(pipes[id].tat, tat, ntat) != tat);
+
+	return 1;
+}
+
 /**
  * runs the pipe's algorithm
  * (expects rl_lock to be taken), TODO revert to "return" instead of "ret ="
@@ -814,6 +906,14 @@ static int rl_check(struct sip_msg *msg, int forced_pipe)
 		return -1;
 	}
 
+	if(forced_pipe >= 0 && *pipes[forced_pipe].algo == PIPE_ALGO_GCRA) {
+		/* lock-free fast path */
+		que_id = 0;
+		pipe_id = forced_pipe;
+		ret = rl_gcra_push(pipe_id);
+		goto done;
+	}
+
 	LOCK_GET(rl_lock);
 	if(forced_pipe < 0) {
 		if(find_queue(msg, &method, &que_id)) {
@@ -827,10 +927,17 @@ static int rl_check(struct sip_msg *msg, int forced_pipe)
 		pipe_id = forced_pipe;
 	}
 
+	if(*pipes[pipe_id].algo == PIPE_ALGO_GCRA) {
+		LOCK_RELEASE(rl_lock);
+		ret = rl_gcra_push(pipe_id);
+		goto done;
+	}
+
 	ret = pipe_push(msg, pipe_id);
 out_release:
 	LOCK_RELEASE(rl_lock);
 
+done:
 	/* no locks here because it's only read and pipes[pipe_id] is always alloc'ed */
 	LM_DBG("meth=%.*s queue=%d pipe=%d algo=%d limit=%d pkg_load=%d counter=%d "
 		   "load=%2.1lf network_load=%d => %s\n",
@@ -1058,6 +1165,7 @@ static ticks_t rl_timer_handle(ticks_t ticks, struct timer_ln *tl, void *data)
 {
 	int i, len;
 	char *c, *p;
+	long now, tat;
 
 	LOCK_GET(rl_lock);
 	switch(*load_source) {
@@ -1084,7 +1192,16 @@ static ticks_t rl_timer_handle(ticks_t ticks, struct timer_ln *tl, void *data)
 		LM_WARN("%.*s\n", rl_dbg_str->len, rl_dbg_str->s);
 	}
 
+	now = rl_gcra_now();
 	for(i = 0; i < MAX_PIPES; i++) {
+		if(*pipes[i].algo == PIPE_ALGO_GCRA) {
+			/* move idle theoretical arrival time forward to keep it in the
+			 * comparable range of the clock */
+			tat = atomic_get_long(pipes[i].tat);
+			if(RL_GCRA_DIFF(now, tat) > 0) {
+				atomic_cmpxchg_long(pipes[i].tat, tat, now);
+			}
+		}
 		if(*pipes[i].algo == PIPE_ALGO_NETWORK) {
 			*pipes[i].load = (*network_load_value > *pipes[i].limit) ? 1 : -1;
 		} else if(*pipes[i].limit && timer_interval) {
@@ -39,6 +39,7 @@
 #include "../../core/dprint.h"
 #include "../../core/ip_addr.h"
 #include "../../core/socket_info.h"
+#include "../../core/sr_module.h"
 #include "udomain.h" /* new_udomain, free_udomain */
 #include "usrloc.h"
 #include "utime.h"
@@ -570,8 +571,10 @@ static inline int get_all_mem_ucontacts(void *buf, int len, unsigned int flags,
 							if(c->last_keepalive + ul_keepalive_timeout
 									< tnow) {
 								/* set contact as expired in 10s */
-								if(c->expires > tnow + 10)
+								if(c->expires > tnow + 10) {
 									c->expires = tnow + 10;
+									slot_mark_ucontact(&p->d->table[i], c);
+								}
 								continue;
 							}
 						}
@@ -946,7 +949,9 @@ unsigned long get_number_of_users(void)
  */
 int synchronize_all_udomains(int istart, int istep)
 {
+	static unsigned int sweep_runs = 0;
 	int res = 0;
+	int smode = UL_SWEEP_ALL;
 	dlist_t *ptr;
 
 	ul_get_act_time(); /* Get and save actual time */
@@ -961,8 +966,20 @@ int synchronize_all_udomains(int istart, int istep)
 			ul_ka_db_records((unsigned int)istart);
 		}
 	} else {
+		/* visit only the slots with changed or expiring contacts, doing
+		 * a full sweep every dirty_sweep runs and on shutdown */
+		if(ul_db_mode == WRITE_BACK && ul_dirty_sweep > 0
+				&& ul_ka_mode == ULKA_NONE && ul_handle_lost_tcp == 0) {
+			sweep_runs++;
+			if(destroy_modules_phase() == 0
+					&& (sweep_runs % (unsigned int)ul_dirty_sweep) != 0) {
+				smode = UL_SWEEP_DIRTY;
+			} else {
+				smode = UL_SWEEP_TRACK;
+			}
+		}
 		for(ptr = _ksr_ul_root; ptr; ptr = ptr->next) {
-			mem_timer_udomain(ptr->d, istart, istep);
+			mem_timer_udomain(ptr->d, istart, istep, smode);
 		}
 	}
 
@@ -28,6 +28,10 @@
  */
 
 
+#include <string.h>
+
+#include "../../core/mem/shm_mem.h"
+
 #include "hslot.h"
 
 /*!
@@ -42,6 +46,10 @@ int init_slot(struct udomain *_d, hslot_t *_s, int n)
 	_s->first = 0;
 	_s->last = 0;
 	_s->d = _d;
+	_s->loaded = 1;
+	_s->deleted = 0;
+	_s->dirty = 0;
+	_s->next_expires = 0;
 	if(rec_lock_init(&_s->rlock) == NULL) {
 		LM_ERR("failed to initialize the slock (%d)\n", n);
 		return -1;
@@ -64,6 +72,7 @@ void deinit_slot(hslot_t *_s)
 		_s->first = _s->first->next;
 		free_urecord(ptr);
 	}
+	slot_free_deleted(_s);
 	rec_lock_destroy(&_s->rlock);
 
 	_s->n = 0;
@@ -72,6 +81,70 @@ void deinit_slot(hslot_t *_s)
 }
 
 
+/*!
+ * \brief Remember the ruid of a contact deleted while the slot is not loaded
+ *
+ * The preload processes skip the rows with this ruid, which were read from
+ * database before the contact was deleted. Slot must be locked.
+ * \param _s hash slot
+ * \param _ruid ruid of deleted contact
+ * \return 0 on success, -1 on failure
+ */
+int slot_add_deleted(hslot_t *_s, str *_ruid)
+{
+	hslot_ruid_t *d;
+
+	if(_ruid->len <= 0)
+		return 0;
+	d = (hslot_ruid_t *)shm_malloc(sizeof(hslot_ruid_t) + _ruid->len);
+	if(d == NULL) {
+		SHM_MEM_ERROR;
+		return -1;
+	}
+	d->ruid.s = (char *)(d + 1);
+	memcpy(d->ruid.s, _ruid->s, _ruid->len);
+	d->ruid.len = _ruid->len;
+	d->next = _s->deleted;
+	_s->deleted = d;
+	return 0;
+}
+
+
+/*!
+ * \brief Check if the contact with the ruid was deleted while not loaded
+ * \param _s hash slot
+ * \param _ruid ruid of contact
+ * \return 1 if deleted, 0 if not
+ */
+int slot_is_deleted(hslot_t *_s, str *_ruid)
+{
+	hslot_ruid_t *d;
+
+	for(d = _s->deleted; d != NULL; d = d->next) {
+		if(d->ruid.len == _ruid->len
+				&& memcmp(d->ruid.s, _ruid->s, _ruid->len) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+
+/*!
+ * \brief Forget the contacts deleted while the slot was not loaded
+ * \param _s hash slot
+ */
+void slot_free_deleted(hslot_t *_s)
+{
+	hslot_ruid_t *d;
+
+	while(_s->deleted) {
+		d = _s->deleted;
+		_s->deleted = d->next;
+		shm_free(d);
+	}
+}
+
+
 /*!
  * \brief Add an element to a slot's linked list
  * \param _s hash slot
@@ -114,3 +187,26 @@ void slot_rem(hslot_t *_s, struct urecord *_r)
 	_r->slot = 0;
 	_s->n--;
 }
+
+
+/*!
+ * \brief Update dirty flag and next expire time of the slot for a contact
+ *
+ * Used by the write-back timer to skip the slots that have neither
+ * contacts to flush to database nor contacts to expire.
+ * \param _s hash slot
+ * \param _c new or updated contact
+ */
+void slot_mark_ucontact(hslot_t *_s, struct ucontact *_c)
+{
+	if(_s == NULL || _c == NULL) {
+		return;
+	}
+	if(_c->state != CS_SYNC) {
+		_s->dirty = 1;
+	}
+	if(_c->expires != 0
+			&& (_s->next_expires == 0 || _c->expires < _s->next_expires)) {
+		_s->next_expires = _c->expires;
+	}
+}
@@ -29,6 +29,8 @@
 #ifndef HSLOT_H
 #define HSLOT_H
 
+#include <time.h>
+
 #include "../../core/locking.h"
 
 #include "udomain.h"
@@ -37,7 +39,15 @@
 
 struct udomain;
 struct urecord;
+struct ucontact;
+
 
+/*! \brief ruid of a contact deleted while the slot was not loaded */
+typedef struct hslot_ruid
+{
+	struct hslot_ruid *next;
+	str ruid;
+} hslot_ruid_t;
 
 typedef struct hslot
 {
@@ -46,6 +56,10 @@ typedef struct hslot
 	struct urecord *last;  /*!< Last element in the list */
 	struct udomain *d;	   /*!< Domain we belong to */
 	rec_lock_t rlock;	   /*!< Recursive lock for hash entry */
+	volatile int loaded;   /*!< Records were loaded from database */
+	hslot_ruid_t *deleted; /*!< Contacts deleted while not loaded */
+	volatile int dirty;	   /*!< Slot has contacts not flushed to database */
+	volatile time_t next_expires; /*!< Earliest contact expire time in slot */
 } hslot_t;
 
 /*! \brief
@@ -60,6 +74,24 @@ int init_slot(struct udomain *_d, hslot_t *_s, int n);
 void deinit_slot(hslot_t *_s);
 
 
+/*! \brief
+ * Remember the ruid of a contact deleted while the slot is not loaded
+ */
+int slot_add_deleted(hslot_t *_s, str *_ruid);
+
+
+/*! \brief
+ * Check if the contact with the ruid was deleted while not loaded
+ */
+int slot_is_deleted(hslot_t *_s, str *_ruid);
+
+
+/*! \brief
+ * Forget the contacts deleted while the slot was not loaded
+ */
+void slot_free_deleted(hslot_t *_s);
+
+
 /*! \brief
  * Add an element to slot linked list
  */
@@ -71,4 +103,10 @@ void slot_add(hslot_t *_s, struct urecord *_r);
  */
 void slot_rem(hslot_t *_s, struct urecord *_r);
 
+
+/*! \brief
+ * Update dirty flag and next expire time of the slot for a contact
+ */
+void slot_mark_ucontact(hslot_t *_s, struct ucontact *_c);
+
 #endif /* HSLOT_H */
@@ -1761,6 +1761,9 @@ int update_ucontact(struct urecord *_r, ucontact_t *_c, ucontact_info_t *_ci)
 	}
 
 	st_update_ucontact(_c);
+	if(_r && ul_db_mode != DB_ONLY) {
+		slot_mark_ucontact(_r->slot, _c);
+	}
 
 	if(ul_db_mode == WRITE_THROUGH) {
 		if(update_contact_db(_c) < 0)
@@ -30,6 +30,7 @@
 
 #include "udomain.h"
 #include <string.h>
+#include <sys/time.h>
 #include "../../core/parser/parse_methods.h"
 #include "../../core/mem/shm_mem.h"
 #include "../../core/dprint.h"
@@ -475,57 +476,324 @@ int uldb_delete_tcp_records(db1_con_t *_c, udomain_t *_d)
 
 
 /*!
- * \brief Load all records from a udomain
+ * \brief Search a record in the cache of a domain
+ * \param _d domain to search the record
+ * \param _aor address of record
+ * \param _r new created record
+ * \return 0 if a record was found, 1 if nothing could be found
+ */
+static int get_urecord_cache(udomain_t *_d, str *_aor, struct urecord **_r)
+{
+	unsigned int sl, i, aorhash;
+	urecord_t *r;
+	ucontact_t *ptr = NULL;
+
+	aorhash = ul_get_aorhash(_aor);
+	sl = aorhash & (_d->size - 1);
+	r = _d->table[sl].first;
+
+	for(i = 0; r != NULL && i < _d->table[sl].n; i++) {
+		if((r->aorhash == aorhash) && (r->aor.len == _aor->len)
+				&& !memcmp(r->aor.s, _aor->s, _aor->len)) {
+			if(ul_handle_lost_tcp) {
+				for(ptr = r->contacts; ptr; ptr = ptr->next) {
+					if(ptr->expires == UL_EXPIRED_TIME) {
+						continue;
+					}
+					if(is_valid_tcpconn(ptr) && !is_tcp_alive(ptr)) {
+						ptr->expires = UL_EXPIRED_TIME;
+						slot_mark_ucontact(&_d->table[sl], ptr);
+						continue;
+					}
+				}
+			}
+			*_r = r;
+			return 0;
+		}
+
+		r = r->next;
+	}
+
+	return 1; /* Nothing found */
+}
+
+
+/*!
+ * \brief Add a location row loaded from database to the cache
  *
- * Load all records from a udomain, useful to populate the
- * memory cache on startup.
- * \param _c database connection
- * \param _d loaded domain
- * \return 0 on success, -1 on failure
+ * The row has to be in the layout of usrloc_columns. If the hash slot of
+ * the record is not loaded yet, contacts may have been added meanwhile by
+ * SIP workers or by a lookup fallback, the row being skipped in case its
+ * ruid is already in the record. The row is skipped as well if its contact
+ * was deleted or expired meanwhile, as the row can be read before that.
+ * \param _d domain
+ * \param row database row
+ * \return 1 if the contact was added, 0 if skipped, -1 on failure
  */
-int preload_udomain(db1_con_t *_c, udomain_t *_d)
+static int preload_udomain_row(udomain_t *_d, db_row_t *row)
 {
 	char uri[MAX_URI_SIZE];
 	ucontact_info_t *ci;
-	db_row_t *row;
-	db1_res_t *res = NULL;
-	db_key_t keys[1]; /* where */
-	db_val_t vals[1];
-	db_op_t ops[1];
 	str user, contact;
 	char *domain;
-	int i;
-	int n;
+	unsigned int sl;
 
 	urecord_t *r;
 	ucontact_t *c;
 
-	if(ul_db_clean_tcp != 0) {
-		uldb_delete_tcp_records(_c, _d);
+	user.s = (char *)VAL_STRING(ROW_VALUES(row) + USER_COL);
+	if(VAL_NULL(ROW_VALUES(row)) || user.s == 0 || user.s[0] == 0) {
+		LM_CRIT("empty username record in table %s...skipping\n", _d->name->s);
+		return 0;
+	}
+	user.len = strlen(user.s);
+
+	if(ul_use_domain) {
+		domain = (char *)VAL_STRING(ROW_VALUES(row) + DOMAIN_COL);
+		if(VAL_NULL(ROW_VALUES(row) + SRV_ID_COL) || domain == 0
+				|| domain[0] == 0) {
+			LM_CRIT("empty domain record for user %.*s...skipping\n", user.len,
+					user.s);
+			return 0;
+		}
+		/* user.s cannot be NULL - checked previosly */
+		user.len =
+				snprintf(uri, MAX_URI_SIZE, "%.*s@%s", user.len, user.s, domain);
+		user.s = uri;
+		if(user.s[user.len] != 0) {
+			LM_CRIT("URI '%.*s@%s' longer than %d\n", user.len, user.s, domain,
+					MAX_URI_SIZE);
+			return 0;
+		}
+	}
+
+	sl = ul_get_aorhash(&user) & (_d->size - 1);
+
+	ci = dbrow2info(ROW_VALUES(row), &contact, 0);
+	if(ci == 0) {
+		LM_ERR("skipping record for %.*s in table %s\n", user.len, user.s,
+				_d->name->s);
+		return 0;
+	}
+
+	lock_udomain(_d, &user);
+	if(_d->table[sl].loaded == 0
+			&& slot_is_deleted(&_d->table[sl], &ci->ruid)) {
+		/* deleted or expired after the row was read */
+		unlock_udomain(_d, &user);
+		return 0;
+	}
+	if(get_urecord_cache(_d, &user, &r) > 0) {
+		if(mem_insert_urecord(_d, &user, &r) < 0) {
+			LM_ERR("failed to create a record\n");
+			unlock_udomain(_d, &user);
+			return -1;
+		}
+	} else if(_d->table[sl].loaded == 0) {
+		for(c = r->contacts; c != NULL; c = c->next) {
+			if(c->ruid.len == ci->ruid.len
+					&& memcmp(c->ruid.s, ci->ruid.s, ci->ruid.len) == 0) {
+				unlock_udomain(_d, &user);
+				return 0;
+			}
+		}
+	}
+
+	if((c = mem_insert_ucontact(r, &contact, ci)) == 0) {
+		LM_ERR("inserting contact failed\n");
+		unlock_udomain(_d, &user);
+		return -1;
+	}
+
+	/* We have to do this, because insert_ucontact sets state to CS_NEW
+	 * and we have the contact in the database already */
+	c->state = CS_SYNC;
+	unlock_udomain(_d, &user);
+
+	return 1;
+}
+
+
+/*!
+ * \brief Mark the hash slots of a domain as not loaded from database
+ *
+ * Used when the records are loaded by preload processes while the SIP
+ * workers are running, the lookups in not loaded slots fall back to
+ * database.
+ * \param _d domain
+ */
+void udomain_preload_reset(udomain_t *_d)
+{
+	int i;
+
+	for(i = 0; i < _d->size; i++) {
+		_d->table[i].loaded = 0;
 	}
+}
+
+
+/*!
+ * \brief Mark the hash slots of a domain as loaded from database
+ * \param _d domain
+ */
+void udomain_preload_done(udomain_t *_d)
+{
+	int i;
+
+	for(i = 0; i < _d->size; i++) {
+		lock_ulslot(_d, i);
+		_d->table[i].loaded = 1;
+		slot_free_deleted(&_d->table[i]);
+		unlock_ulslot(_d, i);
+	}
+}
+
+
+/*!
+ * \brief Get the bounds of the id column of a udomain table
+ *
+ * Used to split the table in id ranges for the preload processes, the
+ * query is done with raw_query(), a driver without this capability
+ * makes the table being loaded by a single process.
+ * \param _c database connection
+ * \param _d domain
+ * \param idmin minimum id in the table
+ * \param idmax maximum id in the table, 0 if the table is empty
+ * \return 0 on success, 1 if not supported by database driver, -1 on failure
+ */
+int uldb_preload_id_bounds(db1_con_t *_c, udomain_t *_d, unsigned long *idmin,
+		unsigned long *idmax)
+{
+	char query[256];
+	str query_str;
+	db1_res_t *res = NULL;
+	db_val_t *v;
+	int i;
+
+	*idmin = 0;
+	*idmax = 0;
+
+	if(!DB_CAPABILITY(ul_dbf, DB_CAP_RAW_QUERY)) {
+		return 1;
+	}
+	if(2 * ul_id_col.len + _d->name->len + 32 > sizeof(query)) {
+		LM_ERR("too long query for table %.*s\n", _d->name->len, _d->name->s);
+		return -1;
+	}
+
+	query_str.len = snprintf(query, sizeof(query),
+			"SELECT MIN(%.*s), MAX(%.*s) FROM %.*s", ul_id_col.len,
+			ul_id_col.s, ul_id_col.len, ul_id_col.s, _d->name->len,
+			_d->name->s);
+	query_str.s = query;
+	if(ul_dbf.raw_query(_c, &query_str, &res) < 0 || res == NULL) {
+		LM_ERR("failed to query the id bounds of table %.*s\n",
+				_d->name->len, _d->name->s);
+		return -1;
+	}
+	if(RES_ROW_N(res) > 0 && ROW_N(RES_ROWS(res)) == 2) {
+		for(i = 0; i < 2; i++) {
+			v = ROW_VALUES(RES_ROWS(res)) + i;
+			if(VAL_NULL(v)) {
+				/* empty table */
+				*idmin = 0;
+				*idmax = 0;
+				break;
+			}
+			switch(VAL_TYPE(v)) {
+				case DB1_INT:
+					*((i == 0) ? idmin : idmax) = (unsigned long)VAL_INT(v);
+					break;
+				case DB1_UINT:
+					*((i == 0) ? idmin : idmax) = (unsigned long)VAL_UINT(v);
+					break;
+				case DB1_BIGINT:
+					*((i == 0) ? idmin : idmax) =
+							(unsigned long)VAL_BIGINT(v);
+					break;
+				case DB1_UBIGINT:
+					*((i == 0) ? idmin : idmax) =
+							(unsigned long)VAL_UBIGINT(v);
+					break;
+				default:
+					LM_ERR("unexpected type %d for id bounds of table %.*s\n",
+							VAL_TYPE(v), _d->name->len, _d->name->s);
+					ul_dbf.free_result(_c, res);
+					return -1;
+			}
+		}
+	}
+	ul_dbf.free_result(_c, res);
+
+	return 0;
+}
+
+
+/*!
+ * \brief Load a range of records from a udomain
+ *
+ * Load the records from a udomain that have the id in the range
+ * [idmin, idmax), the range being part of the query. The rows are
+ * streamed using fetch_result() when the database driver supports it.
+ * The hash slots are not marked as loaded, as the contacts of a record
+ * can be spread over the ranges of several preload processes.
+ * \param _c database connection
+ * \param _d loaded domain
+ * \param idmin first id to be loaded
+ * \param idmax id after the last one to be loaded, 0 to load all records
+ * \return 0 on success, -1 on failure
+ */
+int preload_udomain_range(db1_con_t *_c, udomain_t *_d, unsigned long idmin,
+		unsigned long idmax)
+{
+	db_row_t *row;
+	db1_res_t *res = NULL;
+	db_key_t keys[3]; /* where */
+	db_val_t vals[3];
+	db_op_t ops[3];
+	struct timeval tvb, tve;
+	unsigned long nrows;
+	unsigned long dms;
+	int nr_keys;
+	int i;
+	int n;
 
 	if(ul_dbf.use_table(_c, _d->name) < 0) {
 		LM_ERR("sql use_table failed\n");
 		return -1;
 	}
 
-#ifdef EXTRA_DEBUG
-	LM_NOTICE("load start time [%d]\n", (int)time(NULL));
-#endif
+	gettimeofday(&tvb, NULL);
 
+	nr_keys = 0;
 	if(ul_db_srvid) {
 		LM_NOTICE("filtered by server_id[%d]\n", server_id);
-		keys[0] = &ul_srv_id_col;
-		ops[0] = OP_EQ;
-		vals[0].type = DB1_INT;
-		vals[0].nul = 0;
-		vals[0].val.int_val = server_id;
+		keys[nr_keys] = &ul_srv_id_col;
+		ops[nr_keys] = OP_EQ;
+		vals[nr_keys].type = DB1_INT;
+		vals[nr_keys].nul = 0;
+		vals[nr_keys].val.int_val = server_id;
+		nr_keys++;
+	}
+	if(idmax > 0) {
+		keys[nr_keys] = &ul_id_col;
+		ops[nr_keys] = OP_GEQ;
+		vals[nr_keys].type = DB1_BIGINT;
+		vals[nr_keys].nul = 0;
+		vals[nr_keys].val.ll_val = (long long)idmin;
+		nr_keys++;
+		keys[nr_keys] = &ul_id_col;
+		ops[nr_keys] = OP_LT;
+		vals[nr_keys].type = DB1_BIGINT;
+		vals[nr_keys].nul = 0;
+		vals[nr_keys].val.ll_val = (long long)idmax;
+		nr_keys++;
 	}
 
 	if(DB_CAPABILITY(ul_dbf, DB_CAP_FETCH)) {
-		if(ul_dbf.query(_c, (ul_db_srvid) ? (keys) : (0),
-				   (ul_db_srvid) ? (ops) : (0), (ul_db_srvid) ? (vals) : (0),
-				   usrloc_columns, (ul_db_srvid) ? (1) : (0),
+		if(ul_dbf.query(_c, (nr_keys > 0) ? (keys) : (0),
+				   (nr_keys > 0) ? (ops) : (0), (nr_keys > 0) ? (vals) : (0),
+				   usrloc_columns, nr_keys,
 				   (ul_use_domain) ? (NUM_COLS) : (NUM_COLS - 1), 0, 0)
 				< 0) {
 			LM_ERR("db_query (1) failed\n");
@@ -536,9 +804,9 @@ int preload_udomain(db1_con_t *_c, udomain_t *_d)
 			return -1;
 		}
 	} else {
-		if(ul_dbf.query(_c, (ul_db_srvid) ? (keys) : (0),
-				   (ul_db_srvid) ? (ops) : (0), (ul_db_srvid) ? (vals) : (0),
-				   usrloc_columns, (ul_db_srvid) ? (1) : (0),
+		if(ul_dbf.query(_c, (nr_keys > 0) ? (keys) : (0),
+				   (nr_keys > 0) ? (ops) : (0), (nr_keys > 0) ? (vals) : (0),
+				   usrloc_columns, nr_keys,
 				   (ul_use_domain) ? (NUM_COLS) : (NUM_COLS - 1), 0, &res)
 				< 0) {
 			LM_ERR("db_query failed\n");
@@ -554,64 +822,19 @@ int preload_udomain(db1_con_t *_c, udomain_t *_d)
 
 
 	n = 0;
+	nrows = 0;
 	do {
 		LM_DBG("loading records - cycle [%d]\n", ++n);
 		for(i = 0; i < RES_ROW_N(res); i++) {
 			row = RES_ROWS(res) + i;
-
-			user.s = (char *)VAL_STRING(ROW_VALUES(row) + USER_COL);
-			if(VAL_NULL(ROW_VALUES(row)) || user.s == 0 || user.s[0] == 0) {
-				LM_CRIT("empty username record in table %s...skipping\n",
-						_d->name->s);
-				continue;
+			switch(preload_udomain_row(_d, row)) {
+				case -1:
+					ul_dbf.free_result(_c, res);
+					return -1;
+				case 1:
+					nrows++;
+					break;
 			}
-			user.len = strlen(user.s);
-
-			ci = dbrow2info(ROW_VALUES(row), &contact, 0);
-			if(ci == 0) {
-				LM_ERR("skipping record for %.*s in table %s\n", user.len,
-						user.s, _d->name->s);
-				continue;
-			}
-
-			if(ul_use_domain) {
-				domain = (char *)VAL_STRING(ROW_VALUES(row) + DOMAIN_COL);
-				if(VAL_NULL(ROW_VALUES(row) + SRV_ID_COL) || domain == 0
-						|| domain[0] == 0) {
-					LM_CRIT("empty domain record for user %.*s...skipping\n",
-							user.len, user.s);
-					continue;
-				}
-				/* user.s cannot be NULL - checked previosly */
-				user.len = snprintf(
-						uri, MAX_URI_SIZE, "%.*s@%s", user.len, user.s, domain);
-				user.s = uri;
-				if(user.s[user.len] != 0) {
-					LM_CRIT("URI '%.*s@%s' longer than %d\n", user.len, user.s,
-							domain, MAX_URI_SIZE);
-					continue;
-				}
-			}
-
-			lock_udomain(_d, &user);
-			if(get_urecord(_d, &user, &r) > 0) {
-				if(mem_insert_urecord(_d, &user, &r) < 0) {
-					LM_ERR("failed to create a record\n");
-					unlock_udomain(_d, &user);
-					goto error;
-				}
-			}
-
-			if((c = mem_insert_ucontact(r, &contact, ci)) == 0) {
-				LM_ERR("inserting contact failed\n");
-				unlock_udomain(_d, &user);
-				goto error1;
-			}
-
-			/* We have to do this, because insert_ucontact sets state to CS_NEW
-			 * and we have the contact in the database already */
-			c->state = CS_SYNC;
-			unlock_udomain(_d, &user);
 		}
 
 		if(DB_CAPABILITY(ul_dbf, DB_CAP_FETCH)) {
@@ -627,16 +850,101 @@ int preload_udomain(db1_con_t *_c, udomain_t *_d)
 
 	ul_dbf.free_result(_c, res);
 
-#ifdef EXTRA_DEBUG
-	LM_NOTICE("load end time [%d]\n", (int)time(NULL));
-#endif
+	gettimeofday(&tve, NULL);
+	dms = (tve.tv_sec - tvb.tv_sec) * 1000 + (tve.tv_usec - tvb.tv_usec) / 1000;
+	LM_INFO("loaded %lu contacts in table %.*s (ids %lu-%lu) in %lu ms "
+			"(%lu rows/sec)\n",
+			nrows, _d->name->len, _d->name->s, idmin, idmax, dms,
+			(dms > 0) ? (nrows * 1000 / dms) : nrows);
 
 	return 0;
-error1:
-	free_ucontact(c);
-error:
+}
+
+
+/*!
+ * \brief Load all records from a udomain
+ *
+ * Load all records from a udomain, useful to populate the
+ * memory cache on startup.
+ * \param _c database connection
+ * \param _d loaded domain
+ * \return 0 on success, -1 on failure
+ */
+int preload_udomain(db1_con_t *_c, udomain_t *_d)
+{
+	if(ul_db_clean_tcp != 0) {
+		uldb_delete_tcp_records(_c, _d);
+	}
+
+	if(preload_udomain_range(_c, _d, 0, 0) < 0) {
+		return -1;
+	}
+	udomain_preload_done(_d);
+
+	return 0;
+}
+
+
+/*!
+ * \brief Loads from DB all contacts for an AOR into the cache
+ *
+ * Used for lookups in the hash slots not loaded yet by preload processes.
+ * \param _c database connection
+ * \param _d domain
+ * \param _aor address of record
+ * \param _r store pointer to location record
+ * \return 0 if a record was loaded, 1 if nothing was found
+ */
+static int db_load_urecord_cache(
+		db1_con_t *_c, udomain_t *_d, str *_aor, urecord_t **_r)
+{
+	db_key_t keys[2];
+	db_val_t vals[2];
+	db1_res_t *res = NULL;
+	char *domain;
+	int i;
+
+	keys[0] = &ul_user_col;
+	vals[0].type = DB1_STR;
+	vals[0].nul = 0;
+	if(ul_use_domain) {
+		keys[1] = &ul_domain_col;
+		vals[1].type = DB1_STR;
+		vals[1].nul = 0;
+		domain = memchr(_aor->s, '@', _aor->len);
+		vals[0].val.str_val.s = _aor->s;
+		if(domain == 0) {
+			vals[0].val.str_val.len = 0;
+			vals[1].val.str_val = *_aor;
+		} else {
+			vals[0].val.str_val.len = domain - _aor->s;
+			vals[1].val.str_val.s = domain + 1;
+			vals[1].val.str_val.len = _aor->s + _aor->len - domain - 1;
+		}
+	} else {
+		vals[0].val.str_val = *_aor;
+	}
+
+	if(ul_dbf.use_table(_c, _d->name) < 0) {
+		LM_ERR("failed to use table %.*s\n", _d->name->len, _d->name->s);
+		return 1;
+	}
+
+	if(ul_dbf.query(_c, keys, 0, vals, usrloc_columns, (ul_use_domain) ? 2 : 1,
+			   (ul_use_domain) ? (NUM_COLS) : (NUM_COLS - 1), 0, &res)
+			< 0) {
+		LM_ERR("db_query failed\n");
+		return 1;
+	}
+
+	for(i = 0; i < RES_ROW_N(res); i++) {
+		if(preload_udomain_row(_d, RES_ROWS(res) + i) < 0) {
+			break;
+		}
+	}
 	ul_dbf.free_result(_c, res);
-	return -1;
+
+	return get_urecord_cache(_d, _aor, _r);
 }
 
 
@@ -1264,16 +1572,31 @@ void mem_delete_urecord(udomain_t *_d, struct urecord *_r)
  * \param istart start of run
  * \param istep loop steps
  */
-void mem_timer_udomain(udomain_t *_d, int istart, int istep)
+void mem_timer_udomain(udomain_t *_d, int istart, int istep, int smode)
 {
 	struct urecord *ptr, *t;
+	ucontact_t *c;
+	hslot_t *s;
 	int i;
 
 	for(i = istart; i < _d->size; i += istep) {
+		s = &_d->table[i];
+		if(smode == UL_SWEEP_DIRTY && s->dirty == 0
+				&& (s->next_expires == 0 || s->next_expires > ul_act_time)) {
+			/* nothing to flush or to expire - a change done meanwhile
+			 * is caught on next run */
+			continue;
+		}
+
 		if(likely(destroy_modules_phase() == 0))
 			lock_ulslot(_d, i);
 
-		ptr = _d->table[i].first;
+		if(smode != UL_SWEEP_ALL) {
+			s->dirty = 0;
+			s->next_expires = 0;
+		}
+
+		ptr = s->first;
 
 		while(ptr) {
 			timer_urecord(ptr);
@@ -1284,9 +1607,17 @@ void mem_timer_udomain(udomain_t *_d, int istart, int istep)
 				mem_delete_urecord(_d, t);
 			} else {
 				ul_ka_urecord(ptr);
+				if(smode != UL_SWEEP_ALL) {
+					for(c = ptr->contacts; c != NULL; c = c->next) {
+						slot_mark_ucontact(s, c);
+					}
+				}
 				ptr = ptr->next;
 			}
 		}
+		/* commit the db writes of the slot while still holding the lock */
+		ul_wb_batch_flush();
+
 		if(likely(destroy_modules_phase() == 0))
 			unlock_ulslot(_d, i);
 	}
@@ -1377,35 +1708,18 @@ int insert_urecord(udomain_t *_d, str *_aor, struct urecord **_r)
  */
 int get_urecord(udomain_t *_d, str *_aor, struct urecord **_r)
 {
-	unsigned int sl, i, aorhash;
+	unsigned int sl;
 	urecord_t *r;
-	ucontact_t *ptr = NULL;
 
 	if(ul_db_mode != DB_ONLY) {
 		/* search in cache */
-		aorhash = ul_get_aorhash(_aor);
-		sl = aorhash & (_d->size - 1);
-		r = _d->table[sl].first;
-
-		for(i = 0; r != NULL && i < _d->table[sl].n; i++) {
-			if((r->aorhash == aorhash) && (r->aor.len == _aor->len)
-					&& !memcmp(r->aor.s, _aor->s, _aor->len)) {
-				if(ul_handle_lost_tcp) {
-					for(ptr = r->contacts; ptr; ptr = ptr->next) {
-						if(ptr->expires == UL_EXPIRED_TIME) {
-							continue;
-						}
-						if(is_valid_tcpconn(ptr) && !is_tcp_alive(ptr)) {
-							ptr->expires = UL_EXPIRED_TIME;
-							continue;
-						}
-					}
-				}
-				*_r = r;
-				return 0;
-			}
-
-			r = r->next;
+		if(get_urecord_cache(_d, _aor, _r) == 0) {
+			return 0;
+		}
+		sl = ul_get_aorhash(_aor) & (_d->size - 1);
+		if(_d->table[sl].loaded == 0 && ul_dbh != NULL) {
+			/* slot not loaded yet by preload processes - search in DB */
+			return db_load_urecord_cache(ul_dbh, _d, _aor, _r);
 		}
 	} else {
 		/* search in DB */
@@ -94,6 +94,56 @@ void print_udomain(FILE *_f, udomain_t *_d);
 int preload_udomain(db1_con_t *_c, udomain_t *_d);
 
 
+/*!
+ * \brief Load a range of records from a udomain
+ *
+ * Load the records from a udomain that have the id in the range
+ * [idmin, idmax), the hash slots are not marked as loaded.
+ * \param _c database connection
+ * \param _d loaded domain
+ * \param idmin first id to be loaded
+ * \param idmax id after the last one to be loaded, 0 to load all records
+ * \return 0 on success, -1 on failure
+ */
+int preload_udomain_range(db1_con_t *_c, udomain_t *_d, unsigned long idmin,
+		unsigned long idmax);
+
+
+/*!
+ * \brief Delete all location records with tcp connection
+ * \param _c database connection
+ * \param _d loaded domain
+ * \return 0 on success, -1 on failure
+ */
+int uldb_delete_tcp_records(db1_con_t *_c, udomain_t *_d);
+
+
+/*!
+ * \brief Get the bounds of the id column of a udomain table
+ * \param _c database connection
+ * \param _d domain
+ * \param idmin minimum id in the table
+ * \param idmax maximum id in the table, 0 if the table is empty
+ * \return 0 on success, 1 if not supported by database driver, -1 on failure
+ */
+int uldb_preload_id_bounds(db1_con_t *_c, udomain_t *_d, unsigned long *idmin,
+		unsigned long *idmax);
+
+
+/*!
+ * \brief Mark the hash slots of a domain as not loaded from database
+ * \param _d domain
+ */
+void udomain_preload_reset(udomain_t *_d);
+
+
+/*!
+ * \brief Mark the hash slots of a domain as loaded from database
+ * \param _d domain
+ */
+void udomain_preload_done(udomain_t *_d);
+
+
 /*!
  * \brief performs a dummy query just to see if DB is ok
  * \param con database connection
@@ -110,13 +160,19 @@ int testdb_udomain(db1_con_t *con, udomain_t *d);
 int db_timer_udomain(udomain_t *_d);
 
 
+/*! sweep modes of mem_timer_udomain() */
+#define UL_SWEEP_ALL 0	 /*!< process all slots, no dirty tracking */
+#define UL_SWEEP_TRACK 1 /*!< process all slots, rebuild dirty tracking */
+#define UL_SWEEP_DIRTY 2 /*!< process only dirty or expiring slots */
+
 /*!
  * \brief Run timer handler for given domain
  * \param _d domain
  * \param istart index of hash table slot to start processing
  * \param istep step through hash table slots to process
+ * \param smode sweep mode (UL_SWEEP_*)
  */
-void mem_timer_udomain(udomain_t *_d, int istart, int istep);
+void mem_timer_udomain(udomain_t *_d, int istart, int istep, int smode);
 
 
 /*!
@@ -163,6 +163,7 @@ int ul_ka_urecord(urecord_t *ur)
 						uc->c.len, uc->c.s);
 				if(uc->expires > tnow + 10) {
 					uc->expires = tnow + 10;
+					slot_mark_ucontact(ur->slot, uc);
 					continue;
 				}
 			}
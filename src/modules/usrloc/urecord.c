@@ -31,6 +31,7 @@
 
 #include "urecord.h"
 #include <string.h>
+#include "../../core/mem/mem.h"
 #include "../../core/mem/shm_mem.h"
 #include "../../core/dprint.h"
 #include "../../core/ut.h"
@@ -181,6 +182,7 @@ ucontact_t *mem_insert_ucontact(urecord_t *_r, str *_c, ucontact_info_t *_ci)
 	} else {
 		_r->contacts = c;
 	}
+	slot_mark_ucontact(_r->slot, c);
 
 	return c;
 }
@@ -214,6 +216,10 @@ void mem_remove_ucontact(urecord_t *_r, ucontact_t *_c)
  */
 void mem_delete_ucontact(urecord_t *_r, ucontact_t *_c)
 {
+	if(_r->slot != NULL && _r->slot->loaded == 0) {
+		/* not to be loaded again by the preload processes */
+		slot_add_deleted(_r->slot, &_c->ruid);
+	}
 	mem_remove_ucontact(_r, _c);
 	if_update_stat(_r->slot, _r->slot->d->contacts, -1);
 	free_ucontact(_c);
@@ -364,6 +370,111 @@ static inline void wt_timer(urecord_t *_r)
 	}
 }
 
+/*! \brief contact flushed by the timer in the current db transaction */
+typedef struct ul_wb_batch_item
+{
+	urecord_t *r;	/*!< record of the contact */
+	ucontact_t *c;	/*!< flushed contact */
+	cstate_t state; /*!< state of contact before flushing */
+	int del;		/*!< expired contact deleted from db */
+} ul_wb_batch_item_t;
+
+/*! \brief contacts flushed by the timer in the current db transaction */
+typedef struct ul_wb_batch
+{
+	int active;				   /*!< db transaction started */
+	int n;					   /*!< number of contacts in batch */
+	ul_wb_batch_item_t *items; /*!< flushed contacts */
+} ul_wb_batch_t;
+
+static ul_wb_batch_t _ul_wb_batch = {0};
+
+/*!
+ * \brief Commit the contacts written by the timer in current db batch
+ *
+ * Called at the end of each hash slot, with the slot still locked, so the
+ * contacts of the batch are valid and can get back their previous state
+ * if the transaction fails, to be written again on next timer run. The
+ * expired contacts deleted from db are removed from memory only after
+ * the commit, on failure they are kept for the delete to be retried.
+ */
+void ul_wb_batch_flush(void)
+{
+	ul_wb_batch_item_t *it;
+	int ok = 1;
+	int i;
+
+	if(_ul_wb_batch.active == 0) {
+		return;
+	}
+	if(ul_dbf.end_transaction(ul_dbh) < 0) {
+		LM_ERR("failed to commit %d contacts to database\n", _ul_wb_batch.n);
+		if(ul_dbf.abort_transaction) {
+			ul_dbf.abort_transaction(ul_dbh);
+		}
+		ok = 0;
+	}
+	for(i = 0; i < _ul_wb_batch.n; i++) {
+		it = &_ul_wb_batch.items[i];
+		if(ok == 0) {
+			it->c->state = it->state;
+		} else if(it->del) {
+			mem_delete_ucontact(it->r, it->c);
+			if(it->r->contacts == NULL) {
+				mem_delete_urecord(it->r->slot->d, it->r);
+			}
+		}
+	}
+	_ul_wb_batch.active = 0;
+	_ul_wb_batch.n = 0;
+}
+
+/*!
+ * \brief Add a flushed contact to the db batch, starting the transaction
+ * \param _r record of the contact
+ * \param _c flushed contact
+ * \param _s state of contact before flushing
+ * \param _del set if the contact is deleted from db
+ * \return 1 if the contact is in the batch, 0 if no batch is used
+ */
+static int ul_wb_batch_add(
+		urecord_t *_r, ucontact_t *_c, cstate_t _s, int _del)
+{
+	ul_wb_batch_item_t *it;
+
+	if(ul_db_batch_write <= 0 || ul_dbh == NULL
+			|| ul_dbf.start_transaction == NULL
+			|| ul_dbf.end_transaction == NULL) {
+		return 0;
+	}
+	if(_ul_wb_batch.items == NULL) {
+		_ul_wb_batch.items = (ul_wb_batch_item_t *)pkg_malloc(
+				ul_db_batch_write * sizeof(ul_wb_batch_item_t));
+		if(_ul_wb_batch.items == NULL) {
+			PKG_MEM_ERROR;
+			ul_db_batch_write = 0;
+			return 0;
+		}
+	}
+	if(_ul_wb_batch.n >= ul_db_batch_write) {
+		ul_wb_batch_flush();
+	}
+	if(_ul_wb_batch.active == 0) {
+		if(ul_dbf.start_transaction(ul_dbh, DB_LOCKING_NONE) < 0) {
+			LM_ERR("failed to start db transaction\n");
+			return 0;
+		}
+		_ul_wb_batch.active = 1;
+	}
+	it = &_ul_wb_batch.items[_ul_wb_batch.n];
+	it->r = _r;
+	it->c = _c;
+	it->state = _s;
+	it->del = _del;
+	_ul_wb_batch.n++;
+	return 1;
+}
+
 /*!
  * \brief Write-back timer, used for WRITE_BACK db_mode
  *
@@ -377,6 +488,7 @@ static inline void wb_timer(urecord_t *_r)
 {
 	ucontact_t *ptr, *t;
 	cstate_t old_state;
+	int batched;
 	int op;
 	int res;
 
@@ -395,17 +507,20 @@ static inline void wb_timer(urecord_t *_r)
 		}
 
 		if(!VALID_CONTACT(ptr, ul_act_time)) {
-			/* run callbacks for EXPIRE event */
-			if(exists_ulcb_type(UL_CONTACT_EXPIRE)) {
-				run_ul_callbacks(UL_CONTACT_EXPIRE, ptr);
-			}
+			/* contact kept after a failed batch delete is expired already */
+			if(!(ptr->flags & FL_EXPCLB)) {
+				/* run callbacks for EXPIRE event */
+				if(exists_ulcb_type(UL_CONTACT_EXPIRE)) {
+					run_ul_callbacks(UL_CONTACT_EXPIRE, ptr);
+				}
 
-			LM_DBG("Binding '%.*s','%.*s' has expired\n", ptr->aor->len,
-					ZSW(ptr->aor->s), ptr->c.len, ZSW(ptr->c.s));
-			update_stat(_r->slot->d->expires, 1);
+				LM_DBG("Binding '%.*s','%.*s' has expired\n", ptr->aor->len,
+						ZSW(ptr->aor->s), ptr->c.len, ZSW(ptr->c.s));
+				update_stat(_r->slot->d->expires, 1);
 
-			if(ul_close_expired_tcp && is_valid_tcpconn(ptr)) {
-				close_connection(ptr->tcpconn_id);
+				if(ul_close_expired_tcp && is_valid_tcpconn(ptr)) {
+					close_connection(ptr->tcpconn_id);
+				}
 			}
 
 			t = ptr;
@@ -413,15 +528,22 @@ static inline void wb_timer(urecord_t *_r)
 
 			/* Should we remove the contact from the database ? */
 			if(st_expired_ucontact(t) == 1) {
+				batched = ul_wb_batch_add(_r, t, t->state, 1);
 				if(db_delete_ucontact(t) < 0) {
 					LM_ERR("failed to delete contact from the database"
 						   " (aor: %.*s)\n",
 							t->aor->len, ZSW(t->aor->s));
 				}
+				if(batched) {
+					/* removed from memory after commit */
+					t->flags |= FL_EXPCLB;
+					continue;
+				}
 			}
 
 			mem_delete_ucontact(_r, t);
 		} else {
+			ptr->flags &= ~FL_EXPCLB;
 			/* Determine the operation we have to do */
 			old_state = ptr->state;
 			op = st_flush_ucontact(ptr);
@@ -431,6 +553,7 @@ static inline void wb_timer(urecord_t *_r)
 					break;
 
 				case 1: /* insert */
+					ul_wb_batch_add(_r, ptr, old_state, 0);
 					if(db_insert_ucontact(ptr) < 0) {
 						LM_ERR("inserting contact into database failed"
 							   " (aor: %.*s)\n",
@@ -440,6 +563,7 @@ static inline void wb_timer(urecord_t *_r)
 					break;
 
 				case 2: /* update */
+					ul_wb_batch_add(_r, ptr, old_state, 0);
 					if(ul_db_update_as_insert)
 						res = db_insert_ucontact(ptr);
 					else
@@ -671,6 +795,8 @@ int delete_ucontact(urecord_t *_r, struct ucontact *_c)
 		}
 
 		mem_delete_ucontact(_r, _c);
+	} else {
+		slot_mark_ucontact(_r->slot, _c);
 	}
 
 	return ret;
@@ -109,6 +109,12 @@ void mem_delete_ucontact(urecord_t *_r, ucontact_t *_c);
 void timer_urecord(urecord_t *_r);
 
 
+/*!
+ * \brief Commit the contacts written by the timer in current db batch
+ */
+void ul_wb_batch_flush(void);
+
+
 /*!
  * \brief Delete a record from the database
  * \param _r deleted record
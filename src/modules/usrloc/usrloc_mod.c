@@ -51,6 +51,11 @@
 #include "../../core/globals.h"
 #include "../../core/ut.h" /* str_init */
 #include "../../core/utils/sruid.h"
+#include "../../core/pt.h"
+#include "../../core/daemonize.h"
+#include "../../core/atomic_ops.h"
+#include "../../core/mem/shm_mem.h"
+#include "../../core/cfg/cfg_struct.h"
 #include "dlist.h"	  /* register_udomain */
 #include "udomain.h"  /* {insert,delete,get,release}_urecord */
 #include "urecord.h"  /* {insert,delete,get}_ucontact */
@@ -84,6 +89,7 @@ MODULE_VERSION
 #define CON_ID_COL "connection_id"
 #define KEEPALIVE_COL "keepalive"
 #define PARTITION_COL "partition"
+#define ID_COL "id"
 
 #define ULATTRS_USER_COL "username"
 #define ULATTRS_DOMAIN_COL "domain"
@@ -102,13 +108,26 @@ static void ul_local_timer(
 static void ul_db_clean_timer(
 		unsigned int ticks, void *param); /*!< DB clean timer handler */
 static int child_init(int rank);		  /*!< Per-child init function */
+static void ul_preload_exec(int idx);	  /*!< Preload process function */
 static int ul_sip_reply_received(sip_msg_t *msg); /*!< SIP response handling */
 
 #define UL_PRELOAD_SIZE 8
+#define UL_PRELOAD_IDLE_INTERVAL 3600
 static char *ul_preload_list[UL_PRELOAD_SIZE];
 static int ul_preload_index = 0;
 static int ul_preload_param(modparam_t type, void *val);
 
+/*! \brief range of ids of a table loaded by preload processes */
+typedef struct ul_preload_range
+{
+	unsigned long idmin; /*!< first id in the table */
+	unsigned long idmax; /*!< id after the last one, 0 to load all records */
+	int nprocs;			 /*!< number of processes loading the table */
+} ul_preload_range_t;
+static ul_preload_range_t *ul_preload_ranges = NULL;
+static int *ul_preload_pending = NULL; /*!< preload processes not done */
+static int ul_preload_prepare(void);
+
 extern int bind_usrloc(usrloc_api_t *api);
 int ul_db_update_as_insert = 0;
 int ul_timer_procs = 0;
@@ -122,6 +141,9 @@ int ul_rm_expired_delay = 0;
 int ul_version_table = 1;
 
 int ul_load_rank = PROC_SIPINIT;
+int ul_preload_procs = 0;
+int ul_dirty_sweep = 0;
+int ul_db_batch_write = 0;
 str ul_xavp_contact_name = {0};
 
 str ul_ka_from = str_init("sip:server@kamailio.org");
@@ -185,6 +207,7 @@ str ul_keepalive_col = str_init(
 		KEEPALIVE_COL); /*!< Name of column containing the keepalive value */
 str ul_partition_col = str_init(
 		PARTITION_COL); /*!< Name of column containing the partition value */
+str ul_id_col = str_init(ID_COL); /*!< Name of column containing the row id */
 
 str ulattrs_user_col =
 		str_init(ULATTRS_USER_COL); /*!< Name of column containing username */
@@ -278,6 +301,7 @@ static param_export_t params[] = {
 	{"connection_id_column", PARAM_STR, &ul_con_id_col},
 	{"keepalive_column", PARAM_STR, &ul_keepalive_col},
 	{"partition_column", PARAM_STR, &ul_partition_col},
+	{"id_column", PARAM_STR, &ul_id_col},
 	{"matching_mode", PARAM_INT, &ul_matching_mode},
 	{"cseq_delay", PARAM_INT, &ul_cseq_delay},
 	{"fetch_rows", PARAM_INT, &ul_fetch_rows},
@@ -311,6 +335,9 @@ static param_export_t params[] = {
 	{"ka_logmsg", PARAM_STR, &ul_ka_logmsg},
 	{"ka_reply_codes", PARAM_STRING, &ul_ka_reply_codes_str},
 	{"load_rank", PARAM_INT, &ul_load_rank},
+	{"preload_procs", PARAM_INT, &ul_preload_procs},
+	{"dirty_sweep", PARAM_INT, &ul_dirty_sweep},
+	{"db_batch_write", PARAM_INT, &ul_db_batch_write},
 	{"db_clean_tcp", PARAM_INT, &ul_db_clean_tcp},
 	{0, 0, 0}
 };
@@ -392,8 +419,33 @@ static int mod_init(void)
 			LM_ERR("invalid matching mode %d\n", ul_matching_mode);
 	}
 
+	if(ul_preload_procs > 0) {
+		if(ul_db_load == 0
+				|| (ul_db_mode != WRITE_THROUGH && ul_db_mode != WRITE_BACK
+						&& ul_db_mode != DB_READONLY)) {
+			LM_INFO("no db preload for the db mode - ignoring preload_procs\n");
+			ul_preload_procs = 0;
+		} else {
+			ul_preload_pending = (int *)shm_malloc(sizeof(int));
+			if(ul_preload_pending == NULL) {
+				SHM_MEM_ERROR;
+				return -1;
+			}
+			*ul_preload_pending = ul_preload_procs;
+			register_procs(ul_preload_procs);
+			cfg_register_child(ul_preload_procs);
+		}
+	}
+
 	/* Register cache timer */
-	if(ul_timer_procs <= 0) {
+	if(ul_preload_procs > 0 && ul_timer_interval > 0) {
+		/* the preload processes run the timer once their range is loaded */
+		if(ul_timer_procs > 0 && ul_timer_procs != ul_preload_procs) {
+			LM_INFO("timer_procs set to preload_procs (%d)\n",
+					ul_preload_procs);
+		}
+		ul_timer_procs = ul_preload_procs;
+	} else if(ul_timer_procs <= 0) {
 		if(ul_timer_interval > 0) {
 			register_timer(ul_core_timer, 0, ul_timer_interval);
 		}
@@ -488,11 +540,40 @@ static int child_init(int _rank)
 {
 	dlist_t *ptr;
 	int i;
+	int pid;
 
 	if(sruid_init(&_ul_sruid, '-', "ulcx", SRUID_INC) < 0)
 		return -1;
 
-	if(_rank == PROC_MAIN && ul_timer_procs > 0) {
+	if(_rank == PROC_INIT && ul_preload_procs > 0) {
+		/* records are loaded by preload processes while serving traffic */
+		for(ptr = _ksr_ul_root; ptr; ptr = ptr->next) {
+			udomain_preload_reset(ptr->d);
+		}
+	}
+
+	if(_rank == PROC_MAIN && ul_preload_procs > 0) {
+		if(ul_preload_prepare() < 0) {
+			LM_ERR("failed to prepare the preload of location records\n");
+			return -1;
+		}
+		for(i = 0; i < ul_preload_procs; i++) {
+			pid = fork_process(PROC_NOCHLDINIT, "USRLOC Preload Timer", 1);
+			if(pid < 0) {
+				LM_ERR("failed to start preload process\n");
+				return -1; /* error */
+			}
+			if(pid == 0) {
+				/* child */
+				if(cfg_child_init()) {
+					return -1;
+				}
+				ul_preload_exec(i);
+			}
+		}
+	}
+
+	if(_rank == PROC_MAIN && ul_timer_procs > 0 && ul_preload_procs <= 0) {
 		for(i = 0; i < ul_timer_procs; i++) {
 			if(fork_sync_timer(PROC_TIMER, "USRLOC Timer", 1 /*socks flag*/,
 					   ul_local_timer, (void *)(long)i,
@@ -520,13 +601,14 @@ static int child_init(int _rank)
 			/* connect to db only from TIMER (for flush), from MAIN (for
 			 * final flush() and from child 1 for preload */
 			if(_rank != PROC_TIMER && _rank != PROC_POSTCHILDINIT
-					&& _rank != PROC_SIPINIT)
+					&& _rank != PROC_SIPINIT
+					&& !(ul_preload_procs > 0 && _rank > 0))
 				return 0;
 			break;
 		case DB_READONLY:
 			/* connect to db only from child 1 for preload */
 			ul_db_load = 1; /* we always load from the db in this mode */
-			if(_rank != PROC_SIPINIT)
+			if(_rank != PROC_SIPINIT && !(ul_preload_procs > 0 && _rank > 0))
 				return 0;
 			break;
 	}
@@ -537,7 +619,8 @@ static int child_init(int _rank)
 		return -1;
 	}
 	/* _rank==PROC_SIPINIT is used even when fork is disabled */
-	if(_rank == ul_load_rank && ul_db_mode != DB_ONLY && ul_db_load) {
+	if(_rank == ul_load_rank && ul_db_mode != DB_ONLY && ul_db_load
+			&& ul_preload_procs <= 0) {
 		/* if cache is used, populate domains from DB */
 		for(ptr = _ksr_ul_root; ptr; ptr = ptr->next) {
 			if(preload_udomain(ul_dbh, ptr->d) < 0) {
@@ -553,6 +636,154 @@ static int child_init(int _rank)
 }
 
 
+/*! \brief
+ * Split the preloaded tables in ranges of ids for the preload processes
+ *
+ * Done in main process before forking the preload processes, together
+ * with the removal of the tcp records, so the loading does not race with
+ * the cleanup.
+ */
+static int ul_preload_prepare(void)
+{
+	db1_con_t *con;
+	dlist_t *ptr;
+	unsigned long idmin;
+	unsigned long idmax;
+	int ret;
+	int n;
+	int i;
+
+	n = 0;
+	for(ptr = _ksr_ul_root; ptr; ptr = ptr->next) {
+		n++;
+	}
+	if(n == 0) {
+		return 0;
+	}
+	ul_preload_ranges =
+			(ul_preload_range_t *)pkg_malloc(n * sizeof(ul_preload_range_t));
+	if(ul_preload_ranges == NULL) {
+		PKG_MEM_ERROR;
+		return -1;
+	}
+	memset(ul_preload_ranges, 0, n * sizeof(ul_preload_range_t));
+
+	con = ul_dbf.init(&ul_db_url);
+	if(con == NULL) {
+		LM_ERR("failed to connect to database\n");
+		return -1;
+	}
+	for(ptr = _ksr_ul_root, i = 0; ptr; ptr = ptr->next, i++) {
+		if(ul_db_clean_tcp != 0) {
+			uldb_delete_tcp_records(con, ptr->d);
+		}
+		ret = uldb_preload_id_bounds(con, ptr->d, &idmin, &idmax);
+		if(ret < 0) {
+			ul_dbf.close(con);
+			return -1;
+		}
+		if(ret == 1) {
+			LM_INFO("no raw query support - table '%.*s' loaded by one "
+					"process\n",
+					ptr->name.len, ZSW(ptr->name.s));
+			ul_preload_ranges[i].nprocs = 1;
+			continue;
+		}
+		if(idmax == 0) {
+			/* empty table */
+			continue;
+		}
+		ul_preload_ranges[i].idmin = idmin;
+		ul_preload_ranges[i].idmax = idmax + 1;
+		ul_preload_ranges[i].nprocs = ul_preload_procs;
+		if(idmax - idmin + 1 < (unsigned long)ul_preload_procs) {
+			ul_preload_ranges[i].nprocs = (int)(idmax - idmin + 1);
+		}
+	}
+	ul_dbf.close(con);
+
+	return 0;
+}
+
+
+/*! \brief
+ * Preload process - load the records for a range of ids of each table,
+ * then run the timer for the partition of the same index
+ *
+ * The last process finishing the load adds the contact attributes and
+ * marks the hash slots as loaded. A failure stops the process, which makes
+ * the main process shut down like for a failed preload at startup.
+ */
+static void ul_preload_exec(int idx)
+{
+	ul_preload_range_t *pr;
+	unsigned long span;
+	dlist_t *ptr;
+	ticks_t ts1;
+	ticks_t ts2;
+	int interval;
+	int i;
+
+	ul_dbh = ul_dbf.init(&ul_db_url);
+	if(!ul_dbh) {
+		LM_CRIT("preload process %d: failed to connect to database\n", idx);
+		ksr_exit(-1);
+	}
+	for(ptr = _ksr_ul_root, i = 0; ptr; ptr = ptr->next, i++) {
+		pr = &ul_preload_ranges[i];
+		if(idx >= pr->nprocs) {
+			continue;
+		}
+		span = pr->idmax - pr->idmin;
+		if(preload_udomain_range(ul_dbh, ptr->d,
+				   pr->idmin + span * idx / pr->nprocs,
+				   (pr->idmax == 0)
+						   ? 0
+						   : pr->idmin + span * (idx + 1) / pr->nprocs)
+				< 0) {
+			LM_CRIT("preload process %d: failed to preload domain "
+					"'%.*s'\n",
+					idx, ptr->name.len, ZSW(ptr->name.s));
+			ksr_exit(-1);
+		}
+	}
+	if(atomic_dec_and_test_int(ul_preload_pending)) {
+		/* all contacts are in cache */
+		for(ptr = _ksr_ul_root; ptr; ptr = ptr->next) {
+			uldb_preload_attrs(ptr->d);
+			udomain_preload_done(ptr->d);
+		}
+		LM_INFO("preload of location records completed\n");
+	}
+
+	if(ul_timer_interval <= 0) {
+		/* no timer work, the process cannot exit without stopping all */
+		ul_dbf.close(ul_dbh);
+		ul_dbh = 0;
+		for(;;) {
+			sleep(UL_PRELOAD_IDLE_INTERVAL);
+		}
+	}
+
+	/* timer for partition idx, the connection is kept for db sync */
+	interval = ul_timer_interval * 1000;
+	ts2 = interval;
+	for(;;) {
+		if(ksr_shutdown_phase() != 0) {
+			ksr_exit(0);
+		}
+		if(ts2 > interval)
+			sleep_us(1000);
+		else
+			sleep_us(ts2 * 1000);
+		ts1 = get_ticks_raw();
+		cfg_update();
+		ul_local_timer(TICKS_TO_S(ts1), (void *)(long)idx);
+		ts2 = interval - TICKS_TO_MS(get_ticks_raw()) + TICKS_TO_MS(ts1);
+	}
+}
+
+
 /*! \brief
  * Module destroy function
  */
@@ -64,6 +64,7 @@ extern str ul_srv_id_col;
 extern str ul_con_id_col;
 extern str ul_keepalive_col;
 extern str ul_partition_col;
+extern str ul_id_col;
 extern str ul_last_mod_col;
 
 extern str ulattrs_user_col;
@@ -83,6 +84,9 @@ extern int ul_use_domain;
 extern int ul_desc_time_order;
 extern int ul_cseq_delay;
 extern int ul_fetch_rows;
+extern int ul_preload_procs;
+extern int ul_dirty_sweep;
+extern int ul_db_batch_write;
 extern int ul_hash_size;
 extern int ul_db_update_as_insert;
 extern int ul_db_check_update;
@@ -0,0 +1,532 @@
+/*
+ * Copyright (C) 2026 kamailio.org
+ *
+ * This file is part of Kamailio, a free SIP server.
+ *
+ * Kamailio is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version
+ *
+ * Kamailio is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/*
+ * Builds the prebuilt tree files served by the mtree module with mode=2
+ * from a text file with one "prefix value" record per line. The string
+ * trees (type 0) are served also by the pdt module ("prefix domain"
+ * records, file parameter) and the prefix_route module ("prefix route_name"
+ * records, file parameter).
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <ctype.h>
+
+#include "mtree_mfile.h"
+
+#define MTB_MAX_DEPTH 64 /* same as MT_MAX_DEPTH of the module */
+#define MTB_CELL_NONE 0xffffffff
+
+typedef struct mtb_rec
+{
+	unsigned char *key; /* prefix as char list indexes */
+	uint32_t klen;
+	uint32_t line;
+	char *value;
+	uint32_t vlen;
+} mtb_rec_t;
+
+typedef struct mtb_build
+{
+	mt_mcell_t *cells;
+	uint32_t ncells; /* allocated */
+	uint32_t nused;
+	uint32_t nfree;
+	mt_mvalue_t *values;
+	uint32_t nvalues;
+	uint32_t avalues;
+	mt_mitem_t *items;
+	uint32_t nitems;
+	uint32_t aitems;
+	mt_mdw_t *dw;
+	uint32_t ndw;
+	uint32_t adw;
+	char *strs;
+	uint64_t strsize;
+	uint64_t astrs;
+} mtb_build_t;
+
+static char *mtb_chars = "0123456789";
+static int mtb_nchars = 10;
+static unsigned char mtb_table[256];
+static int mtb_type = 0;
+static int mtb_dups = 0; /* 0 - error, 1 - ignore, 2 - allow */
+static int mtb_verbose = 0;
+static mtb_build_t mtb;
+
+static void usage(char *name)
+{
+	fprintf(stderr,
+			"usage: %s -i <input> -o <output> [-t <type>] [-c <char list>]"
+			" [-d ignore|allow] [-v]\n\n"
+			"  -i <input>     text file with one 'prefix value' per line, '-' "
+			"for stdin\n"
+			"  -o <output>    tree file, written next to it and renamed over "
+			"it\n"
+			"  -t <type>      tree type: 0 - string (default), 1 - dstid=weight "
+			"list,\n"
+			"                 2 - integer\n"
+			"  -c <chars>     prefix char list, as set with the module "
+			"char_list\n"
+			"                 parameter (default 0123456789)\n"
+			"  -d <mode>      on duplicated prefixes keep the first record "
+			"(ignore) or\n"
+			"                 store all records (allow), default is to stop "
+			"with error\n"
+			"  -v             print statistics\n",
+			name);
+}
+
+static void *mtb_grow(void *p, uint32_t *size, uint32_t need, size_t isize)
+{
+	uint32_t n;
+
+	if(need <= *size)
+		return p;
+	n = (*size < 1024) ? 1024 : *size + *size / 2;
+	if(n < need)
+		n = need;
+	p = realloc(p, (size_t)n * isize);
+	if(p == NULL) {
+		fprintf(stderr, "error: out of memory\n");
+		exit(1);
+	}
+	*size = n;
+	return p;
+}
+
+static void mtb_grow_cells(uint32_t need)
+{
+	uint32_t i, old;
+
+	old = mtb.ncells;
+	mtb.cells = (mt_mcell_t *)mtb_grow(
+			mtb.cells, &mtb.ncells, need, sizeof(mt_mcell_t));
+	for(i = old; i < mtb.ncells; i++) {
+		mtb.cells[i].base = 0;
+		mtb.cells[i].check = MTB_CELL_NONE;
+		mtb.cells[i].vidx = 0;
+	}
+}
+
+static uint32_t mtb_add_str(char *s, uint32_t len)
+{
+	uint64_t off;
+
+	if(mtb.strsize + len + 1 > mtb.astrs) {
+		mtb.astrs = (mtb.astrs < 65536) ? 65536 : mtb.astrs * 2;
+		while(mtb.strsize + len + 1 > mtb.astrs)
+			mtb.astrs *= 2;
+		mtb.strs = (char *)realloc(mtb.strs, mtb.astrs);
+		if(mtb.strs == NULL) {
+			fprintf(stderr, "error: out of memory\n");
+			exit(1);
+		}
+	}
+	if(mtb.strsize + len + 1 > UINT32_MAX) {
+		fprintf(stderr, "error: too much string data\n");
+		exit(1);
+	}
+	off = mtb.strsize;
+	memcpy(mtb.strs + off, s, len);
+	mtb.strs[off + len] = '\0';
+	mtb.strsize += len + 1;
+	return (uint32_t)off;
+}
+
+/* parse dstid=weight;... the way the module parses the values */
+static void mtb_add_dw(mt_mvalue_t *mv, char *s, uint32_t len)
+{
+	char *p, *end, *e;
+
+	mv->dw = mtb.ndw;
+	end = s + len;
+	if(len > 0 && end[-1] == ';')
+		end--;
+	p = s;
+	while(p < end) {
+		for(e = p; e < end && *e != ';'; e++)
+			;
+		while(p < e && isspace((unsigned char)*p))
+			p++;
+		if(p < e) {
+			mtb.dw = (mt_mdw_t *)mtb_grow(
+					mtb.dw, &mtb.adw, mtb.ndw + 1, sizeof(mt_mdw_t));
+			mtb.dw[mtb.ndw].dstid = (uint32_t)strtoul(p, &p, 10);
+			while(p < e && *p != '=')
+				p++;
+			mtb.dw[mtb.ndw].weight =
+					(p < e) ? (uint32_t)strtoul(p + 1, NULL, 10) : 0;
+			mtb.ndw++;
+		}
+		p = e + 1;
+	}
+	/* the module prepends the parsed pairs */
+	for(len = 0; len < (mtb.ndw - mv->dw) / 2; len++) {
+		mt_mdw_t t = mtb.dw[mv->dw + len];
+		mtb.dw[mv->dw + len] = mtb.dw[mtb.ndw - 1 - len];
+		mtb.dw[mtb.ndw - 1 - len] = t;
+	}
+	mv->ndw = mtb.ndw - mv->dw;
+}
+
+/* store the values of records [lo, hi) for cell t, newest first */
+static void mtb_set_values(uint32_t t, mtb_rec_t *recs, size_t lo, size_t hi)
+{
+	mt_mvalue_t *mv;
+	mt_mitem_t *mi;
+	size_t i;
+	char *ep;
+	long n;
+
+	if(hi - lo > 1 && mtb_dups != 2) {
+		if(mtb_dups == 0) {
+			fprintf(stderr, "error: duplicated prefix at line %u\n",
+					recs[lo].line);
+			exit(1);
+		}
+		/* keep the first one in the input */
+		lo = hi - 1;
+	}
+	mtb.values = (mt_mvalue_t *)mtb_grow(
+			mtb.values, &mtb.avalues, mtb.nvalues + 1, sizeof(mt_mvalue_t));
+	mv = &mtb.values[mtb.nvalues];
+	memset(mv, 0, sizeof(mt_mvalue_t));
+	mv->item = mtb.nitems;
+	for(i = lo; i < hi; i++) {
+		mtb.items = (mt_mitem_t *)mtb_grow(
+				mtb.items, &mtb.aitems, mtb.nitems + 1, sizeof(mt_mitem_t));
+		mi = &mtb.items[mtb.nitems++];
+		memset(mi, 0, sizeof(mt_mitem_t));
+		if(mtb_type == 2) {
+			errno = 0;
+			n = strtol(recs[i].value, &ep, 10);
+			if(errno != 0 || ep != recs[i].value + recs[i].vlen
+					|| recs[i].vlen == 0 || n < INT32_MIN || n > INT32_MAX) {
+				fprintf(stderr, "error: bad integer value at line %u\n",
+						recs[i].line);
+				exit(1);
+			}
+			mi->n = (int32_t)n;
+		} else {
+			mi->soff = mtb_add_str(recs[i].value, recs[i].vlen);
+			mi->slen = recs[i].vlen;
+		}
+	}
+	mv->nitems = mtb.nitems - mv->item;
+	if(mtb_type == 1) {
+		mtb_add_dw(mv, recs[lo].value, recs[lo].vlen);
+	}
+	mtb.nvalues++;
+	mtb.cells[t].vidx = mtb.nvalues;
+}
+
+/* place the children of cell s, records [lo, hi) have the prefix of s and
+ * are longer than d */
+static void mtb_place(uint32_t s, mtb_rec_t *recs, size_t lo, size_t hi,
+		uint32_t d)
+{
+	size_t i, j, k;
+	uint32_t b, t;
+	int cmin, cmax;
+	unsigned char used[256];
+
+	memset(used, 0, sizeof(used));
+	for(i = lo; i < hi; i++)
+		used[recs[i].key[d]] = 1;
+	cmin = recs[lo].key[d];
+	cmax = recs[hi - 1].key[d];
+
+	b = (mtb.nfree > (uint32_t)cmin + 1) ? mtb.nfree - cmin : 1;
+	while(1) {
+		if(b + cmax >= mtb.ncells)
+			mtb_grow_cells(b + cmax + 1);
+		for(k = cmin; k <= cmax; k++) {
+			if(used[k] && mtb.cells[b + k].check != MTB_CELL_NONE)
+				break;
+		}
+		if(k > cmax)
+			break;
+		b++;
+	}
+	mtb.cells[s].base = b;
+	for(k = cmin; k <= cmax; k++) {
+		if(!used[k])
+			continue;
+		mtb.cells[b + k].check = s;
+		if(b + k >= mtb.nused)
+			mtb.nused = b + k + 1;
+	}
+	while(mtb.nfree < mtb.ncells && mtb.cells[mtb.nfree].check != MTB_CELL_NONE)
+		mtb.nfree++;
+
+	/* records are sorted - one group per child char */
+	for(i = lo; i < hi; i = j) {
+		t = b + recs[i].key[d];
+		for(j = i; j < hi && recs[j].key[d] == recs[i].key[d]; j++)
+			;
+		/* records ending at this char come first */
+		for(k = i; k < j && recs[k].klen == d + 1; k++)
+			;
+		if(k > i)
+			mtb_set_values(t, recs, i, k);
+		if(k < j)
+			mtb_place(t, recs, k, j, d + 1);
+	}
+}
+
+static int mtb_rec_cmp(const void *a, const void *b)
+{
+	const mtb_rec_t *ra = (const mtb_rec_t *)a;
+	const mtb_rec_t *rb = (const mtb_rec_t *)b;
+	uint32_t n;
+	int r;
+
+	n = (ra->klen < rb->klen) ? ra->klen : rb->klen;
+	r = memcmp(ra->key, rb->key, n);
+	if(r != 0)
+		return r;
+	if(ra->klen != rb->klen)
+		return (ra->klen < rb->klen) ? -1 : 1;
+	/* newest record first, like in the module lists */
+	return (ra->line < rb->line) ? 1 : -1;
+}
+
+static mtb_rec_t *mtb_read(FILE *f, size_t *nrecs)
+{
+	mtb_rec_t *recs = NULL;
+	size_t n = 0, a = 0;
+	char *line = NULL;
+	size_t lsize = 0;
+	ssize_t len;
+	uint32_t lno = 0;
+	char *p, *v;
+	uint32_t i, klen;
+
+	while((len = getline(&line, &lsize, f)) >= 0) {
+		lno++;
+		while(len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+			line[--len] = '\0';
+		p = line;
+		while(*p == ' ' || *p == '\t')
+			p++;
+		if(*p == '\0' || *p == '#')
+			continue;
+		for(v = p; *v != '\0' && *v != ' ' && *v != '\t'; v++)
+			;
+		klen = v - p;
+		while(*v == ' ' || *v == '\t')
+			v++;
+		if(*v == '\0') {
+			fprintf(stderr, "error: no value at line %u\n", lno);
+			exit(1);
+		}
+		if(klen >= MTB_MAX_DEPTH) {
+			fprintf(stderr, "error: prefix too long at line %u\n", lno);
+			exit(1);
+		}
+		if(n == a) {
+			a = (a == 0) ? 65536 : a * 2;
+			recs = (mtb_rec_t *)realloc(recs, a * sizeof(mtb_rec_t));
+			if(recs == NULL) {
+				fprintf(stderr, "error: out of memory\n");
+				exit(1);
+			}
+		}
+		recs[n].key = (unsigned char *)malloc(klen);
+		recs[n].value = strdup(v);
+		if(recs[n].key == NULL || recs[n].value == NULL) {
+			fprintf(stderr, "error: out of memory\n");
+			exit(1);
+		}
+		for(i = 0; i < klen; i++) {
+			if(mtb_table[(unsigned char)p[i]] == 255) {
+				fprintf(stderr, "error: invalid char '%c' at line %u\n", p[i],
+						lno);
+				exit(1);
+			}
+			recs[n].key[i] = mtb_table[(unsigned char)p[i]];
+		}
+		recs[n].klen = klen;
+		recs[n].line = lno;
+		recs[n].vlen = strlen(v);
+		n++;
+	}
+	free(line);
+	*nrecs = n;
+	return recs;
+}
+
+static int mtb_write(char *fname)
+{
+	mt_mfile_hdr_t hdr;
+	char *tmpname;
+	FILE *f;
+	int ok;
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, MT_MFILE_MAGIC, sizeof(hdr.magic));
+	hdr.version = MT_MFILE_VERSION;
+	hdr.type = mtb_type;
+	hdr.ncells = mtb.nused;
+	hdr.nvalues = mtb.nvalues;
+	hdr.nitems = mtb.nitems;
+	hdr.ndw = mtb.ndw;
+	if(mtb.strsize == 0)
+		mtb_add_str("", 0);
+	hdr.strsize = (uint32_t)mtb.strsize;
+	hdr.nchars = mtb_nchars;
+	memcpy(hdr.chars, mtb_chars, mtb_nchars);
+	hdr.size = MT_MFILE_SIZE(&hdr);
+
+	if(asprintf(&tmpname, "%s.tmp.%d", fname, (int)getpid()) < 0) {
+		fprintf(stderr, "error: out of memory\n");
+		return -1;
+	}
+	f = fopen(tmpname, "wb");
+	if(f == NULL) {
+		fprintf(stderr, "error: cannot open %s: %s\n", tmpname,
+				strerror(errno));
+		free(tmpname);
+		return -1;
+	}
+	ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1
+		 && fwrite(mtb.cells, sizeof(mt_mcell_t), hdr.ncells, f) == hdr.ncells
+		 && fwrite(mtb.values, sizeof(mt_mvalue_t), hdr.nvalues, f)
+					== hdr.nvalues
+		 && fwrite(mtb.items, sizeof(mt_mitem_t), hdr.nitems, f) == hdr.nitems
+		 && fwrite(mtb.dw, sizeof(mt_mdw_t), hdr.ndw, f) == hdr.ndw
+		 && fwrite(mtb.strs, 1, hdr.strsize, f) == hdr.strsize;
+	if(fclose(f) != 0)
+		ok = 0;
+	if(!ok || rename(tmpname, fname) < 0) {
+		fprintf(stderr, "error: cannot write %s: %s\n", fname,
+				strerror(errno));
+		unlink(tmpname);
+		free(tmpname);
+		return -1;
+	}
+	free(tmpname);
+	if(mtb_verbose) {
+		printf("cells: %u values: %u items: %u dw: %u strings: %u size: "
+			   "%llu\n",
+				hdr.ncells, hdr.nvalues, hdr.nitems, hdr.ndw, hdr.strsize,
+				(unsigned long long)hdr.size);
+	}
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	char *input = NULL;
+	char *output = NULL;
+	mtb_rec_t *recs;
+	size_t nrecs, lo;
+	FILE *f;
+	int c;
+
+	while((c = getopt(argc, argv, "i:o:t:c:d:vh")) != -1) {
+		switch(c) {
+			case 'i':
+				input = optarg;
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			case 't':
+				mtb_type = atoi(optarg);
+				if(mtb_type < 0 || mtb_type > 2) {
+					fprintf(stderr, "error: invalid tree type\n");
+					return 1;
+				}
+				break;
+			case 'c':
+				mtb_chars = optarg;
+				break;
+			case 'd':
+				if(strcmp(optarg, "ignore") == 0) {
+					mtb_dups = 1;
+				} else if(strcmp(optarg, "allow") == 0) {
+					mtb_dups = 2;
+				} else {
+					fprintf(stderr, "error: invalid duplicates mode\n");
+					return 1;
+				}
+				break;
+			case 'v':
+				mtb_verbose = 1;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+	if(input == NULL || output == NULL) {
+		usage(argv[0]);
+		return 1;
+	}
+	mtb_nchars = strlen(mtb_chars);
+	if(mtb_nchars == 0 || mtb_nchars >= MT_MFILE_CHARS) {
+		fprintf(stderr, "error: invalid char list\n");
+		return 1;
+	}
+	memset(mtb_table, 255, sizeof(mtb_table));
+	for(c = 0; c < mtb_nchars; c++)
+		mtb_table[(unsigned char)mtb_chars[c]] = (unsigned char)c;
+
+	if(strcmp(input, "-") == 0) {
+		f = stdin;
+	} else {
+		f = fopen(input, "r");
+		if(f == NULL) {
+			fprintf(stderr, "error: cannot open %s: %s\n", input,
+					strerror(errno));
+			return 1;
+		}
+	}
+	recs = mtb_read(f, &nrecs);
+	if(f != stdin)
+		fclose(f);
+	if(nrecs == 0) {
+		fprintf(stderr, "error: no records in %s\n", input);
+		return 1;
+	}
+	qsort(recs, nrecs, sizeof(mtb_rec_t), mtb_rec_cmp);
+
+	memset(&mtb, 0, sizeof(mtb));
+	mtb_grow_cells(nrecs + nrecs / 4 + mtb_nchars + 1);
+	mtb.cells[0].check = 0;
+	mtb.nused = 1;
+	mtb.nfree = 1;
+	/* prefixes have at least one char */
+	for(lo = 0; lo < nrecs && recs[lo].klen == 0; lo++)
+		;
+	if(lo < nrecs)
+		mtb_place(0, recs, lo, nrecs, 0);
+
+	if(mtb_verbose)
+		printf("records: %zu\n", nrecs);
+	return (mtb_write(output) < 0) ? 1 : 0;
+}